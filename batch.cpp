@@ -0,0 +1,207 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy trybu wsadowego.
+ *  \file
+ *
+ */
+
+#include "batch.hpp"
+
+BATCH::BATCH(const string& host, uint16_t port, unsigned workers)
+: m_host(host), m_port(port), m_workers(max(1u, workers)) {}
+
+void BATCH::set_profile(const SOCKBASE::PROFILE& profile)
+{
+	m_profile = profile;
+}
+
+bool BATCH::run(const vector<TASK>& tasks)
+{
+	using clock = chrono::steady_clock;
+
+	const auto start = clock::now();
+
+	atomic<size_t> next(0); // Indeks kolejnej operacji
+	vector<thread> pool;
+
+	m_results.assign(tasks.size(), RESULT());
+
+	for (unsigned i = 0; i < min<size_t>(m_workers, max<size_t>(1, tasks.size())); ++i)
+		pool.emplace_back([this, &tasks, &next] (void)
+		{
+			for (size_t i; (i = next++) < tasks.size();)
+			{
+				const auto& task = tasks[i];
+				auto& result = m_results[i];
+
+				// Brak połączenia z serwerem pozostawia błąd połączenia
+				result.error = RESULT::ERROR::Connection;
+
+				// Połączenie z puli mogło zostać zamknięte przez serwer - ponów
+				// operację jednokrotnie na nowym połączeniu
+				for (int attempt = 0; attempt < 2 && result.error == RESULT::ERROR::Connection; ++attempt)
+				{
+					bool reused = false;
+					auto client = acquire(reused);
+
+					if (!client) break;
+
+					result = task.upload ? client->push(task.remote, task.local) :
+									   client->fetch(task.remote, task.local);
+
+					// Błąd połączenia - połączenie nie wraca do puli
+					if (result.error != RESULT::ERROR::Connection) release(move(client));
+					else if (!reused) break;
+				}
+			}
+		});
+
+	for (auto& t : pool) t.join();
+
+	const double seconds = chrono::duration<double>(clock::now() - start).count();
+
+	size_t done(0);
+	uint64_t bytes(0);
+
+	// Wyświetl wyniki poszczególnych operacji
+	for (size_t i = 0; i < tasks.size(); ++i)
+	{
+		const auto& r = m_results[i];
+
+		cout << (r.ok() ? "OK" : "FAIL") << '\t'
+			<< (tasks[i].upload ? "upload" : "download") << '\t'
+			<< tasks[i].remote << '\t';
+
+		if (r.ok()) cout << r.bytes << " B\t" << r.seconds * 1000 << " ms\n";
+		else cout << '(' << r.what() << ')' << '\n';
+
+		done += r.ok();
+		bytes += r.bytes;
+	}
+
+	cout << "Completed tasks:\t" << done << '/' << tasks.size() << '\n'
+		<< "Transferred data:\t" << bytes << " B in " << seconds << " s ("
+		<< bytes / max(seconds, 1e-9) / (1 << 20) << " MiB/s)\n";
+
+	// Zamknij połączenia z puli
+	m_idle.clear();
+
+	return done == tasks.size();
+}
+
+const vector<BATCH::RESULT>& BATCH::results(void) const
+{
+	return m_results;
+}
+
+bool BATCH::parse(istream& in, vector<TASK>& tasks, size_t& line)
+{
+	string text;
+
+	for (line = 1; getline(in, text); ++line)
+	{
+		istringstream stream(text);
+		vector<string> words;
+
+		for (string word; stream >> word;) words.push_back(word);
+
+		// Pomiń puste wiersze i komentarze
+		if (words.empty() || words[0][0] == '#') continue;
+		else if (words.size() < 2 || words.size() > 3) return false;
+
+		const string& local = words.back();
+
+		if (words[0] == "upload" || words[0] == "put") tasks.push_back({ true, words[1], local });
+		else if (words[0] == "download" || words[0] == "get") tasks.push_back({ false, words[1], local });
+		else return false;
+	}
+
+	return true;
+}
+
+unique_ptr<CLIENT> BATCH::acquire(bool& reused)
+{
+	{
+		lock_guard<mutex> guard(m_lock);
+
+		// Użyj bezczynnego połączenia, jeśli jest dostępne
+		if (!m_idle.empty())
+		{
+			auto client = move(m_idle.back());
+			m_idle.pop_back();
+
+			reused = true;
+
+			return client;
+		}
+	}
+
+	reused = false;
+
+	auto client = make_unique<CLIENT>();
+	client->set_profile(m_profile);
+
+	sockaddr_storage addr;
+	socklen_t len;
+
+	// Pobiera zapamiętany adres serwera
+	const auto cached = [this, &addr, &len] (void)
+	{
+		lock_guard<mutex> guard(m_lock);
+
+		addr = m_addr;
+		len = m_alen;
+
+		return len != 0;
+	};
+
+	// Rozwiąż adres tylko przy pierwszym połączeniu - pozostałe
+	// wątki czekają na jego wynik i łączą się bezpośrednio
+	if (!cached())
+	{
+		lock_guard<mutex> resolve(m_resolve);
+
+		if (!cached())
+		{
+			if (!client->connect(m_host, m_port)) return nullptr;
+			else if (client->peer_address(addr, len))
+			{
+				lock_guard<mutex> guard(m_lock);
+
+				m_addr = addr;
+				m_alen = len;
+			}
+
+			return client;
+		}
+	}
+
+	if (!client->connect(addr, len)) return nullptr;
+
+	return client;
+}
+
+void BATCH::release(unique_ptr<CLIENT> client)
+{
+	lock_guard<mutex> guard(m_lock);
+
+	m_idle.push_back(move(client));
+}
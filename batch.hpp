@@ -0,0 +1,142 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy trybu wsadowego.
+ *  \file
+ *
+ */
+
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "client.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+
+using namespace std;
+
+/*! \brief Klasa trybu wsadowego.
+ *
+ *  Wykonuje listę operacji pobierania i wysyłania plików (manifest) przy użyciu
+ *  puli wątków. Połączenia są utrzymywane w puli i używane ponownie przez kolejne
+ *  operacje (polecenia `MGET` i `MPUT` nie zamykają połączenia), a adres serwera
+ *  rozwiązywany jest tylko przy pierwszym połączeniu.
+ *
+ *  Wiersz manifestu ma postać `download|upload PLIK [PLIK_LOKALNY]` (również
+ *  `get|put`). Puste wiersze i wiersze zaczynające się od `#` są pomijane.
+ *
+ */
+class BATCH
+{
+
+	public:
+
+		/*! \brief Operacja manifestu.
+		 *
+		 *  Pojedynczy wiersz manifestu.
+		 *
+		 */
+		struct TASK
+		{
+			bool upload; //!< Flaga wysyłania (w przeciwnym razie pobieranie).
+			string remote; //!< Nazwa pliku na serwerze.
+			string local; //!< Lokalna ścieżka pliku.
+		};
+
+		using RESULT = CLIENT::TRANSFER; //!< Wynik operacji.
+
+	protected:
+
+		string m_host; //!< Adres serwera.
+		uint16_t m_port; //!< Port serwera.
+		unsigned m_workers; //!< Liczba wątków.
+
+		SOCKBASE::PROFILE m_profile; //!< Profil strojenia gniazd.
+
+		mutex m_lock; //!< Blokada puli połączeń i adresu.
+		mutex m_resolve; //!< Blokada pierwszego rozwiązania adresu.
+		vector<unique_ptr<CLIENT>> m_idle; //!< Bezczynne połączenia.
+
+		sockaddr_storage m_addr; //!< Zapamiętany adres serwera.
+		socklen_t m_alen = 0; //!< Długość zapamiętanego adresu (`0` - brak).
+
+		vector<RESULT> m_results; //!< Wyniki ostatniego wykonania.
+
+	public:
+
+		/*! \brief Konstruktor trybu wsadowego.
+		 *  \param [in] host Adres serwera.
+		 *  \param [in] port Port serwera.
+		 *  \param [in] workers Liczba wątków wykonujących operacje.
+		 *
+		 */
+		BATCH(const string& host, uint16_t port, unsigned workers = 4);
+
+		//! Ustawia profil strojenia gniazd połączeń.
+		void set_profile(const SOCKBASE::PROFILE& profile);
+
+		/*! \brief Wykonanie manifestu.
+		 *  \returns `true` gdy wszystkie operacje zakończyły się powodzeniem.
+		 *  \param [in] tasks Lista operacji.
+		 *
+		 *  Wykonuje operacje równolegle, a następnie wyświetla wynik każdej z nich
+		 *  oraz łączną przepustowość.
+		 *
+		 */
+		bool run(const vector<TASK>& tasks);
+
+		//! Zwraca wyniki ostatniego wykonania (w kolejności manifestu).
+		const vector<RESULT>& results(void) const;
+
+		/*! \brief Wczytanie manifestu.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] in Strumień z manifestem.
+		 *  \param [out] tasks Lista operacji.
+		 *  \param [out] line Numer błędnego wiersza.
+		 *
+		 */
+		static bool parse(istream& in, vector<TASK>& tasks, size_t& line);
+
+	protected:
+
+		/*! \brief Pobranie połączenia z puli.
+		 *  \returns Połączony klient lub `nullptr` w przypadku błędu.
+		 *  \param [out] reused Flaga połączenia pobranego z puli.
+		 *
+		 *  Zwraca bezczynne połączenie lub nawiązuje nowe z zapamiętanym adresem.
+		 *
+		 */
+		unique_ptr<CLIENT> acquire(bool& reused);
+
+		//! Zwraca połączenie do puli.
+		void release(unique_ptr<CLIENT> client);
+
+};
+
+#endif // BATCH_HPP
@@ -0,0 +1,516 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy magazynu fragmentów.
+ *  \file
+ *
+ */
+
+#include "chunkstore.hpp"
+#include "committer.hpp"
+
+//! Tablica wartości losowych skrótu gear (generowana deterministycznie).
+static const array<uint64_t, 256> gear = [] (void)
+{
+	array<uint64_t, 256> t;
+	uint64_t x = 0x5D4E3C2B1A09F8E7ull;
+
+	// Generator splitmix64
+	for (auto& v : t)
+	{
+		x += 0x9E3779B97F4A7C15ull;
+
+		uint64_t z = x;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		v = z ^ (z >> 31);
+	}
+
+	return t;
+}();
+
+//! Stałe rundy SHA-256.
+static const uint32_t sha_k[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+//! Obrót bitowy w prawo.
+static inline uint32_t rotr(uint32_t x, int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+//! Przetwarza jeden 64-bajtowy blok SHA-256.
+static void sha_block(uint32_t h[8], const uint8_t* p)
+{
+	uint32_t w[64];
+
+	for (int i = 0; i < 16; ++i)
+		w[i] = WIRE::get32((const char*) p + 4 * i);
+
+	for (int i = 16; i < 64; ++i)
+	{
+		const uint32_t s0 = rotr(w[i-15], 7) ^ rotr(w[i-15], 18) ^ (w[i-15] >> 3);
+		const uint32_t s1 = rotr(w[i-2], 17) ^ rotr(w[i-2], 19) ^ (w[i-2] >> 10);
+
+		w[i] = w[i-16] + s0 + w[i-7] + s1;
+	}
+
+	uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+	uint32_t e = h[4], f = h[5], g = h[6], k = h[7];
+
+	for (int i = 0; i < 64; ++i)
+	{
+		const uint32_t t1 = k + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) +
+						((e & f) ^ (~e & g)) + sha_k[i] + w[i];
+		const uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +
+						((a & b) ^ (a & c) ^ (b & c));
+
+		k = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+	h[4] += e; h[5] += f; h[6] += g; h[7] += k;
+}
+
+/*! \brief Zapis pliku tymczasowego.
+ *  \returns Nazwa pliku tymczasowego lub pusty napis w przypadku błędu.
+ *  \param [in] path Ścieżka pliku docelowego.
+ *  \param [in] data Dane do zapisania.
+ *  \param [in] size Liczba danych w bajtach.
+ *
+ *  Tworzy unikalny plik tymczasowy w katalogu pliku docelowego i zapisuje do niego dane.
+ *
+ */
+static string write_temp(const filesystem::path& path, const char* data, size_t size)
+{
+	string temp;
+	bool ok(true);
+
+	const int fd = COMMITTER::create(path, temp);
+
+	if (fd == -1) return string();
+
+	while (ok && size > 0)
+	{
+		const ssize_t wc = ::write(fd, data, size);
+
+		if (wc > 0) { data += wc; size -= wc; }
+		else ok = wc == -1 && errno == EINTR;
+	}
+
+	if (::close(fd) != 0) ok = false;
+	if (!ok) ::unlink(temp.c_str());
+
+	return ok ? temp : string();
+}
+
+CHUNKSTORE::CHUNKSTORE(const string& root)
+: m_root(root) {}
+
+bool CHUNKSTORE::open(void)
+{
+	error_code ec;
+
+	filesystem::create_directories(m_root / "chunks", ec);
+	filesystem::create_directories(m_root / "files", ec);
+
+	return filesystem::is_directory(m_root / "chunks") &&
+		  filesystem::is_directory(m_root / "files");
+}
+
+bool CHUNKSTORE::has(const CHUNK& chunk) const
+{
+	error_code ec;
+
+	// Fragment istnieje, gdy istnieje plik o zgodnym rozmiarze
+	return filesystem::file_size(chunk_path(chunk.hash), ec) == chunk.size && !ec;
+}
+
+bool CHUNKSTORE::contains(const string& name) const
+{
+	error_code ec;
+
+	return filesystem::is_regular_file(file_path(name), ec);
+}
+
+bool CHUNKSTORE::store(const CHUNK& chunk, const char* data)
+{
+	if (has(chunk)) return true; // Fragment już jest w magazynie
+
+	const auto path = chunk_path(chunk.hash);
+
+	error_code ec;
+	filesystem::create_directories(path.parent_path(), ec);
+
+	// Zapisz fragment do pliku tymczasowego - utrwali go dopiero
+	// zatwierdzenie pliku, jedną operacją dla wszystkich fragmentów
+	const string temp = write_temp(path, data, chunk.size);
+
+	if (temp.empty()) return false;
+
+	// Podmień atomowo - równoległe zapisy tego samego fragmentu są bezpieczne
+	if (::rename(temp.c_str(), path.c_str()) == 0) return true;
+
+	::unlink(temp.c_str());
+
+	return false;
+}
+
+size_t CHUNKSTORE::cut(const char* data, size_t size)
+{
+	static const uint64_t mask_s = ~0ull << (64 - 15); // Maska przed rozmiarem oczekiwanym
+	static const uint64_t mask_l = ~0ull << (64 - 11); // Maska po rozmiarze oczekiwanym
+
+	if (size <= chunk_min) return size;
+
+	const auto* x = (const uint8_t*) data;
+	const size_t n = min(size, chunk_max);
+	const size_t normal = min(n, chunk_avg);
+
+	uint64_t fp = 0;
+	size_t i = chunk_min;
+
+	// Normalizacja rozmiaru: trudniejszy warunek przed rozmiarem
+	// oczekiwanym i łatwiejszy po nim (jak w FastCDC)
+	for (; i < normal; ++i)
+	{
+		fp = (fp << 1) + gear[x[i]];
+		if (!(fp & mask_s)) return i + 1;
+	}
+
+	for (; i < n; ++i)
+	{
+		fp = (fp << 1) + gear[x[i]];
+		if (!(fp & mask_l)) return i + 1;
+	}
+
+	return n;
+}
+
+CHUNKSTORE::DIGEST CHUNKSTORE::digest(const char* data, size_t size)
+{
+	uint32_t h[8] =
+	{
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	const auto* p = (const uint8_t*) data;
+	const uint64_t bits = uint64_t(size) * 8;
+
+	// Przetwórz pełne bloki
+	for (; size >= 64; p += 64, size -= 64) sha_block(h, p);
+
+	// Uzupełnij ostatni blok i dopisz długość
+	uint8_t last[128] = {};
+	memcpy(last, p, size);
+	last[size] = 0x80;
+
+	const size_t total = size + 9 > 64 ? 128 : 64;
+	const uint64_t be_bits = htobe64(bits);
+	memcpy(last + total - 8, &be_bits, 8);
+
+	for (size_t i = 0; i < total; i += 64) sha_block(h, last + i);
+
+	DIGEST out;
+
+	for (int i = 0; i < 8; ++i)
+	{
+		const uint32_t v = htobe32(h[i]);
+		memcpy(out.data() + 4 * i, &v, 4);
+	}
+
+	return out;
+}
+
+void CHUNKSTORE::put(vector<char>& out, const CHUNK& chunk)
+{
+	out.insert(out.end(), chunk.hash.begin(), chunk.hash.end());
+	WIRE::put32(out, chunk.size);
+}
+
+CHUNKSTORE::CHUNK CHUNKSTORE::get(const char* in)
+{
+	CHUNK chunk;
+
+	memcpy(chunk.hash.data(), in, chunk.hash.size());
+	chunk.size = WIRE::get32(in + chunk.hash.size());
+
+	return chunk;
+}
+
+filesystem::path CHUNKSTORE::chunk_path(const DIGEST& hash) const
+{
+	static const char hex[] = "0123456789abcdef";
+	string name;
+
+	for (const auto b : hash)
+	{
+		name += hex[b >> 4];
+		name += hex[b & 15];
+	}
+
+	// Pierwszy bajt skrótu wyznacza podkatalog
+	return m_root / "chunks" / name.substr(0, 2) / name;
+}
+
+filesystem::path CHUNKSTORE::file_path(const string& name) const
+{
+	return m_root / "files" / filesystem::path(name).filename();
+}
+
+CHUNKSTORE::WRITER::WRITER(CHUNKSTORE& store, const string& name)
+: m_store(store), m_name(name) {}
+
+bool CHUNKSTORE::WRITER::write(const char* data, size_t size)
+{
+	m_pending.insert(m_pending.end(), data, data + size);
+
+	size_t pos = 0; // Początek kolejnego fragmentu
+
+	// Wydzielaj fragmenty tylko gdy granica jest już stabilna
+	while (m_pending.size() - pos >= chunk_max)
+	{
+		const char* start = m_pending.data() + pos;
+		const size_t len = cut(start, m_pending.size() - pos);
+		const CHUNK chunk = { digest(start, len), uint32_t(len) };
+
+		if (!m_store.store(chunk, start)) return false;
+
+		m_chunks.push_back(chunk);
+		pos += len;
+	}
+
+	m_pending.erase(m_pending.begin(), m_pending.begin() + pos);
+
+	return true;
+}
+
+bool CHUNKSTORE::WRITER::put(const CHUNK& chunk, const char* data)
+{
+	if (chunk.size == 0 || chunk.size > chunk_max) return false;
+
+	// Dane fragmentu muszą zgadzać się ze skrótem
+	if (data && digest(data, chunk.size) != chunk.hash) return false;
+
+	// Fragment bez danych musi być już w magazynie
+	if (data ? !m_store.store(chunk, data) : !m_store.has(chunk)) return false;
+
+	m_chunks.push_back(chunk);
+
+	return true;
+}
+
+bool CHUNKSTORE::WRITER::commit(void)
+{
+	// Podziel pozostałe dane - to koniec pliku
+	for (size_t pos = 0; pos < m_pending.size(); )
+	{
+		const char* start = m_pending.data() + pos;
+		const size_t len = cut(start, m_pending.size() - pos);
+		const CHUNK chunk = { digest(start, len), uint32_t(len) };
+
+		if (!m_store.store(chunk, start)) return false;
+
+		m_chunks.push_back(chunk);
+		pos += len;
+	}
+
+	m_pending.clear();
+
+	vector<char> data;
+	data.reserve(m_chunks.size() * entry_size);
+
+	for (const auto& c : m_chunks) CHUNKSTORE::put(data, c);
+
+	const auto path = m_store.file_path(m_name);
+	const string temp = write_temp(path, data.data(), data.size());
+
+	if (temp.empty()) return false;
+
+	const int dir = ::open(path.parent_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	// Fragmenty i manifest muszą być na dysku przed podmianą manifestu -
+	// `syncfs` utrwala je wszystkie naraz zamiast każdego pliku osobno
+	bool ok = dir != -1 && ::syncfs(dir) == 0 &&
+			::rename(temp.c_str(), path.c_str()) == 0;
+
+	// Po podmianie utrwal jeszcze wpis katalogu
+	if (!ok) ::unlink(temp.c_str());
+	else ok = ::fsync(dir) == 0;
+
+	if (dir != -1) ::close(dir);
+
+	return ok;
+}
+
+uint64_t CHUNKSTORE::WRITER::size(void) const
+{
+	uint64_t total = m_pending.size();
+
+	for (const auto& c : m_chunks) total += c.size;
+
+	return total;
+}
+
+CHUNKSTORE::READER::READER(const CHUNKSTORE& store)
+: m_store(store) {}
+
+bool CHUNKSTORE::READER::open(const string& name)
+{
+	ifstream file(m_store.file_path(name), ios_base::in | ios_base::binary);
+	char entry[entry_size];
+
+	if (!file.is_open()) return false;
+
+	// Wczytaj wszystkie wpisy manifestu
+	while (file.read(entry, sizeof(entry)))
+		m_chunks.push_back(get(entry));
+
+	return file.gcount() == 0;
+}
+
+ssize_t CHUNKSTORE::READER::read(char* data, size_t size)
+{
+	// Gdy bieżący fragment został odczytany przejdź do kolejnego
+	while (!m_chunk.is_open() || m_chunk.peek() == ifstream::traits_type::eof())
+	{
+		m_chunk.close();
+		m_chunk.clear();
+
+		if (m_next == m_chunks.size()) return 0;
+
+		m_chunk.open(m_store.chunk_path(m_chunks[m_next++].hash),
+				   ios_base::in | ios_base::binary);
+
+		if (!m_chunk.is_open()) return -1;
+	}
+
+	m_chunk.read(data, size);
+
+	return m_chunk.gcount();
+}
+
+CHUNKSTORE::SESSION::SESSION(CHUNKSTORE& store, const string& name)
+: m_store(store), m_writer(store, name) {}
+
+bool CHUNKSTORE::SESSION::feed(const char* data, size_t size, vector<char>& reply)
+{
+	m_in.insert(m_in.end(), data, data + size);
+
+	size_t pos = 0; // Pozycja bieżącego rekordu
+
+	while (!m_done && pos < m_in.size())
+	{
+		const char* rec = m_in.data() + pos;
+		const size_t avail = m_in.size() - pos;
+
+		// Oczekiwanie na dane brakujących fragmentów porcji
+		if (m_next < m_batch.size())
+		{
+			const auto& chunk = m_batch[m_next];
+
+			if (m_have[m_next])
+			{
+				if (!m_writer.put(chunk, nullptr)) return false;
+			}
+			else if (avail < chunk.size) break;
+			else if (!m_writer.put(chunk, rec)) return false;
+			else pos += chunk.size;
+
+			++m_next;
+		}
+
+		// Zapytanie o obecność porcji fragmentów
+		else if (rec[0] == 'H')
+		{
+			if (avail < 5) break;
+
+			const uint32_t count = WIRE::get32(rec + 1);
+
+			if (count == 0 || count > batch_max) return false;
+			else if (avail < 5 + count * entry_size) break;
+
+			m_batch.clear();
+			m_have.assign(count, false);
+			m_next = 0;
+
+			vector<char> bits((count + 7) / 8);
+
+			// Odpowiedz mapą bitową fragmentów obecnych w magazynie
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				m_batch.push_back(get(rec + 5 + i * entry_size));
+
+				// Rozmiar sprawdź od razu - dane fragmentu są buforowane w całości
+				if (m_batch.back().size == 0 || m_batch.back().size > chunk_max) return false;
+
+				m_have[i] = m_store.has(m_batch.back());
+
+				if (m_have[i]) bits[i / 8] |= char(1 << (i % 8));
+			}
+
+			reply.insert(reply.end(), bits.begin(), bits.end());
+			pos += 5 + count * entry_size;
+		}
+
+		// Koniec pliku
+		else if (rec[0] == 'E')
+		{
+			if (avail < 9) break;
+
+			// Rozmiar musi zgadzać się z sumą fragmentów
+			if (WIRE::get64(rec + 1) != m_writer.size()) return false;
+
+			m_done = true;
+			pos += 9;
+		}
+
+		else return false;
+	}
+
+	// Porcja mogła zawierać wyłącznie obecne fragmenty
+	while (m_next < m_batch.size() && m_have[m_next])
+		if (!m_writer.put(m_batch[m_next++], nullptr)) return false;
+
+	m_in.erase(m_in.begin(), m_in.begin() + pos);
+
+	return true;
+}
+
+bool CHUNKSTORE::SESSION::commit(void)
+{
+	return m_done && m_writer.commit();
+}
+
+bool CHUNKSTORE::SESSION::is_done(void) const
+{
+	return m_done;
+}
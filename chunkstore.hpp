@@ -0,0 +1,294 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy magazynu fragmentów.
+ *  \file
+ *
+ */
+
+#ifndef CHUNKSTORE_HPP
+#define CHUNKSTORE_HPP
+
+#include "wire.hpp"
+
+#include <filesystem>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+
+using namespace std;
+
+/*! \brief Klasa magazynu fragmentów.
+ *
+ *  Przechowuje pliki podzielone na fragmenty wyznaczane na podstawie zawartości
+ *  (ang. content-defined chunking). Każdy unikalny fragment zapisywany jest raz
+ *  pod nazwą swojego skrótu SHA-256 w katalogu `chunks`, a dla każdego pliku
+ *  tworzony jest manifest z listą fragmentów w katalogu `files`. Identyczne lub
+ *  podobne pliki współdzielą w ten sposób miejsce na dysku.
+ *
+ */
+class CHUNKSTORE
+{
+
+	public:
+
+		using DIGEST = array<uint8_t, 32>; //!< Skrót SHA-256 fragmentu.
+
+		/*! \brief Opis fragmentu.
+		 *
+		 *  Pojedynczy wpis manifestu pliku.
+		 *
+		 */
+		struct CHUNK
+		{
+			DIGEST hash; //!< Skrót fragmentu.
+			uint32_t size; //!< Rozmiar fragmentu.
+		};
+
+		static constexpr size_t chunk_min = 1 << 11; //!< Minimalny rozmiar fragmentu.
+		static constexpr size_t chunk_avg = 1 << 13; //!< Oczekiwany rozmiar fragmentu.
+		static constexpr size_t chunk_max = 1 << 16; //!< Maksymalny rozmiar fragmentu.
+
+		static constexpr size_t entry_size = 36; //!< Rozmiar opisu fragmentu w protokole i manifeście.
+		static constexpr size_t batch_max = 1024; //!< Maksymalna liczba fragmentów w zapytaniu.
+
+		/*! \brief Zapis pliku do magazynu.
+		 *
+		 *  Gromadzi listę fragmentów pliku i po zatwierdzeniu zapisuje jego manifest.
+		 *  Dane mogą być przekazywane jako ciągły strumień (zostaną podzielone na
+		 *  fragmenty) lub jako gotowe fragmenty.
+		 *
+		 */
+		class WRITER
+		{
+
+			protected:
+
+				CHUNKSTORE& m_store; //!< Magazyn docelowy.
+				string m_name; //!< Nazwa pliku.
+
+				vector<char> m_pending; //!< Dane oczekujące na podział.
+				vector<CHUNK> m_chunks; //!< Lista fragmentów pliku.
+
+			public:
+
+				WRITER(CHUNKSTORE& store, const string& name); //!< Konstruktor zapisu.
+
+				/*! \brief Zapis strumienia danych.
+				 *  \returns Powodzenie operacji.
+				 *  \param [in] data Dane do zapisania.
+				 *  \param [in] size Liczba danych w bajtach.
+				 *
+				 *  Dzieli dane na fragmenty i zapisuje nowe fragmenty w magazynie.
+				 *
+				 */
+				bool write(const char* data, size_t size);
+
+				/*! \brief Zapis gotowego fragmentu.
+				 *  \returns Powodzenie operacji.
+				 *  \param [in] chunk Opis fragmentu.
+				 *  \param [in] data Dane fragmentu lub `nullptr` dla fragmentu obecnego w magazynie.
+				 *
+				 *  Dopisuje fragment do pliku weryfikując zgodność skrótu z danymi lub
+				 *  obecność fragmentu w magazynie.
+				 *
+				 */
+				bool put(const CHUNK& chunk, const char* data);
+
+				/*! \brief Zatwierdzenie pliku.
+				 *  \returns Powodzenie operacji.
+				 *
+				 *  Zapisuje ostatni fragment, utrwala fragmenty i manifest na dysku
+				 *  i atomowo podmienia manifest pliku.
+				 *
+				 */
+				bool commit(void);
+
+				//! Zwraca łączny rozmiar zapisanych fragmentów.
+				uint64_t size(void) const;
+
+		};
+
+		/*! \brief Odczyt pliku z magazynu.
+		 *
+		 *  Odtwarza zawartość pliku odczytując kolejne fragmenty z manifestu.
+		 *
+		 */
+		class READER
+		{
+
+			protected:
+
+				const CHUNKSTORE& m_store; //!< Magazyn źródłowy.
+
+				vector<CHUNK> m_chunks; //!< Lista fragmentów pliku.
+				size_t m_next = 0; //!< Indeks kolejnego fragmentu.
+
+				ifstream m_chunk; //!< Bieżący fragment.
+
+			public:
+
+				READER(const CHUNKSTORE& store); //!< Konstruktor odczytu.
+
+				/*! \brief Otwarcie pliku.
+				 *  \returns `false` gdy plik nie istnieje w magazynie.
+				 *  \param [in] name Nazwa pliku.
+				 *
+				 *  Wczytuje manifest pliku.
+				 *
+				 */
+				bool open(const string& name);
+
+				/*! \brief Odczyt danych.
+				 *  \returns Liczba odczytanych bajtów, `0` na końcu pliku lub `-1` w przypadku błędu.
+				 *  \param [out] data Bufor na dane.
+				 *  \param [in] size Rozmiar bufora.
+				 *
+				 *  Odczytuje kolejne dane pliku przechodząc pomiędzy fragmentami.
+				 *
+				 */
+				ssize_t read(char* data, size_t size);
+
+		};
+
+		/*! \brief Sesja wysyłania z deduplikacją.
+		 *
+		 *  Dekoduje protokół polecenia `CUPLOAD`. Klient wysyła porcje opisów
+		 *  fragmentów (rekord `H`), serwer odpowiada mapą bitową fragmentów, które
+		 *  już posiada, a klient przesyła dane jedynie brakujących fragmentów.
+		 *  Rekord `E` kończy plik i powoduje jego zatwierdzenie.
+		 *
+		 */
+		class SESSION
+		{
+
+			protected:
+
+				CHUNKSTORE& m_store; //!< Magazyn docelowy.
+				WRITER m_writer; //!< Zapis pliku.
+
+				vector<char> m_in; //!< Bufor niepełnych rekordów.
+				vector<CHUNK> m_batch; //!< Bieżąca porcja fragmentów.
+				vector<bool> m_have; //!< Fragmenty obecne w magazynie.
+				size_t m_next = 0; //!< Indeks kolejnego fragmentu porcji.
+
+				bool m_done = false; //!< Flaga odebrania rekordu końca.
+
+			public:
+
+				SESSION(CHUNKSTORE& store, const string& name); //!< Konstruktor sesji.
+
+				/*! \brief Przetworzenie danych.
+				 *  \returns `false` w przypadku błędnych danych, `true` w przeciwnym razie.
+				 *  \param [in] data Odebrane dane.
+				 *  \param [in] size Liczba danych w bajtach.
+				 *  \param [out] reply Bufor na odpowiedź dla klienta.
+				 *
+				 *  Dekoduje kompletne rekordy, zapisuje fragmenty i przygotowuje odpowiedzi.
+				 *
+				 */
+				bool feed(const char* data, size_t size, vector<char>& reply);
+
+				//! Zatwierdza plik po odebraniu rekordu końca.
+				bool commit(void);
+
+				//! Sprawdza, czy odebrano rekord końca.
+				bool is_done(void) const;
+
+		};
+
+	protected:
+
+		filesystem::path m_root; //!< Katalog główny magazynu.
+
+	public:
+
+		explicit CHUNKSTORE(const string& root); //!< Konstruktor magazynu.
+
+		/*! \brief Inicjacja magazynu.
+		 *  \returns Powodzenie operacji.
+		 *
+		 *  Tworzy strukturę katalogów magazynu.
+		 *
+		 */
+		bool open(void);
+
+		/*! \brief Test obecności fragmentu.
+		 *  \returns `true` gdy fragment jest przechowywany w magazynie.
+		 *  \param [in] chunk Opis fragmentu.
+		 *
+		 */
+		bool has(const CHUNK& chunk) const;
+
+		/*! \brief Test obecności pliku.
+		 *  \returns `true` gdy w magazynie istnieje manifest pliku.
+		 *  \param [in] name Nazwa pliku.
+		 *
+		 */
+		bool contains(const string& name) const;
+
+		/*! \brief Zapis fragmentu.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] chunk Opis fragmentu.
+		 *  \param [in] data Dane fragmentu.
+		 *
+		 *  Zapisuje fragment, jeśli nie ma go jeszcze w magazynie.
+		 *
+		 */
+		bool store(const CHUNK& chunk, const char* data);
+
+		/*! \brief Wyznaczenie granicy fragmentu.
+		 *  \returns Długość kolejnego fragmentu.
+		 *  \param [in] data Dane.
+		 *  \param [in] size Liczba dostępnych danych.
+		 *
+		 *  Wyszukuje granicę fragmentu skrótem typu gear. Wynik jest stabilny tylko
+		 *  wtedy, gdy dostępne jest co najmniej `chunk_max` bajtów lub dane kończą plik.
+		 *
+		 */
+		static size_t cut(const char* data, size_t size);
+
+		/*! \brief Skrót SHA-256.
+		 *  \returns Skrót danych.
+		 *  \param [in] data Dane.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 */
+		static DIGEST digest(const char* data, size_t size);
+
+		//! Dopisuje opis fragmentu do bufora.
+		static void put(vector<char>& out, const CHUNK& chunk);
+
+		//! Odczytuje opis fragmentu spod wskazanego adresu.
+		static CHUNK get(const char* in);
+
+	protected:
+
+		//! Zwraca ścieżkę pliku fragmentu.
+		filesystem::path chunk_path(const DIGEST& hash) const;
+
+		//! Zwraca ścieżkę manifestu pliku.
+		filesystem::path file_path(const string& name) const;
+
+};
+
+#endif // CHUNKSTORE_HPP
@@ -25,6 +25,35 @@
 
 #include "client.hpp"
 
+CLIENT::TRANSFER& CLIENT::TRANSFER::finish(chrono::steady_clock::time_point start, ERROR code)
+{
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	throughput = seconds > 0 ? bytes / seconds : 0;
+	error = code;
+
+	return *this;
+}
+
+bool CLIENT::TRANSFER::ok(void) const
+{
+	return error == ERROR::None;
+}
+
+const char* CLIENT::TRANSFER::what(void) const
+{
+	switch (error)
+	{
+		case ERROR::None: return "";
+		case ERROR::Local: return "local file";
+		case ERROR::Connection: return "connection";
+		case ERROR::Missing: return "not found";
+		case ERROR::Rejected: return "not stored";
+		case ERROR::Refused: return "refused";
+	}
+
+	return "unknown";
+}
+
 CLIENT::CLIENT(void)
 {
 	cout << "Constructing client...\tOK\n";
@@ -42,11 +71,11 @@ bool CLIENT::connect(const string& addr, const uint16_t port)
 	const string ports = to_string(port);
 	int sockfd(0);
 
-	addrinfo hints, *servinfo, *p;
+	addrinfo hints, *servinfo;
 
-	// Uzupełnij strukturę podpowiedzi
+	// Uzupełnij strukturę podpowiedzi - adresy IPv4 i IPv6
 	memset(&hints, 0, sizeof(hints));
-	hints.ai_family = AF_INET;
+	hints.ai_family = AF_UNSPEC;
 	hints.ai_socktype = SOCK_STREAM;
 
 	cout << "Translating host...\t";
@@ -59,34 +88,140 @@ bool CLIENT::connect(const string& addr, const uint16_t port)
 
 	cout << "Connecting socket...\t";
 
-	// Wyszukaj pierwszy pasujący adres
-	for (p = servinfo; p != nullptr; p = p->ai_next)
+	// Połącz się z pierwszym adresem, który odpowie
+	sockfd = connect_any(servinfo);
+
+	// Zwolnij zasoby informacji o adresie
+	freeaddrinfo(servinfo);
+
+	if (sockfd == -1) return false;
+	else cout << "OK\n";
+
+	this->m_sock = sockfd;
+
+	return true;
+}
+
+int CLIENT::connect_any(const addrinfo* list, int delay)
+{
+	vector<const addrinfo*> first, second, order;
+
+	// Podziel adresy według rodziny - rodzina pierwszego wyniku ma pierwszeństwo
+	for (const addrinfo* p = list; p != nullptr; p = p->ai_next)
+		(p->ai_family == list->ai_family ? first : second).push_back(p);
+
+	// Przeplataj rodziny adresów (IPv6, IPv4, IPv6, ...)
+	for (size_t i = 0; i < max(first.size(), second.size()); ++i)
+	{
+		if (i < first.size()) order.push_back(first[i]);
+		if (i < second.size()) order.push_back(second[i]);
+	}
+
+	vector<pollfd> pending; // Trwające próby połączenia
+	size_t next(0); // Indeks kolejnego adresu
+	int winner(-1); // Pierwsze nawiązane połączenie
+
+	while (winner == -1 && (next < order.size() || !pending.empty()))
 	{
-		// Na podstawie danych spróbuj utworzyć gniazdo
-		if ((sockfd = ::socket(p->ai_family,
-						   p->ai_socktype,
-						   p->ai_protocol)) == -1)
+		// Rozpocznij kolejną próbę połączenia bez blokowania
+		if (next < order.size())
 		{
-			sockfd = 0; // Gdy błąd - przejdź dalej
-			continue; // do kolejnego elementu
+			const addrinfo* p = order[next++];
+			const int fd = ::socket(p->ai_family, p->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, p->ai_protocol);
+
+			if (fd != -1)
+			{
+				apply(fd, ROLE::Connecting); // Zastosuj profil strojenia
+
+				if (::connect(fd, p->ai_addr, p->ai_addrlen) == 0) winner = fd;
+				else if (errno == EINPROGRESS) pending.push_back({ fd, POLLOUT, 0 });
+				else ::close(fd);
+			}
+
+			// Natychmiastowy błąd - od razu przejdź do kolejnego adresu
+			if (winner != -1) break;
+			else if (pending.empty()) continue;
 		}
 
-		// Spróbuj nawiązać połączenie
-		if (::connect(sockfd,
-				    p->ai_addr,
-				    p->ai_addrlen) == -1)
+		// Czekaj na wynik prób, a jeśli są kolejne adresy - najwyżej `delay` ms
+		const int rc = ::poll(pending.data(), pending.size(), next < order.size() ? delay : -1);
+
+		if (rc < 0 && errno != EINTR) break;
+
+		// Sprawdź zakończone próby - pierwsza udana wygrywa, nieudane zamknij
+		for (auto i = pending.begin(); i != pending.end();)
 		{
-			::close(sockfd); // Gdy błąd - zamknij
-			sockfd = 0; // gniazdo po czym przejdź
-			continue; // dalej do kolejnego elementu
+			if (!i->revents) { ++i; continue; }
+
+			int err(0);
+			socklen_t len = sizeof(err);
+
+			::getsockopt(i->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+
+			if (err == 0 && winner == -1) winner = i->fd;
+			else ::close(i->fd);
+
+			i = pending.erase(i);
 		}
-		else break; // Gdy wszystko OK pomiń resztę elementów
 	}
 
-	// Zwolnij zasoby informacji o adresie
-	freeaddrinfo(servinfo);
+	// Porzuć pozostałe próby
+	for (const auto& p : pending) ::close(p.fd);
+
+	// Przywróć tryb blokujący
+	if (winner != -1) ::fcntl(winner, F_SETFL, ::fcntl(winner, F_GETFL) & ~O_NONBLOCK);
+
+	return winner;
+}
+
+bool CLIENT::connect(const sockaddr_storage& addr, socklen_t len)
+{
+	if (m_sock) this->disconnect();
+
+	cout << "Connecting socket...\t";
+
+	// Stwórz socket - rodzina zgodna z adresem, TCP
+	int sockfd = ::socket(addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (sockfd == -1) return false;
+
+	apply(sockfd, ROLE::Connecting); // Zastosuj profil strojenia
+
+	// Spróbuj nawiązać połączenie
+	if (::connect(sockfd, (const sockaddr*) &addr, len) == -1)
+	{
+		::close(sockfd);
+		return false;
+	}
+	else cout << "OK\n";
+
+	this->m_sock = sockfd;
+
+	return true;
+}
+
+bool CLIENT::connect_unix(const string& path)
+{
+	if (m_sock) this->disconnect();
+
+	sockaddr_un sun;
+	socklen_t len;
+
+	cout << "Connecting local...\t";
+
+	if (!unix_address(path, sun, len)) return false;
 
-	if (sockfd == 0) return false;
+	// Stwórz socket - lokalny, strumieniowy
+	int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (sockfd == -1) return false;
+
+	// Spróbuj nawiązać połączenie
+	if (::connect(sockfd, (sockaddr*) &sun, len) == -1)
+	{
+		::close(sockfd);
+		return false;
+	}
 	else cout << "OK\n";
 
 	this->m_sock = sockfd;
@@ -99,94 +234,1251 @@ void CLIENT::disconnect(void)
 	close(); // Zamknij gniazdo
 }
 
-int CLIENT::download(const string& path, const string& dest)
+CLIENT::TRANSFER CLIENT::download(const string& path, const string& dest, uint64_t offset)
 {
+	using ERROR = TRANSFER::ERROR;
+
+	const auto start = chrono::steady_clock::now();
+	TRANSFER result;
+
 	cout << "Opening local file...\t";
 
-	// Pobierz nazwę pliku i otwórz lokalny plik
+	// Pobierz nazwę pliku i otwórz lokalny plik - przy wznawianiu
+	// zachowaj jego zawartość i dopisuj dane od pozycji początkowej
 	const string name = filesystem::path(path).filename();
-	fstream file(dest, ios_base::out | ios_base::trunc | ios_base::binary);
+	const int fd = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (offset ? 0 : O_TRUNC), 0644);
+
+	if (fd == -1 || ::lseek(fd, offset, SEEK_SET) == -1)
+	{
+		if (fd != -1) ::close(fd);
 
-	if (!file.is_open()) return -1;
+		cout << "FAIL\n";
+		return result.finish(start, ERROR::Local);
+	}
 	else cout << "OK\n";
 
 	// Wygeneruj nagłówek
-	const string header = "DOWNLOAD " + name + '\n';
+	const string header = request(FRAME::Download, name, offset);
 
-	size_t count(0); // Licznik wszystkich danych
-	ssize_t rec(0); // Licznik danych w pakiecie
+	int64_t count(-1); // Licznik wszystkich danych
+	int status(-1); // Status ramki
+	ERROR code(ERROR::None); // Kod błędu
 
 	cout << "Downloading file...\t";
 
-	// Wyślij nagłówek do serwera
-	if (send_all(m_sock, header.c_str(), header.size()))
+	// Wyślij nagłówek do serwera i przenoś dane z gniazda
+	// do pliku aż do zamknięcia połączenia przez serwer
+	if (send_all(m_sock, header.c_str(), header.size()) &&
+	    (status = confirm(offset)) == FRAME::Ok)
+		count = recv_file(m_sock, fd, UINT64_MAX, m_progress);
+
+	// Ramka zgłasza brak pliku i kompletny plik - po jej potwierdzeniu
+	// serwer ma dane za pozycją początkową. Serwer zamyka połączenie
+	// bez danych, gdy pliku brak.
+	if (status == FRAME::Complete) count = 0;
+	else if (status == FRAME::Missing) code = ERROR::Missing;
+	else if (status > FRAME::Ok) code = ERROR::Refused;
+	else if (count < 0) code = ERROR::Connection;
+	else if (count == 0 && offset) code = ERROR::Connection;
+	else if (count == 0 && !m_framing) code = ERROR::Missing;
+
+	if (::close(fd) != 0 && code == ERROR::None) code = ERROR::Local;
+
+	// Rozłącz się po wykonaniu zadania
+	this->disconnect();
+
+	if (code == ERROR::None) cout << "OK\n";
+	else cout << "FAIL\n";
+
+	result.bytes = max<int64_t>(count, 0);
+
+	return result.finish(start, code);
+}
+
+CLIENT::TRANSFER CLIENT::upload(const string& path, const string& src)
+{
+	using ERROR = TRANSFER::ERROR;
+
+	const auto start = chrono::steady_clock::now();
+	TRANSFER result;
+
+	cout << "Opening local file...\t";
+
+	// Otwórz lokalny plik i pobierz jego długość
+	const int fd = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+
+	if (fd == -1 || ::fstat(fd, &st) == -1)
 	{
-		// Odbierz fragment pliku z serwera
-		while ((rec = ::recv(m_sock, m_buff, sizeof(m_buff), 0)) > 0)
+		if (fd != -1) ::close(fd);
+
+		cout << "FAIL\n";
+		return result.finish(start, ERROR::Local);
+	}
+	else cout << "OK\n";
+
+	// Odczyt sekwencyjny całego pliku
+	::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	// Pobierz nazwę pliku i wygeneruj nagłówek
+	const string name = filesystem::path(path).filename();
+	const string header = request(FRAME::Upload, name);
+	const uint64_t size = st.st_size;
+
+	int64_t count(-1); // Licznik wszystkich danych
+	ERROR code(ERROR::None); // Kod błędu
+
+	cout << "Uploading file...\t";
+
+	// Wyślij nagłówek do serwera - trafi on do jednego pakietu
+	// z danymi, które następnie wysyłane są bez kopiowania; nagłówek
+	// pustego pliku jest ostatnią porcją i nie może czekać na dalsze dane
+	if (send_all(m_sock, header.c_str(), header.size(), size ? MSG_MORE | cork_flags() : 0))
+		count = send_file(m_sock, fd, size, m_progress);
+
+	// Potwierdzenie ramki czeka w buforze gniazda od początku wysyłania
+	if (count >= 0 && confirm() != FRAME::Ok) count = -1;
+
+	// Plik skrócony w trakcie wysyłania traktuj jako błąd lokalny
+	if (count < 0) code = ERROR::Connection;
+	else if (uint64_t(count) != size) code = ERROR::Local;
+
+	::close(fd);
+
+	// Rozłącz się po wykonaniu zadania
+	this->disconnect();
+
+	if (code == ERROR::None) cout << "OK\n";
+	else cout << "FAIL\n";
+
+	result.bytes = max<int64_t>(count, 0);
+
+	return result.finish(start, code);
+}
+
+CLIENT::TRANSFER CLIENT::follow(const string& path, const string& dest, uint64_t offset)
+{
+	using ERROR = TRANSFER::ERROR;
+
+	const auto start = chrono::steady_clock::now();
+	TRANSFER result;
+
+	cout << "Opening local file...\t";
+
+	// Pobierz nazwę pliku i otwórz lokalny plik - przy wznawianiu
+	// zachowaj jego zawartość i dopisuj dane od pozycji początkowej
+	const string name = filesystem::path(path).filename();
+	const int fd = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (offset ? 0 : O_TRUNC), 0644);
+
+	if (fd == -1 || ::lseek(fd, offset, SEEK_SET) == -1)
+	{
+		if (fd != -1) ::close(fd);
+
+		cout << "FAIL\n";
+		return result.finish(start, ERROR::Local);
+	}
+	else cout << "OK\n";
+
+	// Wygeneruj nagłówek
+	const string header = request(FRAME::Follow, name, offset);
+
+	int64_t count(-1); // Licznik wszystkich danych
+	int status(-1); // Status ramki
+	ERROR code(ERROR::None); // Kod błędu
+
+	cout << "Following file...\t" << flush;
+
+	// Przenoś dane z gniazda do pliku aż do zamknięcia połączenia - serwer
+	// zamyka je dopiero po usunięciu lub skróceniu śledzonego pliku
+	if (send_all(m_sock, header.c_str(), header.size()) &&
+	    (status = confirm(offset)) == FRAME::Ok)
+		count = recv_file(m_sock, fd, UINT64_MAX, m_progress);
+
+	// Serwer zamyka połączenie bez danych, gdy pliku brak - wznowione
+	// śledzenie może zakończyć się bez nowych danych
+	if (status == FRAME::Missing) code = ERROR::Missing;
+	else if (status > FRAME::Ok) code = ERROR::Refused;
+	else if (count < 0) code = ERROR::Connection;
+	else if (count == 0 && !offset) code = ERROR::Missing;
+
+	if (::close(fd) != 0 && code == ERROR::None) code = ERROR::Local;
+
+	// Rozłącz się po wykonaniu zadania
+	this->disconnect();
+
+	if (code == ERROR::None) cout << "OK\n";
+	else cout << "FAIL\n";
+
+	result.bytes = max<int64_t>(count, 0);
+
+	return result.finish(start, code);
+}
+
+CLIENT::TRANSFER CLIENT::download_sparse(const string& path, const string& dest)
+{
+	using ERROR = TRANSFER::ERROR;
+
+	const auto start = chrono::steady_clock::now();
+	TRANSFER result;
+
+	cout << "Opening local file...\t";
+
+	// Pobierz nazwę pliku i otwórz lokalny plik
+	const string name = filesystem::path(path).filename();
+	const int fd = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (fd == -1) { cout << "FAIL\n"; return result.finish(start, ERROR::Local); }
+	else cout << "OK\n";
+
+	// Wygeneruj nagłówek
+	const string header = "SGET " + name + '\n';
+
+	char head[SPARSE::header]; // Rekord obszaru
+	uint64_t count(0); // Licznik danych pliku
+	uint64_t size(0); // Rozmiar pliku
+	ERROR code(ERROR::None); // Kod błędu
+	bool ended = false; // Flaga odebrania rekordu zakończenia
+
+	cout << "Downloading extents...\t";
+
+	if (!send_all(m_sock, header.c_str(), header.size())) code = ERROR::Connection;
+
+	// Odbieraj rekordy aż do rekordu zakończenia
+	while (code == ERROR::None && !ended)
+	{
+		// Serwer zamyka połączenie bez danych, gdy pliku brak
+		if (!recv_all(m_sock, head, sizeof(head)))
+		{
+			code = count == 0 && size == 0 ? ERROR::Missing : ERROR::Connection;
+			break;
+		}
+
+		const char type = head[0];
+		const uint64_t offset = WIRE::get64(head + 1);
+		const uint64_t length = WIRE::get64(head + 9);
+
+		size = max(size, offset + length);
+
+		if (type == SPARSE::End)
+		{
+			ended = true;
+			size = offset;
+
+			// Końcowa dziura powstaje przez ustalenie rozmiaru pliku
+			if (::ftruncate(fd, size) != 0) code = ERROR::Local;
+		}
+		else if (type == SPARSE::Hole)
 		{
-			file.write(m_buff, rec); // Zapisz go do pliku
-			count += rec; // Dodaj do licznika długość danych
+			if (!SPARSE::punch(fd, offset, length)) code = ERROR::Local;
 		}
+		else if (type == SPARSE::Data)
+		{
+			// Dane obszaru przenoś z gniazda bezpośrednio pod jego pozycję
+			const int64_t rc = ::lseek(fd, offset, SEEK_SET) == -1 ? -1 :
+				recv_file(m_sock, fd, length, m_progress ? PROGRESS([this, count] (uint64_t n)
+				{
+					m_progress(count + n);
+				}) : PROGRESS());
 
-		// W przypadku błędu podczas odbierania lub zamknięcia
-		// połączenia przez serwer - rozłącz się
-		if (rec <= 0) disconnect();
+			if (rc < 0 || uint64_t(rc) != length) code = ERROR::Connection;
+			else count += rc;
+		}
+		else code = ERROR::Connection;
 	}
 
+	if (::close(fd) != 0 && code == ERROR::None) code = ERROR::Local;
+
 	// Rozłącz się po wykonaniu zadania
 	this->disconnect();
 
-	if (count) cout << "OK\n";
+	if (code == ERROR::None) cout << "OK\n" << "Received data:\t\t" << count << '/' << size << " B\n";
 	else cout << "FAIL\n";
 
-	return count;
+	result.bytes = count;
+
+	return result.finish(start, code);
 }
 
-int CLIENT::upload(const string& path, const string& src)
+CLIENT::TRANSFER CLIENT::upload_sparse(const string& path, const string& src)
 {
+	using ERROR = TRANSFER::ERROR;
+
+	const auto start = chrono::steady_clock::now();
+	TRANSFER result;
+
 	cout << "Opening local file...\t";
 
-	// Pobierz długość pliku i otwórz lokalny plik
-	const auto size = filesystem::file_size(src);
-	fstream file(src, ios_base::in | ios_base::binary);
+	// Otwórz lokalny plik i pobierz jego długość
+	const int fd = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+
+	if (fd == -1 || ::fstat(fd, &st) == -1)
+	{
+		if (fd != -1) ::close(fd);
 
-	if (!file.is_open()) return -1;
+		cout << "FAIL\n";
+		return result.finish(start, ERROR::Local);
+	}
 	else cout << "OK\n";
 
 	// Pobierz nazwę pliku i wygeneruj nagłówek
 	const string name = filesystem::path(path).filename();
-	const string header = "UPLOAD " + name + '\n';
+	const string header = "SPUT " + name + '\n';
+	const uint64_t size = st.st_size;
 
-	size_t count(0); // Licznik wszystkich danych
-	bool fail = false; // Stan błędu
+	vector<char> out(header.begin(), header.end()); // Nagłówek i rekordy
+	uint64_t pos(0); // Pozycja w pliku
+	uint64_t count(0); // Licznik danych pliku
+	char status(1); // Status odpowiedzi
+	ERROR code(ERROR::None); // Kod błędu
 
-	cout << "Uploading file...\t";
+	cout << "Uploading extents...\t";
 
-	// Wyślij nagłówek do serwera
-	if (send_all(m_sock, header.c_str(), header.size()))
+	while (code == ERROR::None)
+	{
+		uint64_t data(0), end(0);
+
+		if (!SPARSE::next(fd, pos, size, data, end)) { code = ERROR::Local; break; }
+
+		// Dziurę przed obszarem opisz rekordem
+		if (data > pos) SPARSE::put(out, SPARSE::Hole, pos, data - pos);
+
+		if (data == end)
+		{
+			SPARSE::put(out, SPARSE::End, size, 0);
+
+			if (!send_all(m_sock, out.data(), out.size())) code = ERROR::Connection;
+
+			break;
+		}
+
+		SPARSE::put(out, SPARSE::Data, data, end - data);
+
+		// Rekordy trafią do jednego pakietu z danymi obszaru
+		if (!send_all(m_sock, out.data(), out.size(), MSG_MORE | cork_flags()) ||
+		    ::lseek(fd, data, SEEK_SET) == -1) { code = ERROR::Connection; break; }
+
+		out.clear();
+
+		const int64_t rc = send_file(m_sock, fd, end - data, m_progress ? PROGRESS([this, count] (uint64_t n)
+		{
+			m_progress(count + n);
+		}) : PROGRESS());
+
+		// Plik skrócony w trakcie wysyłania traktuj jako błąd lokalny
+		if (rc < 0) code = ERROR::Connection;
+		else if (uint64_t(rc) != end - data) code = ERROR::Local;
+		else count += rc;
+
+		pos = end;
+	}
+
+	// Status serwer odsyła po utrwaleniu pliku
+	if (code == ERROR::None && !recv_all(m_sock, &status, 1)) code = ERROR::Connection;
+	else if (code == ERROR::None && status) code = ERROR::Rejected;
+
+	::close(fd);
+
+	// Rozłącz się po wykonaniu zadania
+	this->disconnect();
+
+	if (code == ERROR::None) cout << "OK\n" << "Sent data:\t\t" << count << '/' << size << " B\n";
+	else cout << "FAIL\n";
+
+	result.bytes = count;
+
+	return result.finish(start, code);
+}
+
+CLIENT::TRANSFER CLIENT::sync(const string& path, const string& src)
+{
+	using ERROR = TRANSFER::ERROR;
+
+	const auto start = chrono::steady_clock::now();
+	TRANSFER result;
+
+	cout << "Opening local file...\t";
+
+	char* data = nullptr; // Zmapowany plik
+	size_t size(0); // Rozmiar pliku
+
+	// Zmapuj plik do pamięci - okna będą przeglądane wielokrotnie
+	if (!map(src, data, size)) { cout << "FAIL\n"; return result.finish(start, ERROR::Local); }
+
+	cout << "OK\n";
+
+	// Pobierz nazwę pliku i wygeneruj nagłówek
+	const string name = filesystem::path(path).filename();
+	const string header = "DELTA " + name + '\n';
+
+	vector<DELTA::BLOCK> sig; // Sygnatury bloków serwera
+	char head[DELTA::signature_header]; // Nagłówek sygnatury
+	uint32_t block(0); // Rozmiar bloku
+
+	uint64_t count(0); // Licznik wysłanych danych
+	char status(1); // Status odpowiedzi
+	bool ok = false; // Stan operacji
+
+	cout << "Syncing file...\t\t";
+
+	// Wyślij nagłówek i odbierz nagłówek sygnatury
+	if (send_all(m_sock, header.c_str(), header.size()) &&
+	    recv_all(m_sock, head, sizeof(head)))
 	{
-		// Odczytuj plik i wysyłaj fragmenty do serwera
-		while (!file.eof() && !fail)
+		block = WIRE::get32(head);
+		const uint64_t blocks = WIRE::get64(head + 4);
+
+		// Odbieraj sygnatury porcjami wielkości bufora
+		const size_t per_buff = sizeof(m_buff) / DELTA::signature_entry;
+		ok = block >= DELTA::block_min && block <= DELTA::block_max && blocks < (1ull << 32);
+
+		while (ok && sig.size() < blocks)
 		{
-			file.read(m_buff, sizeof(m_buff)); // Odczytaj fragment
-			const size_t chunk = file.gcount(); // Pobierz jego rozmiar
+			const size_t n = min<uint64_t>(per_buff, blocks - sig.size());
 
-			if (chunk <= 0) break; // Gdy nic nie odczytano przerwij pętlę
-			else if (send_all(m_sock, m_buff, chunk)) count += chunk;
-			else break; // Gdy nie udało się wysłać danych przerwij pętlę
+			if (!recv_all(m_sock, m_buff, n * DELTA::signature_entry)) ok = false;
+			else for (size_t i = 0; i < n; ++i)
+			{
+				const char* e = m_buff + i * DELTA::signature_entry;
+				sig.push_back({ WIRE::get32(e), WIRE::get64(e + 4) });
+			}
 		}
 	}
 
+	// Wyślij strumień zmian i odbierz status
+	if (ok)
+	{
+		ok = DELTA::encode(data, size, block, sig, [&] (const char* d, size_t s)
+		{
+			count += s;
+			return send_all(m_sock, d, s);
+		});
+
+		ok = ok && recv_all(m_sock, &status, 1);
+	}
+
+	if (data) ::munmap(data, size);
+
 	// Rozłącz się po wykonaniu zadania
 	this->disconnect();
 
-	if (count == size) cout << "OK\n";
+	// Odebrany niezerowy status oznacza błąd zapisu po stronie serwera
+	const ERROR code = !ok ? ERROR::Connection : status ? ERROR::Rejected : ERROR::None;
+
+	if (code == ERROR::None) cout << "OK\n" << "Sent delta:\t\t" << count << '/' << size << " B\n";
 	else cout << "FAIL\n";
 
-	return count;
+	result.bytes = count;
+
+	return result.finish(start, code);
 }
 
-bool CLIENT::is_connected(void) const
+CLIENT::TRANSFER CLIENT::dedup(const string& path, const string& src)
 {
-	return m_sock > 0;
+	using ERROR = TRANSFER::ERROR;
+
+	const auto start = chrono::steady_clock::now();
+	TRANSFER result;
+
+	cout << "Opening local file...\t";
+
+	char* data = nullptr; // Zmapowany plik
+	size_t size(0); // Rozmiar pliku
+
+	// Zmapuj plik do pamięci - brakujące fragmenty będą wysyłane bezpośrednio z niego
+	if (!map(src, data, size)) { cout << "FAIL\n"; return result.finish(start, ERROR::Local); }
+
+	cout << "OK\n";
+
+	// Pobierz nazwę pliku i wygeneruj nagłówek
+	const string name = filesystem::path(path).filename();
+	const string header = "CUPLOAD " + name + '\n';
+
+	uint64_t count(0); // Licznik wysłanych danych plików
+	size_t pos(0); // Pozycja kolejnego fragmentu
+	char status(1); // Status odpowiedzi
+	bool ok = send_all(m_sock, header.c_str(), header.size());
+
+	cout << "Uploading chunks...\t";
+
+	// Wysyłaj zapytania porcjami fragmentów
+	while (ok && pos < size)
+	{
+		vector<pair<size_t, CHUNKSTORE::CHUNK>> batch;
+		vector<char> req = { 'H', 0, 0, 0, 0 };
+
+		// Podziel kolejną część pliku na fragmenty
+		while (pos < size && batch.size() < CHUNKSTORE::batch_max)
+		{
+			const size_t len = CHUNKSTORE::cut(data + pos, size - pos);
+			const CHUNKSTORE::CHUNK chunk = { CHUNKSTORE::digest(data + pos, len), uint32_t(len) };
+
+			batch.push_back({ pos, chunk });
+			CHUNKSTORE::put(req, chunk);
+			pos += len;
+		}
+
+		const uint32_t n = htobe32(batch.size());
+		memcpy(req.data() + 1, &n, sizeof(n));
+
+		vector<char> bits((batch.size() + 7) / 8);
+
+		// Wyślij zapytanie i odbierz mapę obecnych fragmentów
+		ok = send_all(m_sock, req.data(), req.size()) &&
+			recv_all(m_sock, bits.data(), bits.size());
+
+		// Wyślij dane fragmentów, których serwer nie posiada
+		for (size_t i = 0; ok && i < batch.size(); ++i)
+			if (!(bits[i / 8] & (1 << (i % 8))))
+			{
+				ok = send_all(m_sock, data + batch[i].first, batch[i].second.size);
+				count += batch[i].second.size;
+			}
+	}
+
+	// Zakończ plik i odbierz status
+	if (ok)
+	{
+		vector<char> end = { 'E' };
+
+		WIRE::put64(end, size);
+
+		ok = send_all(m_sock, end.data(), end.size()) &&
+			recv_all(m_sock, &status, 1);
+	}
+
+	if (data) ::munmap(data, size);
+
+	// Rozłącz się po wykonaniu zadania
+	this->disconnect();
+
+	// Odebrany niezerowy status oznacza błąd zapisu po stronie serwera
+	const ERROR code = !ok ? ERROR::Connection : status ? ERROR::Rejected : ERROR::None;
+
+	if (code == ERROR::None) cout << "OK\n" << "Sent chunks:\t\t" << count << '/' << size << " B\n";
+	else cout << "FAIL\n";
+
+	result.bytes = count;
+
+	return result.finish(start, code);
+}
+
+bool CLIENT::map(const string& path, char*& data, size_t& size)
+{
+	// Otwórz lokalny plik i pobierz jego rozmiar
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	struct stat st;
+
+	if (fd == -1) return false;
+	else if (::fstat(fd, &st) == -1) { ::close(fd); return false; }
+
+	size = st.st_size;
+	data = nullptr;
+
+	// Pusty plik nie wymaga mapowania
+	if (size > 0)
+	{
+		void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (map != MAP_FAILED) data = (char*) map;
+		else { ::close(fd); return false; }
+
+		::madvise(map, size, MADV_SEQUENTIAL);
+	}
+
+	::close(fd); // Odwzorowanie pozostaje ważne po zamknięciu pliku
+
+	return true;
+}
+
+CLIENT::TRANSFER CLIENT::download_fd(const string& path, const string& dest)
+{
+	using ERROR = TRANSFER::ERROR;
+
+	const auto start = chrono::steady_clock::now();
+	TRANSFER result;
+
+	// Pobierz nazwę pliku i wygeneruj nagłówek
+	const string name = filesystem::path(path).filename();
+	const string header = "FDOWNLOAD " + name + '\n';
+
+	ERROR code(ERROR::Connection); // Kod błędu
+	ssize_t received(-1); // Wynik odbioru deskryptora
+	char status(1); // Status odpowiedzi
+	int fd(-1); // Deskryptor pliku na serwerze
+
+	cout << "Receiving handle...\t";
+
+	// Wyślij nagłówek i odbierz status wraz z deskryptorem
+	if (send_all(m_sock, header.c_str(), header.size()))
+		received = recv_fd(m_sock, &status, 1, fd);
+
+	// Niezerowy status oznacza brak pliku na serwerze
+	if (received == 1 && status != 0) code = ERROR::Missing;
+	else if (received == 1 && fd != -1)
+	{
+		cout << "OK\n";
+
+		const int out = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+		cout << "Copying file...\t\t";
+
+		code = ERROR::Local;
+
+		if (out != -1)
+		{
+			ssize_t rc(0);
+
+			// Kopiuj plik bez udziału gniazda
+			while ((rc = copy_fd(out, fd, 1 << 30)) > 0) result.bytes += rc;
+
+			if (::close(out) == 0 && rc == 0) code = ERROR::None;
+		}
+	}
+
+	if (fd != -1) ::close(fd);
+
+	// Rozłącz się po wykonaniu zadania
+	this->disconnect();
+
+	if (code == ERROR::None) cout << "OK\n";
+	else cout << "FAIL\n";
+
+	return result.finish(start, code);
+}
+
+CLIENT::TRANSFER CLIENT::upload_fd(const string& path, const string& src)
+{
+	using ERROR = TRANSFER::ERROR;
+
+	const auto start = chrono::steady_clock::now();
+	TRANSFER result;
+
+	cout << "Opening local file...\t";
+
+	// Otwórz lokalny plik - serwer odczyta go bezpośrednio
+	const int fd = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+
+	if (fd == -1 || ::fstat(fd, &st) == -1)
+	{
+		if (fd != -1) ::close(fd);
+
+		cout << "FAIL\n";
+		return result.finish(start, ERROR::Local);
+	}
+	else cout << "OK\n";
+
+	// Pobierz nazwę pliku i wygeneruj nagłówek
+	const string name = filesystem::path(path).filename();
+	const string header = "FUPLOAD " + name + '\n';
+
+	char status(1); // Status odpowiedzi
+
+	cout << "Passing handle...\t";
+
+	// Przekaż deskryptor wraz z nagłówkiem i poczekaj na zapis pliku
+	const bool ok = send_fd(m_sock, fd, header.c_str(), header.size()) &&
+				 recv_all(m_sock, &status, 1);
+
+	::close(fd);
+
+	// Rozłącz się po wykonaniu zadania
+	this->disconnect();
+
+	// Odebrany niezerowy status oznacza błąd zapisu po stronie serwera
+	const ERROR code = !ok ? ERROR::Connection : status ? ERROR::Rejected : ERROR::None;
+
+	if (code == ERROR::None) cout << "OK\n";
+	else cout << "FAIL\n";
+
+	if (code == ERROR::None) result.bytes = st.st_size;
+
+	return result.finish(start, code);
+}
+
+int CLIENT::list(const string& prefix, const function<void(const string&, const INDEX::ENTRY&)>& callback)
+{
+	const string header = "LIST " + prefix + '\n';
+
+	vector<char> in; // Bufor niepełnych rekordów
+	int count(0); // Liczba plików
+	bool done = false; // Flaga odebrania rekordu zakończenia
+
+	cout << "Listing files...\t";
+
+	// Wyślij nagłówek i odbieraj rekordy aż do rekordu zakończenia
+	if (send_all(m_sock, header.c_str(), header.size()))
+	{
+		ssize_t rec(0);
+
+		while (!done && (rec = ::recv(m_sock, m_buff, sizeof(m_buff), 0)) > 0)
+		{
+			in.insert(in.end(), m_buff, m_buff + rec);
+
+			size_t pos(0), used(0);
+			string name;
+			INDEX::ENTRY entry;
+
+			// Przetwórz wszystkie kompletne rekordy
+			while (!done && (used = INDEX::get(in.data() + pos, in.size() - pos, name, entry)))
+			{
+				pos += used;
+
+				if (name.empty()) done = true;
+				else
+				{
+					callback(name, entry);
+					++count;
+				}
+			}
+
+			in.erase(in.begin(), in.begin() + pos);
+		}
+	}
+
+	// Rozłącz się po wykonaniu zadania
+	this->disconnect();
+
+	if (done) cout << "OK\n";
+	else cout << "FAIL\n";
+
+	return done ? count : -1;
+}
+
+int CLIENT::stat(const string& path, INDEX::ENTRY& entry)
+{
+	// Pobierz nazwę pliku i wygeneruj nagłówek
+	const string name = filesystem::path(path).filename();
+	const string header = "STAT " + name + '\n';
+
+	vector<char> in; // Odebrana odpowiedź
+	string found; // Nazwa z rekordu odpowiedzi
+	int result(-1); // Wynik zapytania
+
+	cout << "Querying file...\t";
+
+	// Odpowiedź to status i jeden rekord - odbieraj do zamknięcia połączenia
+	if (send_all(m_sock, header.c_str(), header.size()))
+	{
+		ssize_t rec(0);
+
+		while ((rec = ::recv(m_sock, m_buff, sizeof(m_buff), 0)) > 0)
+			in.insert(in.end(), m_buff, m_buff + rec);
+
+		if (in.size() > 1 && INDEX::get(in.data() + 1, in.size() - 1, found, entry))
+			result = WIRE::get8(in.data()) == 0 ? 1 : 0;
+	}
+
+	// Rozłącz się po wykonaniu zadania
+	this->disconnect();
+
+	if (result >= 0) cout << "OK\n";
+	else cout << "FAIL\n";
+
+	return result;
+}
+
+int CLIENT::mget(const string& pattern, const string& dir, unsigned writers)
+{
+	// Pobierz jedynie nazwę wzorca - ścieżka zostanie odrzucona
+	const string header = "MGET " + filesystem::path(pattern).filename().string() + '\n';
+
+	cout << "Requesting files...\t";
+
+	if (!send_all(m_sock, header.c_str(), header.size()))
+	{
+		this->disconnect();
+		cout << "FAIL\n";
+
+		return -1;
+	}
+	else cout << "OK\n";
+
+	return receive_files(dir, writers);
+}
+
+int CLIENT::mget(const vector<string>& names, const string& dir, unsigned writers)
+{
+	const string header = "MGET -\n";
+	vector<char> request(header.begin(), header.end());
+
+	// Lista nazw w postaci rekordów zakończonych rekordem pustym
+	for (const auto& path : names)
+	{
+		const string name = filesystem::path(path).filename();
+
+		if (name.empty()) continue;
+
+		WIRE::put16(request, name.size());
+		request.insert(request.end(), name.begin(), name.end());
+	}
+
+	WIRE::put16(request, 0);
+
+	cout << "Requesting files...\t";
+
+	if (!send_all(m_sock, request.data(), request.size()))
+	{
+		this->disconnect();
+		cout << "FAIL\n";
+
+		return -1;
+	}
+	else cout << "OK\n";
+
+	return receive_files(dir, writers);
+}
+
+int CLIENT::receive_files(const string& dir, unsigned writers)
+{
+	// Zadanie zapisu małego pliku
+	struct JOB
+	{
+		string path; //!< Ścieżka pliku.
+		vector<char> data; //!< Zawartość pliku.
+	};
+
+	deque<JOB> queue; // Kolejka zadań zapisu
+	mutex lock; // Blokada kolejki
+	condition_variable ready, drained; // Zmiany stanu kolejki
+	size_t pending(0); // Rozmiar danych w kolejce
+	bool closed = false; // Flaga zakończenia odbioru
+
+	int written(0), failed(0); // Liczniki plików (chronione blokadą)
+
+	// Zapisuje plik i aktualizuje liczniki
+	const auto store = [&] (const string& path, const char* data, size_t size)
+	{
+		const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		const bool ok = fd != -1 && write_all(fd, data, size);
+
+		if (fd != -1) ::close(fd);
+
+		lock_guard<mutex> guard(lock);
+		if (ok) ++written; else ++failed;
+	};
+
+	vector<thread> pool;
+
+	// Wątki zapisujące pliki z kolejki
+	for (unsigned i = 0; i < max(1u, writers); ++i) pool.emplace_back([&] (void)
+	{
+		unique_lock<mutex> guard(lock);
+
+		while (true)
+		{
+			ready.wait(guard, [&] (void) { return closed || !queue.empty(); });
+
+			if (queue.empty()) return;
+
+			JOB job = move(queue.front());
+			queue.pop_front();
+
+			guard.unlock();
+			store(job.path, job.data.data(), job.data.size());
+			guard.lock();
+
+			pending -= job.data.size();
+			drained.notify_all();
+		}
+	});
+
+	error_code ec;
+	filesystem::create_directories(dir, ec);
+
+	vector<char> buff(1 << 18); // Bufor odbioru
+	vector<char> head; // Niepełny nagłówek ramki
+	vector<char> data; // Zawartość małego pliku
+
+	string path; // Ścieżka bieżącego pliku
+	uint64_t left(0); // Liczba pozostałych danych bieżącego pliku
+	size_t count(0); // Licznik wszystkich danych
+	bool inside = false; // Flaga odbioru danych pliku
+	bool direct = false; // Flaga zapisu bezpośredniego
+	bool done = false; // Flaga odebrania ramki zakończenia
+	int fd(-1); // Plik zapisywany bezpośrednio
+
+	// Kończy bieżący plik - mały plik trafia do kolejki zapisu
+	const auto finish = [&] (void)
+	{
+		inside = false;
+
+		if (direct)
+		{
+			lock_guard<mutex> guard(lock);
+			if (fd != -1 && ::close(fd) == 0) ++written; else ++failed;
+
+			fd = -1;
+		}
+		else if (path.empty())
+		{
+			lock_guard<mutex> guard(lock);
+			++failed;
+
+			data.clear();
+		}
+		else
+		{
+			unique_lock<mutex> guard(lock);
+
+			// Ogranicz pamięć zajmowaną przez oczekujące pliki
+			drained.wait(guard, [&] (void) { return pending < (64 << 20); });
+
+			pending += data.size();
+			queue.push_back({ path, move(data) });
+			ready.notify_one();
+
+			data = vector<char>();
+		}
+	};
+
+	cout << "Receiving files...\t";
+
+	ssize_t rec(0);
+
+	while (!done && (rec = ::recv(m_sock, buff.data(), buff.size(), 0)) > 0)
+	{
+		const char* p = buff.data();
+		size_t n = rec;
+
+		count += rec;
+
+		while (n > 0 && !done)
+		{
+			// Kompletuj nagłówek ramki: długość nazwy, nazwa i rozmiar
+			if (!inside)
+			{
+				const size_t need = head.size() < 2 ? 2 : 2 + WIRE::get16(head.data()) + 8;
+				const size_t take = min(n, need - head.size());
+
+				head.insert(head.end(), p, p + take);
+				p += take; n -= take;
+
+				if (head.size() < 2) continue;
+
+				const size_t len = WIRE::get16(head.data());
+
+				if (len == 0) { done = true; break; }
+				else if (head.size() < 2 + len + 8) continue;
+
+				// Zapisuj jedynie nazwy plików - ścieżki zostaną odrzucone
+				const string name = filesystem::path(string(head.data() + 2, len)).filename();
+
+				path = (name.empty() || name == "." || name == "..") ? string() :
+					  (filesystem::path(dir) / name).string();
+				left = WIRE::get64(head.data() + 2 + len);
+
+				head.clear();
+				inside = true;
+				direct = left >= direct_min && !path.empty();
+
+				if (direct) fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+				else data.reserve(left);
+
+				if (!left) finish();
+			}
+
+			// Odbieraj dane bieżącego pliku
+			else
+			{
+				const size_t take = min<uint64_t>(n, left);
+
+				if (!direct) data.insert(data.end(), p, p + take);
+				else if (fd != -1 && !write_all(fd, p, take))
+				{
+					::close(fd);
+					fd = -1;
+				}
+
+				p += take; n -= take; left -= take;
+
+				if (!left) finish();
+			}
+		}
+	}
+
+	if (fd != -1) ::close(fd);
+
+	// Poczekaj na zapisanie wszystkich plików z kolejki
+	{
+		lock_guard<mutex> guard(lock);
+		closed = true;
+	}
+
+	ready.notify_all();
+	for (auto& t : pool) t.join();
+
+	// Rozłącz się po wykonaniu zadania
+	this->disconnect();
+
+	if (done && !failed) cout << "OK\n";
+	else cout << "FAIL\n";
+
+	cout << "Received files:\t\t" << written << " (" << count << " B)\n";
+
+	return done ? written : -1;
+}
+
+bool CLIENT::mput_begin(void)
+{
+	static const string header = "MPUT -\n";
+
+	return send_all(m_sock, header.c_str(), header.size(), MSG_MORE);
+}
+
+int64_t CLIENT::mput_file(const string& path, const string& src)
+{
+	const int fd = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+
+	// Nic jeszcze nie wysłano - strumień pozostaje poprawny
+	if (fd == -1 || ::fstat(fd, &st) == -1)
+	{
+		if (fd != -1) ::close(fd);
+		return -2;
+	}
+
+	// Pobierz nazwę pliku i wygeneruj nagłówek ramki
+	const string name = filesystem::path(path).filename();
+	vector<char> data;
+
+	WIRE::put16(data, name.size());
+	data.insert(data.end(), name.begin(), name.end());
+	WIRE::put64(data, st.st_size);
+
+	// Nagłówek ramki trafi do jednego pakietu z danymi (o ile są)
+	int64_t count(-1);
+
+	if (send_all(m_sock, data.data(), data.size(), st.st_size ? MSG_MORE : 0))
+		count = send_file(m_sock, fd, st.st_size, m_progress);
+
+	::close(fd);
+
+	// Wysłano dokładnie tyle danych, ile zapowiedziano w nagłówku
+	return count == st.st_size ? count : -1;
+}
+
+int CLIENT::mput_end(int& failed)
+{
+	vector<char> end;
+	char reply[8];
+
+	WIRE::put16(end, 0);
+
+	// Wyślij ramkę zakończenia i odbierz liczniki plików
+	if (!send_all(m_sock, end.data(), end.size()) || !recv_all(m_sock, reply, sizeof(reply)))
+		return -1;
+
+	failed = WIRE::get32(reply + 4);
+
+	return WIRE::get32(reply);
+}
+
+CLIENT::TRANSFER CLIENT::fetch(const string& path, const string& dest)
+{
+	using ERROR = TRANSFER::ERROR;
+
+	const auto start = chrono::steady_clock::now();
+	TRANSFER result;
+
+	// Pobierz nazwę pliku i wygeneruj zapytanie z jedną nazwą
+	const string name = filesystem::path(path).filename();
+	const string header = "MGET -\n";
+
+	vector<char> request(header.begin(), header.end());
+
+	WIRE::put16(request, name.size());
+	request.insert(request.end(), name.begin(), name.end());
+	WIRE::put16(request, 0);
+
+	char head[8];
+
+	if (!send_all(m_sock, request.data(), request.size()) || !recv_all(m_sock, head, 2))
+		return result.finish(start, ERROR::Connection);
+
+	// Pusta odpowiedź (od razu ramka zakończenia) oznacza brak pliku
+	const size_t len = WIRE::get16(head);
+
+	if (len == 0) return result.finish(start, ERROR::Missing);
+
+	vector<char> skip(len);
+
+	if (!recv_all(m_sock, skip.data(), len) || !recv_all(m_sock, head, 8))
+		return result.finish(start, ERROR::Connection);
+
+	const uint64_t size = WIRE::get64(head);
+	const int fd = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	// Odbierz dokładnie zapowiedziany rozmiar - dane muszą zostać
+	// odebrane również po błędzie otwarcia pliku, aby zachować strumień
+	int64_t count(0);
+	bool ok = fd != -1;
+
+	if (ok) count = recv_file(m_sock, fd, size, m_progress);
+
+	while (!ok && uint64_t(count) < size)
+	{
+		const ssize_t rec = ::recv(m_sock, m_buff, min<uint64_t>(sizeof(m_buff), size - count), 0);
+
+		if (rec <= 0) return result.finish(start, ERROR::Connection);
+		else count += rec;
+	}
+
+	if (fd != -1 && ::close(fd) != 0) ok = false;
+
+	// Zerwane połączenie (lub błąd zapisu) psuje strumień
+	if (count < 0 || uint64_t(count) != size) return result.finish(start, ERROR::Connection);
+
+	// Odbierz ramkę zakończenia strumienia
+	if (!recv_all(m_sock, head, 2) || WIRE::get16(head) != 0)
+		return result.finish(start, ERROR::Connection);
+
+	result.bytes = ok ? size : 0;
+
+	return result.finish(start, ok ? ERROR::None : ERROR::Local);
+}
+
+CLIENT::TRANSFER CLIENT::push(const string& path, const string& src)
+{
+	using ERROR = TRANSFER::ERROR;
+
+	const auto start = chrono::steady_clock::now();
+	TRANSFER result;
+
+	int failed(0);
+
+	// Brak lokalnego pliku wykryj przed rozpoczęciem strumienia
+	if (::access(src.c_str(), R_OK) != 0) return result.finish(start, ERROR::Local);
+	else if (!mput_begin()) return result.finish(start, ERROR::Connection);
+
+	const int64_t count = mput_file(path, src);
+
+	// Błąd podczas wysyłania ramki psuje strumień
+	if (count == -1) return result.finish(start, ERROR::Connection);
+
+	const int stored = mput_end(failed);
+
+	// Po błędzie lokalnym zamknij pusty strumień, zachowując połączenie
+	if (stored < 0) return result.finish(start, ERROR::Connection);
+	else if (count < 0) return result.finish(start, ERROR::Local);
+	else if (stored != 1) return result.finish(start, ERROR::Rejected);
+
+	result.bytes = count;
+
+	return result.finish(start);
+}
+
+bool CLIENT::replicate_begin(const string& path, const string& chain)
+{
+	if (chain.size() > UINT16_MAX) return false;
+
+	// Pobierz nazwę pliku i wygeneruj nagłówek z listą dalszych węzłów
+	const string name = filesystem::path(path).filename();
+	const string header = "REPLICATE " + name + '\n';
+
+	vector<char> data(header.begin(), header.end());
+
+	WIRE::put16(data, chain.size());
+	data.insert(data.end(), chain.begin(), chain.end());
+
+	// Nagłówek trafi do jednego pakietu z pierwszymi danymi
+	return send_all(m_sock, data.data(), data.size(), MSG_MORE);
+}
+
+bool CLIENT::replicate_data(const char* data, size_t size)
+{
+	// Rekord pustej długości kończy plik - nie wysyłaj go tutaj
+	while (size > 0)
+	{
+		const uint32_t part = min<size_t>(size, UINT32_MAX);
+		vector<char> head;
+
+		WIRE::put32(head, part);
+
+		if (!send_all(m_sock, head.data(), head.size(), MSG_MORE) ||
+		    !send_all(m_sock, data, part)) return false;
+
+		data += part;
+		size -= part;
+	}
+
+	return true;
+}
+
+bool CLIENT::replicate_end(void)
+{
+	vector<char> end;
+	char status(1);
+
+	WIRE::put32(end, 0);
+
+	return send_all(m_sock, end.data(), end.size()) &&
+		  recv_all(m_sock, &status, 1) && status == 0;
+}
+
+bool CLIENT::peer_address(sockaddr_storage& addr, socklen_t& len) const
+{
+	len = sizeof(addr);
+
+	return m_sock > 0 && ::getpeername(m_sock, (sockaddr*) &addr, &len) == 0;
+}
+
+void CLIENT::set_progress(const PROGRESS& callback)
+{
+	m_progress = callback;
+}
+
+void CLIENT::set_framing(bool enable)
+{
+	m_framing = enable;
+}
+
+bool CLIENT::is_connected(void) const
+{
+	return m_sock > 0;
+}
+
+bool CLIENT::is_alive(void) const
+{
+	pollfd pfd = { m_sock, POLLIN, 0 };
+
+	// Gotowość do odczytu bezczynnego połączenia oznacza jego zamknięcie
+	return m_sock > 0 && ::poll(&pfd, 1, 0) == 0;
+}
+
+void CLIENT::interrupt(void)
+{
+	if (m_sock > 0) ::shutdown(m_sock, SHUT_RDWR);
+}
+
+string CLIENT::request(FRAME::OPCODE opcode, const string& name, uint64_t offset) const
+{
+	// Nagłówek tekstowy nie przenosi pozycji początkowej
+	if (!m_framing && !offset) return string(FRAME::command(opcode)) + ' ' + name + '\n';
+
+	FRAME::REQUEST request;
+	vector<char> frame;
+
+	request.opcode = opcode;
+	request.name = name;
+	request.offset = offset;
+
+	FRAME::encode(frame, request);
+
+	return string(frame.begin(), frame.end());
+}
+
+int CLIENT::confirm(uint64_t offset) const
+{
+	char reply[FRAME::reply];
+
+	if (!m_framing && !offset) return FRAME::Ok;
+	else if (!recv_all(m_sock, reply, sizeof(reply))) return -1;
+
+	const int status = FRAME::decode_reply(reply);
+
+	if (status != FRAME::Ok) cout << "(frame status " << status << ") ";
+
+	return status;
 }
@@ -27,13 +27,30 @@
 #define CLIENT_H
 
 #include "sockbase.hpp"
+#include "delta.hpp"
+#include "chunkstore.hpp"
+#include "index.hpp"
+#include "sparse.hpp"
+#include "frame.hpp"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <errno.h>
+
+#include <condition_variable>
 #include <filesystem>
+#include <functional>
 #include <iostream>
 #include <fstream>
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <deque>
 #include <map>
 
 using namespace std;
@@ -48,6 +65,51 @@ class CLIENT : public SOCKBASE
 
 	public:
 
+		/*! \brief Wynik przesyłania.
+		 *
+		 *  Opisuje zakończoną operację przesyłania pliku. Rozmiary są 64-bitowe,
+		 *  więc wynik jest poprawny również dla plików większych niż 4 GiB.
+		 *
+		 */
+		struct TRANSFER
+		{
+			/*! \brief Kody błędów.
+			 *
+			 *  Przyczyna niepowodzenia operacji.
+			 *
+			 */
+			enum class ERROR
+			{
+				None, //!< Operacja zakończona powodzeniem.
+				Local, //!< Błąd otwarcia lub zapisu lokalnego pliku.
+				Connection, //!< Błąd lub przedwczesne zamknięcie połączenia.
+				Missing, //!< Brak pliku na serwerze.
+				Rejected, //!< Serwer nie zapisał pliku.
+				Refused //!< Serwer odrzucił żądanie (np. pozycję początkową za końcem pliku).
+			};
+
+			uint64_t bytes = 0; //!< Liczba przesłanych bajtów.
+			double seconds = 0; //!< Czas operacji w sekundach.
+			double throughput = 0; //!< Przepustowość w bajtach na sekundę.
+			ERROR error = ERROR::None; //!< Kod błędu.
+
+			/*! \brief Zakończenie pomiaru.
+			 *  \returns Referencja do wyniku.
+			 *  \param [in] start Chwila rozpoczęcia operacji.
+			 *  \param [in] code Kod błędu.
+			 *
+			 *  Uzupełnia czas operacji, przepustowość i kod błędu.
+			 *
+			 */
+			TRANSFER& finish(chrono::steady_clock::time_point start, ERROR code = ERROR::None);
+
+			//! Sprawdza, czy operacja zakończyła się powodzeniem.
+			bool ok(void) const;
+
+			//! Zwraca opis błędu (pusty w przypadku powodzenia).
+			const char* what(void) const;
+		};
+
 		explicit CLIENT(void); //!< Konstruktor domyślny
 		virtual ~CLIENT(void) override; //!< Wirtualny destruktor
 
@@ -64,6 +126,30 @@ class CLIENT : public SOCKBASE
 		bool connect(const string& addr,
 				   const uint16_t port);
 
+		/*! \brief Inicjacja połączenia z adresem.
+		 *  \see connect, peer_address.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] addr Adres serwera (IPv4 lub IPv6).
+		 *  \param [in] len Długość adresu.
+		 *
+		 *  Nawiązuje połączenie z już rozwiązanym adresem, bez odpytywania resolvera.
+		 *  Pozwala wielokrotnie łączyć się z adresem zapamiętanym po pierwszym połączeniu.
+		 *
+		 */
+		bool connect(const sockaddr_storage& addr,
+				   socklen_t len);
+
+		/*! \brief Inicjacja połączenia lokalnego.
+		 *  \see connect, SOCKBASE::unix_address.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] path Ścieżka gniazda lub nazwa z prefiksem `@` (przestrzeń abstrakcyjna).
+		 *
+		 *  Nawiązuje połączenie z serwerem działającym na tym samym hoście przez
+		 *  gniazdo `AF_UNIX`.
+		 *
+		 */
+		bool connect_unix(const string& path);
+
 		/*! \brief Zamyka połączenie.
 		 *  \see start.
 		 *
@@ -73,32 +159,322 @@ class CLIENT : public SOCKBASE
 		void disconnect(void);
 
 		/*! \brief Pobieranie pliku.
-		 *  \see connect.
-		 *  \returns Liczba odebranych bajtów.
+		 *  \see connect, set_framing.
+		 *  \returns Wynik operacji.
 		 *  \param [in] path Nazwa pliku na serwerze.
 		 *  \param [in] dest Lokalna ścieżka pliku.
+		 *  \param [in] offset Pozycja początkowa pobierania.
 		 *
 		 *  Pobiera plik z połączonego serwera i zapisuje we wskazane miejsce w
 		 *  systemie plików. Ze wskazanej ścieżki do pliku źródłowego na serwerze
-		 *  pozyskiwana jest jedynie nazwa pliku.
+		 *  pozyskiwana jest jedynie nazwa pliku. Dane przenoszone są z gniazda do
+		 *  pliku funkcją `splice`.
+		 *
+		 *  Niezerowa pozycja początkowa wznawia pobieranie - lokalny plik nie jest
+		 *  skracany, a żądanie wysyłane jest jako ramka binarna. Brak nowych danych
+		 *  nie jest wtedy traktowany jako błąd.
 		 *
 		 */
-		int download(const string& path,
-				   const string& dest);
+		TRANSFER download(const string& path,
+					  const string& dest,
+					  uint64_t offset = 0);
 
 		/*! \brief Wysyłanie pliku.
 		 *  \see connect.
-		 *  \returns Liczba wysłanych bajtów.
+		 *  \returns Wynik operacji.
 		 *  \param [in] path Nazwa pliku na serwerze.
 		 *  \param [in] src Lokalna ścieżka pliku.
 		 *
 		 *  Wysyła plik do połączonego serwera odczytany z wskazanego miejsca w
 		 *  systemie plików. Ze wskazanej ścieżki do pliku docelowego na serwerze
-		 *  pozyskiwana jest jedynie nazwa pliku.
+		 *  pozyskiwana jest jedynie nazwa pliku. Dane wysyłane są funkcją `sendfile`.
+		 *
+		 */
+		TRANSFER upload(const string& path,
+					const string& src);
+
+		/*! \brief Śledzenie pliku.
+		 *  \see connect, download.
+		 *  \returns Wynik operacji.
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [in] dest Lokalna ścieżka pliku.
+		 *  \param [in] offset Pozycja początkowa (wznowienie śledzenia).
+		 *
+		 *  Pobiera plik jak `download`, lecz po dotarciu do jego końca połączenie
+		 *  pozostaje otwarte, a serwer wysyła dane dopisywane do pliku (polecenie
+		 *  `FOLLOW`). Kończy się, gdy plik zostanie usunięty, przeniesiony lub
+		 *  skrócony albo gdy serwer zamknie połączenie.
+		 *
+		 */
+		TRANSFER follow(const string& path,
+				      const string& dest,
+				      uint64_t offset = 0);
+
+		/*! \brief Pobieranie pliku rzadkiego.
+		 *  \see connect, SPARSE.
+		 *  \returns Wynik operacji (liczba bajtów danych pliku).
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [in] dest Lokalna ścieżka pliku.
+		 *
+		 *  Pobiera jedynie obszary danych pliku (polecenie `SGET`) i zapisuje je pod
+		 *  ich pozycjami. Dziury odtwarzane są bez zapisywania zer, a rozmiar pliku
+		 *  ustala rekord zakończenia.
+		 *
+		 */
+		TRANSFER download_sparse(const string& path,
+						     const string& dest);
+
+		/*! \brief Wysyłanie pliku rzadkiego.
+		 *  \see connect, SPARSE.
+		 *  \returns Wynik operacji (liczba bajtów danych pliku).
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [in] src Lokalna ścieżka pliku.
+		 *
+		 *  Wysyła jedynie obszary danych pliku (polecenie `SPUT`) wraz z opisem
+		 *  dziur i oczekuje na status zapisu. Dane obszarów wysyłane są funkcją
+		 *  `sendfile`. Wymaga serwera bez magazynu fragmentów i replikacji.
+		 *
+		 */
+		TRANSFER upload_sparse(const string& path,
+						   const string& src);
+
+		/*! \brief Synchronizacja różnicowa pliku.
+		 *  \see connect, DELTA.
+		 *  \returns Wynik operacji (liczba wysłanych bajtów strumienia zmian).
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [in] src Lokalna ścieżka pliku.
+		 *
+		 *  Wysyła do serwera jedynie zmiany względem kopii pliku przechowywanej na
+		 *  serwerze. Serwer przesyła sygnatury bloków swojej kopii, a klient odsyła
+		 *  dane dosłowne i odwołania do pasujących bloków. Liczba przesłanych danych
+		 *  jest proporcjonalna do wielkości zmian, a nie do rozmiaru pliku.
+		 *
+		 */
+		TRANSFER sync(const string& path,
+				    const string& src);
+
+		/*! \brief Wysyłanie pliku z deduplikacją.
+		 *  \see connect, CHUNKSTORE.
+		 *  \returns Wynik operacji (liczba wysłanych bajtów danych fragmentów).
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [in] src Lokalna ścieżka pliku.
+		 *
+		 *  Dzieli plik na fragmenty zależne od zawartości i przed wysłaniem danych
+		 *  pyta serwer, które fragmenty już posiada. Wysyłane są jedynie brakujące
+		 *  fragmenty. Wymaga serwera z włączonym magazynem fragmentów.
+		 *
+		 */
+		TRANSFER dedup(const string& path,
+				     const string& src);
+
+		/*! \brief Pobieranie pliku przez przekazanie deskryptora.
+		 *  \see connect_unix.
+		 *  \returns Wynik operacji.
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [in] dest Lokalna ścieżka pliku.
+		 *
+		 *  Odbiera od serwera lokalnego deskryptor otwartego pliku i kopiuje go
+		 *  we wskazane miejsce bez przesyłania danych przez gniazdo.
+		 *
+		 */
+		TRANSFER download_fd(const string& path,
+						 const string& dest);
+
+		/*! \brief Wysyłanie pliku przez przekazanie deskryptora.
+		 *  \see connect_unix.
+		 *  \returns Wynik operacji (liczba bajtów pliku).
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [in] src Lokalna ścieżka pliku.
+		 *
+		 *  Przekazuje serwerowi lokalnemu deskryptor pliku wraz z nagłówkiem i
+		 *  oczekuje na status zapisu. Dane nie są przesyłane przez gniazdo.
+		 *
+		 */
+		TRANSFER upload_fd(const string& path,
+					   const string& src);
+
+		/*! \brief Lista plików serwera.
+		 *  \see connect, INDEX.
+		 *  \returns Liczba plików lub `-1` w przypadku błędu.
+		 *  \param [in] prefix Przedrostek nazw plików (pusty dla wszystkich plików).
+		 *  \param [in] callback Funkcja wywoływana dla kolejnych plików.
+		 *
+		 *  Pobiera z indeksu serwera strumień rekordów z nazwami i metadanymi plików
+		 *  w porządku nazw. Wymaga serwera z włączonym indeksem metadanych.
+		 *
+		 */
+		int list(const string& prefix,
+			    const function<void(const string&, const INDEX::ENTRY&)>& callback);
+
+		/*! \brief Metadane pliku na serwerze.
+		 *  \see connect, INDEX.
+		 *  \returns `1` gdy plik istnieje, `0` gdy go brak lub `-1` w przypadku błędu.
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [out] entry Metadane pliku.
+		 *
+		 *  Pobiera z indeksu serwera rozmiar, czas modyfikacji i (jeśli serwer je
+		 *  wyznacza) skrót zawartości pliku bez jego przesyłania.
+		 *
+		 */
+		int stat(const string& path,
+			    INDEX::ENTRY& entry);
+
+		/*! \brief Pobieranie plików pasujących do wzorca.
+		 *  \see connect, receive_files.
+		 *  \returns Liczba zapisanych plików lub `-1` w przypadku błędu.
+		 *  \param [in] pattern Wzorzec nazw plików na serwerze (`fnmatch`, np. `*.log`).
+		 *  \param [in] dir Lokalny katalog docelowy.
+		 *  \param [in] writers Liczba wątków zapisujących pliki.
+		 *
+		 *  Pobiera wszystkie pasujące pliki w jednym strumieniu ramek.
+		 *
+		 */
+		int mget(const string& pattern,
+			    const string& dir,
+			    unsigned writers = 4);
+
+		/*! \brief Pobieranie listy plików.
+		 *  \see connect, receive_files.
+		 *  \returns Liczba zapisanych plików lub `-1` w przypadku błędu.
+		 *  \param [in] names Nazwy plików na serwerze.
+		 *  \param [in] dir Lokalny katalog docelowy.
+		 *  \param [in] writers Liczba wątków zapisujących pliki.
+		 *
+		 *  Pobiera wskazane pliki w jednym strumieniu ramek. Pliki nieobecne na
+		 *  serwerze są pomijane.
+		 *
+		 */
+		int mget(const vector<string>& names,
+			    const string& dir,
+			    unsigned writers = 4);
+
+		/*! \brief Rozpoczęcie wysyłania wielu plików.
+		 *  \see mput_file, mput_end.
+		 *  \returns Powodzenie operacji.
+		 *
+		 *  Wysyła nagłówek `MPUT`. Kolejne pliki przesyłane są jako ramki w tym
+		 *  samym połączeniu, które pozostaje otwarte po zakończeniu strumienia.
+		 *
+		 */
+		bool mput_begin(void);
+
+		/*! \brief Wysłanie pliku w strumieniu.
+		 *  \see mput_begin.
+		 *  \returns Liczba wysłanych bajtów pliku, `-1` w przypadku błędu strumienia
+		 *  lub `-2` gdy nie udało się otworzyć lokalnego pliku.
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [in] src Lokalna ścieżka pliku.
+		 *
+		 *  Wysyła ramkę pliku (długość nazwy, nazwa, rozmiar i dane). Błąd podczas
+		 *  wysyłania danych psuje strumień - połączenie należy wtedy zamknąć. Błąd
+		 *  otwarcia pliku zgłaszany jest przed wysłaniem ramki, więc strumień
+		 *  pozostaje poprawny.
+		 *
+		 */
+		int64_t mput_file(const string& path,
+					   const string& src);
+
+		/*! \brief Zakończenie wysyłania wielu plików.
+		 *  \see mput_begin.
+		 *  \returns Liczba plików zapisanych przez serwer lub `-1` w przypadku błędu.
+		 *  \param [out] failed Liczba plików, których serwer nie zapisał.
+		 *
+		 *  Wysyła ramkę zakończenia i czeka, aż serwer utrwali wszystkie pliki.
+		 *
+		 */
+		int mput_end(int& failed);
+
+		/*! \brief Pobranie pliku bez zamykania połączenia.
+		 *  \see mget.
+		 *  \returns Wynik operacji.
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [in] dest Lokalna ścieżka pliku.
+		 *
+		 *  Pobiera jeden plik strumieniem `MGET`. Połączenie pozostaje otwarte i może
+		 *  obsłużyć kolejne polecenie, o ile kodem błędu nie jest `Connection`.
+		 *
+		 */
+		TRANSFER fetch(const string& path,
+				     const string& dest);
+
+		/*! \brief Wysłanie pliku bez zamykania połączenia.
+		 *  \see mput_begin.
+		 *  \returns Wynik operacji.
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [in] src Lokalna ścieżka pliku.
+		 *
+		 *  Wysyła jeden plik strumieniem `MPUT` i czeka na jego utrwalenie. Połączenie
+		 *  pozostaje otwarte, o ile kodem błędu nie jest `Connection`.
 		 *
 		 */
-		int upload(const string& path,
-				 const string& src);
+		TRANSFER push(const string& path,
+				    const string& src);
+
+		/*! \brief Rozpoczęcie replikacji pliku.
+		 *  \see replicate_data, replicate_end.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] path Nazwa pliku na serwerze.
+		 *  \param [in] chain Dalsze węzły łańcucha replikacji (`host:port` rozdzielone przecinkami).
+		 *
+		 *  Wysyła nagłówek `REPLICATE` wraz z listą węzłów, do których serwer
+		 *  przekaże plik. Używane przez serwery łańcucha replikacji.
+		 *
+		 */
+		bool replicate_begin(const string& path,
+						 const string& chain);
+
+		/*! \brief Wysłanie danych replikowanego pliku.
+		 *  \see replicate_begin.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] data Dane pliku.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Wysyła dane jako rekordy (długość i dane).
+		 *
+		 */
+		bool replicate_data(const char* data,
+						size_t size);
+
+		/*! \brief Zakończenie replikacji pliku.
+		 *  \see replicate_begin.
+		 *  \returns `true` gdy plik zapisały wszystkie węzły łańcucha.
+		 *
+		 *  Wysyła rekord zakończenia i czeka na status. Serwer odsyła go dopiero po
+		 *  utrwaleniu pliku i potwierdzeniu od kolejnych węzłów. Po powodzeniu
+		 *  połączenie pozostaje otwarte.
+		 *
+		 */
+		bool replicate_end(void);
+
+		/*! \brief Adres połączonego serwera.
+		 *  \returns Powodzenie operacji.
+		 *  \param [out] addr Adres serwera.
+		 *  \param [out] len Długość adresu.
+		 *
+		 */
+		bool peer_address(sockaddr_storage& addr,
+					   socklen_t& len) const;
+
+		/*! \brief Śledzenie postępu.
+		 *  \param [in] callback Funkcja informowana o liczbie przesłanych bajtów pliku (pusta wyłącza śledzenie).
+		 *
+		 *  Funkcja wywoływana jest w wątku wykonującym przesyłanie w trakcie operacji
+		 *  `download`, `upload`, `follow`, `download_sparse`, `upload_sparse`, `fetch`
+		 *  i `push`.
+		 *
+		 */
+		void set_progress(const PROGRESS& callback);
+
+		/*! \brief Wybór formatu żądań.
+		 *  \see FRAME.
+		 *  \param [in] enable Wysyłanie żądań jako ramek binarnych.
+		 *
+		 *  Dotyczy operacji `download`, `upload` i `follow`. Serwer potwierdza
+		 *  każdą ramkę, więc odrzucone żądanie zgłaszane jest jako błąd zamiast
+		 *  cichego zamknięcia połączenia.
+		 *
+		 */
+		void set_framing(bool enable);
 
 		/*! \brief Test nawiązania połączenia.
 		 *  \see connect, disconnect.
@@ -110,6 +486,88 @@ class CLIENT : public SOCKBASE
 		 */
 		bool is_connected(void) const;
 
+		/*! \brief Test bezczynnego połączenia.
+		 *  \see is_connected.
+		 *  \returns `true` gdy serwer nie zamknął połączenia i nie przysłał nieoczekiwanych danych.
+		 *
+		 *  Sprawdza bez blokowania połączenie przechowywane w puli przed jego
+		 *  ponownym użyciem.
+		 *
+		 */
+		bool is_alive(void) const;
+
+		/*! \brief Przerwanie operacji.
+		 *  \see disconnect.
+		 *
+		 *  Zamyka połączenie w obu kierunkach bez zwalniania gniazda, przez co
+		 *  operacje blokujące w innym wątku kończą się błędem. Gniazdo należy
+		 *  następnie zamknąć funkcją `disconnect`.
+		 *
+		 */
+		void interrupt(void);
+
+	protected:
+
+		static constexpr size_t direct_min = 1 << 22; //!< Rozmiar pliku zapisywanego bezpośrednio przez wątek odbioru.
+
+		PROGRESS m_progress; //!< Funkcja śledzenia postępu.
+		bool m_framing = false; //!< Flaga wysyłania żądań jako ramek binarnych.
+
+		/*! \brief Przygotowanie żądania.
+		 *  \see confirm.
+		 *  \returns Nagłówek tekstowy lub ramka binarna.
+		 *  \param [in] opcode Kod polecenia.
+		 *  \param [in] name Nazwa pliku.
+		 *  \param [in] offset Pozycja początkowa (wymusza ramkę binarną).
+		 *
+		 */
+		string request(FRAME::OPCODE opcode, const string& name, uint64_t offset = 0) const;
+
+		/*! \brief Odbiór potwierdzenia ramki.
+		 *  \see request.
+		 *  \returns Status ramki (`FRAME::Ok` dla żądania tekstowego) lub `-1` w przypadku błędu połączenia.
+		 *  \param [in] offset Pozycja początkowa przekazana do `request`.
+		 *
+		 */
+		int confirm(uint64_t offset = 0) const;
+
+		/*! \brief Odbiór strumienia wielu plików.
+		 *  \see mget.
+		 *  \returns Liczba zapisanych plików lub `-1` w przypadku błędu.
+		 *  \param [in] dir Lokalny katalog docelowy.
+		 *  \param [in] writers Liczba wątków zapisujących pliki.
+		 *
+		 *  Dekoduje ramki plików odpowiedzi `MGET`. Małe pliki gromadzone są w
+		 *  pamięci i zapisywane równolegle przez pulę wątków, dzięki czemu odbiór
+		 *  nie czeka na otwieranie i zamykanie plików. Pliki większe niż `direct_min`
+		 *  zapisywane są bezpośrednio w trakcie odbioru.
+		 *
+		 */
+		int receive_files(const string& dir, unsigned writers);
+
+		/*! \brief Mapowanie pliku do pamięci.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] path Ścieżka pliku.
+		 *  \param [out] data Wskaźnik na dane (`nullptr` dla pustego pliku).
+		 *  \param [out] size Rozmiar pliku.
+		 *
+		 *  Mapuje cały plik tylko do odczytu. Odwzorowanie należy zwolnić funkcją `munmap`.
+		 *
+		 */
+		static bool map(const string& path, char*& data, size_t& size);
+
+		/*! \brief Równoległe nawiązywanie połączenia.
+		 *  \returns Deskryptor połączonego gniazda lub `-1` w przypadku błędu.
+		 *  \param [in] list Lista adresów z `getaddrinfo`.
+		 *  \param [in] delay Odstęp pomiędzy kolejnymi próbami w ms.
+		 *
+		 *  Realizuje algorytm Happy Eyeballs: próby połączenia z kolejnymi adresami
+		 *  (na przemian IPv6 i IPv4) rozpoczynane są co `delay` ms bez czekania na
+		 *  zakończenie poprzednich. Wygrywa pierwsze nawiązane połączenie.
+		 *
+		 */
+		int connect_any(const addrinfo* list, int delay = 250);
+
 };
 
 #endif // CLIENT_H
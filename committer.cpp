@@ -0,0 +1,262 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy grupowego zatwierdzania plików.
+ *  \file
+ *
+ */
+
+#include "committer.hpp"
+
+COMMITTER::COMMITTER(void) {}
+
+COMMITTER::~COMMITTER(void)
+{
+	close(); // Zatwierdź oczekujące pliki
+}
+
+bool COMMITTER::open(const string& dir)
+{
+	if (is_open()) return true;
+
+	m_event = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	m_dir = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (m_event == -1 || m_dir == -1)
+	{
+		close();
+		return false;
+	}
+
+	m_stop = false;
+	m_thread = thread(&COMMITTER::run, this);
+
+	return true;
+}
+
+void COMMITTER::close(void)
+{
+	// Zakończ wątek - wcześniej zatwierdzi on pozostałe pliki
+	if (m_thread.joinable())
+	{
+		{
+			lock_guard<mutex> lock(m_lock);
+			m_stop = true;
+		}
+
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	if (m_event != -1) ::close(m_event);
+	if (m_dir != -1) ::close(m_dir);
+
+	m_event = m_dir = -1;
+	m_done.clear();
+}
+
+bool COMMITTER::submit(int fd, const string& temp, const string& name, const CALLBACK& callback)
+{
+	if (!is_open())
+	{
+		discard(fd, temp);
+		return false;
+	}
+
+	{
+		lock_guard<mutex> lock(m_lock);
+		m_queue.push_back({ fd, temp, name, callback });
+	}
+
+	m_wake.notify_one();
+
+	return true;
+}
+
+void COMMITTER::dispatch(void)
+{
+	uint64_t count;
+	vector<JOB> done;
+
+	// Wyzeruj licznik powiadomień
+	if (::read(m_event, &count, sizeof(count)) <= 0) return;
+
+	{
+		lock_guard<mutex> lock(m_lock);
+		done.swap(m_done);
+	}
+
+	// Funkcje zwrotne wywołuj poza blokadą
+	for (const auto& job : done) job.callback(job.ok);
+}
+
+int COMMITTER::fd(void) const
+{
+	return m_event;
+}
+
+bool COMMITTER::is_open(void) const
+{
+	return m_event != -1;
+}
+
+size_t COMMITTER::batches(void) const
+{
+	return m_batches;
+}
+
+size_t COMMITTER::files(void) const
+{
+	return m_files;
+}
+
+int COMMITTER::create(const string& name, string& temp, int dir)
+{
+	static atomic<unsigned> serial = 0;
+
+	const size_t slash = name.rfind('/');
+	const size_t base = slash == string::npos ? 0 : slash + 1;
+
+	// Ukryty plik w katalogu pliku docelowego, np. `3f/.nazwa.PID.N` - kolejny
+	// numer i identyfikator procesu odróżniają pliki równoległych wysyłań
+	const string prefix = name.substr(0, base) + '.' + name.substr(base) + '.' + to_string(::getpid()) + '.';
+
+	for (unsigned i = 0; i < 16; ++i)
+	{
+		const string path = prefix + to_string(++serial);
+
+		// Względem katalogu plik tworzony jest samą nazwą - `rename` będzie atomowy
+		const int fd = ::openat(dir, path.c_str() + (dir == AT_FDCWD ? 0 : base),
+						    O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+		if (fd != -1) temp = path;
+		if (fd != -1 || errno != EEXIST) return fd;
+	}
+
+	return -1;
+}
+
+void COMMITTER::discard(int fd, const string& temp)
+{
+	if (fd != -1) ::close(fd);
+	if (!temp.empty()) ::unlink(temp.c_str());
+}
+
+void COMMITTER::run(void)
+{
+	unique_lock<mutex> lock(m_lock);
+
+	while (true)
+	{
+		m_wake.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+
+		// Zakończ dopiero po opróżnieniu kolejki
+		if (m_queue.empty()) break;
+
+		// Przejmij wszystkie zgłoszone pliki jako jedną porcję - pliki
+		// zgłoszone w trakcie jej zatwierdzania trafią do kolejnej
+		vector<JOB> batch;
+		batch.swap(m_queue);
+
+		lock.unlock();
+		flush(batch);
+		lock.lock();
+
+		bool notify = false;
+
+		for (auto& job : batch) if (job.callback)
+		{
+			m_done.push_back(move(job));
+			notify = true;
+		}
+
+		// Powiadom pętlę serwera o wynikach
+		if (notify)
+		{
+			const uint64_t one = 1;
+			(void) ::write(m_event, &one, sizeof(one));
+		}
+	}
+}
+
+void COMMITTER::flush(vector<JOB>& batch)
+{
+	// Rozpocznij zapis danych wszystkich plików porcji naraz
+	for (auto& job : batch) ::sync_file_range(job.fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+
+	atomic<size_t> next = 0; // Indeks kolejnego pliku do utrwalenia
+
+	// Utrwal dane każdego pliku osobno (błąd zapisu dotyczy wtedy tylko
+	// jego pliku), ale równolegle - kolejne wywołania `fdatasync` kosztują
+	// osobne zatwierdzenie dziennika i opróżnienie pamięci podręcznej dysku,
+	// a jednoczesne czekają na wspólne
+	const auto sync = [&batch, &next] (void)
+	{
+		for (size_t i; (i = next++) < batch.size(); )
+			batch[i].ok = ::fdatasync(batch[i].fd) == 0;
+	};
+
+	vector<thread> workers;
+
+	// Bez dodatkowych wątków pozostałe pliki utrwali wątek roboczy
+	try
+	{
+		while (workers.size() + 1 < min(batch.size(), sync_threads)) workers.emplace_back(sync);
+	}
+	catch (const system_error&) {}
+
+	sync();
+
+	for (auto& worker : workers) worker.join();
+
+	set<string> dirs; // Katalogi ze zmienionymi wpisami
+
+	// Dane są już na dysku - podmień pliki docelowe
+	for (auto& job : batch)
+	{
+		job.ok = job.ok && ::rename(job.temp.c_str(), job.name.c_str()) == 0;
+
+		if (!job.ok) ::unlink(job.temp.c_str());
+		else dirs.insert(parent(job.name));
+
+		::close(job.fd);
+	}
+
+	// Utrwal wpisy każdego katalogu jedną operacją
+	for (const auto& dir : dirs)
+	{
+		const int fd = dir.empty() ? m_dir : ::openat(m_dir, dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		const bool ok = fd != -1 && ::fsync(fd) == 0;
+
+		if (fd != -1 && fd != m_dir) ::close(fd);
+
+		if (!ok) for (auto& job : batch) if (parent(job.name) == dir) job.ok = false;
+	}
+
+	m_batches += 1;
+	m_files += batch.size();
+}
+
+string COMMITTER::parent(const string& name)
+{
+	const size_t slash = name.rfind('/');
+
+	return slash == string::npos ? string() : name.substr(0, slash);
+}
@@ -0,0 +1,203 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy grupowego zatwierdzania plików.
+ *  \file
+ *
+ */
+
+#ifndef COMMITTER_HPP
+#define COMMITTER_HPP
+
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+#include <condition_variable>
+#include <system_error>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <set>
+#include <mutex>
+
+using namespace std;
+
+/*! \brief Klasa grupowego zatwierdzania plików.
+ *
+ *  Wysyłane pliki zapisywane są do plików tymczasowych i po odebraniu całości
+ *  przekazywane do tej klasy. Wątek roboczy utrwala dane na dysku, atomowo
+ *  podmienia pliki docelowe (`rename`) i utrwala zmiany katalogu. Pliki, które
+ *  zakończyły się w trakcie trwającego zatwierdzania, trafiają do kolejnej
+ *  wspólnej porcji - koszt opróżnienia pamięci podręcznej dysku jest dzielony
+ *  pomiędzy wiele plików. Wyniki zgłaszane są przez `eventfd` obsługiwany w
+ *  pętli serwera metodą `dispatch`.
+ *
+ */
+class COMMITTER
+{
+
+	public:
+
+		/*! \brief Funkcja zwrotna zatwierdzenia.
+		 *
+		 *  Otrzymuje wynik operacji. Wywoływana w wątku wywołującym `dispatch`.
+		 *
+		 */
+		using CALLBACK = function<void(bool ok)>;
+
+	protected:
+
+		/*! \brief Opis zadania.
+		 *
+		 *  Plik tymczasowy oczekujący na zatwierdzenie.
+		 *
+		 */
+		struct JOB
+		{
+			int fd; //!< Deskryptor pliku tymczasowego.
+			string temp; //!< Nazwa pliku tymczasowego.
+			string name; //!< Nazwa pliku docelowego.
+			CALLBACK callback; //!< Funkcja zwrotna.
+			bool ok = false; //!< Wynik zatwierdzenia.
+		};
+
+		static constexpr size_t sync_threads = 8; //!< Maksymalna liczba równoległych wywołań `fdatasync`.
+
+		int m_event = -1; //!< Deskryptor powiadomień (`eventfd`).
+		int m_dir = -1; //!< Deskryptor katalogu roboczego.
+
+		thread m_thread; //!< Wątek roboczy.
+		mutex m_lock; //!< Blokada kolejek.
+		condition_variable m_wake; //!< Powiadomienie wątku roboczego.
+
+		vector<JOB> m_queue; //!< Zadania oczekujące na zatwierdzenie.
+		vector<JOB> m_done; //!< Zadania zakończone z funkcją zwrotną.
+		bool m_stop = false; //!< Flaga zakończenia pracy wątku.
+
+		atomic<size_t> m_batches = 0; //!< Liczba porcji.
+		atomic<size_t> m_files = 0; //!< Liczba zatwierdzonych plików.
+
+	public:
+
+		explicit COMMITTER(void); //!< Konstruktor domyślny.
+		virtual ~COMMITTER(void); //!< Destruktor, zatwierdza oczekujące pliki.
+
+		COMMITTER(const COMMITTER&) = delete; //!< Konstruktor kopiujący (usunięty).
+		COMMITTER& operator= (const COMMITTER&) = delete; //!< Operator przypisania (usunięty).
+
+		/*! \brief Uruchomienie zatwierdzania.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] dir Katalog, względem którego podawane są ścieżki plików.
+		 *
+		 *  Otwiera deskryptor powiadomień i uruchamia wątek roboczy.
+		 *
+		 */
+		bool open(const string& dir = ".");
+
+		/*! \brief Zatrzymanie zatwierdzania.
+		 *
+		 *  Zatwierdza wszystkie oczekujące pliki i kończy wątek roboczy. Funkcje
+		 *  zwrotne niewywołanych zadań są porzucane.
+		 *
+		 */
+		void close(void);
+
+		/*! \brief Zgłoszenie pliku.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] fd Deskryptor pliku tymczasowego (przejmowany przez obiekt).
+		 *  \param [in] temp Nazwa pliku tymczasowego.
+		 *  \param [in] name Nazwa pliku docelowego.
+		 *  \param [in] callback Opcjonalna funkcja zwrotna.
+		 *
+		 *  Dodaje plik do kolejnej porcji zatwierdzania.
+		 *
+		 */
+		bool submit(int fd, const string& temp, const string& name,
+				  const CALLBACK& callback = nullptr);
+
+		/*! \brief Obsługa wyników.
+		 *
+		 *  Odczytuje powiadomienie i wywołuje funkcje zwrotne zakończonych zadań.
+		 *
+		 */
+		void dispatch(void);
+
+		//! Zwraca deskryptor powiadomień do monitorowania funkcją `poll`.
+		int fd(void) const;
+
+		//! Sprawdza, czy zatwierdzanie zostało uruchomione.
+		bool is_open(void) const;
+
+		//! Zwraca liczbę wykonanych porcji.
+		size_t batches(void) const;
+
+		//! Zwraca liczbę zatwierdzonych plików.
+		size_t files(void) const;
+
+		/*! \brief Utworzenie pliku tymczasowego.
+		 *  \returns Deskryptor pliku lub `-1` w przypadku błędu.
+		 *  \param [in] name Ścieżka pliku docelowego.
+		 *  \param [out] temp Ścieżka utworzonego pliku tymczasowego.
+		 *  \param [in] dir Deskryptor katalogu pliku - plik tworzony jest wtedy względem niego.
+		 *
+		 *  Tworzy unikalny, ukryty plik tymczasowy w katalogu pliku docelowego.
+		 *
+		 */
+		static int create(const string& name, string& temp, int dir = AT_FDCWD);
+
+		/*! \brief Porzucenie pliku tymczasowego.
+		 *  \param [in] fd Deskryptor pliku tymczasowego.
+		 *  \param [in] temp Nazwa pliku tymczasowego.
+		 *
+		 *  Zamyka i usuwa niezatwierdzony plik tymczasowy.
+		 *
+		 */
+		static void discard(int fd, const string& temp);
+
+	protected:
+
+		//! Pętla wątku roboczego.
+		void run(void);
+
+		/*! \brief Zatwierdzenie porcji.
+		 *  \param [in,out] batch Porcja zadań.
+		 *
+		 *  Rozpoczyna zapis danych całej porcji, następnie utrwala dane każdego
+		 *  pliku równoległymi wywołaniami `fdatasync` (błędy zgłaszane są dla
+		 *  pojedynczych plików), podmienia pliki i utrwala każdy ich katalog
+		 *  jedną operacją.
+		 *
+		 */
+		void flush(vector<JOB>& batch);
+
+		//! Zwraca katalog nadrzędny ścieżki (pusty dla katalogu roboczego).
+		static string parent(const string& name);
+
+};
+
+#endif // COMMITTER_HPP
@@ -0,0 +1,440 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy synchronizacji różnicowej.
+ *  \file
+ *
+ */
+
+#include "delta.hpp"
+
+#include <cmath>
+
+//! Stała mieszająca skrótu (złoty podział).
+static const uint64_t mix_k = 0x9E3779B97F4A7C15ull;
+
+//! Funkcja mieszająca pojedyncze słowo skrótu.
+static inline uint64_t mix64(uint64_t k)
+{
+	k ^= k >> 33; k *= 0xFF51AFD7ED558CCDull;
+	k ^= k >> 33; k *= 0xC4CEB9FE1A85EC53ull;
+	k ^= k >> 33;
+
+	return k;
+}
+
+DELTA::HASH::HASH(uint64_t seed)
+: m_hash(seed ^ mix_k) {}
+
+void DELTA::HASH::update(const char* data, size_t size)
+{
+	m_total += size;
+
+	// Uzupełnij niepełne słowo z poprzedniego wywołania
+	if (m_tsize)
+	{
+		const size_t n = min(size, sizeof(m_tail) - m_tsize);
+
+		memcpy(m_tail + m_tsize, data, n);
+		m_tsize += n; data += n; size -= n;
+
+		if (m_tsize < sizeof(m_tail)) return;
+
+		m_hash = (m_hash ^ mix64(WIRE::get64(m_tail))) * mix_k;
+		m_tsize = 0;
+	}
+
+	// Przetwarzaj pełne słowa
+	for (; size >= 8; data += 8, size -= 8)
+		m_hash = (m_hash ^ mix64(WIRE::get64(data))) * mix_k;
+
+	// Zachowaj resztę danych na kolejne wywołanie
+	memcpy(m_tail, data, size);
+	m_tsize = size;
+}
+
+uint64_t DELTA::HASH::digest(void) const
+{
+	uint64_t h = m_hash;
+	char last[8] = {};
+
+	// Dołącz niepełne słowo i długość danych
+	memcpy(last, m_tail, m_tsize);
+	h = (h ^ mix64(WIRE::get64(last))) * mix_k;
+
+	return mix64(h ^ m_total);
+}
+
+DELTA::DELTA(void) {}
+
+DELTA::~DELTA(void)
+{
+	if (m_patch) ::fclose(m_patch);
+	if (m_basis != -1) ::close(m_basis);
+
+	// Usuń plik tymczasowy jeśli nie został przekazany do zatwierdzenia
+	if (!m_released && !m_temp.empty()) ::unlink(m_temp.c_str());
+}
+
+bool DELTA::open(const string& name, int dir)
+{
+	struct stat st;
+
+	const filesystem::path path(name);
+
+	// Względem katalogu plik bazowy otwierany jest samą nazwą
+	const string base = dir == AT_FDCWD ? name : path.filename().string();
+
+	m_name = name;
+	m_basis = ::openat(dir, base.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (m_basis == -1 && errno != ENOENT) return false;
+
+	// Rozmiar pliku bazowego (zero gdy plik nie istnieje)
+	const uint64_t size = m_basis != -1 && ::fstat(m_basis, &st) == 0 &&
+					  S_ISREG(st.st_mode) ? st.st_size : 0;
+
+	m_block = block_size(size);
+	m_count = size / m_block;
+
+	// Unikalny plik tymczasowy - równoległe sesje tego samego pliku
+	// nie mogą współdzielić ani usuwać sobie nawzajem nowej wersji
+	const int fd = COMMITTER::create(name, m_temp, dir);
+
+	// Zapisy są buforowane - rekordy danych bywają krótkie
+	if (fd != -1 && !(m_patch = ::fdopen(fd, "w"))) ::close(fd);
+
+	m_scratch.resize(m_block);
+
+	return m_patch != nullptr;
+}
+
+bool DELTA::sign(vector<char>& out)
+{
+	// Na początku wyślij rozmiar bloku i liczbę bloków
+	if (!m_header)
+	{
+		WIRE::put32(out, m_block);
+		WIRE::put64(out, m_count);
+
+		m_header = true;
+	}
+
+	// Generuj sygnatury porcjami po 256 bloków
+	for (int i = 0; i < 256 && m_signed < m_count; ++i, ++m_signed)
+	{
+		if (::pread(m_basis, m_scratch.data(), m_block, m_signed * m_block) != ssize_t(m_block))
+			return false;
+
+		WIRE::put32(out, weak(m_scratch.data(), m_block));
+		WIRE::put64(out, strong(m_scratch.data(), m_block));
+	}
+
+	return true;
+}
+
+bool DELTA::feed(const char* data, size_t size)
+{
+	m_in.insert(m_in.end(), data, data + size);
+
+	size_t pos = 0; // Pozycja bieżącego rekordu
+
+	// Dekoduj wszystkie kompletne rekordy
+	while (!m_done && pos < m_in.size())
+	{
+		const char* rec = m_in.data() + pos;
+		const size_t avail = m_in.size() - pos;
+
+		if (rec[0] == Literal)
+		{
+			if (avail < 5) break;
+
+			const uint32_t len = WIRE::get32(rec + 1);
+
+			if (len > literal_max) return false;
+			else if (avail < 5 + len) break;
+
+			if (::fwrite(rec + 5, 1, len, m_patch) != len) return false;
+
+			m_hash.update(rec + 5, len);
+			m_written += len;
+
+			pos += 5 + len;
+		}
+		else if (rec[0] == Copy)
+		{
+			if (avail < 13) break;
+
+			const uint64_t index = WIRE::get64(rec + 1);
+			const uint32_t count = WIRE::get32(rec + 9);
+
+			// Odwołanie poza plik bazowy jest błędem
+			if (index > m_count || count > m_count - index) return false;
+
+			// Przepisz wskazane bloki z pliku bazowego
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				const off_t offset = (index + i) * m_block;
+
+				if (::pread(m_basis, m_scratch.data(), m_block, offset) != ssize_t(m_block) ||
+				    ::fwrite(m_scratch.data(), 1, m_block, m_patch) != m_block) return false;
+
+				m_hash.update(m_scratch.data(), m_block);
+				m_written += m_block;
+			}
+
+			pos += 13;
+		}
+		else if (rec[0] == End)
+		{
+			if (avail < 17) break;
+
+			const uint64_t total = WIRE::get64(rec + 1);
+			const uint64_t hash = WIRE::get64(rec + 9);
+
+			// Zweryfikuj odtworzony plik
+			if (total != m_written || hash != m_hash.digest()) return false;
+
+			m_done = true;
+			pos += 17;
+		}
+		else return false;
+	}
+
+	m_in.erase(m_in.begin(), m_in.begin() + pos);
+
+	return !::ferror(m_patch);
+}
+
+int DELTA::release(string& temp)
+{
+	if (!m_done) return -1;
+
+	// Deskryptor musi przetrwać zamknięcie strumienia buforowanego
+	const int fd = ::dup(::fileno(m_patch));
+	const bool written = ::fclose(m_patch) == 0;
+
+	if (m_basis != -1) ::close(m_basis);
+
+	m_patch = nullptr;
+	m_basis = -1;
+
+	if (fd == -1 || !written)
+	{
+		if (fd != -1) ::close(fd);
+		return -1;
+	}
+
+	temp = m_temp;
+	m_released = true;
+
+	return fd;
+}
+
+bool DELTA::is_done(void) const
+{
+	return m_done;
+}
+
+uint32_t DELTA::block_size(uint64_t size)
+{
+	// Pierwiastek z rozmiaru wyrównany do 8 B
+	const uint64_t block = uint64_t(sqrt(double(size))) & ~7ull;
+
+	return clamp<uint64_t>(block, block_min, block_max);
+}
+
+uint32_t DELTA::weak(const char* data, size_t size)
+{
+	const auto* x = (const unsigned char*) data;
+	uint32_t a = 0, b = 0;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		a += x[i];
+		b += uint32_t(size - i) * x[i];
+	}
+
+	return (a & 0xFFFF) | (b << 16);
+}
+
+uint64_t DELTA::strong(const char* data, size_t size)
+{
+	HASH hash;
+	hash.update(data, size);
+
+	return hash.digest();
+}
+
+bool DELTA::encode(const char* data, size_t size, uint32_t block,
+			    const vector<BLOCK>& sig,
+			    const function<bool(const char*, size_t)>& emit)
+{
+	static const size_t segment = 1 << 16; // Liczba okien liczonych jednocześnie
+
+	vector<char> out; // Bufor wyjściowy
+
+	uint64_t run_start = 0, run_count = 0; // Bieżąca seria bloków
+	size_t lit_start = 0; // Początek niewysłanych danych dosłownych
+
+	// Wysyła bufor, gdy zgromadzi się w nim dostatecznie dużo danych
+	const auto flush = [&] (bool force) -> bool
+	{
+		if (out.empty() || (!force && out.size() < literal_max)) return true;
+
+		const bool ok = emit(out.data(), out.size());
+		out.clear();
+
+		return ok;
+	};
+
+	// Koduje serię bloków z pliku bazowego
+	const auto put_run = [&] (void) -> bool
+	{
+		if (!run_count) return true;
+
+		out.push_back(Copy);
+		WIRE::put64(out, run_start);
+		WIRE::put32(out, run_count);
+		run_count = 0;
+
+		return flush(false);
+	};
+
+	// Koduje dane dosłowne od `lit_start` do `end`
+	const auto put_literal = [&] (size_t end) -> bool
+	{
+		if (end > lit_start && !put_run()) return false;
+
+		while (end > lit_start)
+		{
+			const size_t len = min(end - lit_start, literal_max);
+
+			out.push_back(Literal);
+			WIRE::put32(out, len);
+			out.insert(out.end(), data + lit_start, data + lit_start + len);
+			lit_start += len;
+
+			if (!flush(false)) return false;
+		}
+
+		return true;
+	};
+
+	// Indeks sygnatur posortowany po sumie słabej oraz tablica
+	// 16-bitowych znaczników do szybkiego odrzucania okien
+	vector<pair<uint32_t, uint64_t>> index;
+	vector<bool> tags(1 << 16);
+
+	index.reserve(sig.size());
+	for (uint64_t i = 0; i < sig.size(); ++i)
+	{
+		index.push_back({ sig[i].weak, i });
+		tags[(sig[i].weak ^ (sig[i].weak >> 16)) & 0xFFFF] = true;
+	}
+
+	sort(index.begin(), index.end());
+
+	vector<uint32_t> P, Q, W; // Sumy prefiksowe i sumy okien
+	size_t seg_start = 0, seg_end = 0; // Zakres okien w bieżącej porcji
+	size_t pos = 0; // Pozycja bieżącego okna
+
+	while (!sig.empty() && block && pos + block <= size)
+	{
+		// Oblicz sumy słabe dla kolejnej porcji okien
+		if (pos >= seg_end)
+		{
+			const auto* x = (const unsigned char*) data + pos;
+			const size_t count = min(segment, size - block - pos + 1);
+			const size_t span = count + block - 1;
+
+			P.resize(span + 1); Q.resize(span + 1); W.resize(count);
+			P[0] = Q[0] = 0;
+
+			for (size_t i = 0; i < span; ++i)
+			{
+				P[i + 1] = P[i] + x[i];
+				Q[i + 1] = Q[i] + uint32_t(i) * x[i];
+			}
+
+			// Iteracje są niezależne - pętla jest wektoryzowana
+			for (size_t j = 0; j < count; ++j)
+			{
+				const uint32_t a = P[j + block] - P[j];
+				const uint32_t b = uint32_t(j + block) * a - (Q[j + block] - Q[j]);
+
+				W[j] = (a & 0xFFFF) | (b << 16);
+			}
+
+			seg_start = pos;
+			seg_end = pos + count;
+		}
+
+		const uint32_t w = W[pos - seg_start];
+		bool found = false;
+
+		// Sprawdź silny skrót tylko dla kandydatów
+		if (tags[(w ^ (w >> 16)) & 0xFFFF])
+		{
+			auto it = lower_bound(index.begin(), index.end(), make_pair(w, uint64_t(0)));
+			uint64_t s = 0; bool has_s = false;
+
+			for (; it != index.end() && it->first == w; ++it)
+			{
+				if (!has_s) { s = strong(data + pos, block); has_s = true; }
+				if (sig[it->second].strong != s) continue;
+
+				if (!put_literal(pos)) return false;
+
+				// Przedłuż serię lub rozpocznij nową
+				if (run_count && run_start + run_count == it->second) ++run_count;
+				else
+				{
+					if (!put_run()) return false;
+
+					run_start = it->second;
+					run_count = 1;
+				}
+
+				found = true;
+				break;
+			}
+		}
+
+		if (found)
+		{
+			pos += block;
+			lit_start = pos;
+		}
+
+		// Nie gromadź zbyt wielu danych dosłownych
+		else if (++pos - lit_start >= literal_max && !put_literal(pos)) return false;
+	}
+
+	// Pozostałe dane wyślij dosłownie
+	if (!put_literal(size) || !put_run()) return false;
+
+	// Zakończ strumień skrótem całego pliku
+	out.push_back(End);
+	WIRE::put64(out, size);
+	WIRE::put64(out, strong(data, size));
+
+	return flush(true);
+}
@@ -0,0 +1,255 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy synchronizacji różnicowej.
+ *  \file
+ *
+ */
+
+#ifndef DELTA_HPP
+#define DELTA_HPP
+
+#include "wire.hpp"
+#include "committer.hpp"
+
+#include <sys/stat.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*! \brief Klasa synchronizacji różnicowej.
+ *
+ *  Realizuje przesyłanie zmian w pliku w stylu `rsync`. Serwer dzieli swoją kopię
+ *  pliku na bloki i wysyła ich sygnatury (słabą sumę kroczącą i silny skrót).
+ *  Klient wyszukuje w swoim pliku pasujące bloki i wysyła jedynie dane, których
+ *  serwer nie posiada, oraz odwołania do bloków. Serwer na tej podstawie odtwarza
+ *  nową wersję pliku w pliku tymczasowym i po weryfikacji przekazuje go do
+ *  zatwierdzenia, które podmienia oryginał.
+ *
+ *  Obiekt klasy reprezentuje stronę serwera, funkcje statyczne stronę klienta.
+ *
+ */
+class DELTA
+{
+
+	public:
+
+		/*! \brief Sygnatura bloku.
+		 *
+		 *  Opisuje jeden blok pliku bazowego.
+		 *
+		 */
+		struct BLOCK
+		{
+			uint32_t weak; //!< Słaba suma krocząca.
+			uint64_t strong; //!< Silny skrót.
+		};
+
+		/*! \brief Kody instrukcji strumienia zmian.
+		 *
+		 *  Pierwszy bajt każdego rekordu wysyłanego przez klienta.
+		 *
+		 */
+		enum OPCODE : char
+		{
+			Literal = 'L', //!< Dane dosłowne: długość (32 b) i dane.
+			Copy = 'B', //!< Bloki z pliku bazowego: indeks (64 b) i liczba bloków (32 b).
+			End = 'E' //!< Koniec: rozmiar pliku (64 b) i jego skrót (64 b).
+		};
+
+		/*! \brief Strumieniowy silny skrót.
+		 *
+		 *  Skrót 64-bitowy przetwarzający dane słowami 8-bajtowymi. Wynik nie zależy od
+		 *  podziału danych na fragmenty podczas kolejnych wywołań `update`.
+		 *
+		 */
+		class HASH
+		{
+
+			protected:
+
+				uint64_t m_hash; //!< Bieżący stan skrótu.
+				uint64_t m_total = 0; //!< Liczba przetworzonych bajtów.
+
+				char m_tail[8]; //!< Niepełne słowo z poprzedniego wywołania.
+				size_t m_tsize = 0; //!< Liczba bajtów w niepełnym słowie.
+
+			public:
+
+				explicit HASH(uint64_t seed = 0); //!< Konstruktor skrótu.
+
+				/*! \brief Dodanie danych.
+				 *  \param [in] data Dane do przetworzenia.
+				 *  \param [in] size Liczba danych w bajtach.
+				 *
+				 *  Aktualizuje stan skrótu o kolejny fragment danych.
+				 *
+				 */
+				void update(const char* data, size_t size);
+
+				/*! \brief Wynik skrótu.
+				 *  \returns Wartość skrótu.
+				 *
+				 *  Zwraca skrót wszystkich przetworzonych danych. Nie zmienia stanu obiektu.
+				 *
+				 */
+				uint64_t digest(void) const;
+
+		};
+
+		static constexpr size_t signature_header = 12; //!< Rozmiar nagłówka sygnatury (rozmiar bloku i liczba bloków).
+		static constexpr size_t signature_entry = 12; //!< Rozmiar sygnatury jednego bloku.
+		static constexpr size_t literal_max = 1 << 16; //!< Maksymalna długość jednego rekordu danych.
+		static constexpr uint32_t block_min = 1 << 9; //!< Minimalny rozmiar bloku.
+		static constexpr uint32_t block_max = 1 << 17; //!< Maksymalny rozmiar bloku.
+
+	protected:
+
+		int m_basis = -1; //!< Plik bazowy (aktualna kopia serwera).
+		FILE* m_patch = nullptr; //!< Plik tymczasowy z nową wersją.
+
+		string m_name; //!< Nazwa pliku docelowego.
+		string m_temp; //!< Nazwa pliku tymczasowego.
+
+		uint32_t m_block = 0; //!< Rozmiar bloku.
+		uint64_t m_count = 0; //!< Liczba pełnych bloków pliku bazowego.
+		uint64_t m_signed = 0; //!< Liczba bloków, których sygnatury wygenerowano.
+		bool m_header = false; //!< Flaga wysłania nagłówka sygnatury.
+
+		vector<char> m_in; //!< Bufor niepełnych rekordów.
+		vector<char> m_scratch; //!< Bufor na blok pliku bazowego.
+
+		HASH m_hash; //!< Skrót odtwarzanego pliku.
+		uint64_t m_written = 0; //!< Liczba zapisanych bajtów.
+
+		bool m_done = false; //!< Flaga odebrania rekordu końca.
+		bool m_released = false; //!< Flaga przekazania pliku tymczasowego.
+
+	public:
+
+		explicit DELTA(void); //!< Konstruktor domyślny.
+		virtual ~DELTA(void); //!< Destruktor, usuwa niezatwierdzony plik tymczasowy.
+
+		DELTA(const DELTA&) = delete; //!< Konstruktor kopiujący (usunięty).
+		DELTA& operator= (const DELTA&) = delete; //!< Operator przypisania (usunięty).
+
+		/*! \brief Rozpoczęcie synchronizacji.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] name Ścieżka pliku docelowego.
+		 *  \param [in] dir Deskryptor katalogu pliku - pliki otwierane są wtedy względem niego.
+		 *
+		 *  Otwiera plik bazowy (jeśli istnieje) oraz plik tymczasowy na nową wersję.
+		 *  Brak pliku bazowego nie jest błędem - sygnatura będzie wtedy pusta.
+		 *
+		 */
+		bool open(const string& name, int dir = AT_FDCWD);
+
+		/*! \brief Generowanie sygnatury.
+		 *  \returns Powodzenie operacji.
+		 *  \param [out] out Bufor na kolejny fragment sygnatury.
+		 *
+		 *  Dopisuje do bufora kolejny fragment sygnatury pliku bazowego. Gdy cała
+		 *  sygnatura została już wygenerowana bufor pozostaje niezmieniony.
+		 *
+		 */
+		bool sign(vector<char>& out);
+
+		/*! \brief Przetworzenie strumienia zmian.
+		 *  \returns `false` w przypadku błędnych danych, `true` w przeciwnym razie.
+		 *  \param [in] data Odebrane dane.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Dekoduje kompletne rekordy i zapisuje wynikowe dane do pliku tymczasowego.
+		 *
+		 */
+		bool feed(const char* data, size_t size);
+
+		/*! \brief Przekazanie nowej wersji pliku.
+		 *  \returns Deskryptor pliku tymczasowego lub `-1` w przypadku błędu.
+		 *  \param [out] temp Nazwa pliku tymczasowego.
+		 *
+		 *  Kończy zapis pliku tymczasowego i przekazuje go wywołującemu, który
+		 *  odpowiada za jego zatwierdzenie (`COMMITTER::submit`) lub usunięcie.
+		 *
+		 */
+		int release(string& temp);
+
+		//! Sprawdza, czy odebrano rekord końca strumienia zmian.
+		bool is_done(void) const;
+
+		/*! \brief Dobór rozmiaru bloku.
+		 *  \returns Rozmiar bloku.
+		 *  \param [in] size Rozmiar pliku bazowego.
+		 *
+		 *  Wyznacza rozmiar bloku proporcjonalny do pierwiastka z rozmiaru pliku.
+		 *
+		 */
+		static uint32_t block_size(uint64_t size);
+
+		/*! \brief Słaba suma krocząca.
+		 *  \returns Wartość sumy.
+		 *  \param [in] data Dane bloku.
+		 *  \param [in] size Rozmiar bloku.
+		 *
+		 *  Oblicza sumę w stylu `rsync` (dwie 16-bitowe składowe).
+		 *
+		 */
+		static uint32_t weak(const char* data, size_t size);
+
+		/*! \brief Silny skrót bloku.
+		 *  \returns Wartość skrótu.
+		 *  \param [in] data Dane bloku.
+		 *  \param [in] size Rozmiar bloku.
+		 *
+		 *  Oblicza skrót 64-bitowy przy użyciu klasy `HASH`.
+		 *
+		 */
+		static uint64_t strong(const char* data, size_t size);
+
+		/*! \brief Kodowanie strumienia zmian.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] data Dane nowej wersji pliku.
+		 *  \param [in] size Rozmiar nowej wersji pliku.
+		 *  \param [in] block Rozmiar bloku z sygnatury.
+		 *  \param [in] sig Sygnatury bloków pliku bazowego.
+		 *  \param [in] emit Funkcja wysyłająca kolejne fragmenty strumienia.
+		 *
+		 *  Wyszukuje w danych bloki obecne w pliku bazowym i generuje strumień
+		 *  rekordów. Sumy kroczące wszystkich okien wyznaczane są porcjami z sum
+		 *  prefiksowych, dzięki czemu pętla obliczeń nie ma zależności pomiędzy
+		 *  iteracjami i jest wektoryzowana przez kompilator.
+		 *
+		 */
+		static bool encode(const char* data, size_t size, uint32_t block,
+					    const vector<BLOCK>& sig,
+					    const function<bool(const char*, size_t)>& emit);
+
+};
+
+#endif // DELTA_HPP
@@ -0,0 +1,271 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy wysyłania katalogów.
+ *  \file
+ *
+ */
+
+#include "dirsync.hpp"
+
+DIRSYNC::DIRSYNC(const string& host, uint16_t port, unsigned connections, bool skip)
+: m_host(host), m_port(port), m_connections(max(1u, connections)), m_skip(skip) {}
+
+void DIRSYNC::set_profile(const SOCKBASE::PROFILE& profile)
+{
+	m_profile = profile;
+}
+
+bool DIRSYNC::run(const string& root)
+{
+	const auto start = chrono::steady_clock::now();
+
+	m_stats = STATS();
+
+	cout << "Scanning directory...\t";
+
+	const auto items = scan(root);
+
+	cout << items.size() << " files\n";
+
+	map<string, INDEX::ENTRY> remote; // Pliki na serwerze
+
+	// Pobierz metadane wszystkich plików serwera jednym zapytaniem
+	if (m_skip)
+	{
+		CLIENT cli;
+		cli.set_profile(m_profile);
+
+		if (!cli.connect(m_host, m_port) ||
+		    cli.list(string(), [&remote] (const string& name, const INDEX::ENTRY& entry)
+		    {
+			    remote.insert({ name, entry });
+		    }) < 0) return false;
+	}
+
+	atomic<size_t> next(0); // Wspólna kolejka - indeks kolejnego pliku
+	vector<thread> pool;
+
+	for (unsigned i = 0; i < min<size_t>(m_connections, max<size_t>(1, items.size())); ++i)
+		pool.emplace_back(&DIRSYNC::worker, this, cref(items), ref(next), cref(remote));
+
+	for (auto& t : pool) t.join();
+
+	m_stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	cout << "Uploaded files:\t\t" << m_stats.files << " (" << m_stats.bytes << " B, "
+		<< m_stats.bytes / max(m_stats.seconds, 1e-9) / (1 << 20) << " MiB/s)\n"
+		<< "Skipped files:\t\t" << m_stats.skipped << '\n'
+		<< "Failed files:\t\t" << m_stats.failed << '\n';
+
+	return m_stats.failed == 0;
+}
+
+const DIRSYNC::STATS& DIRSYNC::stats(void) const
+{
+	return m_stats;
+}
+
+vector<DIRSYNC::ITEM> DIRSYNC::scan(const string& root, unsigned threads)
+{
+	if (!threads) threads = max(1u, thread::hardware_concurrency());
+
+	deque<string> pending = { string() }; // Katalogi do przejrzenia (ścieżki względne)
+	mutex lock; // Blokada stosu katalogów
+	condition_variable wake; // Zmiana stanu stosu
+	unsigned active(0); // Liczba wątków przeglądających katalog
+
+	vector<vector<ITEM>> found(threads);
+	vector<thread> pool;
+
+	for (unsigned t = 0; t < threads; ++t) pool.emplace_back([&, t] (void)
+	{
+		unique_lock<mutex> guard(lock);
+
+		while (true)
+		{
+			// Przeglądanie kończy się, gdy stos jest pusty i żaden wątek nie pracuje
+			wake.wait(guard, [&] (void) { return !pending.empty() || !active; });
+
+			if (pending.empty()) return;
+
+			const string rel = move(pending.back());
+			pending.pop_back();
+
+			++active;
+			guard.unlock();
+
+			const string dir = rel.empty() ? root : root + '/' + rel;
+			vector<string> subdirs;
+
+			if (DIR* d = ::opendir(dir.c_str()))
+			{
+				while (const dirent* e = ::readdir(d))
+				{
+					struct stat st;
+
+					// Pomiń pliki ukryte (w tym `.` i `..`)
+					if (e->d_name[0] == '.') continue;
+					else if (::fstatat(::dirfd(d), e->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1) continue;
+
+					const string child = rel.empty() ? e->d_name : rel + '/' + e->d_name;
+
+					if (S_ISDIR(st.st_mode)) subdirs.push_back(child);
+					else if (S_ISREG(st.st_mode)) found[t].push_back(
+					{
+						dir + '/' + e->d_name, flatten(child), uint64_t(st.st_size),
+						int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec
+					});
+				}
+
+				::closedir(d);
+			}
+
+			guard.lock();
+			--active;
+
+			for (auto& s : subdirs) pending.push_back(move(s));
+
+			wake.notify_all();
+		}
+	});
+
+	for (auto& t : pool) t.join();
+
+	vector<ITEM> items;
+
+	for (auto& f : found) items.insert(items.end(), make_move_iterator(f.begin()), make_move_iterator(f.end()));
+
+	// Największe pliki na początku wyrównują obciążenie połączeń
+	sort(items.begin(), items.end(), [] (const ITEM& a, const ITEM& b) { return a.size > b.size; });
+
+	return items;
+}
+
+string DIRSYNC::flatten(const string& rel)
+{
+	string name;
+
+	for (const char c : rel)
+	{
+		if (c == '%') name += "%25";
+		else if (c == '/') name += "%2F";
+		else name += c;
+	}
+
+	return name;
+}
+
+void DIRSYNC::worker(const vector<ITEM>& items, atomic<size_t>& next,
+				 const map<string, INDEX::ENTRY>& remote)
+{
+	CLIENT cli;
+	cli.set_profile(m_profile);
+
+	STATS local; // Statystyki wątku
+	size_t batch(0); // Liczba plików wysłanych w bieżącym strumieniu
+	bool open = false; // Flaga otwartego strumienia
+
+	// Kończy strumień i zlicza pliki zapisane przez serwer
+	const auto finish = [&] (void)
+	{
+		int failed(0);
+		const int stored = open ? cli.mput_end(failed) : 0;
+
+		if (stored < 0) local.failed += batch;
+		else
+		{
+			local.files += stored;
+			local.failed += failed;
+		}
+
+		cli.disconnect();
+		open = false;
+		batch = 0;
+	};
+
+	for (size_t i; (i = next++) < items.size();)
+	{
+		const auto& item = items[i];
+
+		// Pomiń pliki, których aktualna kopia jest na serwerze
+		if (m_skip)
+		{
+			const auto r = remote.find(item.name);
+
+			if (r != remote.end() && unchanged(item, r->second))
+			{
+				++local.skipped;
+				continue;
+			}
+		}
+
+		// Otwórz strumień przy pierwszym pliku lub po zerwaniu poprzedniego
+		if (!open)
+		{
+			if (cli.connect(m_host, m_port) && cli.mput_begin()) open = true;
+			else
+			{
+				cli.disconnect();
+				++local.failed;
+
+				continue;
+			}
+		}
+
+		const int64_t rc = cli.mput_file(item.name, item.path);
+
+		// Lokalny błąd pomija tylko ten plik, błąd
+		// w trakcie ramki psuje cały strumień
+		if (rc == -2) ++local.failed;
+		else if (rc < 0)
+		{
+			local.failed += batch + 1;
+			batch = 0;
+
+			cli.disconnect();
+			open = false;
+		}
+		else
+		{
+			local.bytes += rc;
+			++batch;
+		}
+	}
+
+	if (open) finish();
+
+	lock_guard<mutex> guard(m_lock);
+
+	m_stats.files += local.files;
+	m_stats.skipped += local.skipped;
+	m_stats.failed += local.failed;
+	m_stats.bytes += local.bytes;
+}
+
+bool DIRSYNC::unchanged(const ITEM& item, const INDEX::ENTRY& remote)
+{
+	if (remote.size != item.size) return false;
+	else if (!remote.hashed) return remote.mtime >= item.mtime;
+
+	INDEX::ENTRY entry;
+
+	return INDEX::read(item.path, entry, true) && entry.hashed && entry.hash == remote.hash;
+}
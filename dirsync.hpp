@@ -0,0 +1,179 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy wysyłania katalogów.
+ *  \file
+ *
+ */
+
+#ifndef DIRSYNC_HPP
+#define DIRSYNC_HPP
+
+#include "client.hpp"
+#include "index.hpp"
+
+#include <sys/stat.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <map>
+
+using namespace std;
+
+/*! \brief Klasa wysyłania katalogów.
+ *
+ *  Wysyła rekurencyjnie całe drzewo katalogów. Drzewo przeglądane jest przez
+ *  kilka wątków, a znalezione pliki (od największych) trafiają do wspólnej
+ *  kolejki obsługiwanej przez pulę trwałych połączeń, z których każde przesyła
+ *  swoje pliki jednym strumieniem `MPUT`. Opcjonalnie pomijane są pliki, których
+ *  aktualna kopia znajduje się już na serwerze (na podstawie listy `LIST`).
+ *
+ *  Serwer przechowuje pliki w jednej przestrzeni nazw, dlatego ścieżka względna
+ *  pliku zapisywana jest jako nazwa ze znakami `/` zamienionymi na `%2F`.
+ *
+ */
+class DIRSYNC
+{
+
+	public:
+
+		/*! \brief Opis pliku lokalnego.
+		 *
+		 *  Wynik przeglądania drzewa katalogów.
+		 *
+		 */
+		struct ITEM
+		{
+			string path; //!< Ścieżka pliku.
+			string name; //!< Nazwa pliku na serwerze.
+			uint64_t size; //!< Rozmiar pliku.
+			int64_t mtime; //!< Czas modyfikacji w ns od początku epoki.
+		};
+
+		/*! \brief Statystyki wysyłania.
+		 *
+		 *  Podsumowanie ostatniego wywołania `run`.
+		 *
+		 */
+		struct STATS
+		{
+			size_t files = 0; //!< Liczba zapisanych plików.
+			size_t skipped = 0; //!< Liczba pominiętych (niezmienionych) plików.
+			size_t failed = 0; //!< Liczba błędów.
+			uint64_t bytes = 0; //!< Liczba wysłanych bajtów danych.
+			double seconds = 0; //!< Czas działania w sekundach.
+		};
+
+	protected:
+
+		string m_host; //!< Adres serwera.
+		uint16_t m_port; //!< Port serwera.
+		unsigned m_connections; //!< Liczba połączeń.
+		bool m_skip; //!< Flaga pomijania niezmienionych plików.
+
+		SOCKBASE::PROFILE m_profile; //!< Profil strojenia gniazd.
+
+		mutex m_lock; //!< Blokada statystyk.
+		STATS m_stats; //!< Statystyki wysyłania.
+
+	public:
+
+		/*! \brief Konstruktor wysyłania.
+		 *  \param [in] host Adres serwera.
+		 *  \param [in] port Port serwera.
+		 *  \param [in] connections Liczba równoległych połączeń.
+		 *  \param [in] skip Pomijanie plików niezmienionych względem serwera.
+		 *
+		 */
+		DIRSYNC(const string& host, uint16_t port,
+			   unsigned connections = 4, bool skip = false);
+
+		//! Ustawia profil strojenia gniazd połączeń.
+		void set_profile(const SOCKBASE::PROFILE& profile);
+
+		/*! \brief Wysłanie drzewa katalogów.
+		 *  \returns `true` gdy wszystkie pliki zostały zapisane lub pominięte.
+		 *  \param [in] root Katalog główny drzewa.
+		 *
+		 */
+		bool run(const string& root);
+
+		//! Zwraca statystyki ostatniego wysyłania.
+		const STATS& stats(void) const;
+
+		/*! \brief Przeglądanie drzewa katalogów.
+		 *  \returns Lista zwykłych plików posortowana od największego.
+		 *  \param [in] root Katalog główny drzewa.
+		 *  \param [in] threads Liczba wątków (`0` - liczba procesorów).
+		 *
+		 *  Wątki pobierają katalogi ze wspólnego stosu i odkładają na niego znalezione
+		 *  podkatalogi. Pliki i katalogi ukryte oraz dowiązania są pomijane.
+		 *
+		 */
+		static vector<ITEM> scan(const string& root, unsigned threads = 0);
+
+		/*! \brief Nazwa pliku na serwerze.
+		 *  \returns Nazwa bez separatorów katalogów.
+		 *  \param [in] rel Ścieżka względna pliku.
+		 *
+		 *  Zamienia znaki `%` i `/` na `%25` i `%2F`.
+		 *
+		 */
+		static string flatten(const string& rel);
+
+	protected:
+
+		/*! \brief Wątek połączenia.
+		 *  \param [in] items Lista plików.
+		 *  \param [in,out] next Indeks kolejnego pliku wspólnej kolejki.
+		 *  \param [in] remote Metadane plików na serwerze.
+		 *
+		 *  Pobiera kolejne pliki z kolejki i wysyła je w jednym strumieniu `MPUT`.
+		 *  Po zerwaniu strumienia nawiązuje nowe połączenie.
+		 *
+		 */
+		void worker(const vector<ITEM>& items, atomic<size_t>& next,
+				  const map<string, INDEX::ENTRY>& remote);
+
+		/*! \brief Test zmiany pliku.
+		 *  \returns `true` gdy kopia na serwerze jest aktualna.
+		 *  \param [in] item Plik lokalny.
+		 *  \param [in] remote Metadane pliku na serwerze.
+		 *
+		 *  Porównuje rozmiar, a następnie skrót zawartości (gdy serwer go podaje) lub
+		 *  czasy modyfikacji (kopia na serwerze nie może być starsza od pliku).
+		 *
+		 */
+		static bool unchanged(const ITEM& item, const INDEX::ENTRY& remote);
+
+};
+
+#endif // DIRSYNC_HPP
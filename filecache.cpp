@@ -0,0 +1,136 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy pamięci podręcznej plików.
+ *  \file
+ *
+ */
+
+#include "filecache.hpp"
+
+FILECACHE::ENTRY::~ENTRY(void)
+{
+	if (fd != -1) ::close(fd); // Zamknij deskryptor pliku
+}
+
+FILECACHE::FILECACHE(size_t budget, size_t small, size_t files)
+: m_budget(budget), m_small(min(small, budget)), m_files(files) {}
+
+FILECACHE::POINTER FILECACHE::get(const string& name, int dir)
+{
+	const auto it = m_map.find(name);
+
+	// Trafienie - przenieś wpis na początek listy
+	if (it != m_map.end())
+	{
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		++m_hits;
+
+		return it->second->second;
+	}
+
+	++m_misses;
+
+	auto entry = make_shared<ENTRY>();
+	struct stat st;
+
+	const size_t slash = dir == AT_FDCWD ? string::npos : name.rfind('/');
+
+	// Otwórz plik i pobierz jego metadane (względem katalogu samą nazwą)
+	entry->fd = ::openat(dir, name.c_str() + (slash == string::npos ? 0 : slash + 1), O_RDONLY | O_CLOEXEC);
+
+	if (entry->fd == -1) return nullptr;
+	else if (::fstat(entry->fd, &st) == -1) return nullptr;
+	else if (!S_ISREG(st.st_mode)) return nullptr;
+
+	entry->size = st.st_size;
+	entry->mtime = st.st_mtim;
+
+	// Małe pliki wczytaj w całości
+	if (entry->size <= m_small)
+	{
+		entry->data.resize(entry->size);
+
+		size_t done = 0;
+		ssize_t rc = 0;
+
+		while (done < entry->size &&
+			  (rc = ::pread(entry->fd, entry->data.data() + done,
+						 entry->size - done, done)) > 0) done += rc;
+
+		// Plik mógł zostać skrócony w trakcie odczytu
+		entry->data.resize(done);
+		entry->size = done;
+		entry->loaded = true;
+
+		m_usage += entry->data.size();
+	}
+
+	m_lru.push_front({ name, entry });
+	m_map[name] = m_lru.begin();
+
+	evict();
+
+	return entry;
+}
+
+void FILECACHE::invalidate(const string& name)
+{
+	const auto it = m_map.find(name);
+
+	if (it == m_map.end()) return;
+
+	m_usage -= it->second->second->data.size();
+	m_lru.erase(it->second);
+	m_map.erase(it);
+}
+
+void FILECACHE::clear(void)
+{
+	m_lru.clear();
+	m_map.clear();
+	m_usage = 0;
+}
+
+size_t FILECACHE::usage(void) const
+{
+	return m_usage;
+}
+
+size_t FILECACHE::hits(void) const
+{
+	return m_hits;
+}
+
+size_t FILECACHE::misses(void) const
+{
+	return m_misses;
+}
+
+void FILECACHE::evict(void)
+{
+	// Usuwaj najdawniej używane wpisy, zachowując co najmniej jeden
+	while (m_lru.size() > 1 && (m_usage > m_budget || m_lru.size() > m_files))
+	{
+		m_usage -= m_lru.back().second->data.size();
+		m_map.erase(m_lru.back().first);
+		m_lru.pop_back();
+	}
+}
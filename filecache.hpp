@@ -0,0 +1,142 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy pamięci podręcznej plików.
+ *  \file
+ *
+ */
+
+#ifndef FILECACHE_HPP
+#define FILECACHE_HPP
+
+#include <sys/stat.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <list>
+
+using namespace std;
+
+/*! \brief Klasa pamięci podręcznej plików.
+ *
+ *  Przechowuje otwarte deskryptory i metadane najczęściej pobieranych plików,
+ *  a dla małych plików również ich pełną zawartość. Wpisy usuwane są według
+ *  strategii LRU po przekroczeniu limitu pamięci lub liczby otwartych plików.
+ *  Spójność z systemem plików zapewnia unieważnianie wpisów na podstawie
+ *  zdarzeń `inotify` (zob. WATCHER). Pobieranie pliku obecnego w pamięci nie
+ *  wymaga wywołań `open`, `stat` ani `read`.
+ *
+ */
+class FILECACHE
+{
+
+	public:
+
+		/*! \brief Wpis pamięci podręcznej.
+		 *
+		 *  Wpis jest współdzielony z trwającymi transferami - po unieważnieniu
+		 *  pozostaje ważny do zakończenia ostatniego z nich.
+		 *
+		 */
+		struct ENTRY
+		{
+			int fd = -1; //!< Otwarty deskryptor pliku.
+			uint64_t size = 0; //!< Rozmiar pliku.
+			timespec mtime = {}; //!< Czas modyfikacji pliku.
+
+			vector<char> data; //!< Zawartość pliku (tylko małe pliki).
+			bool loaded = false; //!< Flaga obecności zawartości.
+
+			~ENTRY(void); //!< Destruktor, zamyka deskryptor.
+		};
+
+		using POINTER = shared_ptr<const ENTRY>; //!< Wskaźnik na wpis.
+
+	protected:
+
+		using LRU = list<pair<string, POINTER>>; //!< Lista wpisów od najświeższego.
+
+		LRU m_lru; //!< Wpisy w kolejności użycia.
+		unordered_map<string, LRU::iterator> m_map; //!< Indeks wpisów według nazwy.
+
+		size_t m_budget; //!< Limit pamięci na zawartość plików.
+		size_t m_small; //!< Maksymalny rozmiar pliku przechowywanego w pamięci.
+		size_t m_files; //!< Limit otwartych plików.
+
+		size_t m_usage = 0; //!< Bieżące zużycie pamięci.
+		size_t m_hits = 0; //!< Liczba trafień.
+		size_t m_misses = 0; //!< Liczba chybień.
+
+	public:
+
+		/*! \brief Konstruktor pamięci podręcznej.
+		 *  \param [in] budget Limit pamięci na zawartość plików w bajtach.
+		 *  \param [in] small Maksymalny rozmiar pliku przechowywanego w pamięci.
+		 *  \param [in] files Limit otwartych plików.
+		 *
+		 */
+		explicit FILECACHE(size_t budget,
+					    size_t small = 1 << 20,
+					    size_t files = 256);
+
+		/*! \brief Pobranie wpisu.
+		 *  \returns Wpis pliku lub pusty wskaźnik gdy plik nie istnieje.
+		 *  \param [in] name Ścieżka pliku.
+		 *  \param [in] dir Deskryptor katalogu pliku - plik otwierany jest wtedy względem niego.
+		 *
+		 *  Zwraca wpis z pamięci podręcznej, a w przypadku jego braku otwiera plik,
+		 *  wczytuje go (jeśli jest mały) i dodaje do pamięci usuwając najstarsze wpisy.
+		 *
+		 */
+		POINTER get(const string& name, int dir = AT_FDCWD);
+
+		/*! \brief Unieważnienie wpisu.
+		 *  \param [in] name Nazwa pliku.
+		 *
+		 *  Usuwa wpis z pamięci podręcznej. Trwające transfery korzystają dalej ze starego wpisu.
+		 *
+		 */
+		void invalidate(const string& name);
+
+		//! Usuwa wszystkie wpisy.
+		void clear(void);
+
+		//! Zwraca bieżące zużycie pamięci w bajtach.
+		size_t usage(void) const;
+
+		//! Zwraca liczbę trafień.
+		size_t hits(void) const;
+
+		//! Zwraca liczbę chybień.
+		size_t misses(void) const;
+
+	protected:
+
+		//! Usuwa najstarsze wpisy do czasu spełnienia limitów.
+		void evict(void);
+
+};
+
+#endif // FILECACHE_HPP
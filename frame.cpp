@@ -0,0 +1,128 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy binarnych ramek żądań.
+ *  \file
+ *
+ */
+
+#include "frame.hpp"
+
+bool FRAME::is_frame(const char* data, size_t size)
+{
+	return size > 0 && uint8_t(data[0]) == (magic >> 8);
+}
+
+int FRAME::parse(const char* data, size_t size, REQUEST& request, STATUS& status)
+{
+	if (size < header) return 0;
+
+	const uint16_t name = WIRE::get16(data + 6);
+	const uint32_t ext = WIRE::get32(data + 8);
+
+	// Wszystkie długości są znane po odczytaniu stałego nagłówka
+	if (WIRE::get16(data) != magic) { status = Length; return -1; }
+	else if (WIRE::get8(data + 2) != version) { status = Version; return -1; }
+	else if (!command(WIRE::get8(data + 3))) { status = Opcode; return -1; }
+	else if (ext > limit || header + name + ext > limit) { status = Length; return -1; }
+	else if (size < header + name + ext) return 0;
+
+	request = REQUEST();
+	request.opcode = OPCODE(WIRE::get8(data + 3));
+	request.flags = WIRE::get16(data + 4);
+	request.name.assign(data + header, name);
+	request.size = header + name + ext;
+
+	// Nazwa przekazywana jest dalej jako parametr nagłówka tekstowego
+	if (request.name.find_first_of(string("\n\0", 2)) != string::npos) { status = Length; return -1; }
+
+	// Odczytaj rozszerzenia - każde musi mieścić się w obszarze rozszerzeń
+	for (const char* p = data + header + name, * end = p + ext; p < end;)
+	{
+		if (end - p < 4) { status = Length; return -1; }
+
+		const uint16_t type = WIRE::get16(p);
+		const uint16_t len = WIRE::get16(p + 2);
+
+		p += 4;
+
+		if (end - p < len) { status = Length; return -1; }
+
+		// Pozycja początkowa dotyczy wyłącznie pobierania
+		if (type == Offset && len == 8 &&
+		    (request.opcode == Download || request.opcode == Follow))
+			request.offset = WIRE::get64(p);
+		else if (type & critical) { status = Extension; return -1; }
+
+		p += len;
+	}
+
+	status = Ok;
+
+	return 1;
+}
+
+const char* FRAME::command(uint8_t opcode)
+{
+	static const char* const names[] =
+	{
+		nullptr, "UPLOAD", "DOWNLOAD", "DELTA", "CUPLOAD", "FDOWNLOAD", "FUPLOAD",
+		"LIST", "STAT", "MGET", "MPUT", "REPLICATE", "FOLLOW", "SGET", "SPUT"
+	};
+
+	if (opcode < sizeof(names) / sizeof(names[0])) return names[opcode];
+	else return nullptr;
+}
+
+void FRAME::encode(vector<char>& out, const REQUEST& request)
+{
+	vector<char> ext;
+
+	// Rozszerzenia o wartościach domyślnych są pomijane
+	if (request.offset)
+	{
+		WIRE::put16(ext, Offset);
+		WIRE::put16(ext, 8);
+		WIRE::put64(ext, request.offset);
+	}
+
+	WIRE::put16(out, magic);
+	WIRE::put8(out, version);
+	WIRE::put8(out, request.opcode);
+	WIRE::put16(out, request.flags);
+	WIRE::put16(out, request.name.size());
+	WIRE::put32(out, ext.size());
+
+	out.insert(out.end(), request.name.begin(), request.name.end());
+	out.insert(out.end(), ext.begin(), ext.end());
+}
+
+void FRAME::encode_reply(vector<char>& out, STATUS status)
+{
+	WIRE::put16(out, magic);
+	WIRE::put8(out, version);
+	WIRE::put8(out, status);
+}
+
+int FRAME::decode_reply(const char* data)
+{
+	if (WIRE::get16(data) != magic) return -1;
+	else return WIRE::get8(data + 3);
+}
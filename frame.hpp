@@ -0,0 +1,185 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy binarnych ramek żądań.
+ *  \file
+ *
+ */
+
+#ifndef FRAME_HPP
+#define FRAME_HPP
+
+#include "wire.hpp"
+
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*! \brief Klasa binarnych ramek żądań.
+ *
+ *  Alternatywa dla tekstowego nagłówka `POLECENIE nazwa\n`. Ramka zaczyna się
+ *  stałym nagłówkiem (12 B): sygnatura (16 b), wersja (8 b), kod polecenia
+ *  (8 b), flagi (16 b), długość nazwy (16 b) i długość rozszerzeń (32 b). Za
+ *  nim następuje nazwa oraz rozszerzenia w postaci TLV: typ (16 b), długość
+ *  (16 b) i wartość. Rozszerzenia z ustawionym bitem `critical` muszą zostać
+ *  zrozumiane przez serwer, pozostałe mogą zostać pominięte - nowe możliwości
+ *  nie wymagają zmiany wersji.
+ *
+ *  Pierwszy bajt sygnatury spoza zakresu ASCII odróżnia ramkę od nagłówka
+ *  tekstowego. Serwer odpowiada na każdą ramkę odpowiedzią (4 B): sygnatura,
+ *  obsługiwana wersja i status, a dopiero po niej przesyła dane polecenia.
+ *
+ */
+class FRAME
+{
+
+	public:
+
+		static constexpr uint16_t magic = 0xB754; //!< Sygnatura ramki.
+		static constexpr uint8_t version = 1; //!< Wersja formatu ramek.
+
+		static constexpr size_t header = 12; //!< Rozmiar stałego nagłówka ramki.
+		static constexpr size_t reply = 4; //!< Rozmiar odpowiedzi na ramkę.
+		static constexpr size_t limit = 512; //!< Maksymalny rozmiar ramki (mieści się w buforze nagłówka serwera).
+
+		static constexpr uint16_t critical = 0x8000; //!< Bit rozszerzenia wymaganego.
+
+		/*! \brief Kod polecenia.
+		 *
+		 *  Odpowiada poleceniom nagłówka tekstowego.
+		 *
+		 */
+		enum OPCODE : uint8_t
+		{
+			Upload = 1, //!< `UPLOAD`.
+			Download, //!< `DOWNLOAD`.
+			Delta, //!< `DELTA`.
+			ChunkUpload, //!< `CUPLOAD`.
+			FdDownload, //!< `FDOWNLOAD`.
+			FdUpload, //!< `FUPLOAD`.
+			List, //!< `LIST`.
+			Stat, //!< `STAT`.
+			MultiGet, //!< `MGET`.
+			MultiPut, //!< `MPUT`.
+			Replicate, //!< `REPLICATE`.
+			Follow, //!< `FOLLOW`.
+			SparseGet, //!< `SGET`.
+			SparsePut //!< `SPUT`.
+		};
+
+		/*! \brief Status odpowiedzi.
+		 *
+		 *  Wynik sprawdzenia ramki. Po statusie innym niż `Ok` serwer zamyka połączenie.
+		 *  Dla `DOWNLOAD` i `FOLLOW` status uwzględnia również plik i pozycję
+		 *  początkową, więc po `Ok` brak danych nie oznacza braku pliku.
+		 *
+		 */
+		enum STATUS : uint8_t
+		{
+			Ok = 0, //!< Ramka została przyjęta.
+			Version, //!< Nieobsługiwana wersja (odpowiedź podaje wersję serwera).
+			Opcode, //!< Nieznany kod polecenia.
+			Length, //!< Niepoprawne długości pól.
+			Extension, //!< Nieobsługiwane rozszerzenie wymagane.
+			Unsupported, //!< Polecenie nieobsługiwane w konfiguracji serwera (np. pośrednika).
+			Missing, //!< Brak pobieranego pliku.
+			Range, //!< Pozycja początkowa za końcem pliku lub nieobsługiwana dla pliku.
+			Complete //!< Brak danych za pozycją początkową - plik jest już kompletny.
+		};
+
+		/*! \brief Typ rozszerzenia.
+		 *
+		 *  Typy z bitem `critical` muszą zostać obsłużone przez serwer.
+		 *
+		 */
+		enum EXTENSION : uint16_t
+		{
+			Offset = critical | 1 //!< Pozycja początkowa pobierania (64 b, `DOWNLOAD` i `FOLLOW`).
+		};
+
+		/*! \brief Opis żądania.
+		 *
+		 *  Odczytane pola ramki.
+		 *
+		 */
+		struct REQUEST
+		{
+			OPCODE opcode = Upload; //!< Kod polecenia.
+			uint16_t flags = 0; //!< Flagi (zarezerwowane).
+			string name; //!< Nazwa pliku lub parametr polecenia.
+			uint64_t offset = 0; //!< Pozycja początkowa pobierania.
+			size_t size = 0; //!< Rozmiar całej ramki.
+		};
+
+		/*! \brief Rozpoznanie ramki.
+		 *  \returns `true` gdy dane zaczynają się od pierwszego bajtu sygnatury.
+		 *  \param [in] data Odebrane dane.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 */
+		static bool is_frame(const char* data, size_t size);
+
+		/*! \brief Odczyt ramki.
+		 *  \returns `1` dla kompletnej ramki, `0` gdy brakuje danych lub `-1` w przypadku błędu.
+		 *  \param [in] data Odebrane dane.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *  \param [out] request Odczytane żądanie.
+		 *  \param [out] status Status odpowiedzi.
+		 *
+		 *  Sprawdza stały nagłówek i długości pól już po odczytaniu 12 B, zanim
+		 *  zostanie odebrana reszta ramki.
+		 *
+		 */
+		static int parse(const char* data, size_t size, REQUEST& request, STATUS& status);
+
+		/*! \brief Polecenie tekstowe.
+		 *  \returns Nazwa polecenia lub `nullptr` dla nieznanego kodu.
+		 *  \param [in] opcode Kod polecenia.
+		 *
+		 */
+		static const char* command(uint8_t opcode);
+
+		/*! \brief Zapis ramki.
+		 *  \param [out] out Bufor docelowy.
+		 *  \param [in] request Żądanie (pole `size` jest pomijane).
+		 *
+		 */
+		static void encode(vector<char>& out, const REQUEST& request);
+
+		/*! \brief Zapis odpowiedzi.
+		 *  \param [out] out Bufor docelowy.
+		 *  \param [in] status Status odpowiedzi.
+		 *
+		 */
+		static void encode_reply(vector<char>& out, STATUS status);
+
+		/*! \brief Odczyt odpowiedzi.
+		 *  \returns Status odpowiedzi lub `-1` dla niepoprawnej sygnatury.
+		 *  \param [in] data Odpowiedź (4 B).
+		 *
+		 */
+		static int decode_reply(const char* data);
+
+};
+
+#endif // FRAME_HPP
@@ -0,0 +1,422 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy indeksu metadanych plików.
+ *  \file
+ *
+ */
+
+#include "index.hpp"
+
+INDEX::INDEX(bool hash)
+: m_hash(hash) {}
+
+INDEX::~INDEX(void)
+{
+	close(); // Zakończ wątek roboczy
+}
+
+bool INDEX::open(void)
+{
+	if (is_open()) return true;
+
+	m_event = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (m_event == -1) return false;
+
+	m_stop = false;
+	m_thread = thread(&INDEX::run, this);
+
+	return true;
+}
+
+void INDEX::close(void)
+{
+	// Zakończ wątek - niezakończone zadania są porzucane
+	if (m_thread.joinable())
+	{
+		{
+			lock_guard<mutex> lock(m_lock);
+			m_stop = true;
+		}
+
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	if (m_event != -1) ::close(m_event);
+
+	m_event = -1;
+	m_queue.clear();
+	m_done.clear();
+	m_fresh.clear();
+	m_rebuild = m_built = m_rebuilding = m_again = false;
+	m_pending.clear();
+	m_dirty.clear();
+}
+
+void INDEX::dispatch(void)
+{
+	uint64_t count;
+	vector<JOB> done;
+	map<string, ENTRY> fresh;
+	bool built;
+
+	// Wyzeruj licznik powiadomień
+	if (::read(m_event, &count, sizeof(count)) <= 0) return;
+
+	{
+		lock_guard<mutex> lock(m_lock);
+
+		done.swap(m_done);
+		fresh.swap(m_fresh);
+		built = m_built;
+		m_built = false;
+	}
+
+	if (built)
+	{
+		// Zachowaj skróty plików, które nie zmieniły się od ich wyznaczenia
+		for (auto& [name, entry] : fresh)
+		{
+			const auto old = m_entries.find(name);
+
+			if (old != m_entries.end() && old->second.hashed &&
+			    old->second.size == entry.size && old->second.mtime == entry.mtime)
+				entry = old->second;
+		}
+
+		m_entries.swap(fresh);
+		m_rebuilding = false;
+
+		// Odśwież pliki zmienione w trakcie przeglądu
+		for (const auto& name : m_dirty) refresh(name);
+		m_dirty.clear();
+
+		// Kolejne przepełnienie w trakcie odbudowy wymaga nowego przeglądu
+		if (m_again)
+		{
+			m_again = false;
+			rebuild();
+		}
+	}
+
+	// Skrót jest ważny tylko dla niezmienionej od tego czasu zawartości
+	for (const auto& job : done)
+	{
+		const auto it = m_entries.find(job.name);
+
+		m_pending.erase(job.name);
+
+		if (it != m_entries.end() && !it->second.hashed &&
+		    it->second.size == job.entry.size && it->second.mtime == job.entry.mtime)
+			it->second = job.entry;
+	}
+}
+
+int INDEX::fd(void) const
+{
+	return m_event;
+}
+
+bool INDEX::is_open(void) const
+{
+	return m_event != -1;
+}
+
+size_t INDEX::build(LAYOUT& layout, unsigned threads)
+{
+	m_layout = &layout;
+	m_entries = collect(layout, threads, m_hash);
+
+	return m_entries.size();
+}
+
+void INDEX::rebuild(void)
+{
+	if (!m_layout) return;
+	else if (!is_open())
+	{
+		build(*m_layout);
+		return;
+	}
+	else if (m_rebuilding)
+	{
+		m_again = true;
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock(m_lock);
+		m_rebuild = true;
+	}
+
+	m_rebuilding = true;
+	m_wake.notify_one();
+}
+
+void INDEX::refresh(const string& name)
+{
+	ENTRY entry;
+
+	if (!m_layout) return;
+	else if (m_rebuilding) m_dirty.insert(name);
+
+	if (read(name, entry, false, m_layout->dir(name))) m_entries[name] = entry;
+	else m_entries.erase(name);
+}
+
+void INDEX::remove(const string& name)
+{
+	if (m_rebuilding) m_dirty.insert(name);
+
+	m_entries.erase(name);
+}
+
+const INDEX::ENTRY* INDEX::find(const string& name)
+{
+	const auto it = m_entries.find(name);
+
+	if (it == m_entries.end()) return nullptr;
+	else if (!m_hash || it->second.hashed || !m_layout) return &it->second;
+
+	// Bez wątku roboczego wyznacz skrót od razu
+	if (!is_open())
+	{
+		read(name, it->second, true, m_layout->dir(name));
+		return &it->second;
+	}
+
+	// Zleć wyznaczenie skrótu - wątek roboczy nie może używać
+	// buforowanych deskryptorów katalogów, więc otrzymuje ścieżkę
+	if (m_pending.insert(name).second)
+	{
+		{
+			lock_guard<mutex> lock(m_lock);
+			m_queue.push_back({ name, m_layout->full(m_layout->path(name)), it->second });
+		}
+
+		m_wake.notify_one();
+	}
+
+	return &it->second;
+}
+
+bool INDEX::list(const string& prefix, string& next, vector<char>& out, size_t limit) const
+{
+	// Pliki o zadanym przedrostku tworzą ciągły zakres mapy
+	for (auto it = m_entries.lower_bound(max(next, prefix));
+		it != m_entries.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+	{
+		if (out.size() >= limit)
+		{
+			next = it->first;
+			return false;
+		}
+
+		put(out, it->first, it->second);
+	}
+
+	WIRE::put16(out, 0); // Rekord zakończenia
+
+	return true;
+}
+
+size_t INDEX::match(const string& pattern, vector<string>& names) const
+{
+	// Stały przedrostek wzorca ogranicza zakres przeglądanej mapy
+	const string prefix = pattern.substr(0, pattern.find_first_of("*?[\\"));
+
+	for (auto it = m_entries.lower_bound(prefix);
+		it != m_entries.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+	{
+		if (::fnmatch(pattern.c_str(), it->first.c_str(), FNM_PERIOD) == 0)
+			names.push_back(it->first);
+	}
+
+	return names.size();
+}
+
+size_t INDEX::size(void) const
+{
+	return m_entries.size();
+}
+
+void INDEX::put(vector<char>& out, const string& name, const ENTRY& entry)
+{
+	WIRE::put16(out, name.size());
+	out.insert(out.end(), name.begin(), name.end());
+	WIRE::put64(out, entry.size);
+	WIRE::put64(out, entry.mtime);
+	WIRE::put8(out, entry.hashed ? 1 : 0);
+	WIRE::put64(out, entry.hash);
+}
+
+size_t INDEX::get(const char* in, size_t size, string& name, ENTRY& entry)
+{
+	if (size < 2) return 0;
+
+	const size_t len = WIRE::get16(in);
+
+	// Rekord zakończenia zawiera jedynie długość
+	if (len == 0)
+	{
+		name.clear();
+		return 2;
+	}
+	else if (size < 2 + len + record_fixed - 2) return 0;
+
+	name.assign(in + 2, len);
+	in += 2 + len;
+
+	entry.size = WIRE::get64(in);
+	entry.mtime = WIRE::get64(in + 8);
+	entry.hashed = WIRE::get8(in + 16) & 1;
+	entry.hash = WIRE::get64(in + 17);
+
+	return len + record_fixed;
+}
+
+bool INDEX::read(const string& path, ENTRY& entry, bool hash, int dir)
+{
+	struct stat st;
+
+	if (::fstatat(dir, path.c_str(), &st, 0) == -1 || !S_ISREG(st.st_mode)) return false;
+
+	entry.size = st.st_size;
+	entry.mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+	entry.hashed = false;
+
+	if (!hash) return true;
+
+	const int fd = ::openat(dir, path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd == -1) return true;
+
+	DELTA::HASH h;
+	vector<char> buff(1 << 16);
+	ssize_t rc;
+
+	// Odczyt sekwencyjny całego pliku
+	::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	while ((rc = ::read(fd, buff.data(), buff.size())) > 0) h.update(buff.data(), rc);
+
+	::close(fd);
+
+	entry.hash = h.digest();
+	entry.hashed = rc == 0;
+
+	return true;
+}
+
+void INDEX::run(void)
+{
+	unique_lock<mutex> lock(m_lock);
+
+	while (true)
+	{
+		m_wake.wait(lock, [this] { return m_stop || m_rebuild || !m_queue.empty(); });
+
+		if (m_stop) return;
+
+		vector<JOB> batch;
+		const bool rebuild = m_rebuild;
+
+		batch.swap(m_queue);
+		m_rebuild = false;
+
+		lock.unlock();
+
+		// Przegląd i odczyt plików odbywają się bez blokady
+		map<string, ENTRY> fresh;
+
+		if (rebuild) fresh = collect(*m_layout, 0, false);
+
+		for (auto& job : batch)
+			if (!read(job.path, job.entry, true)) job.entry.hashed = false;
+
+		lock.lock();
+
+		if (rebuild)
+		{
+			m_fresh.swap(fresh);
+			m_built = true;
+		}
+
+		m_done.insert(m_done.end(), batch.begin(), batch.end());
+
+		const uint64_t one = 1;
+		(void) ::write(m_event, &one, sizeof(one));
+	}
+}
+
+map<string, INDEX::ENTRY> INDEX::collect(const LAYOUT& layout, unsigned threads, bool hash)
+{
+	if (!threads) threads = max(1u, thread::hardware_concurrency());
+
+	const auto dirs = layout.directories();
+	vector<vector<pair<string, string>>> found(threads); // Ścieżki i nazwy według wątków
+
+	// Uruchamia funkcję w `threads` wątkach i czeka na ich zakończenie
+	const auto parallel = [threads] (const function<void(unsigned)>& job)
+	{
+		vector<thread> pool;
+
+		for (unsigned t = 0; t < threads; ++t) pool.emplace_back(job, t);
+		for (auto& t : pool) t.join();
+	};
+
+	atomic<size_t> next(0);
+
+	// Etap 1: równoległy przegląd katalogów
+	parallel([&] (unsigned t)
+	{
+		for (size_t d; (d = next++) < dirs.size();)
+			layout.scan(dirs[d], [&found, t] (const string& path, const string& name)
+			{
+				found[t].push_back({ path, name });
+			});
+	});
+
+	vector<pair<string, string>> files;
+
+	for (auto& f : found) files.insert(files.end(), f.begin(), f.end());
+
+	vector<ENTRY> entries(files.size());
+	vector<char> valid(files.size(), 0);
+
+	next = 0;
+
+	// Etap 2: równoległe pobieranie metadanych porcjami po 64 pliki
+	parallel([&] (unsigned)
+	{
+		for (size_t b; (b = next.fetch_add(64)) < files.size();)
+			for (size_t i = b; i < min(b + 64, files.size()); ++i)
+				valid[i] = read(layout.full(files[i].first), entries[i], hash);
+	});
+
+	map<string, ENTRY> result;
+
+	for (size_t i = 0; i < files.size(); ++i)
+		if (valid[i]) result.insert({ files[i].second, entries[i] });
+
+	return result;
+}
@@ -0,0 +1,276 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy indeksu metadanych plików.
+ *  \file
+ *
+ */
+
+#ifndef INDEX_HPP
+#define INDEX_HPP
+
+#include "wire.hpp"
+#include "delta.hpp"
+#include "layout.hpp"
+
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <fcntl.h>
+
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <map>
+#include <set>
+
+using namespace std;
+
+/*! \brief Klasa indeksu metadanych plików.
+ *
+ *  Przechowuje w pamięci nazwy, rozmiary, czasy modyfikacji oraz opcjonalne
+ *  skróty plików serwera. Indeks budowany jest przy starcie równoległym
+ *  przeglądem katalogów układu, a następnie aktualizowany zdarzeniami systemu
+ *  plików. Pozwala odpowiadać na polecenia `LIST` i `STAT` bez dostępu do dysku.
+ *
+ *  Po uruchomieniu metodą `open` skróty plików wyznaczane są w wątku roboczym,
+ *  który odbudowuje też indeks po przepełnieniu kolejki zdarzeń. Wyniki
+ *  zgłaszane są przez `eventfd` obsługiwany w pętli serwera metodą `dispatch`.
+ *
+ *  Rekord protokołu: długość nazwy (16 b), nazwa, rozmiar (64 b), czas
+ *  modyfikacji w ns (64 b), flagi (8 b, bit 0 - skrót ważny) i skrót (64 b).
+ *  Lista kończy się rekordem o zerowej długości nazwy.
+ *
+ */
+class INDEX
+{
+
+	public:
+
+		/*! \brief Metadane pliku.
+		 *
+		 *  Pojedynczy wpis indeksu.
+		 *
+		 */
+		struct ENTRY
+		{
+			uint64_t size = 0; //!< Rozmiar pliku.
+			int64_t mtime = 0; //!< Czas modyfikacji w ns od początku epoki.
+			uint64_t hash = 0; //!< Skrót zawartości (`DELTA::HASH`).
+			bool hashed = false; //!< Flaga ważności skrótu.
+		};
+
+		static constexpr size_t record_fixed = 27; //!< Rozmiar rekordu bez nazwy.
+
+	protected:
+
+		/*! \brief Opis zadania.
+		 *
+		 *  Plik oczekujący na wyznaczenie skrótu.
+		 *
+		 */
+		struct JOB
+		{
+			string name; //!< Nazwa pliku.
+			string path; //!< Ścieżka pliku względem bieżącego katalogu.
+			ENTRY entry; //!< Metadane i wyznaczony skrót.
+		};
+
+		map<string, ENTRY> m_entries; //!< Wpisy według nazwy.
+		LAYOUT* m_layout = nullptr; //!< Układ przechowywania plików.
+
+		bool m_hash; //!< Flaga wyznaczania skrótów.
+
+		int m_event = -1; //!< Deskryptor powiadomień (`eventfd`).
+
+		thread m_thread; //!< Wątek roboczy.
+		mutex m_lock; //!< Blokada kolejek.
+		condition_variable m_wake; //!< Powiadomienie wątku roboczego.
+
+		vector<JOB> m_queue; //!< Pliki oczekujące na skrót.
+		vector<JOB> m_done; //!< Pliki z wyznaczonym skrótem.
+		map<string, ENTRY> m_fresh; //!< Wynik odbudowy indeksu.
+		bool m_rebuild = false; //!< Flaga zleconej odbudowy.
+		bool m_built = false; //!< Flaga zakończonej odbudowy.
+		bool m_stop = false; //!< Flaga zakończenia pracy wątku.
+
+		set<string> m_pending; //!< Pliki, których skrót jest wyznaczany (pętla serwera).
+		set<string> m_dirty; //!< Pliki zmienione w trakcie odbudowy (pętla serwera).
+		bool m_rebuilding = false; //!< Flaga trwającej odbudowy (pętla serwera).
+		bool m_again = false; //!< Flaga ponownej odbudowy (pętla serwera).
+
+	public:
+
+		/*! \brief Konstruktor indeksu.
+		 *  \param [in] hash Wyznaczanie skrótów zawartości plików.
+		 *
+		 */
+		explicit INDEX(bool hash = false);
+
+		virtual ~INDEX(void); //!< Destruktor, kończy wątek roboczy.
+
+		INDEX(const INDEX&) = delete; //!< Konstruktor kopiujący (usunięty).
+		INDEX& operator= (const INDEX&) = delete; //!< Operator przypisania (usunięty).
+
+		/*! \brief Uruchomienie wątku roboczego.
+		 *  \returns Powodzenie operacji.
+		 *
+		 *  Otwiera deskryptor powiadomień i uruchamia wątek wyznaczający skróty.
+		 *  Bez wątku skróty wyznaczane są synchronicznie w metodzie `find`.
+		 *
+		 */
+		bool open(void);
+
+		/*! \brief Zatrzymanie wątku roboczego.
+		 *
+		 *  Kończy wątek roboczy i porzuca niezakończone zadania.
+		 *
+		 */
+		void close(void);
+
+		/*! \brief Obsługa wyników.
+		 *
+		 *  Odczytuje powiadomienie, uzupełnia skróty niezmienionych plików
+		 *  i podmienia zawartość indeksu po zakończonej odbudowie.
+		 *
+		 */
+		void dispatch(void);
+
+		//! Zwraca deskryptor powiadomień do monitorowania funkcją `poll`.
+		int fd(void) const;
+
+		//! Sprawdza, czy wątek roboczy został uruchomiony.
+		bool is_open(void) const;
+
+		/*! \brief Budowa indeksu.
+		 *  \returns Liczba plików w indeksie.
+		 *  \param [in] layout Układ przechowywania plików.
+		 *  \param [in] threads Liczba wątków (`0` - liczba procesorów).
+		 *
+		 *  Przegląda równolegle katalogi układu, a następnie równolegle pobiera
+		 *  metadane (i skróty) znalezionych plików. Zastępuje dotychczasową zawartość.
+		 *
+		 */
+		size_t build(LAYOUT& layout, unsigned threads = 0);
+
+		/*! \brief Odbudowa indeksu w tle.
+		 *
+		 *  Zleca wątkowi roboczemu ponowny przegląd katalogów (bez skrótów). Do
+		 *  czasu jego zakończenia indeks odpowiada dotychczasową zawartością,
+		 *  a zmienione w tym czasie pliki są odświeżane po podmianie wpisów.
+		 *  Bez wątku roboczego odbudowuje indeks synchronicznie.
+		 *
+		 */
+		void rebuild(void);
+
+		/*! \brief Odświeżenie wpisu.
+		 *  \param [in] name Nazwa pliku.
+		 *
+		 *  Pobiera aktualne metadane pliku lub usuwa wpis, gdy plik nie istnieje.
+		 *  Skrót zostanie wyznaczony przy kolejnym zapytaniu.
+		 *
+		 */
+		void refresh(const string& name);
+
+		//! Usuwa wpis pliku.
+		void remove(const string& name);
+
+		/*! \brief Wyszukanie pliku.
+		 *  \returns Wskaźnik na wpis lub `nullptr`, gdy plik nie istnieje.
+		 *  \param [in] name Nazwa pliku.
+		 *
+		 *  Nieaktualny skrót zlecany jest wątkowi roboczemu - do czasu jego
+		 *  wyznaczenia wpis nie ma ważnego skrótu. Bez wątku roboczego skrót
+		 *  wyznaczany jest od razu (odczytując cały plik).
+		 *
+		 */
+		const ENTRY* find(const string& name);
+
+		/*! \brief Wypisanie fragmentu listy.
+		 *  \returns `true` gdy lista została zakończona.
+		 *  \param [in] prefix Przedrostek nazw.
+		 *  \param [in,out] next Pierwsza nazwa do wypisania (na wejściu zwykle równa przedrostkowi).
+		 *  \param [out] out Bufor na rekordy.
+		 *  \param [in] limit Przybliżony limit rozmiaru bufora.
+		 *
+		 *  Dopisuje rekordy kolejnych plików w porządku nazw. Po zapełnieniu bufora
+		 *  zapamiętuje nazwę kolejnego pliku - zmiany indeksu pomiędzy wywołaniami
+		 *  nie unieważniają pozycji. Na końcu listy dopisuje rekord zakończenia.
+		 *
+		 */
+		bool list(const string& prefix, string& next, vector<char>& out, size_t limit) const;
+
+		/*! \brief Wyszukanie plików wzorcem.
+		 *  \returns Liczba dopasowanych plików.
+		 *  \param [in] pattern Wzorzec nazw (`fnmatch`).
+		 *  \param [out] names Nazwy dopasowanych plików w porządku nazw.
+		 *
+		 */
+		size_t match(const string& pattern, vector<string>& names) const;
+
+		//! Zwraca liczbę plików w indeksie.
+		size_t size(void) const;
+
+		//! Dopisuje rekord pliku do bufora.
+		static void put(vector<char>& out, const string& name, const ENTRY& entry);
+
+		/*! \brief Odczyt rekordu.
+		 *  \returns Liczba odczytanych bajtów lub `0`, gdy rekord jest niekompletny.
+		 *  \param [in] in Dane.
+		 *  \param [in] size Liczba dostępnych danych.
+		 *  \param [out] name Nazwa pliku (pusta dla rekordu zakończenia).
+		 *  \param [out] entry Metadane pliku.
+		 *
+		 */
+		static size_t get(const char* in, size_t size, string& name, ENTRY& entry);
+
+		/*! \brief Pobranie metadanych pliku.
+		 *  \returns `false` gdy plik nie istnieje lub nie jest zwykłym plikiem.
+		 *  \param [in] path Ścieżka pliku (względem katalogu `dir`).
+		 *  \param [out] entry Metadane pliku.
+		 *  \param [in] hash Wyznaczenie skrótu zawartości.
+		 *  \param [in] dir Deskryptor katalogu, względem którego podano ścieżkę.
+		 *
+		 */
+		static bool read(const string& path, ENTRY& entry, bool hash, int dir = AT_FDCWD);
+
+	protected:
+
+		//! Pętla wątku roboczego.
+		void run(void);
+
+		/*! \brief Przegląd plików układu.
+		 *  \returns Wpisy znalezionych plików.
+		 *  \param [in] layout Układ przechowywania plików.
+		 *  \param [in] threads Liczba wątków (`0` - liczba procesorów).
+		 *  \param [in] hash Wyznaczanie skrótów zawartości plików.
+		 *
+		 */
+		static map<string, ENTRY> collect(const LAYOUT& layout, unsigned threads, bool hash);
+
+};
+
+#endif // INDEX_HPP
@@ -0,0 +1,266 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy układu przechowywania plików.
+ *  \file
+ *
+ */
+
+#include "layout.hpp"
+
+LAYOUT::LAYOUT(void) {}
+
+LAYOUT::~LAYOUT(void)
+{
+	if (m_root != -1) ::close(m_root);
+}
+
+bool LAYOUT::open(const string& root)
+{
+	if (m_root != -1) ::close(m_root);
+
+	m_root = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	m_base = root;
+
+	return m_root != -1;
+}
+
+int LAYOUT::open_file(const string& name, int flags, mode_t mode)
+{
+	const int fd = dir(name);
+
+	if (fd == -1) return -1;
+	else return ::openat(fd, name.c_str(), flags | O_CLOEXEC, mode);
+}
+
+bool LAYOUT::scan(const string& dir, const function<void(const string&, const string&)>& callback) const
+{
+	const int fd = ::openat(m_root, dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	DIR* handle = fd == -1 ? nullptr : ::fdopendir(fd);
+
+	if (!handle)
+	{
+		if (fd != -1) ::close(fd);
+		return false;
+	}
+
+	const string prefix = dir == "." ? "" : dir + '/';
+
+	// Zwykłe pliki bez plików ukrytych (tymczasowych, znacznika)
+	while (const dirent* e = ::readdir(handle))
+	{
+		if (e->d_name[0] == '.') continue;
+
+		bool regular = e->d_type == DT_REG;
+
+		// Nie wszystkie systemy plików podają typ wpisu
+		if (e->d_type == DT_UNKNOWN)
+		{
+			struct stat st;
+			regular = ::fstatat(fd, e->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISREG(st.st_mode);
+		}
+
+		if (regular) callback(prefix + e->d_name, e->d_name);
+	}
+
+	::closedir(handle);
+
+	return true;
+}
+
+unique_ptr<LAYOUT> LAYOUT::make(const string& spec)
+{
+	if (spec == "flat") return make_unique<FLAT>();
+	else if (spec == "sharded" || spec == "sharded:1") return make_unique<SHARDED>(1);
+	else if (spec == "sharded:2") return make_unique<SHARDED>(2);
+	else return nullptr;
+}
+
+string LAYOUT::detect(const string& root)
+{
+	char buff[64] = {};
+
+	const string file = root + '/' + marker;
+	FILE* in = ::fopen(file.c_str(), "r");
+
+	if (!in) return string();
+
+	const bool ok = ::fgets(buff, sizeof(buff), in) != nullptr;
+	::fclose(in);
+
+	if (!ok) return string();
+
+	string spec(buff);
+
+	// Usuń znak końca linii
+	while (!spec.empty() && (spec.back() == '\n' || spec.back() == '\r')) spec.pop_back();
+
+	return spec;
+}
+
+bool LAYOUT::mark(const string& root, const string& spec)
+{
+	const string file = root + '/' + marker;
+	const string temp = file + ".tmp";
+
+	FILE* out = ::fopen(temp.c_str(), "w");
+
+	if (!out) return false;
+
+	const bool ok = ::fprintf(out, "%s\n", spec.c_str()) > 0 && ::fflush(out) == 0 &&
+				 ::fsync(::fileno(out)) == 0;
+
+	::fclose(out);
+
+	return ok && ::rename(temp.c_str(), file.c_str()) == 0;
+}
+
+string LAYOUT::full(const string& relative) const
+{
+	return m_base == "." ? relative : m_base + '/' + relative;
+}
+
+string LAYOUT::FLAT::path(const string& name) const
+{
+	return name;
+}
+
+int LAYOUT::FLAT::dir(const string&)
+{
+	return m_root;
+}
+
+vector<string> LAYOUT::FLAT::directories(void) const
+{
+	return { "." };
+}
+
+string LAYOUT::FLAT::spec(void) const
+{
+	return "flat";
+}
+
+LAYOUT::SHARDED::SHARDED(unsigned levels, size_t limit)
+: m_levels(levels), m_limit(limit) {}
+
+LAYOUT::SHARDED::~SHARDED(void)
+{
+	for (const auto& [k, d] : m_dirs) ::close(d.first);
+}
+
+bool LAYOUT::SHARDED::open(const string& root)
+{
+	if (!LAYOUT::open(root)) return false;
+
+	// Utwórz wszystkie podkatalogi - pozwala to obserwować je od początku
+	for (unsigned i = 0; i < 256; ++i)
+	{
+		const string first = shard_path(i << (8 * (m_levels - 1))).substr(0, 2);
+
+		if (::mkdirat(m_root, first.c_str(), 0755) == -1 && errno != EEXIST) return false;
+
+		for (unsigned j = 0; m_levels > 1 && j < 256; ++j)
+		{
+			const string second = shard_path((i << 8) | j);
+
+			if (::mkdirat(m_root, second.c_str(), 0755) == -1 && errno != EEXIST) return false;
+		}
+	}
+
+	return true;
+}
+
+string LAYOUT::SHARDED::path(const string& name) const
+{
+	return shard_path(shard(name)) + '/' + name;
+}
+
+int LAYOUT::SHARDED::dir(const string& name)
+{
+	const uint32_t id = shard(name);
+	const auto it = m_dirs.find(id);
+
+	// Trafienie - przenieś katalog na początek kolejki LRU
+	if (it != m_dirs.end())
+	{
+		m_order.splice(m_order.begin(), m_order, it->second.second);
+		return it->second.first;
+	}
+
+	const int fd = ::openat(m_root, shard_path(id).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+	if (fd == -1) return -1;
+
+	// Usuń najdawniej używany katalog, gdy bufor jest pełny
+	if (m_dirs.size() >= m_limit)
+	{
+		const auto last = m_dirs.find(m_order.back());
+
+		::close(last->second.first);
+		m_dirs.erase(last);
+		m_order.pop_back();
+	}
+
+	m_order.push_front(id);
+	m_dirs.insert({ id, { fd, m_order.begin() } });
+
+	return fd;
+}
+
+vector<string> LAYOUT::SHARDED::directories(void) const
+{
+	vector<string> list;
+	const uint32_t count = 1u << (8 * m_levels);
+
+	list.reserve(count);
+
+	for (uint32_t i = 0; i < count; ++i) list.push_back(shard_path(i));
+
+	return list;
+}
+
+string LAYOUT::SHARDED::spec(void) const
+{
+	return "sharded:" + to_string(m_levels);
+}
+
+uint32_t LAYOUT::SHARDED::shard(const string& name) const
+{
+	uint32_t hash = 2166136261u; // FNV-1a
+
+	for (const char c : name)
+	{
+		hash ^= uint8_t(c);
+		hash *= 16777619u;
+	}
+
+	// Zwiń skrót do liczby podkatalogów
+	return (hash ^ (hash >> 16)) & ((1u << (8 * m_levels)) - 1);
+}
+
+string LAYOUT::SHARDED::shard_path(uint32_t shard) const
+{
+	char buff[8];
+
+	if (m_levels == 1) ::snprintf(buff, sizeof(buff), "%02x", shard & 0xff);
+	else ::snprintf(buff, sizeof(buff), "%02x/%02x", (shard >> 8) & 0xff, shard & 0xff);
+
+	return buff;
+}
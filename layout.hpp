@@ -0,0 +1,223 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy układu przechowywania plików.
+ *  \file
+ *
+ */
+
+#ifndef LAYOUT_HPP
+#define LAYOUT_HPP
+
+#include <sys/stat.h>
+
+#include <dirent.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+
+using namespace std;
+
+/*! \brief Klasa układu przechowywania plików.
+ *
+ *  Odwzorowuje nazwy plików na ścieżki w katalogu roboczym serwera. Układ płaski
+ *  (`FLAT`) przechowuje wszystkie pliki w jednym katalogu. Układ podzielony
+ *  (`SHARDED`) rozkłada je na podkatalogi wyznaczone skrótem nazwy, dzięki czemu
+ *  przy milionach plików katalogi pozostają małe, a wyszukiwanie i tworzenie
+ *  wpisów szybkie. Pliki otwierane są względem buforowanych deskryptorów
+ *  katalogów (`openat`), co pozwala uniknąć wielokrotnego przechodzenia ścieżki.
+ *
+ *  Wybrany układ zapisywany jest w pliku znacznika w katalogu głównym.
+ *
+ */
+class LAYOUT
+{
+
+	public:
+
+		class FLAT;
+		class SHARDED;
+
+		static constexpr const char* marker = ".layout"; //!< Nazwa pliku znacznika układu.
+
+	protected:
+
+		int m_root = -1; //!< Deskryptor katalogu głównego.
+		string m_base; //!< Ścieżka katalogu głównego.
+
+	public:
+
+		explicit LAYOUT(void); //!< Konstruktor domyślny.
+		virtual ~LAYOUT(void); //!< Destruktor, zamyka deskryptory.
+
+		LAYOUT(const LAYOUT&) = delete; //!< Konstruktor kopiujący (usunięty).
+		LAYOUT& operator= (const LAYOUT&) = delete; //!< Operator przypisania (usunięty).
+
+		/*! \brief Otwarcie układu.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] root Katalog główny.
+		 *
+		 *  Otwiera katalog główny i tworzy strukturę podkatalogów układu.
+		 *
+		 */
+		virtual bool open(const string& root);
+
+		/*! \brief Ścieżka pliku.
+		 *  \returns Ścieżka względem katalogu głównego.
+		 *  \param [in] name Nazwa pliku.
+		 *
+		 */
+		virtual string path(const string& name) const = 0;
+
+		/*! \brief Katalog pliku.
+		 *  \returns Deskryptor katalogu zawierającego plik lub `-1` w przypadku błędu.
+		 *  \param [in] name Nazwa pliku.
+		 *
+		 *  Zwraca buforowany deskryptor - nie należy go zamykać.
+		 *
+		 */
+		virtual int dir(const string& name) = 0;
+
+		//! Zwraca listę katalogów z plikami (względem katalogu głównego).
+		virtual vector<string> directories(void) const = 0;
+
+		//! Zwraca opis układu w postaci akceptowanej przez `make`.
+		virtual string spec(void) const = 0;
+
+		/*! \brief Otwarcie pliku.
+		 *  \returns Deskryptor pliku lub `-1` w przypadku błędu.
+		 *  \param [in] name Nazwa pliku.
+		 *  \param [in] flags Flagi funkcji `open`.
+		 *  \param [in] mode Uprawnienia tworzonego pliku.
+		 *
+		 *  Otwiera plik względem deskryptora jego katalogu.
+		 *
+		 */
+		int open_file(const string& name, int flags, mode_t mode = 0644);
+
+		/*! \brief Przegląd plików.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] dir Katalog z listy `directories`.
+		 *  \param [in] callback Funkcja wywoływana dla każdego pliku (ścieżka i nazwa).
+		 *
+		 *  Wywołuje funkcję dla zwykłych plików katalogu z pominięciem plików
+		 *  ukrytych (tymczasowych i znacznika).
+		 *
+		 */
+		bool scan(const string& dir, const function<void(const string&, const string&)>& callback) const;
+
+		/*! \brief Utworzenie układu.
+		 *  \returns Obiekt układu lub pusty wskaźnik dla błędnego opisu.
+		 *  \param [in] spec Opis układu: `flat`, `sharded` lub `sharded:POZIOMY` (1 lub 2).
+		 *
+		 */
+		static unique_ptr<LAYOUT> make(const string& spec);
+
+		/*! \brief Odczyt znacznika układu.
+		 *  \returns Opis układu zapisany w katalogu lub pusty łańcuch.
+		 *  \param [in] root Katalog główny.
+		 *
+		 */
+		static string detect(const string& root);
+
+		/*! \brief Zapis znacznika układu.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] root Katalog główny.
+		 *  \param [in] spec Opis układu.
+		 *
+		 */
+		static bool mark(const string& root, const string& spec);
+
+		//! Zwraca ścieżkę pliku względem bieżącego katalogu.
+		string full(const string& relative) const;
+
+};
+
+/*! \brief Układ płaski.
+ *
+ *  Wszystkie pliki w katalogu głównym - zgodny z wcześniejszymi wersjami serwera.
+ *
+ */
+class LAYOUT::FLAT : public LAYOUT
+{
+
+	public:
+
+		virtual string path(const string& name) const override;
+		virtual int dir(const string& name) override;
+		virtual vector<string> directories(void) const override;
+		virtual string spec(void) const override;
+
+};
+
+/*! \brief Układ podzielony.
+ *
+ *  Pliki rozkładane są na 256 (jeden poziom) lub 65536 (dwa poziomy) podkatalogów
+ *  według skrótu FNV-1a nazwy, np. `3f/nazwa` lub `3f/a2/nazwa`. Deskryptory
+ *  ostatnio używanych podkatalogów przechowywane są w buforze LRU.
+ *
+ */
+class LAYOUT::SHARDED : public LAYOUT
+{
+
+	protected:
+
+		unsigned m_levels; //!< Liczba poziomów podkatalogów.
+		size_t m_limit; //!< Maksymalna liczba buforowanych deskryptorów.
+
+		list<uint32_t> m_order; //!< Kolejność użycia (na początku najnowsze).
+		map<uint32_t, pair<int, list<uint32_t>::iterator>> m_dirs; //!< Buforowane deskryptory katalogów.
+
+	public:
+
+		/*! \brief Konstruktor układu.
+		 *  \param [in] levels Liczba poziomów podkatalogów (1 lub 2).
+		 *  \param [in] limit Maksymalna liczba buforowanych deskryptorów.
+		 *
+		 */
+		explicit SHARDED(unsigned levels = 1, size_t limit = 512);
+		virtual ~SHARDED(void) override; //!< Destruktor, zamyka deskryptory.
+
+		virtual bool open(const string& root) override;
+		virtual string path(const string& name) const override;
+		virtual int dir(const string& name) override;
+		virtual vector<string> directories(void) const override;
+		virtual string spec(void) const override;
+
+	protected:
+
+		//! Zwraca numer podkatalogu pliku.
+		uint32_t shard(const string& name) const;
+
+		//! Zwraca ścieżkę podkatalogu o wskazanym numerze.
+		string shard_path(uint32_t shard) const;
+
+};
+
+#endif // LAYOUT_HPP
@@ -0,0 +1,532 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik main programu testów wydajności.
+ *  \file
+ *
+ *  Zawiera program mierzący wydajność elementów serwera TPK: układu katalogów
+ *  magazynu oraz przepustowości przesyłania dużych plików.
+ *
+ */
+
+#include "layout.hpp"
+#include "committer.hpp"
+#include "client.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+
+#include <sys/sysmacros.h>
+
+#include <argp.h>
+#include <poll.h>
+
+//! Wersja programu dla argp
+const char* argp_program_version = "TPK Bench 1.0";
+
+//! Email zgłoszenia błędu dla argp
+const char* argp_program_bug_address = "<lukasz.drozdz@polsl.pl>";
+
+//! Opis programu dla argp
+static char doc[] = "Benchmark program for TPK project";
+
+//! Opis parametrów dla argp
+static char args_doc[] = "[DIR]\n-c [DIR]\n-t FILE [-u]";
+
+//! Struktura parametrów dla argp
+static struct argp_option options[] =
+{
+	{ "layout",	'L',	"SPEC",	0, "Compare create/open latency of layout against flat (default sharded)" },
+	{ "count",	'n',	"N",		0, "Number of files (default 100000)" },
+	{ "keep",		'k',	0,		0, "Keep created files" },
+	{ "commit",	'c',	0,		0, "Measure group commit of created files and count device cache flushes" },
+	{ "transfer",	't',	"FILE",	0, "Measure steady throughput of downloading FILE from server" },
+	{ "upload",	'u',	0,		0, "Measure upload of local FILE instead" },
+	{ "host",		'h',	"HOST",	0, "Select hostname (default is localhost)" },
+	{ "port",		'p',	"PORT",	0, "Select port number (default is 8080)" },
+	{ "window",	'w',	"SEC",	0, "Throughput sampling window (default 1 s)" },
+	{ "tolerance",	'T',	"PCT",	0, "Allowed throughput drop at the end of transfer (default 20%)" },
+	{ 0 }
+};
+
+/*! \brief Struktura opisująca argumenty.
+ *  \see parse_opt.
+ *
+ *  Przechowuje wartości wszystkich argumentów programu w wygodnej do użytku formie.
+ *  Jest uzupełniana przez odpowiednią funkcję podczas parsowania argumentów.
+ *
+ */
+struct arguments
+{
+	string dir = "tpk-bench"; //!< Katalog testowy.
+	string layout = "sharded"; //!< Porównywany układ.
+	size_t count = 100000; //!< Liczba plików.
+	bool keep = false; //!< Pozostawienie plików.
+	bool commit = false; //!< Pomiar zatwierdzania zamiast układu.
+
+	string transfer; //!< Plik mierzonego przesyłania (pusty - pomiar układu).
+	bool upload = false; //!< Pomiar wysyłania zamiast pobierania.
+	string host = "localhost"; //!< Adres serwera.
+	uint16_t port = 8080; //!< Port serwera.
+	double window = 1; //!< Okno próbkowania przepustowości w sekundach.
+	double tolerance = 20; //!< Dopuszczalny spadek przepustowości w procentach.
+};
+
+/*! \brief Funkcja przetwarzająca argumenty.
+ *  \see arguments.
+ *  \returns Kod błędu.
+ *  \param [in] key Kod argumentu.
+ *  \param [in] arg Wartość argumentu.
+ *  \param [in] state Stan argp.
+ *
+ *  Przetwarza surowe argumenty i na ich podstawie uzupełnia pola struktury z danymi.
+ *
+ */
+static error_t parse_opt(int key, char* arg, argp_state* state)
+{
+	struct arguments* args = (arguments*) state->input;
+
+	switch (key)
+	{
+		case 'L':
+			args->layout = arg;
+			if (!LAYOUT::make(args->layout)) argp_usage(state);
+		break;
+
+		case 'n':
+			args->count = atol(arg);
+			if (!args->count) argp_usage(state);
+		break;
+
+		case 'k':
+			args->keep = true;
+		break;
+
+		case 'c':
+			args->commit = true;
+		break;
+
+		case 't':
+			args->transfer = arg;
+		break;
+
+		case 'u':
+			args->upload = true;
+		break;
+
+		case 'h':
+			args->host = arg;
+		break;
+
+		case 'p':
+			args->port = atoi(arg);
+			if (!args->port) argp_usage(state);
+		break;
+
+		case 'w':
+			args->window = atof(arg);
+			if (args->window <= 0) argp_usage(state);
+		break;
+
+		case 'T':
+			args->tolerance = atof(arg);
+			if (args->tolerance < 0 || args->tolerance >= 100) argp_usage(state);
+		break;
+
+		case ARGP_KEY_ARG:
+			if (state->arg_num == 0) args->dir = arg;
+			else argp_usage(state);
+		break;
+
+		default: return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+//! Struktura konfiguracji argp
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+/*! \brief Wypisanie statystyk.
+ *  \param [in] label Opis pomiaru.
+ *  \param [in,out] samples Czasy operacji w ns (zostaną posortowane).
+ *
+ *  Wypisuje średnią oraz percentyle 50 i 99 w µs.
+ *
+ */
+static void report(const string& label, vector<double>& samples);
+
+/*! \brief Pomiar układu.
+ *  \returns Powodzenie operacji.
+ *  \param [in] spec Opis układu.
+ *  \param [in] root Katalog testowy układu.
+ *  \param [in] args Parametry programu.
+ *
+ *  Tworzy pliki (tak jak serwer - jako pliki tymczasowe), a następnie otwiera
+ *  je w losowej kolejności mierząc czas każdej operacji.
+ *
+ */
+static bool bench_layout(const string& spec, const string& root, const arguments& args);
+
+/*! \brief Liczba opróżnień pamięci podręcznej urządzenia.
+ *  \returns Licznik opróżnień urządzenia lub `-1`, gdy jest niedostępny.
+ *  \param [in] path Plik na badanym urządzeniu.
+ *
+ *  Odczytuje licznik żądań opróżnienia z `/proc/diskstats` (jądro 5.5+).
+ *
+ */
+static long device_flushes(const string& path);
+
+/*! \brief Pomiar grupowego zatwierdzania.
+ *  \returns Powodzenie operacji.
+ *  \param [in] root Katalog testowy.
+ *  \param [in] args Parametry programu.
+ *
+ *  Zapisuje pliki tymczasowe, zgłasza je wszystkie do zatwierdzenia i czeka
+ *  na wyniki. Wypisuje liczbę porcji oraz liczbę opróżnień pamięci podręcznej
+ *  urządzenia - przy grupowym zatwierdzaniu jest ona mniejsza od liczby plików.
+ *
+ */
+static bool bench_commit(const string& root, const arguments& args);
+
+/*! \brief Pomiar przesyłania dużego pliku.
+ *  \returns `true` gdy przesyłanie się powiodło, a przepustowość nie spadła.
+ *  \param [in] args Parametry programu.
+ *
+ *  Pobiera plik z serwera do `/dev/null` (lub wysyła lokalny plik) próbkując
+ *  przepustowość w oknach czasowych. Przepustowość ostatniej ćwiartki okien
+ *  porównywana jest z pierwszą ćwiartką (bez pierwszego okna rozbiegu), co
+ *  wykrywa spowolnienie narastające w trakcie wielogigabajtowych przesyłań.
+ *  Plik testowy nie musi zajmować miejsca na dysku - wystarczy plik rzadki
+ *  utworzony poleceniem `truncate -s 200G`.
+ *
+ */
+static bool bench_transfer(const arguments& args);
+
+/*! \brief Funkcja główna programu testów wydajności.
+ *  \returns Kod błędu.
+ *  \param [in] argc Liczba argumentów.
+ *  \param [in] argv Lista argumentów.
+ *
+ *  Przetwarza parametry i uruchamia pomiary.
+ *
+ */
+int main(int argc, char* argv[]);
+
+int main(int argc, char* argv[])
+{
+	struct arguments args; // Wartości parametrów
+
+	// Przetwórz argumenty
+	argp_parse(&argp, argc, argv, 0, 0, &args);
+
+	// Pomiar przesyłania nie korzysta z katalogu testowego
+	if (!args.transfer.empty()) return bench_transfer(args) ? 0 : -1;
+
+	if (::mkdir(args.dir.c_str(), 0755) == -1 && errno != EEXIST) return -1;
+
+	// Pomiar zatwierdzania w osobnym katalogu
+	if (args.commit)
+	{
+		if (!bench_commit(args.dir + "/commit", args)) return -1;
+		if (!args.keep) ::rmdir(args.dir.c_str());
+
+		return 0;
+	}
+
+	// Porównaj wybrany układ z płaskim w osobnych katalogach
+	for (const string& spec : { string("flat"), LAYOUT::make(args.layout)->spec() })
+	{
+		string sub = spec;
+		replace(sub.begin(), sub.end(), ':', '-');
+
+		if (!bench_layout(spec, args.dir + '/' + sub, args)) return -1;
+	}
+
+	if (!args.keep) ::rmdir(args.dir.c_str());
+
+	return 0;
+}
+
+static void report(const string& label, vector<double>& samples)
+{
+	if (samples.empty()) return;
+
+	sort(samples.begin(), samples.end());
+
+	double sum(0);
+	for (const double s : samples) sum += s;
+
+	cout << label << fixed << setprecision(2)
+		<< "avg " << sum / samples.size() / 1e3 << " us\t"
+		<< "p50 " << samples[samples.size() / 2] / 1e3 << " us\t"
+		<< "p99 " << samples[samples.size() * 99 / 100] / 1e3 << " us\n";
+}
+
+static bool bench_layout(const string& spec, const string& root, const arguments& args)
+{
+	using clock = chrono::steady_clock;
+
+	auto layout = LAYOUT::make(spec);
+
+	cout << "Layout " << spec << ":\n";
+
+	if (::mkdir(root.c_str(), 0755) == -1 && errno != EEXIST) return false;
+	if (!layout->open(root)) return false;
+
+	vector<double> create, open;
+	vector<size_t> order(args.count);
+
+	create.reserve(args.count);
+	open.reserve(args.count);
+
+	for (size_t i = 0; i < args.count; ++i) order[i] = i;
+
+	// Tworzenie plików tymczasowych tak jak przy wysyłaniu na serwer
+	// (podmiana na plik docelowy odbywa się poza pętlą serwera)
+	for (size_t i = 0; i < args.count; ++i)
+	{
+		const string name = "file-" + to_string(i);
+		const auto start = clock::now();
+
+		string temp;
+		const int dir = layout->dir(name);
+		const int fd = COMMITTER::create(layout->path(name), temp, dir);
+
+		create.push_back(chrono::duration<double, nano>(clock::now() - start).count());
+
+		if (fd == -1) return false;
+		else ::close(fd);
+
+		if (::renameat(dir, temp.c_str() + temp.rfind('/') + 1, dir, name.c_str()) == -1) return false;
+	}
+
+	// Otwieranie istniejących plików w losowej kolejności
+	shuffle(order.begin(), order.end(), mt19937(42));
+
+	for (const size_t i : order)
+	{
+		const string name = "file-" + to_string(i);
+		const auto start = clock::now();
+
+		const int fd = layout->open_file(name, O_RDONLY);
+
+		open.push_back(chrono::duration<double, nano>(clock::now() - start).count());
+
+		if (fd == -1) return false;
+		else ::close(fd);
+	}
+
+	report("  create\t", create);
+	report("  open\t\t", open);
+
+	if (args.keep) return true;
+
+	// Usuń pliki i katalogi
+	for (size_t i = 0; i < args.count; ++i)
+	{
+		const string name = "file-" + to_string(i);
+		::unlinkat(layout->dir(name), name.c_str(), 0);
+	}
+
+	const auto dirs = layout->directories();
+
+	for (auto d = dirs.rbegin(); d != dirs.rend(); ++d)
+	{
+		if (*d == ".") continue;
+
+		const size_t slash = d->find('/');
+
+		::rmdir(layout->full(*d).c_str());
+		if (slash != string::npos) ::rmdir(layout->full(d->substr(0, slash)).c_str());
+	}
+
+	::unlink(layout->full(LAYOUT::marker).c_str());
+	::rmdir(root.c_str());
+
+	return true;
+}
+
+static long device_flushes(const string& path)
+{
+	struct stat st;
+	string line;
+
+	if (::stat(path.c_str(), &st) == -1) return -1;
+
+	ifstream file("/proc/diskstats");
+
+	while (getline(file, line))
+	{
+		istringstream in(line);
+		unsigned maj(0), min(0);
+		string name;
+		long value[16];
+
+		in >> maj >> min >> name;
+
+		if (maj != major(st.st_dev) || min != minor(st.st_dev)) continue;
+
+		// Szesnasta wartość to liczba zakończonych opróżnień
+		for (auto& v : value) in >> v;
+
+		return in ? value[15] : -1;
+	}
+
+	return -1;
+}
+
+static bool bench_commit(const string& root, const arguments& args)
+{
+	using clock = chrono::steady_clock;
+
+	const vector<char> data(4096, 'x');
+	vector<pair<int, string>> temps;
+	COMMITTER committer;
+	size_t done(0), failed(0);
+
+	cout << "Group commit:\n";
+
+	if (::mkdir(root.c_str(), 0755) == -1 && errno != EEXIST) return false;
+	if (!committer.open()) return false;
+
+	// Przygotuj pliki tymczasowe tak jak przy wysyłaniu na serwer
+	for (size_t i = 0; i < args.count; ++i)
+	{
+		string temp;
+
+		const int fd = COMMITTER::create(root + "/file-" + to_string(i), temp);
+
+		if (fd == -1 || ::write(fd, data.data(), data.size()) != ssize_t(data.size())) return false;
+		else temps.push_back({ fd, temp });
+	}
+
+	const long before = device_flushes(root);
+	const auto start = clock::now();
+
+	for (size_t i = 0; i < temps.size(); ++i)
+	{
+		committer.submit(temps[i].first, temps[i].second, root + "/file-" + to_string(i),
+					  [&done, &failed] (bool ok) { ++done; if (!ok) ++failed; });
+	}
+
+	// Wyniki zgłaszane są przez deskryptor powiadomień
+	while (done < temps.size())
+	{
+		pollfd p = { committer.fd(), POLLIN, 0 };
+
+		if (::poll(&p, 1, -1) > 0) committer.dispatch();
+	}
+
+	const double time = chrono::duration<double>(clock::now() - start).count();
+	const long after = device_flushes(root);
+
+	cout << "  files\t\t" << committer.files() << " (" << failed << " failed)\n"
+		<< "  batches\t" << committer.batches() << '\n'
+		<< "  flushes\t";
+
+	if (before < 0 || after < 0) cout << "unknown\n";
+	else cout << after - before << '\n';
+
+	cout << "  time\t\t" << fixed << setprecision(2) << time * 1e3 << " ms\n";
+
+	committer.close();
+
+	if (args.keep) return !failed;
+
+	for (size_t i = 0; i < temps.size(); ++i)
+		::unlink((root + "/file-" + to_string(i)).c_str());
+
+	::rmdir(root.c_str());
+
+	return !failed;
+}
+
+static bool bench_transfer(const arguments& args)
+{
+	using clock = chrono::steady_clock;
+
+	vector<pair<uint64_t, double>> samples; // Pozycja i przepustowość w MiB/s
+	auto last = clock::now();
+	uint64_t mark(0);
+
+	CLIENT cli;
+
+	// Próbkuj przepustowość w kolejnych oknach czasowych
+	cli.set_progress([&] (uint64_t done)
+	{
+		const auto now = clock::now();
+		const double dt = chrono::duration<double>(now - last).count();
+
+		if (dt < args.window) return;
+
+		samples.push_back({ done, (done - mark) / dt / (1 << 20) });
+
+		last = now;
+		mark = done;
+	});
+
+	if (!cli.connect(args.host, args.port)) return false;
+
+	last = clock::now();
+
+	const auto result = args.upload ? cli.upload(args.transfer, args.transfer) :
+							    cli.download(args.transfer, "/dev/null");
+
+	if (!result.ok())
+	{
+		cout << "Transfer failed:\t" << result.what() << '\n';
+		return false;
+	}
+
+	cout << "Throughput samples:\n" << fixed << setprecision(2);
+
+	for (const auto& s : samples)
+		cout << "  " << s.first / double(1 << 30) << " GiB\t" << s.second << " MiB/s\n";
+
+	cout << "Transferred data:\t" << result.bytes << " B in " << result.seconds << " s ("
+		<< result.throughput / (1 << 20) << " MiB/s)\n";
+
+	// Porównanie wymaga co najmniej dwóch okien na ćwiartkę
+	if (samples.size() < 9)
+	{
+		cout << "Steady throughput:\tSKIP (too few samples)\n";
+		return true;
+	}
+
+	const size_t quarter = (samples.size() - 1) / 4;
+	double first(0), final(0), lowest(samples[1].second);
+
+	for (size_t i = 1; i < samples.size(); ++i) lowest = min(lowest, samples[i].second);
+	for (size_t i = 0; i < quarter; ++i) first += samples[1 + i].second / quarter;
+	for (size_t i = 0; i < quarter; ++i) final += samples[samples.size() - 1 - i].second / quarter;
+
+	const bool steady = final >= first * (1 - args.tolerance / 100);
+
+	cout << "Steady throughput:\t" << (steady ? "OK" : "FAIL")
+		<< " (first " << first << " MiB/s, last " << final
+		<< " MiB/s, lowest " << lowest << " MiB/s)\n";
+
+	return steady;
+}
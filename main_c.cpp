@@ -26,9 +26,14 @@
  */
 
 #include "client.hpp"
+#include "dirsync.hpp"
+#include "batch.hpp"
 
 #include <stdlib.h>
 #include <argp.h>
+#include <time.h>
+
+#include <fstream>
 
 //! Wersja programu dla argp
 const char* argp_program_version = "TPK Client 1.0";
@@ -40,15 +45,31 @@ const char* argp_program_bug_address = "<lukasz.drozdz@polsl.pl>";
 static char doc[] = "Client program for TPK project";
 
 //! Opis parametrów dla argp
-static char args_doc[] = "FILE [LOCALFILE]";
+static char args_doc[] = "FILE [LOCALFILE]\n-l [PREFIX]\n-m PATTERN|- [DIR]\n-r DIR\n-b MANIFEST|-";
 
 //! Struktura parametrów dla argp
 static struct argp_option options[] =
 {
 	{ "download",	'd',	0,		0, "Download selected file" },
 	{ "upload",	'u',	0,		0, "Upload selected file" },
+	{ "sync",		's',	0,		0, "Upload only changes of selected file" },
+	{ "dedup",	'D',	0,		0, "Upload only chunks missing in server store" },
+	{ "list",		'l',	0,		0, "List server files with given name prefix" },
+	{ "stat",		'S',	0,		0, "Show metadata of selected file" },
+	{ "mget",		'm',	0,		0, "Download files matching pattern (- reads names from stdin)" },
+	{ "writers",	'w',	"N",		0, "Number of threads writing downloaded files (default is 4)" },
+	{ "recursive",	'r',	0,		0, "Upload whole directory tree" },
+	{ "batch",	'b',	0,		0, "Run download/upload lines of manifest (- reads stdin)" },
+	{ "connections",	'c',	"N",		0, "Number of parallel connections (default is 4)" },
+	{ "skip-unchanged",	'k',	0,		0, "Skip files already present on server" },
+	{ "sparse",	'H',	0,		0, "Transfer only data extents of sparse file (with -d or -u)" },
+	{ "follow",	'F',	0,		0, "Keep downloading data appended to file (with -d)" },
+	{ "resume",	'R',	0,		0, "Continue download from end of local file (with -d)" },
+	{ "binary",	'B',	0,		0, "Send requests as binary frames" },
 	{ "port",		'p',	"PORT",	0, "Select port number (default is 8080)" },
 	{ "host",		'h',	"HOST",	0, "Select hostname (default is localhost)" },
+	{ "profile",	'P',	"SPEC",	0, "Socket tuning profile (default, bulk, latency)[,option=value...]" },
+	{ "unix",		'U',	"PATH",	0, "Connect to local server socket (@name for abstract namespace)" },
 	{ 0 }
 };
 
@@ -70,7 +91,14 @@ struct arguments
 	{
 		unknown, //!< Nieznana czynność.
 		download, //!< Pobierz plik.
-		upload //!< Wyślij plik.
+		upload, //!< Wyślij plik.
+		sync, //!< Wyślij zmiany w pliku.
+		dedup, //!< Wyślij brakujące fragmenty pliku.
+		list, //!< Wyświetl listę plików.
+		stat, //!< Wyświetl metadane pliku.
+		mget, //!< Pobierz wiele plików.
+		recursive, //!< Wyślij drzewo katalogów.
+		batch //!< Wykonaj manifest.
 	};
 
 	modeset mode; //!< Wybrana czynność.
@@ -78,8 +106,18 @@ struct arguments
 	string local; //!< Lokalna ścieżka pliku.
 	string file; //!< Nazwa pliku na serwerze.
 	string host; //!< Adres serwera.
+	string socket; //!< Ścieżka gniazda lokalnego serwera.
 
 	uint16_t port; //!< Port serwera.
+	unsigned writers; //!< Liczba wątków zapisujących pliki.
+	unsigned connections; //!< Liczba równoległych połączeń.
+	bool skip; //!< Pomijanie niezmienionych plików.
+	bool sparse; //!< Przesyłanie jedynie obszarów danych pliku rzadkiego.
+	bool follow; //!< Śledzenie dopisywanych danych pobieranego pliku.
+	bool resume; //!< Wznawianie pobierania od końca lokalnego pliku.
+	bool binary; //!< Wysyłanie żądań jako ramek binarnych.
+
+	SOCKBASE::PROFILE profile; //!< Profil strojenia gniazd.
 };
 
 /*! \brief Funkcja przetwarzająca argumenty.
@@ -106,15 +144,73 @@ static error_t parse_opt(int key, char* arg, argp_state* state)
 			args->host = arg;
 			if (args->host.empty()) argp_usage(state);
 		break;
+		case 'P':
+			if (!SOCKBASE::PROFILE::parse(arg, args->profile)) argp_usage(state);
+		break;
+		case 'U':
+			args->socket = arg;
+			if (args->socket.empty()) argp_usage(state);
+		break;
 
 		case 'u':
 			if (args->mode != arguments::unknown) argp_usage(state);
 			else args->mode = arguments::upload;
 		break;
+		case 's':
+			if (args->mode != arguments::unknown) argp_usage(state);
+			else args->mode = arguments::sync;
+		break;
+		case 'D':
+			if (args->mode != arguments::unknown) argp_usage(state);
+			else args->mode = arguments::dedup;
+		break;
 		case 'd':
 			if (args->mode != arguments::unknown) argp_usage(state);
 			else args->mode = arguments::download;
 		break;
+		case 'l':
+			if (args->mode != arguments::unknown) argp_usage(state);
+			else args->mode = arguments::list;
+		break;
+		case 'S':
+			if (args->mode != arguments::unknown) argp_usage(state);
+			else args->mode = arguments::stat;
+		break;
+		case 'm':
+			if (args->mode != arguments::unknown) argp_usage(state);
+			else args->mode = arguments::mget;
+		break;
+		case 'w':
+			args->writers = atoi(arg);
+			if (!args->writers) argp_usage(state);
+		break;
+		case 'r':
+			if (args->mode != arguments::unknown) argp_usage(state);
+			else args->mode = arguments::recursive;
+		break;
+		case 'b':
+			if (args->mode != arguments::unknown) argp_usage(state);
+			else args->mode = arguments::batch;
+		break;
+		case 'c':
+			args->connections = atoi(arg);
+			if (!args->connections) argp_usage(state);
+		break;
+		case 'k':
+			args->skip = true;
+		break;
+		case 'H':
+			args->sparse = true;
+		break;
+		case 'F':
+			args->follow = true;
+		break;
+		case 'R':
+			args->resume = true;
+		break;
+		case 'B':
+			args->binary = true;
+		break;
 
 		case ARGP_KEY_ARG:
 			switch (state->arg_num)
@@ -131,9 +227,13 @@ static error_t parse_opt(int key, char* arg, argp_state* state)
 		break;
 
 		case ARGP_KEY_END:
-			if (state->arg_num < 1 || args->file.empty() ||
-			    args->mode == arguments::unknown) argp_usage(state);
-			else if (args->local.empty()) args->local = args->file;
+			if (args->mode == arguments::list) break; // Przedrostek jest opcjonalny
+			else if (state->arg_num < 1 || args->file.empty() ||
+				    args->mode == arguments::unknown) argp_usage(state);
+			else if (args->resume && (args->sparse || !args->socket.empty()))
+				argp_error(state, "--resume is not supported with --sparse or --unix");
+			else if (args->local.empty())
+				args->local = args->mode == arguments::mget ? "." : args->file;
 		break;
 
 		default: return ARGP_ERR_UNKNOWN;
@@ -144,6 +244,47 @@ static error_t parse_opt(int key, char* arg, argp_state* state)
 //! Struktura konfiguracji argp
 static struct argp argp = { options, parse_opt, args_doc, doc };
 
+/*! \brief Wyświetlenie metadanych pliku.
+ *  \param [in] name Nazwa pliku.
+ *  \param [in] entry Metadane pliku.
+ *
+ *  Wypisuje rozmiar, czas modyfikacji, skrót (jeśli jest znany) i nazwę pliku.
+ *
+ */
+static void print_entry(const string& name, const INDEX::ENTRY& entry)
+{
+	const time_t sec = entry.mtime / 1000000000;
+	char date[32], hash[20] = "-";
+	tm local;
+
+	strftime(date, sizeof(date), "%F %T", localtime_r(&sec, &local));
+
+	if (entry.hashed) snprintf(hash, sizeof(hash), "%016llx", (unsigned long long) entry.hash);
+
+	printf("%12llu  %s  %-16s  %s\n", (unsigned long long) entry.size, date, hash, name.c_str());
+}
+
+/*! \brief Wyświetlenie wyniku przesyłania.
+ *  \returns Kod błędu programu.
+ *  \param [in] result Wynik operacji.
+ *
+ *  Wypisuje liczbę przesłanych bajtów, czas i przepustowość lub przyczynę błędu.
+ *
+ */
+static int print_transfer(const CLIENT::TRANSFER& result)
+{
+	if (!result.ok())
+	{
+		cout << "Transfer failed:\t" << result.what() << '\n';
+		return -3;
+	}
+
+	cout << "Transferred data:\t" << result.bytes << " B in " << result.seconds << " s ("
+		<< result.throughput / (1 << 20) << " MiB/s)\n";
+
+	return 0;
+}
+
 /*! \brief Funkcja główna programu klienta.
  *  \returns Kod błędu.
  *  \param [in] argc Liczba argumentów.
@@ -159,22 +300,116 @@ int main(int argc, char* argv[])
 	{
 		.mode = arguments::unknown,
 		.host = "localhost",
-		.port = 8080
+		.port = 8080,
+		.writers = 4,
+		.connections = 4,
+		.skip = false,
+		.sparse = false,
+		.follow = false,
+		.resume = false,
+		.binary = false
 	};
 
 	// Przetwórz argumenty
 	argp_parse(&argp, argc, argv, 0, 0, &args);
 
+	// Drzewo katalogów wysyłane jest przez własną pulę połączeń
+	if (args.mode == arguments::recursive)
+	{
+		DIRSYNC sync(args.host, args.port, args.connections, args.skip);
+		sync.set_profile(args.profile);
+
+		return sync.run(args.file) ? 0 : -3;
+	}
+
+	// Manifest wykonywany jest przez pulę wątków i połączeń
+	else if (args.mode == arguments::batch)
+	{
+		BATCH batch(args.host, args.port, args.connections);
+		batch.set_profile(args.profile);
+
+		vector<BATCH::TASK> tasks;
+		ifstream file;
+		size_t line(0);
+
+		if (args.file != "-") file.open(args.file);
+
+		if (args.file != "-" && !file.is_open())
+		{
+			cerr << "Cannot open manifest:\t" << args.file << '\n';
+			return -1;
+		}
+		else if (!BATCH::parse(args.file == "-" ? cin : file, tasks, line))
+		{
+			cerr << "Invalid manifest line:\t" << line << '\n';
+			return -1;
+		}
+
+		return batch.run(tasks) ? 0 : -3;
+	}
+
 	CLIENT cli; // Utwórz klienta
+	cli.set_profile(args.profile);
+	cli.set_framing(args.binary);
+
+	// Wznawiane pobieranie zaczyna się od końca lokalnego pliku
+	error_code ec;
+	const uint64_t offset = args.resume ? filesystem::file_size(args.local, ec) : 0;
+
+	// Połączenie lokalne przekazuje pliki przez deskryptory
+	const bool local = !args.socket.empty();
 
 	// Nawiąż połączenie i wykonaj akcję
-	if (cli.connect(args.host, args.port)) switch (args.mode)
+	if (local ? cli.connect_unix(args.socket) : cli.connect(args.host, args.port)) switch (args.mode)
 	{
 		case arguments::download:
-			cli.download(args.file, args.local);
-		break;
+			return print_transfer(local ? cli.download_fd(args.file, args.local) :
+							 args.follow ? cli.follow(args.file, args.local, ec ? 0 : offset) :
+							 args.sparse ? cli.download_sparse(args.file, args.local) :
+									cli.download(args.file, args.local, ec ? 0 : offset));
 		case arguments::upload:
-			cli.upload(args.file, args.local);
+			return print_transfer(local ? cli.upload_fd(args.file, args.local) :
+							 args.sparse ? cli.upload_sparse(args.file, args.local) :
+									cli.upload(args.file, args.local));
+		case arguments::sync:
+			return print_transfer(cli.sync(args.file, args.local));
+		case arguments::dedup:
+			return print_transfer(cli.dedup(args.file, args.local));
+		case arguments::list:
+		{
+			vector<pair<string, INDEX::ENTRY>> files;
+
+			// Wypisz listę po zakończeniu komunikatów o postępie
+			if (cli.list(args.file, [&files] (const string& name, const INDEX::ENTRY& entry)
+			{
+				files.push_back({ name, entry });
+			}) < 0) return -3;
+
+			for (const auto& f : files) print_entry(f.first, f.second);
+		}
+		break;
+		case arguments::mget:
+			if (args.file == "-")
+			{
+				vector<string> names;
+				string line;
+
+				// Wczytaj nazwy plików ze standardowego wejścia
+				while (getline(cin, line)) if (!line.empty()) names.push_back(line);
+
+				if (cli.mget(names, args.local, args.writers) < 0) return -3;
+			}
+			else if (cli.mget(args.file, args.local, args.writers) < 0) return -3;
+		break;
+		case arguments::stat:
+		{
+			INDEX::ENTRY entry;
+			const int rc = cli.stat(args.file, entry);
+
+			if (rc < 0) return -3;
+			else if (rc == 0) cout << "No such file:\t\t" << args.file << '\n';
+			else print_entry(args.file, entry);
+		}
 		break;
 		default: return -2;
 	}
@@ -0,0 +1,204 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik main narzędzia migracji.
+ *  \file
+ *
+ *  Zawiera narzędzie przenoszące pliki serwera TPK pomiędzy układami przechowywania.
+ *
+ */
+
+#include "layout.hpp"
+
+#include <iostream>
+#include <set>
+
+#include <argp.h>
+
+//! Wersja programu dla argp
+const char* argp_program_version = "TPK Migrate 1.0";
+
+//! Email zgłoszenia błędu dla argp
+const char* argp_program_bug_address = "<lukasz.drozdz@polsl.pl>";
+
+//! Opis programu dla argp
+static char doc[] = "Storage layout migration tool for TPK project";
+
+//! Opis parametrów dla argp
+static char args_doc[] = "[DIR]";
+
+//! Struktura parametrów dla argp
+static struct argp_option options[] =
+{
+	{ "to",		't',	"SPEC",	0, "Target layout (flat, sharded, sharded:2)" },
+	{ 0 }
+};
+
+/*! \brief Struktura opisująca argumenty.
+ *  \see parse_opt.
+ *
+ *  Przechowuje wartości wszystkich argumentów programu w wygodnej do użytku formie.
+ *  Jest uzupełniana przez odpowiednią funkcję podczas parsowania argumentów.
+ *
+ */
+struct arguments
+{
+	string dir = "."; //!< Katalog roboczy serwera.
+	string to; //!< Docelowy układ.
+};
+
+/*! \brief Funkcja przetwarzająca argumenty.
+ *  \see arguments.
+ *  \returns Kod błędu.
+ *  \param [in] key Kod argumentu.
+ *  \param [in] arg Wartość argumentu.
+ *  \param [in] state Stan argp.
+ *
+ *  Przetwarza surowe argumenty i na ich podstawie uzupełnia pola struktury z danymi.
+ *
+ */
+static error_t parse_opt(int key, char* arg, argp_state* state)
+{
+	struct arguments* args = (arguments*) state->input;
+
+	switch (key)
+	{
+		case 't':
+			args->to = arg;
+			if (!LAYOUT::make(args->to)) argp_usage(state);
+		break;
+
+		case ARGP_KEY_ARG:
+			if (state->arg_num == 0) args->dir = arg;
+			else argp_usage(state);
+		break;
+
+		case ARGP_KEY_END:
+			if (args->to.empty()) argp_usage(state);
+		break;
+
+		default: return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+//! Struktura konfiguracji argp
+static struct argp argp = { options, parse_opt, args_doc, doc };
+
+/*! \brief Funkcja główna narzędzia migracji.
+ *  \returns Kod błędu.
+ *  \param [in] argc Liczba argumentów.
+ *  \param [in] argv Lista argumentów.
+ *
+ *  Przenosi pliki z bieżącego układu katalogu (odczytanego ze znacznika) do
+ *  układu docelowego. Znacznik zapisywany jest na końcu, dzięki czemu przerwaną
+ *  migrację można bezpiecznie powtórzyć.
+ *
+ */
+int main(int argc, char* argv[]);
+
+int main(int argc, char* argv[])
+{
+	struct arguments args; // Wartości parametrów
+
+	// Przetwórz argumenty
+	argp_parse(&argp, argc, argv, 0, 0, &args);
+
+	const string stored = LAYOUT::detect(args.dir);
+
+	auto src = LAYOUT::make(stored.empty() ? "flat" : stored);
+	auto dst = LAYOUT::make(args.to);
+
+	cout << "Opening layouts...\t";
+
+	if (!src || !src->open(args.dir) || !dst->open(args.dir))
+	{
+		cout << "FAIL\n";
+		return -1;
+	}
+	else cout << src->spec() << " -> " << dst->spec() << '\n';
+
+	if (src->spec() == dst->spec())
+	{
+		cout << "Nothing to do\n";
+		return 0;
+	}
+
+	vector<pair<string, string>> files; // Ścieżki i nazwy plików
+
+	cout << "Scanning files...\t";
+
+	// Najpierw zbierz listę - katalogi nie są zmieniane podczas przeglądu
+	for (const auto& dir : src->directories())
+		src->scan(dir, [&files] (const string& path, const string& name)
+		{
+			files.push_back({ path, name });
+		});
+
+	cout << files.size() << '\n';
+
+	size_t moved(0), failed(0);
+
+	cout << "Moving files...\t\t";
+
+	for (const auto& [path, name] : files)
+	{
+		const string target = dst->path(name);
+
+		if (target == path) continue;
+		else if (::rename(src->full(path).c_str(), src->full(target).c_str()) == 0) ++moved;
+		else ++failed;
+	}
+
+	cout << moved << " moved, " << failed << " failed\n";
+
+	if (failed)
+	{
+		cout << "Migration incomplete, run again\n";
+		return -1;
+	}
+
+	// Usuń puste katalogi poprzedniego układu (poza katalogami nowego)
+	const auto keep = dst->directories();
+	const set<string> used(keep.begin(), keep.end());
+
+	for (const auto& dir : src->directories())
+	{
+		const size_t slash = dir.find('/');
+
+		if (dir == "." || used.count(dir)) continue;
+
+		::rmdir(src->full(dir).c_str());
+
+		if (slash != string::npos && !used.count(dir.substr(0, slash)))
+			::rmdir(src->full(dir.substr(0, slash)).c_str());
+	}
+
+	cout << "Writing marker...\t";
+
+	if (!LAYOUT::mark(args.dir, dst->spec()))
+	{
+		cout << "FAIL\n";
+		return -1;
+	}
+	else cout << "OK\n";
+
+	return 0;
+}
@@ -27,8 +27,235 @@
 
 #include "server.hpp"
 
+#include <stdlib.h>
+#include <limits.h>
+#include <ctype.h>
+#include <errno.h>
+#include <argp.h>
+
+//! Wersja programu dla argp
+const char* argp_program_version = "TPK Server 1.0";
+
+//! Email zgłoszenia błędu dla argp
+const char* argp_program_bug_address = "<lukasz.drozdz@polsl.pl>";
+
+//! Opis programu dla argp
+static char doc[] = "Server program for TPK project";
+
+//! Struktura parametrów dla argp
+static struct argp_option options[] =
+{
+	{ "store",	's',	"DIR",	0, "Store uploads in deduplicated chunk store" },
+	{ "layout",	'L',	"SPEC",	0, "Storage layout (flat, sharded, sharded:2), default from marker" },
+	{ "cache",	'c',	"MB",	0, "Cache hot files in memory (budget in MiB)" },
+	{ "shared",	'f',	0,		0, "Share read-ahead buffers between concurrent downloads" },
+	{ "index",	'i',	"hash",	OPTION_ARG_OPTIONAL, "Keep metadata index for LIST/STAT (=hash adds checksums)" },
+	{ "profile",	'P',	"SPEC",	0, "Socket tuning profile (default, bulk, latency)[,option=value...]" },
+	{ "unix",		'u',	"PATH",	0, "Also listen on local socket (@name for abstract namespace)" },
+	{ "listen",	'l',	"ADDR:PORT",	0, "Listen on address, may be repeated ([v6]:port, *:port for dual-stack)" },
+	{ "replica",	'r',	"ADDR:PORT",	0, "Replicate uploads to peer, may be repeated to form a chain" },
+	{ "backend",	'b',	"ADDR:PORT",	0, "Run as proxy sharding sessions across backends, may be repeated" },
+	{ "handoff",	'H',	"PATH",	0, "Hand listening sockets to a replacement process over local socket" },
+	{ "takeover",	'T',	"PATH",	0, "Take listening sockets over from a running server instead of binding" },
+	{ "grace",	'g',	"SECONDS",	0, "Time limit for draining active transfers (SIGQUIT or handoff, default 30)" },
+	{ "fixed-chunks",	'F',	0,		0, "Use fixed 64 KiB I/O chunks instead of sizing them per connection" },
+	{ "max-connections",	'C',	"N",		0, "Defer accepting connections above this number" },
+	{ "max-files",	'O',	"N",		0, "Queue requests while connections hold this many open files" },
+	{ "max-buffers",	'M',	"MB",	0, "Pause receiving uploads while connection buffers exceed this size" },
+	{ "trace",	't',	"FILE",	0, "Write session latency traces in Chrome trace-event JSON" },
+	{ "sample",	'S',	"N",		0, "Trace every N-th session (default is 1, with --trace)" },
+	{ 0 }
+};
+
+/*! \brief Struktura opisująca argumenty.
+ *  \see parse_opt.
+ *
+ *  Przechowuje wartości wszystkich argumentów programu w wygodnej do użytku formie.
+ *  Jest uzupełniana przez odpowiednią funkcję podczas parsowania argumentów.
+ *
+ */
+struct arguments
+{
+	string store; //!< Katalog magazynu fragmentów.
+	string layout; //!< Układ przechowywania plików.
+	size_t cache = 0; //!< Limit pamięci podręcznej w MiB.
+	bool shared = false; //!< Współdzielony odczyt plików.
+	int index = 0; //!< Indeks metadanych (`0` - brak, `1` - włączony, `2` - ze skrótami).
+	SOCKBASE::PROFILE profile; //!< Profil strojenia gniazd.
+	string socket; //!< Ścieżka gniazda lokalnego.
+	vector<pair<string, uint16_t>> listen; //!< Adresy nasłuchiwania.
+	vector<pair<string, uint16_t>> replicas; //!< Węzły łańcucha replikacji.
+	vector<pair<string, uint16_t>> backends; //!< Serwery docelowe trybu pośrednika.
+	string handoff; //!< Ścieżka gniazda przekazywania.
+	string takeover; //!< Ścieżka gniazda przekazywania działającego serwera.
+	unsigned grace = 30; //!< Maksymalny czas wygaszania w sekundach.
+	bool fixed = false; //!< Stały rozmiar porcji.
+	SERVER::LIMITS limits; //!< Limity zasobów.
+	string trace; //!< Ścieżka pliku zdarzeń śledzenia.
+	unsigned sample = 1; //!< Śledzona co `sample` sesja.
+};
+
+/*! \brief Odczyt liczby argumentu.
+ *  \returns `false` gdy argument nie jest liczbą dziesiętną z zakresu `[0, max]`.
+ *  \param [in] arg Wartość argumentu.
+ *  \param [out] value Odczytana liczba.
+ *  \param [in] max Największa dozwolona wartość.
+ *
+ */
+static bool parse_number(const char* arg, size_t& value, size_t max)
+{
+	char* end = nullptr;
+
+	// `strtoull` akceptuje znak minus - zaneguje on wtedy wartość
+	if (!isdigit((unsigned char) arg[0])) return false;
+
+	errno = 0;
+	const unsigned long long number = strtoull(arg, &end, 10);
+
+	if (errno || *end || number > max) return false;
+
+	value = number;
+
+	return true;
+}
+
+/*! \brief Funkcja przetwarzająca argumenty.
+ *  \see arguments.
+ *  \returns Kod błędu.
+ *  \param [in] key Kod argumentu.
+ *  \param [in] arg Wartość argumentu.
+ *  \param [in] state Stan argp.
+ *
+ *  Przetwarza surowe argumenty i na ich podstawie uzupełnia pola struktury z danymi.
+ *
+ */
+static error_t parse_opt(int key, char* arg, argp_state* state)
+{
+	struct arguments* args = (arguments*) state->input;
+
+	switch (key)
+	{
+		case 's':
+			args->store = arg;
+			if (args->store.empty()) argp_usage(state);
+		break;
+
+		case 'L':
+			args->layout = arg;
+			if (!LAYOUT::make(args->layout)) argp_usage(state);
+		break;
+
+		case 'c':
+			args->cache = atoi(arg);
+			if (!args->cache) argp_usage(state);
+		break;
+
+		case 'f':
+			args->shared = true;
+		break;
+		case 'i':
+			if (arg && strcmp(arg, "hash") != 0) argp_usage(state);
+			else args->index = arg ? 2 : 1;
+		break;
+
+		case 'P':
+			if (!SOCKBASE::PROFILE::parse(arg, args->profile)) argp_usage(state);
+		break;
+
+		case 'u':
+			args->socket = arg;
+			if (args->socket.empty()) argp_usage(state);
+		break;
+
+		case 'l':
+		{
+			pair<string, uint16_t> ep;
+
+			if (!SOCKBASE::split_endpoint(arg, ep.first, ep.second)) argp_usage(state);
+			else args->listen.push_back(ep);
+		}
+		break;
+
+		case 'r':
+		{
+			pair<string, uint16_t> ep;
+
+			if (!SOCKBASE::split_endpoint(arg, ep.first, ep.second)) argp_usage(state);
+			else args->replicas.push_back(ep);
+		}
+		break;
+
+		case 'b':
+		{
+			pair<string, uint16_t> ep;
+
+			if (!SOCKBASE::split_endpoint(arg, ep.first, ep.second)) argp_usage(state);
+			else args->backends.push_back(ep);
+		}
+		break;
+
+		case 'H':
+			args->handoff = arg;
+			if (args->handoff.empty()) argp_usage(state);
+		break;
+
+		case 'T':
+			args->takeover = arg;
+			if (args->takeover.empty()) argp_usage(state);
+		break;
+
+		case 'g':
+		{
+			size_t grace;
+
+			if (!parse_number(arg, grace, UINT_MAX)) argp_usage(state);
+			else args->grace = grace;
+		}
+		break;
+		case 'F':
+			args->fixed = true;
+		break;
+		case 'C':
+			if (!parse_number(arg, args->limits.connections, SIZE_MAX)) argp_usage(state);
+		break;
+		case 'O':
+			if (!parse_number(arg, args->limits.files, SIZE_MAX)) argp_usage(state);
+		break;
+		case 'M':
+			if (!parse_number(arg, args->limits.buffers, SIZE_MAX >> 20)) argp_usage(state);
+			else args->limits.buffers <<= 20;
+		break;
+		case 't':
+			args->trace = arg;
+		break;
+		case 'S':
+			args->sample = atoi(arg);
+		break;
+
+		case ARGP_KEY_ARG:
+			argp_usage(state);
+		break;
+
+		default: return ARGP_ERR_UNKNOWN;
+	}
+	return 0;
+}
+
+//! Struktura konfiguracji argp
+static struct argp argp = { options, parse_opt, 0, doc };
+
 static SERVER* srv; //!< Obiekt serwera.
 
+/*! \brief Uruchomienie nasłuchiwania.
+ *  \returns Powodzenie operacji.
+ *  \param [in] listen Lista adresów nasłuchiwania.
+ *
+ *  Uruchamia serwer na pierwszym adresie (lub domyślnym, gdy lista jest pusta)
+ *  i dodaje gniazda nasłuchujące dla pozostałych adresów.
+ *
+ */
+static bool start_all(const vector<pair<string, uint16_t>>& listen);
+
 /*! \brief Funkcja obsługująca sygnały.
  *  \param [in] signal Kod sygnału.
  *
@@ -42,22 +269,44 @@ void handler(int);
  *  \param [in] argc Liczba argumentów.
  *  \param [in] argv Lista argumentów.
  *
- *  Rejestruje obsługę zdarzeń i uruchamia serwer.
+ *  Przetwarza parametry, rejestruje obsługę zdarzeń i uruchamia serwer.
  *
  */
 int main(int argc, char* argv[]);
 
 int main(int argc, char* argv[])
 {
+	struct arguments args; // Wartości parametrów
+
+	// Przetwórz argumenty
+	argp_parse(&argp, argc, argv, 0, 0, &args);
+
 	// Utworzenie serwera
 	srv = new SERVER();
+	srv->set_profile(args.profile);
+	srv->set_grace(args.grace);
+	srv->set_pacing(!args.fixed);
+	srv->set_limits(args.limits);
 
 	// Rejestracja obsługi sygnałów przez funkcję `handler`
 	signal(SIGABRT, handler); // Błąd krytyczny (np. libc)
 	signal(SIGINT, handler); // Kombinacja CTRL+C w terminalu
 	signal(SIGTERM, handler); // Proces zakończony (np. kill)
+	signal(SIGQUIT, handler); // Wygaszenie serwera (zakończenie aktywnych transferów)
+	signal(SIGPIPE, SIG_IGN); // Zapis do zamkniętego połączenia (`splice` nie przyjmuje `MSG_NOSIGNAL`)
 
-	if (!srv->start()) cout << "FAIL\n";
+	if (!srv->use_layout(args.layout)) cout << "FAIL\n";
+	else if (!args.store.empty() && !srv->use_store(args.store)) cout << "FAIL\n";
+	else if (args.cache && !srv->use_cache(args.cache << 20)) cout << "FAIL\n";
+	else if (args.shared && !srv->use_shared()) cout << "FAIL\n";
+	else if (args.index && !srv->use_index(args.index == 2)) cout << "FAIL\n";
+	else if (!args.trace.empty() && !srv->use_tracing(args.trace, args.sample)) cout << "FAIL\n";
+	else if (!args.replicas.empty() && !srv->use_replicas(args.replicas)) cout << "FAIL\n";
+	else if (!args.backends.empty() && !srv->use_backends(args.backends)) cout << "FAIL\n";
+	else if (!args.takeover.empty() && !srv->takeover(args.takeover)) cout << "FAIL\n";
+	else if (args.takeover.empty() && !start_all(args.listen)) cout << "FAIL\n";
+	else if (args.takeover.empty() && !args.socket.empty() && !srv->start_unix(args.socket)) cout << "FAIL\n";
+	else if (!args.handoff.empty() && !srv->start_handoff(args.handoff)) cout << "FAIL\n";
 	else while (srv->loop());
 
 	delete srv;
@@ -65,7 +314,19 @@ int main(int argc, char* argv[])
 	return 0;
 }
 
+static bool start_all(const vector<pair<string, uint16_t>>& listen)
+{
+	if (listen.empty()) return srv->start();
+	else if (!srv->start(listen[0].first, listen[0].second)) return false;
+
+	for (size_t i = 1; i < listen.size(); ++i)
+		if (!srv->add_listener(listen[i].first, listen[i].second)) return false;
+
+	return true;
+}
+
 void handler(int signal)
 {
-	srv->end(signal); // Zakończ pętlę główną
+	if (signal == SIGQUIT) srv->drain(signal); // Wygaś serwer
+	else srv->end(signal); // Zakończ pętlę główną
 }
@@ -0,0 +1,99 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy doboru rozmiaru porcji.
+ *  \file
+ *
+ */
+
+#include "pacer.hpp"
+
+void PACER::sent(int sock, STATE& state, size_t size, ssize_t done, bool tune)
+{
+	tcp_info info;
+	bool tcp;
+
+	if (done < 0) return;
+
+	// Niepełne wysłanie oznacza pełny bufor - nadmiar odczytu był zbędny
+	if (size_t(done) < size) state.chunk = max<size_t>(min_chunk, state.chunk / 2);
+
+	if (!due(sock, state, info, tcp)) return;
+
+	int queued = 0, space = 0;
+	socklen_t len = sizeof(space);
+
+	// Jądro podwaja rozmiar bufora na potrzeby narzutu - dane zajmują połowę
+	if (::ioctl(sock, SIOCOUTQ, &queued) == 0 &&
+	    ::getsockopt(sock, SOL_SOCKET, SO_SNDBUF, &space, &len) == 0 &&
+	    space / 2 - queued >= int(2 * state.chunk))
+		state.chunk = min<size_t>(max_chunk, state.chunk * 2);
+
+	// W locie może być najwyżej okno przeciążenia
+	if (tune && tcp) allot(sock, SO_SNDBUF, state, uint64_t(info.tcpi_snd_cwnd) * info.tcpi_snd_mss);
+}
+
+void PACER::received(int sock, STATE& state, ssize_t done, bool tune)
+{
+	tcp_info info;
+	bool tcp;
+
+	if (done <= 0 || !due(sock, state, info, tcp)) return;
+
+	int queued = 0;
+
+	// Zaległe dane w buforze odbiorczym - odbieraj większymi porcjami
+	if (::ioctl(sock, SIOCINQ, &queued) == 0 && size_t(queued) >= state.chunk)
+		state.chunk = min<size_t>(max_chunk, state.chunk * 2);
+
+	// Jądro szacuje ilość danych odbieranych w czasie obiegu
+	if (tune && tcp) allot(sock, SO_RCVBUF, state, info.tcpi_rcv_space);
+}
+
+bool PACER::due(int sock, STATE& state, tcp_info& info, bool& tcp)
+{
+	if (++state.ops < period) return false;
+
+	const auto now = chrono::steady_clock::now();
+
+	if (now - state.sample < chrono::microseconds(state.rtt)) return false;
+
+	socklen_t len = sizeof(info);
+
+	tcp = ::getsockopt(sock, IPPROTO_TCP, TCP_INFO, &info, &len) == 0;
+
+	state.rtt = tcp ? info.tcpi_rtt : 0;
+	state.sample = now;
+	state.ops = 0;
+
+	return true;
+}
+
+void PACER::allot(int sock, int option, STATE& state, uint64_t target)
+{
+	const int size = clamp<uint64_t>(2 * target, min_buffer, max_buffer);
+
+	// Ustawienie bufora wyłącza jego automatyczne strojenie przez jądro,
+	// więc zmieniaj go jedynie przy znaczącej różnicy
+	if (state.buffer && size <= int(state.buffer + state.buffer / 4) &&
+	    size + size / 4 >= int(state.buffer)) return;
+
+	if (::setsockopt(sock, SOL_SOCKET, option, &size, sizeof(size)) == 0) state.buffer = size;
+}
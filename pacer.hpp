@@ -0,0 +1,128 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy doboru rozmiaru porcji.
+ *  \file
+ *
+ */
+
+#ifndef PACER_HPP
+#define PACER_HPP
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <linux/sockios.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+/*! \brief Klasa doboru rozmiaru porcji.
+ *
+ *  Dobiera dla każdego połączenia rozmiar porcji odczytu i zapisu oraz rozmiar
+ *  bufora gniazda na podstawie informacji z jądra. Niepełne wysłanie zmniejsza
+ *  porcję o połowę, a wolne miejsce w buforze nadawczym (`SIOCOUTQ`) lub
+ *  zaległe dane w buforze odbiorczym (`SIOCINQ`) ją podwajają. Bufor gniazda
+ *  dopasowywany jest do dwukrotności iloczynu przepustowości i opóźnienia
+ *  (`TCP_INFO`: okno przeciążenia lub oszacowanie okna odbiorczego), dzięki
+ *  czemu wolne połączenia nie zajmują dużych buforów.
+ *
+ *  Jądro odpytywane jest co `period` operacji, lecz nie częściej niż raz na czas
+ *  obiegu (RTT) - w tym czasie okno przeciążenia i tak się nie zmienia.
+ *
+ */
+class PACER
+{
+
+	public:
+
+		static constexpr size_t min_chunk = 1 << 12; //!< Najmniejszy rozmiar porcji.
+		static constexpr size_t max_chunk = 1 << 20; //!< Największy rozmiar porcji.
+		static constexpr size_t initial = 1 << 16; //!< Początkowy rozmiar porcji.
+
+		static constexpr int min_buffer = 1 << 16; //!< Najmniejszy rozmiar bufora gniazda.
+		static constexpr int max_buffer = 1 << 22; //!< Największy rozmiar bufora gniazda.
+
+		static constexpr unsigned period = 16; //!< Liczba operacji między odczytami stanu gniazda.
+
+		/*! \brief Stan połączenia.
+		 *
+		 *  Bieżąca porcja i bufor gniazda wraz z chwilą ostatniego pomiaru.
+		 *
+		 */
+		struct STATE
+		{
+			uint32_t chunk = initial; //!< Rozmiar porcji.
+			uint32_t buffer = 0; //!< Ustawiony rozmiar bufora gniazda (`0` - ustawienia systemu).
+			uint32_t rtt = 0; //!< Ostatni czas obiegu w µs.
+			uint32_t ops = 0; //!< Liczba operacji od ostatniego pomiaru.
+
+			chrono::steady_clock::time_point sample; //!< Chwila ostatniego pomiaru.
+		};
+
+		/*! \brief Wysłanie porcji.
+		 *  \param [in] sock Gniazdo połączenia.
+		 *  \param [in,out] state Stan połączenia.
+		 *  \param [in] size Liczba danych przekazanych do wysłania.
+		 *  \param [in] done Wynik funkcji `send`.
+		 *  \param [in] tune Dopasowywanie bufora nadawczego (`SO_SNDBUF`).
+		 *
+		 */
+		static void sent(int sock, STATE& state, size_t size, ssize_t done, bool tune);
+
+		/*! \brief Odbiór porcji.
+		 *  \param [in] sock Gniazdo połączenia.
+		 *  \param [in,out] state Stan połączenia.
+		 *  \param [in] done Wynik funkcji `recv`.
+		 *  \param [in] tune Dopasowywanie bufora odbiorczego (`SO_RCVBUF`).
+		 *
+		 */
+		static void received(int sock, STATE& state, ssize_t done, bool tune);
+
+	protected:
+
+		/*! \brief Test terminu pomiaru.
+		 *  \returns `true` gdy minęło `period` operacji i co najmniej jeden czas obiegu.
+		 *  \param [in] sock Gniazdo połączenia.
+		 *  \param [in,out] state Stan połączenia.
+		 *  \param [out] info Stan połączenia TCP.
+		 *  \param [out] tcp Powodzenie odczytu `TCP_INFO` (gniazda lokalne go nie mają).
+		 *
+		 */
+		static bool due(int sock, STATE& state, tcp_info& info, bool& tcp);
+
+		/*! \brief Przydział bufora gniazda.
+		 *  \param [in] sock Gniazdo połączenia.
+		 *  \param [in] option Opcja bufora (`SO_SNDBUF` lub `SO_RCVBUF`).
+		 *  \param [in,out] state Stan połączenia.
+		 *  \param [in] target Szacowany iloczyn przepustowości i opóźnienia.
+		 *
+		 */
+		static void allot(int sock, int option, STATE& state, uint64_t target);
+
+};
+
+#endif // PACER_HPP
@@ -0,0 +1,110 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy potokowego przesyłania danych.
+ *  \file
+ *
+ */
+
+#include "pipeline.hpp"
+
+int64_t PIPELINE::run(const SOURCE& source, const SINK& sink, uint64_t limit, size_t block, unsigned count)
+{
+	count = max(2u, count);
+
+	vector<vector<char>> buffers(count, vector<char>(block));
+	vector<ssize_t> sizes(count, 0); // Liczba danych w buforach
+
+	mutex lock; // Blokada stanu pierścienia
+	condition_variable changed; // Zmiana stanu pierścienia
+	size_t filled(0), drained(0); // Liczniki wypełnionych i opróżnionych buforów
+	bool failed = false; // Flaga błędu odbiorcy
+
+	// Wątek źródła wypełnia kolejne wolne bufory
+	thread reader([&] (void)
+	{
+		uint64_t total(0);
+
+		for (size_t i = 0;; ++i)
+		{
+			{
+				unique_lock<mutex> guard(lock);
+
+				changed.wait(guard, [&] (void) { return failed || i - drained < count; });
+
+				if (failed) return;
+			}
+
+			auto& buff = buffers[i % count];
+			ssize_t rc(0);
+
+			if (total < limit) rc = source(buff.data(), min<uint64_t>(block, limit - total));
+
+			if (rc > 0) total += rc;
+
+			{
+				lock_guard<mutex> guard(lock);
+
+				sizes[i % count] = rc;
+				filled = i + 1;
+			}
+
+			changed.notify_all();
+
+			// Koniec danych lub błąd kończy wątek źródła
+			if (rc <= 0) return;
+		}
+	});
+
+	int64_t total(0);
+
+	// Wątek wywołujący opróżnia bufory w kolejności wypełniania
+	for (size_t i = 0;; ++i)
+	{
+		ssize_t size;
+
+		{
+			unique_lock<mutex> guard(lock);
+
+			changed.wait(guard, [&] (void) { return filled > i; });
+
+			size = sizes[i % count];
+		}
+
+		if (size < 0) total = -1;
+		else if (size > 0 && !sink(buffers[i % count].data(), size)) total = -1;
+		else total += size;
+
+		{
+			lock_guard<mutex> guard(lock);
+
+			drained = i + 1;
+			failed = total < 0;
+		}
+
+		changed.notify_all();
+
+		if (size <= 0 || total < 0) break;
+	}
+
+	reader.join();
+
+	return total;
+}
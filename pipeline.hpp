@@ -0,0 +1,79 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy potokowego przesyłania danych.
+ *  \file
+ *
+ */
+
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <sys/types.h>
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <mutex>
+
+using namespace std;
+
+/*! \brief Klasa potokowego przesyłania danych.
+ *
+ *  Przesyła dane pomiędzy źródłem a odbiorcą przez pierścień kilku dużych buforów.
+ *  Źródło wypełnia kolejne bufory w osobnym wątku, a odbiorca opróżnia je w
+ *  wątku wywołującym, dzięki czemu operacje dyskowe i sieciowe wykonywane są
+ *  równocześnie. Stosowana tam, gdzie niedostępne jest przesyłanie bez kopiowania.
+ *
+ */
+class PIPELINE
+{
+
+	public:
+
+		using SOURCE = function<ssize_t(char*, size_t)>; //!< Źródło: liczba bajtów, `0` na końcu lub `-1` w przypadku błędu.
+		using SINK = function<bool(const char*, size_t)>; //!< Odbiorca: powodzenie zapisu.
+
+		static constexpr size_t block_size = 1 << 20; //!< Domyślny rozmiar bufora.
+		static constexpr unsigned depth = 3; //!< Domyślna liczba buforów.
+
+		/*! \brief Przesłanie danych.
+		 *  \returns Liczba przesłanych bajtów lub `-1` w przypadku błędu.
+		 *  \param [in] source Źródło danych.
+		 *  \param [in] sink Odbiorca danych.
+		 *  \param [in] limit Maksymalna liczba bajtów.
+		 *  \param [in] block Rozmiar bufora.
+		 *  \param [in] count Liczba buforów.
+		 *
+		 *  Przesyła dane do końca źródła lub do osiągnięcia limitu.
+		 *
+		 */
+		static int64_t run(const SOURCE& source, const SINK& sink,
+					    uint64_t limit = UINT64_MAX,
+					    size_t block = block_size,
+					    unsigned count = depth);
+
+};
+
+#endif // PIPELINE_HPP
@@ -0,0 +1,275 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy trybu pośrednika.
+ *  \file
+ *
+ */
+
+#include "proxy.hpp"
+
+PROXY::PROXY(void) {}
+
+PROXY::~PROXY(void)
+{
+	close(); // Zamknij połączenia z pul
+}
+
+bool PROXY::open(const vector<PEER>& backends)
+{
+	if (is_open() || backends.empty()) return false;
+
+	for (const auto& peer : backends)
+	{
+		BACKEND backend;
+		addrinfo hints = {};
+		addrinfo* res = nullptr;
+
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+
+		// Adres serwera rozwiązywany jest jednokrotnie
+		if (::getaddrinfo(peer.first.c_str(), to_string(peer.second).c_str(), &hints, &res) != 0)
+		{
+			m_backends.clear();
+
+			return false;
+		}
+
+		backend.peer = peer;
+		backend.len = res->ai_addrlen;
+		::memcpy(&backend.addr, res->ai_addr, res->ai_addrlen);
+		::freeaddrinfo(res);
+
+		m_backends.push_back(move(backend));
+	}
+
+	// Każdy serwer zajmuje wiele pozycji - nazwy rozkładają się równomiernie
+	for (unsigned i = 0; i < m_backends.size(); ++i)
+		for (unsigned k = 0; k < points; ++k)
+			m_ring.push_back({ hash(name(i) + '#' + to_string(k)), i });
+
+	sort(m_ring.begin(), m_ring.end());
+
+	m_stop = m_refill = false;
+	m_thread = thread(&PROXY::run, this);
+
+	return true;
+}
+
+void PROXY::close(void)
+{
+	if (m_thread.joinable())
+	{
+		{
+			lock_guard<mutex> lock(m_lock);
+			m_stop = true;
+		}
+
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+	for (auto& b : m_backends)
+		for (const int sock : b.idle) ::close(sock);
+
+	m_backends.clear();
+	m_ring.clear();
+}
+
+int PROXY::pick(const string& key)
+{
+	lock_guard<mutex> lock(m_lock);
+
+	if (m_ring.empty()) return -1;
+
+	auto p = lower_bound(m_ring.begin(), m_ring.end(), make_pair(hash(key), 0u));
+
+	// Pomiń niesprawne serwery - ich nazwy przejmują kolejne na pierścieniu
+	for (size_t i = 0; i < m_ring.size(); ++i, ++p)
+	{
+		if (p == m_ring.end()) p = m_ring.begin();
+		if (m_backends[p->second].up) return p->second;
+	}
+
+	return -1;
+}
+
+int PROXY::acquire(unsigned backend, bool& pending)
+{
+	{
+		lock_guard<mutex> lock(m_lock);
+		auto& idle = m_backends[backend].idle;
+
+		while (!idle.empty())
+		{
+			const int sock = idle.back();
+			idle.pop_back();
+
+			// Uzupełnij pulę, zanim zostanie opróżniona
+			if (idle.size() < pool / 2)
+			{
+				m_refill = true;
+				m_wake.notify_one();
+			}
+
+			if (is_alive(sock))
+			{
+				pending = false;
+				return sock;
+			}
+			else ::close(sock);
+		}
+
+		m_refill = true;
+	}
+
+	m_wake.notify_one();
+
+	// Pula jest pusta - nie blokuj pętli serwera oczekiwaniem na połączenie
+	pending = true;
+
+	return dial(m_backends[backend], false);
+}
+
+void PROXY::report(unsigned backend, bool ok)
+{
+	lock_guard<mutex> lock(m_lock);
+
+	m_backends[backend].up = ok;
+}
+
+string PROXY::name(unsigned backend) const
+{
+	const auto& peer = m_backends[backend].peer;
+
+	// Adresy IPv6 zapisuj w nawiasach
+	if (peer.first.find(':') != string::npos) return '[' + peer.first + "]:" + to_string(peer.second);
+	else return peer.first + ':' + to_string(peer.second);
+}
+
+bool PROXY::is_open(void) const
+{
+	return !m_backends.empty();
+}
+
+bool PROXY::routable(const string& command, const string& param)
+{
+	if (command == "LIST") return false;
+	else if (command != "MGET" && command != "MPUT") return true;
+
+	// Lista nazw (`-`) lub wzorzec mogą wskazywać pliki wielu serwerów
+	return param != "-" && param.find_first_of("*?[") == string::npos;
+}
+
+void PROXY::run(void)
+{
+	unique_lock<mutex> lock(m_lock);
+
+	while (!m_stop)
+	{
+		m_refill = false;
+
+		for (auto& b : m_backends)
+		{
+			// Usuń połączenia zamknięte przez serwer
+			b.idle.erase(remove_if(b.idle.begin(), b.idle.end(), [] (int sock)
+			{
+				if (is_alive(sock)) return false;
+
+				::close(sock);
+
+				return true;
+			}), b.idle.end());
+
+			const size_t need = pool - min(pool, b.idle.size());
+			vector<int> fresh;
+			bool ok = true;
+
+			// Nawiązuj połączenia bez blokady - pętla serwera korzysta z puli
+			lock.unlock();
+
+			while (ok && fresh.size() < need)
+			{
+				const int sock = dial(b, true);
+
+				if (sock == -1) ok = false;
+				else fresh.push_back(sock);
+			}
+
+			lock.lock();
+
+			// Serwer jest sprawny, gdy przyjmuje nowe połączenia
+			b.idle.insert(b.idle.end(), fresh.begin(), fresh.end());
+			b.up = ok;
+		}
+
+		m_wake.wait_for(lock, interval, [this] (void) { return m_stop || m_refill; });
+	}
+}
+
+int PROXY::dial(const BACKEND& backend, bool wait) const
+{
+	const int sock = ::socket(backend.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+	if (sock == -1) return -1;
+	else apply(sock, ROLE::Connecting); // Zastosuj profil strojenia
+
+	if (::connect(sock, (const sockaddr*) &backend.addr, backend.len) == 0) return sock;
+	else if (errno != EINPROGRESS) { ::close(sock); return -1; }
+	else if (!wait) return sock;
+
+	pollfd pfd = { sock, POLLOUT, 0 };
+	socklen_t len = sizeof(int);
+	int err = 0;
+
+	// Czekaj na połączenie najwyżej jeden okres sprawdzania
+	if (::poll(&pfd, 1, interval.count()) == 1 &&
+	    ::getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0) return sock;
+
+	::close(sock);
+
+	return -1;
+}
+
+bool PROXY::is_alive(int sock)
+{
+	pollfd pfd = { sock, POLLIN, 0 };
+
+	// Gotowość do odczytu bezczynnego połączenia oznacza jego zamknięcie
+	return ::poll(&pfd, 1, 0) == 0;
+}
+
+uint32_t PROXY::hash(const string& key)
+{
+	uint32_t h = 2166136261u; // FNV-1a
+
+	for (const char c : key)
+	{
+		h ^= uint8_t(c);
+		h *= 16777619u;
+	}
+
+	// Wymieszaj bity - podobne nazwy mają trafiać w odległe pozycje
+	h ^= h >> 16; h *= 0x85ebca6bu;
+	h ^= h >> 13; h *= 0xc2b2ae35u;
+
+	return h ^ (h >> 16);
+}
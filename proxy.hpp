@@ -0,0 +1,174 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy trybu pośrednika.
+ *  \file
+ *
+ */
+
+#ifndef PROXY_HPP
+#define PROXY_HPP
+
+#include "sockbase.hpp"
+
+#include <condition_variable>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <mutex>
+
+using namespace std;
+
+/*! \brief Klasa trybu pośrednika.
+ *
+ *  Wybiera serwer docelowy dla sesji na podstawie spójnego haszowania nazwy
+ *  pliku - każdy serwer zajmuje na pierścieniu `points` pozycji, a nazwa
+ *  trafia do pierwszego sprawnego serwera zgodnie z ruchem wskazówek zegara.
+ *  Dołączenie lub awaria serwera przenosi więc jedynie jego część nazw.
+ *
+ *  Wątek roboczy co `interval` sprawdza serwery i utrzymuje pulę nawiązanych
+ *  połączeń, dzięki czemu przekazanie sesji nie czeka na nawiązanie połączenia.
+ *
+ */
+class PROXY : public SOCKBASE
+{
+
+	public:
+
+		using PEER = pair<string, uint16_t>; //!< Adres i port serwera.
+
+		static constexpr unsigned points = 64; //!< Liczba pozycji serwera na pierścieniu.
+		static constexpr size_t pool = 4; //!< Liczba gotowych połączeń z każdym serwerem.
+		static constexpr chrono::milliseconds interval{ 1000 }; //!< Okres sprawdzania serwerów.
+
+	protected:
+
+		/*! \brief Opis serwera docelowego.
+		 *
+		 *  Adres serwera wraz z jego stanem i pulą połączeń.
+		 *
+		 */
+		struct BACKEND
+		{
+			PEER peer; //!< Adres i port serwera.
+
+			sockaddr_storage addr; //!< Rozwiązany adres serwera.
+			socklen_t len = 0; //!< Długość adresu.
+
+			vector<int> idle; //!< Gotowe połączenia.
+			bool up = true; //!< Stan serwera.
+		};
+
+		vector<BACKEND> m_backends; //!< Serwery docelowe.
+		vector<pair<uint32_t, unsigned>> m_ring; //!< Pozycje serwerów na pierścieniu.
+
+		thread m_thread; //!< Wątek sprawdzający serwery.
+		mutex m_lock; //!< Blokada stanu serwerów i pul połączeń.
+		condition_variable m_wake; //!< Powiadomienie wątku roboczego.
+		bool m_stop = false; //!< Flaga zakończenia pracy wątku.
+		bool m_refill = false; //!< Flaga uzupełnienia pul przed upływem okresu.
+
+	public:
+
+		explicit PROXY(void); //!< Konstruktor domyślny.
+		virtual ~PROXY(void) override; //!< Destruktor, zamyka połączenia z pul.
+
+		/*! \brief Uruchomienie pośrednika.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] backends Serwery docelowe.
+		 *
+		 *  Rozwiązuje adresy serwerów, buduje pierścień i uruchamia wątek roboczy.
+		 *
+		 */
+		bool open(const vector<PEER>& backends);
+
+		//! Zatrzymuje wątek roboczy i zamyka połączenia z pul.
+		void close(void);
+
+		/*! \brief Wybór serwera.
+		 *  \returns Numer serwera lub `-1`, gdy żaden serwer nie jest sprawny.
+		 *  \param [in] key Nazwa pliku.
+		 *
+		 */
+		int pick(const string& key);
+
+		/*! \brief Pobranie połączenia.
+		 *  \returns Deskryptor nieblokującego gniazda lub `-1` w przypadku błędu.
+		 *  \param [in] backend Numer serwera.
+		 *  \param [out] pending Flaga trwającego nawiązywania połączenia.
+		 *
+		 *  Pobiera połączenie z puli, a gdy pula jest pusta rozpoczyna nawiązywanie
+		 *  nowego - jego zakończenie sygnalizuje gotowość gniazda do zapisu.
+		 *
+		 */
+		int acquire(unsigned backend, bool& pending);
+
+		/*! \brief Zgłoszenie stanu serwera.
+		 *  \param [in] backend Numer serwera.
+		 *  \param [in] ok Wynik nawiązania połączenia.
+		 *
+		 */
+		void report(unsigned backend, bool ok);
+
+		//! Zwraca adres serwera w postaci `host:port`.
+		string name(unsigned backend) const;
+
+		//! Sprawdza, czy pośrednik został uruchomiony.
+		bool is_open(void) const;
+
+		/*! \brief Test polecenia jednego pliku.
+		 *  \returns `true` gdy sesję można przekazać do serwera wybranego nazwą pliku.
+		 *  \param [in] command Polecenie.
+		 *  \param [in] param Parametr polecenia.
+		 *
+		 *  Polecenia obejmujące wiele plików (`LIST`, `MGET` i `MPUT` z listą
+		 *  nazw lub wzorcem) dotyczą plików wielu serwerów i nie mogą trafić w
+		 *  całości do jednego z nich.
+		 *
+		 */
+		static bool routable(const string& command, const string& param);
+
+	protected:
+
+		//! Pętla wątku roboczego.
+		void run(void);
+
+		/*! \brief Nawiązanie połączenia.
+		 *  \returns Deskryptor gniazda lub `-1` w przypadku błędu.
+		 *  \param [in] backend Serwer docelowy.
+		 *  \param [in] wait Oczekiwanie na nawiązanie połączenia.
+		 *
+		 *  Zwraca gniazdo nieblokujące - bez oczekiwania połączenie może być
+		 *  jeszcze w trakcie nawiązywania.
+		 *
+		 */
+		int dial(const BACKEND& backend, bool wait) const;
+
+		//! Sprawdza, czy bezczynne połączenie nie zostało zamknięte przez serwer.
+		static bool is_alive(int sock);
+
+		//! Wyznacza pozycję na pierścieniu (FNV-1a).
+		static uint32_t hash(const string& key);
+
+};
+
+#endif // PROXY_HPP
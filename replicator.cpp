@@ -0,0 +1,431 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy replikacji łańcuchowej.
+ *  \file
+ *
+ */
+
+#include "replicator.hpp"
+
+REPLICATOR::REPLICATOR(void) {}
+
+REPLICATOR::~REPLICATOR(void)
+{
+	close(); // Porzuć aktywne strumienie
+}
+
+bool REPLICATOR::open(void)
+{
+	if (is_open()) return true;
+
+	m_event = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	m_stop = false;
+
+	return m_event != -1;
+}
+
+void REPLICATOR::close(void)
+{
+	vector<CALLBACK> callbacks;
+
+	{
+		lock_guard<mutex> lock(m_lock);
+
+		m_stop = true;
+
+		// Strumienie z kompletem danych posiadają zasoby w funkcjach zwrotnych
+		for (auto& s : m_streams)
+			if (s.second.finished && s.second.callback && !s.second.aborted)
+				callbacks.push_back(move(s.second.callback));
+
+		// Przerwij wysyłanie i oczekiwanie na potwierdzenia węzłów
+		for (auto& a : m_active) a.second->interrupt();
+	}
+
+	m_wake.notify_all();
+
+	for (auto& t : m_workers) t.join();
+	for (auto& c : callbacks) c(false);
+
+	m_workers.clear();
+	m_streams.clear();
+	m_pending.clear();
+	m_resumed.clear();
+	m_done.clear();
+	m_links.clear();
+	m_idle = 0;
+
+	if (m_event != -1) ::close(m_event);
+
+	m_event = -1;
+}
+
+void REPLICATOR::set_profile(const SOCKBASE::PROFILE& profile)
+{
+	m_profile = profile;
+}
+
+unsigned REPLICATOR::begin(const string& name, const vector<PEER>& chain, const RESUME& resume)
+{
+	lock_guard<mutex> lock(m_lock);
+
+	// Numer `0` oznacza brak strumienia
+	if (++m_next == 0) ++m_next;
+
+	auto& stream = m_streams[m_next];
+
+	stream.name = name;
+	stream.chain = chain;
+	stream.resume = resume;
+
+	m_pending.push_back(m_next);
+
+	// Utwórz kolejny wątek, gdy wszystkie są zajęte
+	if (m_idle == 0 && m_workers.size() < links)
+		m_workers.emplace_back(&REPLICATOR::run, this);
+	else m_wake.notify_all();
+
+	return m_next;
+}
+
+bool REPLICATOR::push(unsigned id, const char* data, size_t size)
+{
+	{
+		lock_guard<mutex> lock(m_lock);
+
+		const auto s = m_streams.find(id);
+
+		if (s == m_streams.end() || s->second.failed) return false;
+
+		s->second.queue.emplace_back(data, data + size);
+		s->second.queued += size;
+	}
+
+	m_wake.notify_all();
+
+	return true;
+}
+
+bool REPLICATOR::writable(unsigned id, size_t size)
+{
+	lock_guard<mutex> lock(m_lock);
+
+	const auto s = m_streams.find(id);
+
+	// Nieudany strumień nie wstrzymuje odbioru - błąd zgłosi `push`
+	if (s == m_streams.end() || s->second.failed) return true;
+	else if (s->second.queued + size <= window) return true;
+
+	s->second.paused = true;
+
+	return false;
+}
+
+void REPLICATOR::finish(unsigned id, const CALLBACK& callback)
+{
+	bool found = false;
+
+	{
+		lock_guard<mutex> lock(m_lock);
+
+		const auto s = m_streams.find(id);
+
+		if ((found = (s != m_streams.end())))
+		{
+			s->second.callback = callback;
+			s->second.finished = true;
+
+			// Strumień mógł zakończyć się błędem przed przekazaniem całości
+			if (s->second.done)
+			{
+				m_done.push_back(id);
+				notify();
+			}
+		}
+	}
+
+	// Strumienia już nie ma - replikacja została zatrzymana
+	if (found) m_wake.notify_all();
+	else if (callback) callback(false);
+}
+
+void REPLICATOR::abort(unsigned id)
+{
+	{
+		lock_guard<mutex> lock(m_lock);
+
+		const auto s = m_streams.find(id);
+
+		if (s == m_streams.end()) return;
+
+		auto& stream = s->second;
+		const auto p = find(m_pending.begin(), m_pending.end(), id);
+
+		stream.aborted = true;
+		stream.resume = nullptr;
+		stream.callback = nullptr;
+
+		const bool queued = p != m_pending.end();
+
+		// Strumień bez wątku można usunąć od razu
+		if (queued) m_pending.erase(p);
+		if (queued || stream.done) m_streams.erase(s);
+	}
+
+	m_wake.notify_all();
+}
+
+void REPLICATOR::dispatch(void)
+{
+	uint64_t count;
+
+	vector<RESUME> resumed;
+	vector<pair<CALLBACK, bool>> done;
+
+	// Wyzeruj licznik powiadomień
+	if (::read(m_event, &count, sizeof(count)) <= 0) return;
+
+	{
+		lock_guard<mutex> lock(m_lock);
+
+		for (const unsigned id : m_resumed)
+		{
+			const auto s = m_streams.find(id);
+
+			if (s != m_streams.end() && s->second.resume) resumed.push_back(s->second.resume);
+		}
+
+		for (const unsigned id : m_done)
+		{
+			const auto s = m_streams.find(id);
+
+			// Wynik strumienia bez kompletu danych zostanie zgłoszony po `finish`
+			if (s == m_streams.end()) continue;
+			else if (!s->second.finished && !s->second.aborted) continue;
+
+			if (s->second.callback) done.push_back({ move(s->second.callback), !s->second.failed });
+
+			m_streams.erase(s);
+		}
+
+		m_resumed.clear();
+		m_done.clear();
+	}
+
+	// Funkcje zwrotne wywołuj poza blokadą
+	for (const auto& r : resumed) r();
+	for (const auto& d : done) d.first(d.second);
+}
+
+int REPLICATOR::fd(void) const
+{
+	return m_event;
+}
+
+bool REPLICATOR::is_open(void) const
+{
+	return m_event != -1;
+}
+
+bool REPLICATOR::is_idle(void)
+{
+	lock_guard<mutex> lock(m_lock);
+
+	return m_streams.empty();
+}
+
+string REPLICATOR::join(const vector<PEER>& chain)
+{
+	string text;
+
+	for (const auto& peer : chain)
+	{
+		if (!text.empty()) text += ',';
+
+		// Adresy IPv6 zapisuj w nawiasach
+		if (peer.first.find(':') != string::npos) text += '[' + peer.first + ']';
+		else text += peer.first;
+
+		text += ':' + to_string(peer.second);
+	}
+
+	return text;
+}
+
+bool REPLICATOR::split(const string& text, vector<PEER>& chain)
+{
+	chain.clear();
+
+	for (size_t pos = 0; pos < text.size();)
+	{
+		size_t end = text.find(',', pos);
+		if (end == string::npos) end = text.size();
+
+		PEER peer;
+
+		if (!SOCKBASE::split_endpoint(text.substr(pos, end - pos), peer.first, peer.second)) return false;
+		else chain.push_back(peer);
+
+		pos = end + 1;
+	}
+
+	return true;
+}
+
+void REPLICATOR::run(void)
+{
+	unique_lock<mutex> lock(m_lock);
+
+	while (true)
+	{
+		++m_idle;
+		m_wake.wait(lock, [this] (void) { return m_stop || !m_pending.empty(); });
+		--m_idle;
+
+		if (m_stop) break;
+
+		const unsigned id = m_pending.front();
+		auto& stream = m_streams[id]; // Referencje elementów mapy są stabilne
+
+		m_pending.pop_front();
+
+		lock.unlock();
+		const bool ok = transfer(id, stream);
+		lock.lock();
+
+		stream.failed = !ok;
+		stream.done = true;
+
+		// Porzucony strumień usuń od razu - nikt nie czeka na jego wynik
+		if (stream.aborted) m_streams.erase(id);
+		else
+		{
+			// Wstrzymany odbiór należy wznowić, aby serwer odczytał błąd
+			if (stream.paused) m_resumed.push_back(id);
+
+			m_done.push_back(id);
+			notify();
+		}
+	}
+}
+
+bool REPLICATOR::transfer(unsigned id, STREAM& stream)
+{
+	const PEER& peer = stream.chain.front();
+	const string rest = join(vector<PEER>(stream.chain.begin() + 1, stream.chain.end()));
+
+	auto link = acquire(peer);
+	unique_lock<mutex> lock(m_lock);
+
+	// Połączenie nawiązane po zatrzymaniu nie zostanie już przerwane
+	if (!link || m_stop) return false;
+	else m_active[id] = link.get();
+
+	lock.unlock();
+	bool ok = link->replicate_begin(stream.name, rest);
+	lock.lock();
+
+	// Wysyłaj dane w miarę ich napływania do końca pliku
+	while (ok)
+	{
+		m_wake.wait(lock, [this, &stream] (void)
+		{
+			return m_stop || stream.aborted || stream.finished || !stream.queue.empty();
+		});
+
+		if (m_stop || stream.aborted) ok = false;
+		else if (stream.queue.empty()) break;
+		else
+		{
+			vector<char> block = move(stream.queue.front());
+			stream.queue.pop_front();
+
+			lock.unlock();
+			ok = link->replicate_data(block.data(), block.size());
+			lock.lock();
+
+			stream.queued -= block.size();
+
+			// Po opróżnieniu połowy kolejki wznów odbiór od klienta
+			if (stream.paused && stream.queued <= window / 2)
+			{
+				stream.paused = false;
+				m_resumed.push_back(id);
+				notify();
+			}
+		}
+	}
+
+	// Kolejne dane strumienia nie będą już przyjmowane
+	if (!ok) stream.failed = true;
+
+	lock.unlock();
+
+	// Potwierdzenie wraca po zapisaniu pliku przez cały łańcuch
+	ok = ok && link->replicate_end();
+
+	lock.lock();
+	m_active.erase(id);
+	lock.unlock();
+
+	if (ok) release(peer, move(link));
+
+	return ok;
+}
+
+unique_ptr<CLIENT> REPLICATOR::acquire(const PEER& peer)
+{
+	const string key = join({ peer });
+
+	{
+		lock_guard<mutex> lock(m_lock);
+		auto& idle = m_links[key];
+
+		// Użyj bezczynnego połączenia, o ile nie zostało zamknięte przez węzeł
+		while (!idle.empty())
+		{
+			auto link = move(idle.back());
+			idle.pop_back();
+
+			if (link->is_alive()) return link;
+		}
+	}
+
+	auto link = make_unique<CLIENT>();
+	link->set_profile(m_profile);
+
+	if (link->connect(peer.first, peer.second)) return link;
+	else return nullptr;
+}
+
+void REPLICATOR::release(const PEER& peer, unique_ptr<CLIENT> link)
+{
+	lock_guard<mutex> lock(m_lock);
+
+	if (!m_stop) m_links[join({ peer })].push_back(move(link));
+}
+
+void REPLICATOR::notify(void)
+{
+	const uint64_t one = 1;
+
+	if (::write(m_event, &one, sizeof(one)) != sizeof(one)) return;
+}
@@ -0,0 +1,263 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy replikacji łańcuchowej.
+ *  \file
+ *
+ */
+
+#ifndef REPLICATOR_HPP
+#define REPLICATOR_HPP
+
+#include "client.hpp"
+
+#include <sys/eventfd.h>
+
+#include <unistd.h>
+
+#include <condition_variable>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <deque>
+#include <mutex>
+#include <map>
+
+using namespace std;
+
+/*! \brief Klasa replikacji łańcuchowej.
+ *
+ *  Przekazuje wysyłane na serwer pliki do kolejnych węzłów łańcucha w trakcie
+ *  ich odbioru (bez oczekiwania na zapis całego pliku). Dane każdego pliku
+ *  trafiają do strumienia, który wątek roboczy wysyła poleceniem `REPLICATE`
+ *  do pierwszego węzła wraz z listą pozostałych węzłów - każdy węzeł przekazuje
+ *  plik dalej w ten sam sposób. Potwierdzenie wraca dopiero wtedy, gdy plik
+ *  zapisały wszystkie węzły.
+ *
+ *  Liczba danych w locie jednego strumienia jest ograniczona - po przekroczeniu
+ *  limitu serwer wstrzymuje odbiór od klienta do czasu opróżnienia kolejki.
+ *  Wznowienia i wyniki zgłaszane są przez `eventfd` obsługiwany w pętli serwera
+ *  metodą `dispatch`.
+ *
+ */
+class REPLICATOR
+{
+
+	public:
+
+		using PEER = pair<string, uint16_t>; //!< Adres i port węzła.
+
+		/*! \brief Funkcja zwrotna zakończenia.
+		 *
+		 *  Otrzymuje informację, czy plik zapisały wszystkie węzły. Wywoływana w
+		 *  wątku wywołującym `dispatch`.
+		 *
+		 */
+		using CALLBACK = function<void(bool ok)>;
+
+		using RESUME = function<void(void)>; //!< Funkcja wznowienia odbioru danych strumienia.
+
+		static constexpr size_t window = 1 << 22; //!< Maksymalna liczba danych w locie jednego strumienia.
+		static constexpr unsigned links = 8; //!< Maksymalna liczba równoczesnych połączeń z węzłami.
+
+	protected:
+
+		/*! \brief Opis strumienia.
+		 *
+		 *  Replikowany plik wraz z danymi oczekującymi na wysłanie.
+		 *
+		 */
+		struct STREAM
+		{
+			string name; //!< Nazwa pliku.
+			vector<PEER> chain; //!< Węzły łańcucha.
+
+			deque<vector<char>> queue; //!< Dane oczekujące na wysłanie.
+			size_t queued = 0; //!< Liczba danych w kolejce.
+
+			RESUME resume; //!< Funkcja wznowienia odbioru.
+			CALLBACK callback; //!< Funkcja zwrotna zakończenia.
+
+			bool finished = false; //!< Flaga przekazania wszystkich danych.
+			bool aborted = false; //!< Flaga porzucenia strumienia.
+			bool paused = false; //!< Flaga wstrzymania odbioru.
+			bool failed = false; //!< Flaga błędu replikacji.
+			bool done = false; //!< Flaga zakończenia pracy wątku nad strumieniem.
+		};
+
+		int m_event = -1; //!< Deskryptor powiadomień (`eventfd`).
+
+		mutex m_lock; //!< Blokada strumieni i puli połączeń.
+		condition_variable m_wake; //!< Powiadomienie wątków roboczych.
+
+		map<unsigned, STREAM> m_streams; //!< Aktywne strumienie.
+		deque<unsigned> m_pending; //!< Strumienie oczekujące na wątek.
+		vector<unsigned> m_resumed; //!< Strumienie do wznowienia.
+		vector<unsigned> m_done; //!< Zakończone strumienie.
+		unsigned m_next = 0; //!< Numer ostatniego strumienia.
+
+		vector<thread> m_workers; //!< Wątki robocze.
+		unsigned m_idle = 0; //!< Liczba wątków oczekujących na strumień.
+		bool m_stop = false; //!< Flaga zakończenia pracy wątków.
+
+		map<string, vector<unique_ptr<CLIENT>>> m_links; //!< Bezczynne połączenia z węzłami.
+		map<unsigned, CLIENT*> m_active; //!< Połączenia używane przez wątki robocze.
+		SOCKBASE::PROFILE m_profile; //!< Profil strojenia gniazd połączeń.
+
+	public:
+
+		explicit REPLICATOR(void); //!< Konstruktor domyślny.
+		virtual ~REPLICATOR(void); //!< Destruktor, porzuca aktywne strumienie.
+
+		REPLICATOR(const REPLICATOR&) = delete; //!< Konstruktor kopiujący (usunięty).
+		REPLICATOR& operator= (const REPLICATOR&) = delete; //!< Operator przypisania (usunięty).
+
+		/*! \brief Uruchomienie replikacji.
+		 *  \returns Powodzenie operacji.
+		 *
+		 *  Otwiera deskryptor powiadomień. Wątki robocze tworzone są w miarę potrzeb.
+		 *
+		 */
+		bool open(void);
+
+		/*! \brief Zatrzymanie replikacji.
+		 *
+		 *  Porzuca aktywne strumienie i kończy wątki robocze - połączenia w trakcie
+		 *  wysyłania są przerywane, więc zatrzymanie nie czeka na węzły. Funkcje zwrotne
+		 *  strumieni, których dane zostały już w całości przekazane, wywoływane są
+		 *  z wynikiem `false`, aby mogły zwolnić powiązane zasoby.
+		 *
+		 */
+		void close(void);
+
+		//! Ustawia profil strojenia gniazd połączeń z węzłami.
+		void set_profile(const SOCKBASE::PROFILE& profile);
+
+		/*! \brief Rozpoczęcie strumienia.
+		 *  \returns Numer strumienia.
+		 *  \param [in] name Nazwa pliku.
+		 *  \param [in] chain Węzły łańcucha (niepusta lista).
+		 *  \param [in] resume Funkcja wywoływana po opróżnieniu kolejki wstrzymanego strumienia.
+		 *
+		 */
+		unsigned begin(const string& name, const vector<PEER>& chain,
+					const RESUME& resume);
+
+		/*! \brief Dodanie danych.
+		 *  \returns `false` gdy replikacja strumienia już się nie powiodła.
+		 *  \param [in] id Numer strumienia.
+		 *  \param [in] data Dane pliku.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Kopiuje dane do kolejki strumienia.
+		 *
+		 */
+		bool push(unsigned id, const char* data, size_t size);
+
+		/*! \brief Test miejsca w kolejce.
+		 *  \returns `true` gdy można dodać wskazaną liczbę danych.
+		 *  \param [in] id Numer strumienia.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Przy braku miejsca oznacza strumień jako wstrzymany - po opróżnieniu
+		 *  połowy kolejki zostanie wywołana funkcja wznowienia.
+		 *
+		 */
+		bool writable(unsigned id, size_t size);
+
+		/*! \brief Zakończenie strumienia.
+		 *  \param [in] id Numer strumienia.
+		 *  \param [in] callback Funkcja zwrotna wywoływana po potwierdzeniu od węzłów.
+		 *
+		 *  Oznacza koniec danych pliku.
+		 *
+		 */
+		void finish(unsigned id, const CALLBACK& callback);
+
+		/*! \brief Porzucenie strumienia.
+		 *  \param [in] id Numer strumienia.
+		 *
+		 *  Przerywa replikację bez wywoływania funkcji zwrotnych.
+		 *
+		 */
+		void abort(unsigned id);
+
+		/*! \brief Obsługa zdarzeń.
+		 *
+		 *  Odczytuje powiadomienie i wywołuje funkcje wznowienia oraz funkcje
+		 *  zwrotne zakończonych strumieni.
+		 *
+		 */
+		void dispatch(void);
+
+		//! Zwraca deskryptor powiadomień do monitorowania funkcją `poll`.
+		int fd(void) const;
+
+		//! Sprawdza, czy replikacja została uruchomiona.
+		bool is_open(void) const;
+
+		//! Sprawdza, czy żaden strumień nie oczekuje na replikację.
+		bool is_idle(void);
+
+		/*! \brief Zapis łańcucha.
+		 *  \returns Lista węzłów w postaci `host:port` rozdzielonych przecinkami.
+		 *  \param [in] chain Węzły łańcucha.
+		 *
+		 */
+		static string join(const vector<PEER>& chain);
+
+		/*! \brief Odczyt łańcucha.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] text Lista węzłów w postaci `host:port` rozdzielonych przecinkami.
+		 *  \param [out] chain Węzły łańcucha.
+		 *
+		 */
+		static bool split(const string& text, vector<PEER>& chain);
+
+	protected:
+
+		//! Pętla wątku roboczego.
+		void run(void);
+
+		/*! \brief Replikacja strumienia.
+		 *  \returns `true` gdy plik zapisały wszystkie węzły.
+		 *  \param [in] id Numer strumienia.
+		 *  \param [in,out] stream Strumień.
+		 *
+		 *  Wysyła dane strumienia w miarę ich napływania i czeka na potwierdzenie.
+		 *
+		 */
+		bool transfer(unsigned id, STREAM& stream);
+
+		//! Pobiera połączenie z puli lub nawiązuje nowe.
+		unique_ptr<CLIENT> acquire(const PEER& peer);
+
+		//! Zwraca połączenie do puli.
+		void release(const PEER& peer, unique_ptr<CLIENT> link);
+
+		//! Zgłasza zdarzenie pętli serwera.
+		void notify(void);
+
+};
+
+#endif // REPLICATOR_HPP
@@ -32,308 +32,3172 @@ SERVER::SERVER(void)
 
 SERVER::~SERVER(void)
 {
+	if (is_started() || m_draining) stop(); // Zwolnij zasoby (m.in. plik gniazda lokalnego)
+
 	cout << "Destroying server...\tOK\n";
 }
 
-bool SERVER::start(const string& addr, const uint16_t port, const int queue)
+bool SERVER::start(const string& addr, const uint16_t port, const int queue)
+{
+	if (m_sock) this->stop(); // Zatrzymaj serwer, jeśli jest aktywny
+
+	if (!prepare()) return false;
+
+	// Utwórz pierwsze gniazdo nasłuchujące
+	const int sock = open_listener(addr, port, queue);
+
+	if (sock == -1) return false;
+	else return launch(sock);
+}
+
+bool SERVER::prepare(void)
+{
+	// Domyślny układ przechowywania plików
+	if (!m_layout && !use_layout(string())) return false;
+
+	// Zbuduj indeks metadanych przed przyjęciem pierwszych połączeń
+	if (m_index)
+	{
+		cout << "Building index...\t";
+		cout << m_index->build(*m_layout) << " files\n";
+	}
+
+	return true;
+}
+
+bool SERVER::launch(int sock)
+{
+	// Uzupełnij pola i dodaj gniazdo do listy `poll`
+	m_terminate = m_drain = m_draining = false;
+	m_sock = sock;
+	m_listeners.push_back(sock);
+	add_service(sock);
+
+	// Obserwator systemu plików jest również monitorowany przez `poll`
+	if (m_watcher.is_open()) add_service(m_watcher.fd());
+
+	// Uruchom grupowe zatwierdzanie wysyłanych plików
+	if (!m_committer.open()) return false;
+	else add_service(m_committer.fd());
+
+	// Skróty plików indeksu wyznaczane są poza pętlą serwera
+	if (m_index && !m_index->open()) return false;
+	else if (m_index) add_service(m_index->fd());
+
+	// Uruchom replikację - węzeł może być również środkiem łańcucha innego serwera
+	m_replicator.set_profile(m_profile);
+
+	if (!m_replicator.open()) return false;
+	else add_service(m_replicator.fd());
+
+	return true;
+}
+
+bool SERVER::takeover(const string& path)
+{
+	if (m_sock) this->stop(); // Zatrzymaj serwer, jeśli jest aktywny
+
+	if (!prepare()) return false;
+
+	sockaddr_un sun;
+	socklen_t len;
+
+	cout << "Taking over listeners...\t";
+
+	// Połącz się z gniazdem przekazywania działającego serwera
+	const int sock = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+	if (sock == -1 || !unix_address(path, sun, len) ||
+	    ::connect(sock, (sockaddr*) &sun, len) == -1)
+	{
+		if (sock != -1) ::close(sock);
+
+		cout << "FAIL\n";
+
+		return false;
+	}
+
+	vector<int> listeners;
+	int local = -1;
+	string local_path;
+	char buff[sizeof(sun.sun_path) + 1];
+	bool ok = false;
+
+	// Rekordy: `T` (gniazdo TCP), `U` i ścieżka (gniazdo lokalne), `E` (koniec)
+	while (true)
+	{
+		int fd = -1;
+		const ssize_t rec = recv_fd(sock, buff, sizeof(buff), fd);
+
+		if (rec <= 0) break;
+		else if (buff[0] == 'E') { ok = true; break; }
+		else if (fd == -1) break;
+		else if (buff[0] == 'T') listeners.push_back(fd);
+		else if (buff[0] == 'U' && local == -1)
+		{
+			local = fd;
+			local_path.assign(buff + 1, rec - 1);
+		}
+		else ::close(fd);
+	}
+
+	ok = ok && !listeners.empty() && launch(listeners[0]);
+
+	if (ok)
+	{
+		// Pozostałe gniazda obsługuje ta sama pętla serwera
+		for (size_t i = 1; i < listeners.size(); ++i)
+		{
+			m_listeners.push_back(listeners[i]);
+			add_service(listeners[i]);
+		}
+
+		if (local != -1)
+		{
+			m_local = local;
+			m_path = local_path;
+			add_service(local);
+		}
+	}
+	else
+	{
+		for (const int fd : listeners) ::close(fd);
+		if (local != -1) ::close(local);
+	}
+
+	// Potwierdź przejęcie i poczekaj na zwolnienie ścieżki gniazda przekazywania
+	ok = ok && ::send(sock, "A", 1, MSG_NOSIGNAL) == 1 &&
+		::recv(sock, buff, 1, 0) == 1 && buff[0] == 'D';
+
+	::close(sock);
+
+	cout << (ok ? "OK\n" : "FAIL\n");
+
+	return ok;
+}
+
+bool SERVER::add_listener(const string& addr, const uint16_t port, const int queue)
+{
+	// Kolejne gniazda dodawane są do uruchomionego serwera
+	if (!is_started()) return false;
+
+	const int sock = open_listener(addr, port, queue);
+
+	if (sock == -1) return false;
+
+	m_listeners.push_back(sock);
+	add_service(sock);
+
+	return true;
+}
+
+int SERVER::open_listener(const string& addr, const uint16_t port, const int queue)
+{
+	static const int yes = 1; // Zmienna do ustawienia opcji `SO_REUSEADDR`
+
+	const bool dual = addr == "*"; // Gniazdo IPv6 przyjmujące również połączenia IPv4
+	const string ports = to_string(port);
+
+	addrinfo hints, *info = nullptr;
+	int sock(-1);
+
+	// Zwolnij zasoby w przypadku błędu
+	const auto fail = [&] (void) -> int
+	{
+		if (sock != -1) ::close(sock);
+		if (info) freeaddrinfo(info);
+
+		return -1;
+	};
+
+	// Uzupełnij strukturę podpowiedzi - adres liczbowy IPv4 lub IPv6
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST | AI_NUMERICSERV;
+
+	cout << "Filling struct...\t";
+
+	// Konwertuj adres z łańcucha do struktury
+	if (getaddrinfo(dual ? "::" : addr.c_str(), ports.c_str(), &hints, &info) != 0)
+		return fail();
+	else cout << "OK\n";
+
+	// Stwórz socket - IPv4 lub IPv6, TCP
+	cout << "Creating socket...\t";
+	sock = ::socket(info->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (sock == -1) return fail();
+	else cout << "OK\n";
+
+	cout << "Setting options...\t";
+
+	// Ustaw opcję ponownego użycia adresu
+	if (::setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) == -1)
+		return fail();
+
+	// Gniazdo IPv6 obsługuje IPv4 tylko w trybie dwustosowym (adres `*`)
+	if (info->ai_family == AF_INET6)
+	{
+		const int only = !dual;
+
+		if (::setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &only, sizeof(int)) == -1)
+			return fail();
+	}
+
+	cout << "OK\n";
+
+	cout << "Applying profile...\t";
+
+	// Zastosuj profil strojenia - błędy pojedynczych opcji nie są krytyczne
+	if (apply(sock, ROLE::Listening)) cout << "PARTIAL\n";
+	else cout << "OK\n";
+
+	cout << "Binding address...\t";
+
+	// Połącz gniazdo z adresem
+	if (::bind(sock, info->ai_addr, info->ai_addrlen) == -1) return fail();
+	else cout << "OK\n";
+
+	cout << "Start listening...\t";
+
+	// Rozpocznij nasłuchiwanie
+	if (::listen(sock, queue) == -1) return fail();
+	else cout << "OK\n\n";
+
+	freeaddrinfo(info);
+
+	return sock;
+}
+
+bool SERVER::start_unix(const string& path, const int queue)
+{
+	sockaddr_un sun;
+	socklen_t len;
+
+	cout << "Creating local socket...\t";
+
+	// Gniazdo lokalne obsługiwane jest razem z gniazdem TCP
+	if (!is_started() || m_local || !unix_address(path, sun, len)) return false;
+
+	// Stwórz socket - lokalny, strumieniowy
+	int sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (sock == -1) return false;
+	else cout << "OK\n";
+
+	cout << "Binding local path...\t";
+
+	// Usuń pozostałość po poprzednim uruchomieniu (poza przestrzenią abstrakcyjną)
+	if (path[0] != '@') ::unlink(path.c_str());
+
+	// Połącz gniazdo z adresem i rozpocznij nasłuchiwanie
+	if (::bind(sock, (sockaddr*) &sun, len) == -1 || ::listen(sock, queue) == -1)
+	{
+		::close(sock);
+		return false;
+	}
+	else cout << "OK\n\n";
+
+	m_local = sock;
+	m_path = path;
+	add_service(sock);
+
+	return true;
+}
+
+bool SERVER::start_handoff(const string& path)
+{
+	sockaddr_un sun;
+	socklen_t len;
+
+	cout << "Creating handoff socket...\t";
+
+	if (!is_started() || m_handoff != -1 || !unix_address(path, sun, len)) return false;
+
+	// Gniazdo pakietowe zachowuje granice rekordów z deskryptorami
+	const int sock = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+	if (sock == -1) return false;
+
+	// Usuń pozostałość po poprzednim uruchomieniu (poza przestrzenią abstrakcyjną)
+	if (path[0] != '@') ::unlink(path.c_str());
+
+	if (::bind(sock, (sockaddr*) &sun, len) == -1 || ::listen(sock, 1) == -1)
+	{
+		::close(sock);
+		return false;
+	}
+	else cout << "OK\n";
+
+	m_handoff = sock;
+	m_handoff_path = path;
+	add_service(sock);
+
+	return true;
+}
+
+void SERVER::stop(void)
+{
+	cout << "Stopping server...\t";
+
+	// Zakończ obserwację śledzonych plików i zapisz zdarzenia trwających sesji
+	for (auto p = m_sockets.begin() + m_head; p != m_sockets.end(); ++p)
+	{
+		CLIENT* const c = m_clients.find(p->fd);
+
+		if (!c) continue;
+
+		m_tracer.finish(c->trace, p->fd, c->serial);
+		unfollow(*c);
+	}
+
+	m_sockets.clear(); // Wyczyść listę `poll`
+	m_head = 0; // Usuń deskryptory usług
+	m_clients.clear(); // Wyczyść listę klientów
+	m_files = m_buffers = m_receiving = m_held = 0; // Wyzeruj liczniki zasobów
+	m_wakeups.clear(); // Porzuć zaplanowane wznowienia
+	m_replicator.close(); // Porzuć niepotwierdzone repliki
+	m_committer.close(); // Zatwierdź oczekujące pliki
+	if (m_index) m_index->close(); // Porzuć wyznaczanie skrótów
+	m_tracer.close(); // Zapisz zdarzenia śledzonych sesji
+
+	// Zamknij dodatkowe gniazda nasłuchujące (główne zamyka `close`)
+	for (const int fd : m_listeners) if (fd != m_sock) ::close(fd);
+	m_listeners.clear();
+
+	// Zamknij gniazdo lokalne i usuń jego plik
+	if (m_local)
+	{
+		::close(m_local);
+		if (m_path[0] != '@') ::unlink(m_path.c_str());
+
+		m_local = 0;
+		m_path.clear();
+	}
+
+	// Zamknij gniazdo przekazywania i usuń jego plik
+	if (m_handoff != -1)
+	{
+		::close(m_handoff);
+		if (m_handoff_path[0] != '@') ::unlink(m_handoff_path.c_str());
+
+		m_handoff = -1;
+		m_handoff_path.clear();
+	}
+
+	// Porzuć niepotwierdzone przekazanie
+	if (m_takeover != -1) ::close(m_takeover);
+	m_takeover = -1;
+
+	m_draining = false;
+
+	this->close(); // Zamknij gniazdo
+
+	cout << "OK\n";
+
+	// Wszystkie połączenia klientów zostaną
+	// automatycznie zamknięte. Zajmie się
+	// tym destruktor struktury CLIENT::~CLIENT()
+}
+
+void SERVER::end(int signal)
+{
+	cout << "\nTerminating server:\t" << signal << '\n';
+
+	m_terminate = true; // Zakończ po kolejnej pętli
+}
+
+void SERVER::drain(int signal)
+{
+	cout << "\nDraining server:\t" << signal << '\n';
+
+	m_drain = true; // Rozpocznij wygaszanie w kolejnej pętli
+}
+
+void SERVER::set_grace(unsigned seconds)
+{
+	m_grace = chrono::seconds(seconds);
+}
+
+void SERVER::set_pacing(bool enable)
+{
+	m_pacing = enable;
+}
+
+void SERVER::set_limits(const LIMITS& limits)
+{
+	m_limits = limits;
+}
+
+SERVER::USAGE SERVER::usage(void)
+{
+	USAGE usage;
+
+	for (auto i = m_sockets.begin() + m_head; i != m_sockets.end(); ++i)
+	{
+		const CLIENT* const c = m_clients.find(i->fd);
+
+		if (!c) continue;
+
+		usage.connections += 1;
+		usage.files += c->descriptors();
+		usage.buffers += c->footprint();
+		usage.queued += c->queued;
+		usage.paused += c->held;
+	}
+
+	usage.deferred = m_deferred;
+
+	return usage;
+}
+
+void SERVER::on_takeover(void)
+{
+	const int sock = ::accept4(m_handoff, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+
+	if (sock == -1) return;
+
+	cout << "Handing off listeners...\t";
+
+	// Obsługuj jedno przekazanie naraz
+	bool ok = m_takeover == -1;
+
+	// Rekordy mieszczą się w buforze gniazda - wysyłanie nie czeka na nowy
+	// proces, a na jego potwierdzenie czeka dopiero `poll`
+	for (const int fd : m_listeners) ok = ok && send_fd(sock, fd, "T", 1);
+
+	if (m_local)
+	{
+		const string record = 'U' + m_path;
+
+		ok = ok && send_fd(sock, m_local, record.data(), record.size());
+	}
+
+	ok = ok && ::send(sock, "E", 1, MSG_NOSIGNAL) == 1;
+
+	cout << (ok ? "SENT\n" : "FAIL\n");
+
+	if (!ok) ::close(sock);
+	else
+	{
+		m_takeover = sock;
+		add_service(sock);
+	}
+}
+
+void SERVER::on_confirm(void)
+{
+	char ack = 0;
+
+	const ssize_t rec = ::recv(m_takeover, &ack, 1, MSG_DONTWAIT);
+
+	if (rec == -1 && errno == EAGAIN) return;
+
+	const bool ok = rec == 1 && ack == 'A';
+
+	cout << "Handoff confirmed:\t" << (ok ? "OK\n" : "FAIL\n");
+
+	remove_service(m_takeover);
+
+	// Po potwierdzeniu przejęcia gniazda należą do nowego procesu -
+	// zwolnij ścieżkę gniazda przekazywania
+	if (ok)
+	{
+		begin_drain(true);
+		::send(m_takeover, "D", 1, MSG_NOSIGNAL);
+	}
+
+	::close(m_takeover);
+	m_takeover = -1;
+}
+
+void SERVER::begin_drain(bool handed)
+{
+	cout << "Draining clients...\t" << m_clients.size() << '\n';
+
+	m_drain = m_draining = true;
+	m_deadline = chrono::steady_clock::now() + m_grace;
+
+	// Usuń gniazda nasłuchujące z listy `poll` - pozostałe usługi działają dalej
+	const auto head = m_sockets.begin() + m_head;
+	const auto end = remove_if(m_sockets.begin(), head, [this] (const pollfd& p)
+	{
+		return p.fd == m_local || p.fd == m_handoff ||
+			  find(m_listeners.begin(), m_listeners.end(), p.fd) != m_listeners.end();
+	});
+
+	m_head = end - m_sockets.begin();
+	m_sockets.erase(end, head);
+
+	// Zamknięcie kopii przekazanych gniazd nie wpływa na nowy proces
+	for (const int fd : m_listeners) ::close(fd);
+
+	m_listeners.clear();
+	m_sock = 0;
+
+	if (m_local)
+	{
+		::close(m_local);
+		if (!handed && m_path[0] != '@') ::unlink(m_path.c_str());
+
+		m_local = 0;
+		m_path.clear();
+	}
+
+	if (m_handoff != -1)
+	{
+		::close(m_handoff);
+		if (m_handoff_path[0] != '@') ::unlink(m_handoff_path.c_str());
+
+		m_handoff = -1;
+		m_handoff_path.clear();
+	}
+}
+
+bool SERVER::is_drained(void)
+{
+	// Pliki oczekujące na potwierdzenie replik należą do zakończonych wysyłań
+	if (!m_replicator.is_idle()) return false;
+
+	return all_of(m_sockets.begin() + m_head, m_sockets.end(), [this] (const pollfd& p)
+	{
+		const CLIENT* const c = m_clients.find(p.fd);
+
+		return !c || (c->state == STATE::Waiting && c->size == 0) || c->state == STATE::Following;
+	});
+}
+
+void SERVER::admit(void)
+{
+	// Bez limitów kontrola przyjęć nie kosztuje nic
+	if (!m_limits.connections && !m_limits.files && !m_limits.buffers) return;
+
+	// Zwolnione deskryptory przydzielaj żądaniom w kolejności ich nadejścia
+	while (!m_queue.empty() && (!m_limits.files || m_files < m_limits.files))
+	{
+		const auto [sock, serial] = m_queue.front();
+		CLIENT* const c = m_clients.find(sock);
+
+		m_queue.pop_front();
+
+		// Klient mógł się w międzyczasie rozłączyć (a deskryptor zostać ponownie użyty)
+		if (!c || c->serial != serial || !c->queued) continue;
+
+		const auto it = find_if(m_sockets.begin() + m_head, m_sockets.end(),
+						    [sock] (const pollfd& p) { return p.fd == sock; });
+
+		if (it == m_sockets.end()) continue;
+
+		cout << "Admitted request from:\t" << sock << '\n';
+
+		c->queued = false;
+		it->events = POLLIN;
+
+		on_command(it, true);
+
+		// Policz deskryptory otwarte przez przyjęte żądanie
+		account(sock);
+	}
+
+	const size_t connections = m_clients.size();
+	const bool defer = m_limits.connections && connections >= m_limits.connections;
+
+	if (defer != m_deferred) cout << (defer ? "Deferring accept:\t" : "Resuming accept:\t")
+							<< connections << '\n';
+
+	m_deferred = defer;
+
+	// Nowe połączenia czekają w kolejce gniazda nasłuchującego
+	for (size_t s = 0; s < m_head; ++s)
+		if (m_sockets[s].fd == m_local ||
+		    find(m_listeners.begin(), m_listeners.end(), m_sockets[s].fd) != m_listeners.end())
+			m_sockets[s].events = defer ? 0 : POLLIN;
+
+	// Poniżej limitu buforów wszyscy klienci odbierają dane - przegląd
+	// połączeń potrzebny jest tylko do wstrzymania lub wznowienia odbioru
+	if (!m_limits.buffers || (m_buffers <= m_limits.buffers && !m_held)) return;
+
+	// Miejsce w limicie pozostałe po buforach pozostałych klientów
+	size_t spare = m_buffers - m_receiving;
+	spare = m_limits.buffers > spare ? m_limits.buffers - spare : 0;
+
+	bool first = true;
+
+	// Odbieraj od kolejnych klientów, dopóki ich bufory mieszczą się w limicie
+	// - wstrzymanie nie zwalnia buforów, więc jeden klient zawsze odbiera dane
+	for (auto i = m_sockets.begin() + m_head; i != m_sockets.end(); ++i)
+	{
+		CLIENT* const c = m_clients.find(i->fd);
+
+		if (!c || !c->counted_receiving) continue;
+
+		const size_t size = c->counted_buffers;
+		const bool fits = first || size <= spare;
+
+		if (fits) spare -= min(spare, size);
+
+		first = false;
+
+		if (!fits && !c->held)
+		{
+			c->held = true;
+			i->events &= ~POLLIN;
+			++m_held;
+		}
+
+		// Strumień replikacji wstrzymany przez kolejne węzły wznowi `on_resume`
+		else if (fits && c->held)
+		{
+			c->held = false;
+			--m_held;
+
+			if (!c->replica || m_replicator.writable(c->replica, c->pace.chunk)) i->events |= POLLIN;
+		}
+	}
+}
+
+void SERVER::account(int sock)
+{
+	CLIENT* const c = m_clients.find(sock);
+
+	if (!c) return;
+
+	const size_t files = c->descriptors();
+	const size_t buffers = c->footprint();
+	const bool receiving = c->receiving();
+
+	// Zastąp poprzednio uwzględnione zasoby klienta bieżącymi
+	m_files = m_files - c->counted_files + files;
+	m_buffers = m_buffers - c->counted_buffers + buffers;
+	m_receiving = m_receiving - (c->counted_receiving ? c->counted_buffers : 0) + (receiving ? buffers : 0);
+
+	c->counted_files = files;
+	c->counted_buffers = buffers;
+	c->counted_receiving = receiving;
+}
+
+void SERVER::discount(CLIENT& client)
+{
+	m_files -= client.counted_files;
+	m_buffers -= client.counted_buffers;
+	m_receiving -= client.counted_receiving ? client.counted_buffers : 0;
+	m_held -= client.held;
+
+	client.counted_files = client.counted_buffers = 0;
+	client.counted_receiving = client.held = false;
+}
+
+bool SERVER::loop(int timeout)
+{
+	// Rozpocznij wygaszanie zgłoszone sygnałem
+	if (m_drain && !m_draining) begin_drain(false);
+
+	// W trakcie wygaszania zakończ po obsłużeniu transferów lub po terminie
+	if (m_draining)
+	{
+		const auto now = chrono::steady_clock::now();
+
+		if (is_drained() || now >= m_deadline) return false;
+
+		const int left = chrono::ceil<chrono::milliseconds>(m_deadline - now).count();
+
+		if (timeout < 0 || timeout > left) timeout = left;
+	}
+
+	// Dostosuj obsługę połączeń do limitów zasobów
+	admit();
+
+	// Wznów śledzone pliki i nie czekaj dłużej niż do kolejnego wznowienia
+	const int wakeup = wake_followers();
+	const bool early = wakeup >= 0 && (timeout < 0 || timeout > wakeup);
+
+	if (early) timeout = wakeup;
+
+	// Sprawdź stan połączeń pod kątem możliwości ich obsługi
+	const int ready = poll(m_sockets.data(), m_sockets.size(), timeout);
+
+	if (ready > 0)
+	{
+		// Pierwsze elementy na liście to deskryptory usług serwera
+		for (size_t s = 0; s < m_head; ++s)
+		{
+			// Pomiń usługi bez aktywności
+			if (!(m_sockets[s].revents & POLLIN)) continue;
+
+			// Jeśli gniazdo nasłuchujące jest gotowe do odczytu (czeka nowy klient)
+			if (find(m_listeners.begin(), m_listeners.end(), m_sockets[s].fd) != m_listeners.end())
+			{
+				sockaddr_storage sin; // Struktura pomocnicza na adres (IPv4 lub IPv6)
+				socklen_t size = sizeof(sin); // Długość adresu
+
+				// Akceptuj nowe połączenie do serwera
+				int sock = ::accept4(m_sockets[s].fd, (sockaddr*) &sin, &size, SOCK_CLOEXEC);
+
+				// Jeśli połączenie jest prawidłowe dodaj je do listy klientów
+				if (sock != -1) on_accept(sock);
+			}
+
+			// Jeśli czeka nowy klient lokalny
+			else if (m_sockets[s].fd == m_local)
+			{
+				int sock = ::accept4(m_local, nullptr, nullptr, SOCK_CLOEXEC);
+
+				if (sock != -1) on_accept(sock, true);
+			}
+
+			// Jeśli obserwator systemu plików zgłosił zdarzenia - obsłuż je
+			else if (m_sockets[s].fd == m_watcher.fd()) m_watcher.dispatch();
+
+			// Jeśli zakończono zatwierdzanie plików - powiadom klientów
+			else if (m_sockets[s].fd == m_committer.fd()) m_committer.dispatch();
+
+			// Jeśli indeks wyznaczył skróty lub zakończył odbudowę - uzupełnij go
+			else if (m_index && m_sockets[s].fd == m_index->fd()) m_index->dispatch();
+
+			// Jeśli replikacja zgłosiła wznowienia lub wyniki - obsłuż je
+			else if (m_sockets[s].fd == m_replicator.fd()) m_replicator.dispatch();
+
+			// Jeśli nowy proces przejmuje gniazda nasłuchujące - przekaż je
+			// (lista usług zmienia się, więc przerwij jej obsługę)
+			else if (m_sockets[s].fd == m_handoff)
+			{
+				on_takeover();
+				break;
+			}
+
+			// Jeśli nowy proces potwierdził przejęcie gniazd - rozpocznij wygaszanie
+			else if (m_sockets[s].fd == m_takeover)
+			{
+				on_confirm();
+				break;
+			}
+		}
+
+		// Zacznij iteracje od pierwszego klienta
+		auto i = m_sockets.begin() + m_head;
+
+		// Obsługuj kolejne połączenia aż do końca listy
+		while (i != m_sockets.end())
+		{
+			const int sock = i->fd; // Gniazdo obsługiwanego klienta
+			const bool active = i->revents; // Flaga zdarzeń klienta
+
+			// Przekazywana sesja sama obsługuje zamknięcie połączenia - dane
+			// drugiej strony mogą jeszcze oczekiwać w potoku
+			if (i->revents && m_clients[i->fd].state == STATE::Relaying) i = on_relay(i);
+
+			// Jeśli w połączeniu wystąpił błąd/zostało zamknięte - zwolnij zasoby
+			else if (i->revents & (POLLHUP | POLLERR)) i = on_disconnect(i);
+
+			// Jeśli połączenie jest gotowe do odczytu i oczekuje się na nagłówek,
+			// pobierz jego fragment i przetwórz go w celu skompletowania nagłówka
+			else if (m_clients[i->fd].state == STATE::Waiting &&
+				    i->revents & POLLIN) i = on_header(i);
+
+			// Jeśli połączenie jest gotowe do odczytu i oczekuje się na dane pliku,
+			// pobierz kolejny fragment i zapisz go do pliku związanego z klientem
+			else if (m_clients[i->fd].state == STATE::Uploading &&
+				    i->revents & POLLIN) i = on_upload(i);
+
+			// Jeśli połączenie jest gotowe do zapisu i dostępne są dane w pliku,
+			// odczytaj kolejny fragment danych i wyślij go do oczekującego klienta
+			else if (m_clients[i->fd].state == STATE::Downloading &&
+				    i->revents & POLLOUT) i = on_download(i);
+
+			// Klient śledzący plik nie wysyła danych - gotowość do odczytu
+			// oznacza zamknięcie połączenia lub błąd protokołu
+			else if (m_clients[i->fd].state == STATE::Following &&
+				    i->revents & POLLIN) i = on_disconnect(i);
+
+			// Jeśli połączenie jest gotowe do zapisu i trwa synchronizacja różnicowa,
+			// wyślij kolejny fragment sygnatury pliku
+			else if (m_clients[i->fd].state == STATE::Signing &&
+				    i->revents & POLLOUT) i = on_signature(i);
+
+			// Jeśli połączenie jest gotowe do odczytu i trwa synchronizacja różnicowa,
+			// pobierz kolejny fragment strumienia zmian i odtwórz z niego plik
+			else if (m_clients[i->fd].state == STATE::Patching &&
+				    i->revents & POLLIN) i = on_patch(i);
+
+			// Jeśli połączenie jest gotowe do odczytu i trwa wysyłanie z deduplikacją,
+			// pobierz kolejne zapytanie lub fragmenty i zapisz je w magazynie
+			else if (m_clients[i->fd].state == STATE::Deduping &&
+				    i->revents & POLLIN) i = on_dedup(i);
+
+			// Jeśli trwa import pliku klienta lokalnego, skopiuj kolejny fragment
+			// (gniazdo jest wtedy stale gotowe do zapisu - import postępuje w pętli)
+			else if (m_clients[i->fd].state == STATE::Importing &&
+				    i->revents & POLLOUT) i = on_import(i);
+
+			// Jeśli połączenie jest gotowe do zapisu i trwa odpowiedź z indeksu,
+			// wyślij kolejny fragment listy lub metadanych pliku
+			else if (m_clients[i->fd].state == STATE::Replying &&
+				    i->revents & POLLOUT) i = on_reply(i);
+
+			// Jeśli połączenie jest gotowe do odczytu i oczekuje się na listę nazw,
+			// pobierz jej kolejny fragment
+			else if (m_clients[i->fd].state == STATE::Requesting &&
+				    i->revents & POLLIN) i = on_request(i);
+
+			// Jeśli połączenie jest gotowe do zapisu i trwa wysyłanie wielu plików,
+			// wyślij kolejną porcję strumienia
+			else if (m_clients[i->fd].state == STATE::Streaming &&
+				    i->revents & POLLOUT) i = on_stream(i);
+
+			// Jeśli połączenie jest gotowe do odczytu i trwa odbiór wielu plików,
+			// pobierz kolejny fragment strumienia i zapisz dane plików
+			else if (m_clients[i->fd].state == STATE::Receiving &&
+				    i->revents & POLLIN) i = on_receive(i);
+
+			// Jeśli połączenie jest gotowe do odczytu i trwa odbiór repliki,
+			// pobierz kolejny fragment pliku i przekaż go dalej w łańcuchu
+			else if (m_clients[i->fd].state == STATE::Replicating &&
+				    i->revents & POLLIN) i = on_replicate(i);
+
+			// Jeśli połączenie jest gotowe do zapisu i trwa wysyłanie pliku rzadkiego,
+			// wyślij kolejny rekord obszaru lub fragment jego danych
+			else if (m_clients[i->fd].state == STATE::Mapping &&
+				    i->revents & POLLOUT) i = on_extents(i);
+
+			// Jeśli połączenie jest gotowe do odczytu i trwa odbiór pliku rzadkiego,
+			// pobierz kolejny fragment strumienia i odtwórz obszary pliku
+			else if (m_clients[i->fd].state == STATE::Punching &&
+				    i->revents & POLLIN) i = on_punch(i);
+
+			else ++i; // Jeśli nie trzeba podejmować żadnej akcji przejdź do kolejnego klienta
+
+			// Uwzględnij zmiany zasobów obsłużonego klienta w licznikach
+			if (active) account(sock);
+		}
+
+		return !m_terminate; // Zwróć stan serwera - `false` gdy trzeba zakończyć serwer
+	}
+
+	// Przerwanie sygnałem wygaszania lub upływ czasu w jego trakcie nie kończy pracy
+	else if (m_drain && !m_terminate) return true;
+
+	// Upływ czasu do wznowienia śledzonego pliku nie kończy pracy
+	else if (ready == 0 && early) return true;
+
+	else return false; // Gdy `poll` zwróci błąd lub przekroczono czas oczekiwania
+}
+
+bool SERVER::use_layout(const string& spec)
+{
+	cout << "Opening layout...\t";
+
+	// Układ zapisany w katalogu ma pierwszeństwo - zmiana wymaga migracji
+	const string stored = LAYOUT::detect(".");
+	const string wanted = !spec.empty() ? spec : !stored.empty() ? stored : "flat";
+
+	auto layout = LAYOUT::make(wanted);
+	auto current = LAYOUT::make(stored.empty() ? "flat" : stored);
+
+	bool ok = layout && current && layout->spec() == current->spec();
+
+	// Katalog bez znacznika może zostać podzielony tylko, gdy nie zawiera plików
+	if (!ok && layout && stored.empty())
+	{
+		bool empty = true;
+
+		current->open(".");
+		current->scan(".", [&empty] (const string&, const string&) { empty = false; });
+
+		ok = empty;
+	}
+
+	ok = ok && layout->open(".");
+
+	// Zapisz znacznik podzielonego układu
+	if (ok && stored.empty() && layout->spec() != "flat")
+		ok = LAYOUT::mark(".", layout->spec());
+
+	if (ok) m_layout = move(layout);
+
+	cout << (ok ? "OK\n" : "FAIL\n");
+
+	return ok;
+}
+
+bool SERVER::use_store(const string& root)
+{
+	cout << "Opening store...\t";
+
+	m_store = make_unique<CHUNKSTORE>(root);
+
+	// Utwórz katalogi magazynu
+	if (!m_store->open()) m_store.reset();
+
+	cout << (m_store ? "OK\n" : "FAIL\n");
+
+	return bool(m_store);
+}
+
+bool SERVER::use_cache(size_t budget)
+{
+	cout << "Opening cache...\t";
+
+	m_cache = make_unique<FILECACHE>(budget);
+
+	// Obserwuj katalog roboczy i unieważniaj zmienione pliki
+	const bool ok = watch_files([this] (uint32_t ev, const string& name)
+	{
+		if (ev & IN_Q_OVERFLOW) m_cache->clear();
+		else m_cache->invalidate(name);
+	});
+
+	if (!ok) m_cache.reset();
+
+	cout << (m_cache ? "OK\n" : "FAIL\n");
+
+	return bool(m_cache);
+}
+
+bool SERVER::use_shared(size_t block)
+{
+	cout << "Opening shared read...\t";
+
+	m_shared = make_unique<SHAREDREAD>(block);
+
+	// Obserwuj katalog roboczy - zmienione pliki wymagają nowego strumienia
+	const bool ok = watch_files([this] (uint32_t ev, const string& name)
+	{
+		if (ev & IN_Q_OVERFLOW) m_shared->clear();
+		else m_shared->invalidate(name);
+	});
+
+	if (!ok) m_shared.reset();
+
+	cout << (m_shared ? "OK\n" : "FAIL\n");
+
+	return bool(m_shared);
+}
+
+bool SERVER::use_tracing(const string& path, unsigned rate)
+{
+	cout << "Opening trace file...\t";
+
+	const bool ok = m_tracer.open(path, rate);
+
+	cout << (ok ? "OK\n" : "FAIL\n");
+
+	return ok;
+}
+
+bool SERVER::use_index(bool hash)
+{
+	cout << "Opening index...\t";
+
+	m_index = make_unique<INDEX>(hash);
+
+	// Aktualizuj wpisy zmienionych plików - pomijaj pliki tymczasowe
+	const bool ok = watch_files([this] (uint32_t ev, const string& path)
+	{
+		const string name = filesystem::path(path).filename();
+
+		if (ev & IN_Q_OVERFLOW) m_index->rebuild();
+		else if (name.empty() || name[0] == '.') return;
+		else if (ev & (IN_DELETE | IN_MOVED_FROM)) m_index->remove(name);
+		else m_index->refresh(name);
+	});
+
+	if (!ok) m_index.reset();
+
+	cout << (m_index ? "OK\n" : "FAIL\n");
+
+	return bool(m_index);
+}
+
+bool SERVER::use_replicas(const vector<REPLICATOR::PEER>& chain)
+{
+	cout << "Using replicas...\t";
+
+	m_replicas = chain;
+
+	cout << REPLICATOR::join(m_replicas) << '\n';
+
+	return !m_replicas.empty();
+}
+
+bool SERVER::use_backends(const vector<PROXY::PEER>& backends)
+{
+	cout << "Opening proxy...\t";
+
+	m_proxy = make_unique<PROXY>();
+	m_proxy->set_profile(m_profile);
+
+	if (!m_proxy->open(backends)) m_proxy.reset();
+
+	cout << (m_proxy ? "OK\n" : "FAIL\n");
+
+	return bool(m_proxy);
+}
+
+bool SERVER::is_started(void) const
+{
+	return m_sock > 0;
+}
+
+bool SERVER::watch_files(const WATCHER::CALLBACK& callback)
+{
+	static const uint32_t mask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+						    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+
+	// Katalogi obserwowane są już dla wcześniejszych funkcji
+	if (!m_observers.empty())
+	{
+		m_observers.push_back(callback);
+		return true;
+	}
+
+	// Obserwowane katalogi zależą od układu przechowywania plików
+	if (!m_layout && !use_layout(string())) return false;
+
+	// Otwórz obserwator przy pierwszym użyciu
+	if (!m_watcher.is_open() && m_watcher.open() && is_started())
+		add_service(m_watcher.fd());
+
+	vector<int> ids;
+
+	// Obserwuj wszystkie katalogi z plikami jedną rejestracją wspólną dla
+	// wszystkich funkcji - zdarzenia dotyczą nazw bez katalogu, więc
+	// funkcje otrzymują pełną ścieżkę w układzie
+	for (const auto& dir : m_layout->directories())
+	{
+		const string prefix = dir == "." ? "" : dir + '/';
+
+		const int id = m_watcher.watch(dir, mask, [this, prefix] (uint32_t ev, const string& name)
+		{
+			const string path = name.empty() ? name : prefix + name;
+
+			for (const auto& callback : m_observers) callback(ev, path);
+		});
+
+		if (id != -1) { ids.push_back(id); continue; }
+
+		// Układ dwupoziomowy wymaga 65536 obserwacji
+		if (errno == ENOSPC) cout << "(raise fs.inotify.max_user_watches) ";
+
+		for (const int i : ids) m_watcher.unwatch(i);
+
+		return false;
+	}
+
+	m_observers.push_back(callback);
+
+	return true;
+}
+
+void SERVER::add_service(int fd)
+{
+	// Usługi znajdują się przed klientami na liście `poll`
+	m_sockets.insert(m_sockets.begin() + m_head, { fd, POLLIN, 0 });
+	++m_head;
+}
+
+void SERVER::remove_service(int fd)
+{
+	const auto head = m_sockets.begin() + m_head;
+	const auto p = find_if(m_sockets.begin(), head, [fd] (const pollfd& p) { return p.fd == fd; });
+
+	if (p == head) return;
+
+	m_sockets.erase(p);
+	--m_head;
+}
+
+void SERVER::on_accept(int sock, bool local)
+{
+	cout << "Accepted client:\t" << sock << '\t'
+		<< '(' << get_name(sock) << ')' << '\n';
+
+	if (!local) apply(sock, ROLE::Accepted); // Zastosuj profil strojenia
+
+	// Obiekt po zamkniętym wcześniej gnieździe o tym numerze nie zajmuje już zasobów
+	if (CLIENT* const old = m_clients.find(sock)) discount(*old);
+
+	m_sockets.push_back({ sock, POLLIN | POLLHUP, 0 }); // Dodaj socket do listy `poll`
+	auto& client = m_clients.insert(sock); // Dodaj klienta do listy klientów
+
+	client.local = local;
+	client.serial = ++m_serial;
+
+	m_tracer.begin(client.trace); // Wylosuj sesję do śledzenia
+}
+
+SERVER::ITERATOR SERVER::on_header(SERVER::ITERATOR it)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+
+	// Gdy w buforze na nagłówek jest mniej niż 32 B wolnego miejsca
+	// rozszerz bufor nagłówka o dodatkowe 64 B na dane.
+	if (client.cap - client.size < 32)
+		client.resize(client.cap + 64);
+
+	// Jeśli nie istnieje poprawny bufor na nagłówek - zakończ połączenie
+	if (!client.buff) return on_disconnect(it);
+
+	cout << "Recv header chunk from:\t" << it->fd << '\t';
+
+	// Dopisz odebrane dane do bufora, przy czym pobierz maksymalnie
+	// tyle bajtów danych, ile jest wolnego miejsca w buforze
+	ssize_t rec(0);
+
+	// Klient lokalny może dołączyć do nagłówka deskryptor pliku
+	if (client.local)
+	{
+		int fd(-1);
+
+		rec = recv_fd(it->fd,
+				    client.buff + client.size,
+				    client.cap - client.size,
+				    fd);
+
+		if (fd != -1)
+		{
+			if (client.source != -1) ::close(client.source);
+			client.source = fd;
+		}
+	}
+	else rec = ::recv(it->fd,
+				   client.buff + client.size,
+				   client.cap - client.size,
+				   0);
+
+	cout << '(' << rec << " B" << ')' << '\n';
+
+	// Jeśli wystąpił błąd lib zamknięto połączenie - zakończ połączenie
+	// W przeciwnym razie zaktualizuj rozmiar danych w buforze
+	if (rec <= 0) return on_disconnect(it);
+	else client.size += rec;
+
+	// Ramkę binarną rozpoznaj po pierwszym bajcie
+	if (FRAME::is_frame(client.buff, client.size)) return on_frame(it);
+
+	client.start = 0; // Nagłówek tekstowy nie przenosi pozycji początkowej
+
+	return on_command(it);
+}
+
+SERVER::ITERATOR SERVER::on_frame(ITERATOR it)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+
+	FRAME::REQUEST request;
+	FRAME::STATUS status;
+
+	int rc = FRAME::parse(client.buff, client.size, request, status);
+
+	// Jeśli ramka jest niekompletna - czekaj na kolejne dane
+	if (rc == 0) return ++it;
+
+	cout << "Completed frame for:\t" << it->fd << '\t'
+		<< '(' << int(request.opcode) << ':' << request.name << ':' << int(status) << ')' << '\n';
+
+	// Polecenia wielu plików nie mają jednego serwera docelowego
+	if (m_proxy && rc > 0 && !PROXY::routable(FRAME::command(request.opcode), request.name))
+	{
+		cout << "Rejected in proxy mode:\t" << it->fd << '\n';
+
+		rc = -1;
+		status = FRAME::Unsupported;
+	}
+
+	// W trybie pośrednika ramkę sprawdza i potwierdza serwer docelowy
+	if (m_proxy && rc > 0) return on_proxy(it, filesystem::path(request.name).filename());
+
+	// Pobieranie potwierdzaj dopiero po sprawdzeniu pliku
+	if (rc > 0 && (request.opcode == FRAME::Download || request.opcode == FRAME::Follow))
+		if ((status = probe(request)) != FRAME::Ok) rc = -1;
+
+	vector<char> reply;
+	FRAME::encode_reply(reply, status);
+
+	// Zgłoś wynik sprawdzenia ramki - po błędzie zakończ połączenie
+	if (!send_all(it->fd, reply.data(), reply.size()) || rc < 0) return on_disconnect(it);
+
+	// Zastąp ramkę równoważnym nagłówkiem tekstowym - jest on krótszy od
+	// stałej części ramki, więc dane za ramką wystarczy przesunąć
+	const string text = string(FRAME::command(request.opcode)) + ' ' + request.name + '\n';
+	const size_t left = client.size - request.size;
+
+	::memmove(client.buff + text.size(), client.buff + request.size, left);
+	::memcpy(client.buff, text.data(), text.size());
+
+	client.size = text.size() + left;
+	client.start = request.offset;
+
+	return on_command(it);
+}
+
+FRAME::STATUS SERVER::probe(const FRAME::REQUEST& request)
+{
+	const string name = filesystem::path(request.name).filename();
+	const bool follow = request.opcode == FRAME::Follow;
+
+	struct stat st;
+
+	// Pliki magazynu odczytywane są zawsze od początku i nie są śledzone
+	if (m_store && follow) return FRAME::Unsupported;
+	else if (m_store && m_store->contains(name)) return request.offset ? FRAME::Range : FRAME::Ok;
+
+	if (::fstatat(m_layout->dir(name), name.c_str(), &st, 0) == -1 || !S_ISREG(st.st_mode))
+		return FRAME::Missing;
+	else if (request.offset > uint64_t(st.st_size)) return FRAME::Range;
+
+	// Śledzenie czeka na dopisanie danych, pobieranie kończy się od razu
+	if (!follow && request.offset && request.offset == uint64_t(st.st_size)) return FRAME::Complete;
+	else return FRAME::Ok;
+}
+
+SERVER::ITERATOR SERVER::on_command(ITERATOR it, bool admitted)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+
+	const auto pos_start = client.buff; // Początek bufora
+	const auto pos_end = pos_start + client.size; // Koniec bufora
+	const auto pos_nl = find(pos_start, pos_end, '\n'); // Pozycja nowej linii
+
+	// Jeśli znaleziono w buforze znak nowej linii
+	if (pos_nl != pos_end)
+	{
+		// Zapisz chwilę skompletowania nagłówka (przed oczekiwaniem w kolejce)
+		if (client.trace.active && client.trace.command.empty())
+		{
+			client.trace.command.assign(pos_start, pos_nl);
+			TRACER::mark(client.trace, TRACER::Header);
+		}
+
+		// Przy wyczerpanym limicie deskryptorów odłóż kompletne żądanie
+		// (wraz z danymi za nim) do czasu zwolnienia plików przez inne połączenia
+		if (!admitted && m_limits.files)
+		{
+			if (m_files >= m_limits.files)
+			{
+				cout << "Queued request from:\t" << it->fd << '\n';
+
+				client.queued = true;
+				m_queue.push_back({ it->fd, client.serial });
+
+				it->events = 0; // Zamknięcie połączenia zgłosi `POLLHUP`
+
+				return ++it;
+			}
+		}
+
+		const auto pos_sp = find(pos_start, pos_nl, ' '); // Pozycja spacji
+
+		// Jeśli nie znaleziono spacji (brak parametru) - zakończ połączenie
+		// W przeciwnym razie zamień spację i znak nowej linii na '\0'
+		if (pos_sp == pos_nl) return on_disconnect(it);
+		else *pos_nl = *pos_sp = '\0';
+
+		cout << "Completed header for:\t" << it->fd << '\t'
+			<< '(' << pos_start << ':' << pos_sp+1 << ')' << '\n';
+
+		// W trybie pośrednika przekaż całą sesję do serwera docelowego -
+		// polecenia wielu plików nie mają jednego serwera, więc są odrzucane
+		if (m_proxy && !PROXY::routable(pos_start, pos_sp + 1))
+		{
+			cout << "Rejected in proxy mode:\t" << it->fd << '\n';
+
+			return on_disconnect(it);
+		}
+		else if (m_proxy)
+		{
+			const string key = filesystem::path(pos_sp + 1).filename();
+
+			*pos_sp = ' '; *pos_nl = '\n'; // Przywróć nagłówek
+
+			return on_proxy(it, key);
+		}
+
+		// Oblicz ile danych znajduje się za nagłówkiem
+		// ilość = rozmiar_danych - pozycja_nl - pozycja_start - 1
+		const size_t left = client.size - (pos_nl - pos_start) - 1;
+
+		// Jeśli komunikat to "UPLOAD"
+		if (strcmp(pos_start, "UPLOAD") == 0)
+		{
+			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+			const string name = filesystem::path(pos_sp + 1).filename();
+
+			// W trybie magazynu zapisuj plik jako fragmenty
+			if (m_store)
+			{
+				client.writer = make_unique<CHUNKSTORE::WRITER>(*m_store, name);
+
+				if (left > 0 && !client.writer->write(pos_nl + 1, left))
+					return on_disconnect(it);
+			}
+			else
+			{
+				// Zapisuj do pliku tymczasowego - plik docelowy zostanie
+				// podmieniony dopiero po odebraniu i utrwaleniu całości
+				client.name = m_layout->path(name);
+				client.target = COMMITTER::create(client.name, client.temp, m_layout->dir(name));
+
+				// Jeśli nie udało się utworzyć pliku - zakończ połączenie
+				// W przeciwnym razie zapisz dane za nagłówkiem (jeśli są)
+				if (client.target == -1) return on_disconnect(it);
+				else if (left > 0 && !write_all(client.target, pos_nl + 1, left))
+					return on_disconnect(it);
+
+				// Przekazuj plik do kolejnych węzłów w trakcie odbioru
+				if (!m_replicas.empty())
+				{
+					client.replica = replicate(it, name, m_replicas);
+
+					if (left > 0 && !m_replicator.push(client.replica, pos_nl + 1, left))
+						return on_disconnect(it);
+				}
+			}
+
+			client.state = STATE::Uploading; // Zmień stan na odbiór pliku.
+		}
+
+		// Jeśli komunikat to "DOWNLOAD"
+		else if (strcmp(pos_start, "DOWNLOAD") == 0)
+		{
+			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+			const string name = filesystem::path(pos_sp + 1).filename();
+
+			// Pliki z magazynu odczytuj z fragmentów (zawsze od początku)
+			if (m_store && m_store->contains(name))
+			{
+				if (client.start) return on_disconnect(it);
+
+				client.reader = make_unique<CHUNKSTORE::READER>(*m_store);
+
+				if (!client.reader->open(name)) return on_disconnect(it);
+			}
+
+			// Pliki z pamięci podręcznej wysyłaj bez otwierania, a duże pliki
+			// pobierane równocześnie przez wiele połączeń odczytuj wspólnie
+			// (wspólny odczyt zaczyna się zawsze od początku pliku)
+			else if (m_cache || (m_shared && !client.start))
+			{
+				const string path = m_layout->path(name);
+				const int dir = m_layout->dir(name);
+
+				if (m_cache) client.entry = m_cache->get(path, dir);
+
+				if (m_shared && !client.start && (!client.entry || !client.entry->loaded))
+				{
+					client.entry.reset();
+					client.cursor = m_shared->open(path, dir);
+				}
+
+				if (!client.entry && !client.cursor) return on_disconnect(it);
+			}
+			else
+			{
+				// Otwórz do odczytu plik o zadanej w parametrze nazwie
+				client.file = m_layout->open_file(name, O_RDONLY);
+
+				// Jeśli nie udało się otworzyć pliku - zakończ połączenie
+				if (client.file == -1) return on_disconnect(it);
+			}
+
+			client.offset = client.start; // Pozycja początkowa z ramki binarnej
+			client.state = STATE::Downloading; // Zmień stan na wysyłanie pliku.
+
+			// Od teraz sprawdzaj tylko gotowość do zapisu danych
+			it->events = (it->events & ~POLLIN) | POLLOUT;
+		}
+
+		// Jeśli komunikat to "FOLLOW" - wysyłaj plik i dane dopisywane do niego
+		else if (strcmp(pos_start, "FOLLOW") == 0 && !m_store)
+		{
+			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+			const string name = filesystem::path(pos_sp + 1).filename();
+			const string path = m_layout->path(name);
+			const int sock = it->fd;
+			const uint64_t serial = client.serial;
+
+			// Otwórz obserwator przy pierwszym użyciu - dodanie go do listy `poll`
+			// przesuwa klientów, więc iterator należy wyznaczyć ponownie
+			if (!m_watcher.is_open() && m_watcher.open())
+			{
+				add_service(m_watcher.fd());
+
+				it = find_if(m_sockets.begin() + m_head, m_sockets.end(),
+						   [sock] (const pollfd& p) { return p.fd == sock; });
+			}
+
+			client.file = m_layout->open_file(name, O_RDONLY);
+
+			// Jeśli nie udało się otworzyć pliku - zakończ połączenie
+			if (client.file == -1) return on_disconnect(it);
+
+			// Obserwuj plik przed odczytem - dopisania nie zostaną pominięte
+			client.watch = m_watcher.watch(path, IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF,
+									 [this, sock, serial] (uint32_t mask, const string&)
+			{
+				on_follow(sock, serial, mask);
+			});
+
+			if (client.watch == -1) return on_disconnect(it);
+
+			client.offset = client.start; // Pozycja początkowa z ramki binarnej
+			client.state = STATE::Downloading; // Zmień stan na wysyłanie pliku.
+
+			// Od teraz sprawdzaj tylko gotowość do zapisu danych
+			it->events = (it->events & ~POLLIN) | POLLOUT;
+		}
+
+		// Jeśli komunikat to "SGET" - wysyłaj jedynie obszary danych pliku
+		else if (strcmp(pos_start, "SGET") == 0)
+		{
+			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+			const string name = filesystem::path(pos_sp + 1).filename();
+			struct stat st;
+
+			// Dziury rozpoznawane są jedynie w zwykłych plikach układu
+			if (m_store && m_store->contains(name)) return on_disconnect(it);
+
+			client.file = m_layout->open_file(name, O_RDONLY);
+
+			// Jeśli nie udało się otworzyć pliku - zakończ połączenie
+			if (client.file == -1 || ::fstat(client.file, &st) == -1) return on_disconnect(it);
+
+			client.length = st.st_size; // Rozmiar zapowiedziany w rekordzie zakończenia
+			client.offset = client.extent = 0;
+			client.framed = false;
+			client.out.clear();
+			client.sent = 0;
+
+			client.state = STATE::Mapping; // Zmień stan na wysyłanie obszarów pliku.
+
+			// Od teraz sprawdzaj tylko gotowość do zapisu danych
+			it->events = (it->events & ~POLLIN) | POLLOUT;
+		}
+
+		// Jeśli komunikat to "SPUT" - odtwarzaj dziury pliku bez zapisywania zer
+		else if (strcmp(pos_start, "SPUT") == 0 && !m_store && m_replicas.empty())
+		{
+			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+			const string name = filesystem::path(pos_sp + 1).filename();
+
+			client.name = m_layout->path(name);
+			client.target = COMMITTER::create(client.name, client.temp, m_layout->dir(name));
+
+			if (client.target == -1) return on_disconnect(it);
+
+			client.in.clear();
+			client.framed = false;
+			client.extent = 0;
+			client.state = STATE::Punching; // Zmień stan na odbiór obszarów pliku.
+
+			// Przetwórz dane za nagłówkiem (jeśli są) - skopiuj
+			// je, bo bufor nagłówka zostanie wcześniej zwolniony
+			if (left > 0)
+			{
+				const vector<char> rest(pos_nl + 1, pos_nl + 1 + left);
+
+				TRACER::mark(client.trace, TRACER::Open); // Polecenie zostało rozpoczęte
+				client.clean();
+
+				return sparse_feed(it, rest.data(), rest.size());
+			}
+		}
+
+		// Jeśli komunikat to "DELTA" - plik składany z pliku bazowego
+		// nie przechodzi przez łańcuch replikacji, więc wymaga jego braku
+		else if (strcmp(pos_start, "DELTA") == 0 && m_replicas.empty())
+		{
+			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+			const string name = filesystem::path(pos_sp + 1).filename();
+
+			// Przygotuj plik bazowy i tymczasowy
+			client.delta = make_unique<DELTA>();
+
+			// Jeśli nie udało się otworzyć plików - zakończ połączenie
+			// W przeciwnym razie przetwórz dane za nagłówkiem (jeśli są)
+			client.name = m_layout->path(name);
+
+			if (!client.delta->open(client.name, m_layout->dir(name))) return on_disconnect(it);
+			else if (left > 0 && !client.delta->feed(pos_nl + 1, left))
+				return on_disconnect(it);
+
+			client.state = STATE::Signing; // Zmień stan na wysyłanie sygnatury.
+
+			// Od teraz sprawdzaj tylko gotowość do zapisu danych
+			it->events = (it->events & ~POLLIN) | POLLOUT;
+		}
+
+		// Jeśli komunikat to "CUPLOAD" i serwer posiada magazyn fragmentów
+		else if (strcmp(pos_start, "CUPLOAD") == 0 && m_store)
+		{
+			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+			const string name = filesystem::path(pos_sp + 1).filename();
+
+			client.dedup = make_unique<CHUNKSTORE::SESSION>(*m_store, name);
+			client.state = STATE::Deduping; // Zmień stan na odbiór fragmentów.
+
+			// Przetwórz dane za nagłówkiem (jeśli są) - skopiuj
+			// je, bo bufor nagłówka zostanie wcześniej zwolniony
+			if (left > 0)
+			{
+				const vector<char> rest(pos_nl + 1, pos_nl + 1 + left);
+
+				TRACER::mark(client.trace, TRACER::Open); // Polecenie zostało rozpoczęte
+				client.clean();
+
+				return dedup_feed(it, rest.data(), rest.size());
+			}
+		}
+
+		// Jeśli komunikat to "FDOWNLOAD" od klienta lokalnego
+		else if (strcmp(pos_start, "FDOWNLOAD") == 0 && client.local)
+		{
+			return on_handoff(it, filesystem::path(pos_sp + 1).filename());
+		}
+
+		// Jeśli komunikat to "FUPLOAD" od klienta lokalnego z przekazanym plikiem
+		// (import kopiowany w jądrze nie przechodzi przez łańcuch replikacji)
+		else if (strcmp(pos_start, "FUPLOAD") == 0 && client.local && client.source != -1 &&
+			    (m_store || m_replicas.empty()))
+		{
+			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+			const string name = filesystem::path(pos_sp + 1).filename();
+
+			struct stat st;
+
+			// Przyjmuj jedynie zwykłe pliki (w tym `memfd`) - kopiuj od początku
+			if (::fstat(client.source, &st) == -1 || !S_ISREG(st.st_mode) ||
+			    ::lseek(client.source, 0, SEEK_SET) == -1) return on_disconnect(it);
+
+			// W trybie magazynu zapisuj plik jako fragmenty
+			if (m_store) client.writer = make_unique<CHUNKSTORE::WRITER>(*m_store, name);
+			else
+			{
+				client.name = m_layout->path(name);
+				client.target = COMMITTER::create(client.name, client.temp, m_layout->dir(name));
+			}
+
+			if (!client.writer && client.target == -1) return on_disconnect(it);
+
+			client.state = STATE::Importing; // Zmień stan na import pliku.
+
+			// Import postępuje przy każdej gotowości gniazda do zapisu
+			it->events = (it->events & ~POLLIN) | POLLOUT;
+		}
+
+		// Jeśli komunikat to "LIST" i serwer posiada indeks metadanych
+		else if (strcmp(pos_start, "LIST") == 0 && m_index)
+		{
+			// Lista obejmuje pliki o nazwach z zadanym przedrostkiem
+			client.prefix = client.next = pos_sp + 1;
+			client.more = true;
+			client.state = STATE::Replying; // Zmień stan na wysyłanie odpowiedzi.
+
+			// Od teraz sprawdzaj tylko gotowość do zapisu danych
+			it->events = (it->events & ~POLLIN) | POLLOUT;
+		}
+
+		// Jeśli komunikat to "STAT" i serwer posiada indeks metadanych
+		else if (strcmp(pos_start, "STAT") == 0 && m_index)
+		{
+			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+			const string name = filesystem::path(pos_sp + 1).filename();
+			const auto entry = m_index->find(name);
+
+			// Odpowiedź to status i rekord pliku (pusty dla brakującego pliku)
+			WIRE::put8(client.out, entry ? 0 : 1);
+			INDEX::put(client.out, entry ? name : string(), entry ? *entry : INDEX::ENTRY());
+
+			client.state = STATE::Replying; // Zmień stan na wysyłanie odpowiedzi.
+
+			// Od teraz sprawdzaj tylko gotowość do zapisu danych
+			it->events = (it->events & ~POLLIN) | POLLOUT;
+		}
+
+		// Jeśli komunikat to "MGET"
+		else if (strcmp(pos_start, "MGET") == 0)
+		{
+			client.index = 0;
+			client.more = true;
+
+			// Parametr `-` oznacza listę nazw przesyłaną za nagłówkiem
+			if (strcmp(pos_sp + 1, "-") == 0)
+			{
+				client.batch.clear();
+				client.state = STATE::Requesting; // Zmień stan na odbiór listy.
+
+				// Przetwórz dane za nagłówkiem (jeśli są) - skopiuj
+				// je, bo bufor nagłówka zostanie wcześniej zwolniony
+				if (left > 0)
+				{
+					const vector<char> rest(pos_nl + 1, pos_nl + 1 + left);
+
+					TRACER::mark(client.trace, TRACER::Open); // Polecenie zostało rozpoczęte
+					client.clean();
+
+					return request_feed(it, rest.data(), rest.size());
+				}
+			}
+			else
+			{
+				// W przeciwnym razie parametr jest wzorcem nazw plików
+				client.batch = match_files(filesystem::path(pos_sp + 1).filename());
+				client.state = STATE::Streaming; // Zmień stan na wysyłanie plików.
+
+				// Od teraz sprawdzaj tylko gotowość do zapisu danych
+				it->events = (it->events & ~POLLIN) | POLLOUT;
+			}
+		}
+
+		// Jeśli komunikat to "MPUT"
+		else if (strcmp(pos_start, "MPUT") == 0)
+		{
+			client.in.clear();
+			client.framed = false;
+			client.more = true;
+			client.stored = client.failed = client.waiting = 0;
+			client.state = STATE::Receiving; // Zmień stan na odbiór plików.
+
+			// Przetwórz dane za nagłówkiem (jeśli są) - skopiuj
+			// je, bo bufor nagłówka zostanie wcześniej zwolniony
+			if (left > 0)
+			{
+				const vector<char> rest(pos_nl + 1, pos_nl + 1 + left);
+
+				TRACER::mark(client.trace, TRACER::Open); // Polecenie zostało rozpoczęte
+				client.clean();
+
+				return receive_feed(it, rest.data(), rest.size());
+			}
+		}
+
+		// Jeśli komunikat to "REPLICATE" od poprzedniego węzła łańcucha
+		else if (strcmp(pos_start, "REPLICATE") == 0 && !m_store)
+		{
+			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+			const string name = filesystem::path(pos_sp + 1).filename();
+
+			client.name = m_layout->path(name);
+			client.target = COMMITTER::create(client.name, client.temp, m_layout->dir(name));
+
+			if (client.target == -1) return on_disconnect(it);
+
+			client.in.clear();
+			client.chained = client.framed = false;
+			client.state = STATE::Replicating; // Zmień stan na odbiór repliki.
+
+			// Przetwórz dane za nagłówkiem (jeśli są) - skopiuj
+			// je, bo bufor nagłówka zostanie wcześniej zwolniony
+			if (left > 0)
+			{
+				const vector<char> rest(pos_nl + 1, pos_nl + 1 + left);
+
+				TRACER::mark(client.trace, TRACER::Open); // Polecenie zostało rozpoczęte
+				client.clean();
+
+				return replicate_feed(it, rest.data(), rest.size());
+			}
+		}
+
+		// Jeśli nie rozpoznano komunikatu zamknij połączenie
+		else return on_disconnect(it);
+
+		TRACER::mark(client.trace, TRACER::Open); // Polecenie zostało rozpoczęte
+
+		client.clean(); // Wyczyść bufor na nagłówek - nie będzie już potrzebny
+	}
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+SERVER::ITERATOR SERVER::on_upload(ITERATOR it)
+{
+	// Wstrzymaj odbiór, gdy kolejne węzły nie nadążają z zapisem
+	if (throttle(it)) return ++it;
+
+	cout << "Recv file chunk from:\t" << it->fd << '\t';
+
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+	char* const data = m_chunk.data();
+
+	// Odczytaj fragment pliku od klienta
+	ssize_t rec = ::recv(it->fd, data, client.pace.chunk, 0);
+
+	cout << '(' << rec << " B" << ')' << '\n';
+
+	if (m_pacing) PACER::received(it->fd, client.pace, rec, !m_profile.rcvbuf);
+	if (rec > 0) TRACER::data(client.trace);
+
+	// W trybie magazynu zatwierdź plik po zamknięciu połączenia przez klienta
+	if (client.writer && rec == 0)
+	{
+		cout << "Completed store for:\t" << it->fd << '\t'
+			<< '(' << (client.writer->commit() ? "OK" : "FAIL") << ')' << '\n';
+	}
+
+	// W przeciwnym razie przekaż plik tymczasowy do grupowego zatwierdzenia
+	else if (rec == 0)
+	{
+		cout << "Completed upload for:\t" << it->fd << '\n';
+
+		const string name = filesystem::path(client.name).filename();
+
+		// Po zatwierdzeniu zaktualizuj indeks bez oczekiwania na `inotify`
+		commit(client.target, client.temp, client.name, client.replica, [this, name] (bool ok)
+		{
+			if (ok && m_index) m_index->refresh(name);
+		});
+		client.target = -1;
+		client.replica = 0;
+		client.temp.clear();
+	}
+
+	// Jeśli nie udało się odczytać żadnych danych - zakończ połączenie
+	// W przeciwnym razie zapisz dane do pliku związanego z klientem
+	if (rec <= 0) return on_disconnect(it);
+	else if (!client.writer && !write_all(client.target, data, rec)) return on_disconnect(it);
+	else if (client.writer && !client.writer->write(data, rec)) return on_disconnect(it);
+	else if (client.replica && !m_replicator.push(client.replica, data, rec))
+	{
+		cout << "Replication failed:\t" << it->fd << '\n';
+
+		return on_disconnect(it);
+	}
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+SERVER::ITERATOR SERVER::on_download(ITERATOR it)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+
+	// Plik z pamięci podręcznej wysyłaj bezpośrednio z pamięci lub
+	// odczytując dane z otwartego deskryptora od bieżącej pozycji
+	if (client.entry)
+	{
+		const auto& entry = *client.entry;
+
+		// Po wysłaniu całego pliku zakończ połączenie
+		if (client.offset >= entry.size) return on_disconnect(it);
+
+		cout << "Sending file chunk to:\t" << it->fd << '\t';
+
+		const char* data = entry.loaded ? entry.data.data() + client.offset : m_chunk.data();
+		ssize_t rc = min<uint64_t>(entry.size - client.offset, client.pace.chunk);
+
+		if (!entry.loaded) rc = ::pread(entry.fd, m_chunk.data(), rc, client.offset);
+
+		// Gdy nie odczytano danych - zakończ połączenie
+		if (rc <= 0) return on_disconnect(it);
+
+		const ssize_t sd = send_chunk(it->fd, data, rc);
+
+		cout << '(' << sd << '/' << rc << " B" << ')' << '\n';
+
+		if (m_pacing) PACER::sent(it->fd, client.pace, rc, sd, !m_profile.sndbuf);
+
+		if (sd < 0) return on_disconnect(it);
+		else if (sd == 0) return ++it;
+		else client.offset += sd;
+
+		TRACER::data(client.trace);
+
+		return ++it;
+	}
+
+	// Plik odczytywany wspólnie wysyłaj bezpośrednio ze współdzielonego bloku
+	else if (client.cursor)
+	{
+		const char* data = nullptr;
+		const ssize_t rc = client.cursor->peek(data);
+
+		// Na końcu pliku lub w przypadku błędu zakończ połączenie
+		if (rc <= 0) return on_disconnect(it);
+
+		cout << "Sending file chunk to:\t" << it->fd << '\t';
+
+		const ssize_t sd = send_chunk(it->fd, data, rc);
+
+		cout << '(' << sd << '/' << rc << " B" << ')' << '\n';
+
+		if (sd < 0) return on_disconnect(it);
+		else if (sd == 0) return ++it;
+		else client.cursor->advance(sd);
+
+		TRACER::data(client.trace);
+
+		return ++it;
+	}
+
+	// Plik z magazynu wysyłaj przez bufor danych oczekujących
+	else if (client.reader)
+	{
+		// Gdy bufor został wysłany odczytaj kolejny fragment pliku
+		if (client.sent == client.out.size())
+		{
+			client.out.resize(sizeof(m_buff));
+			client.sent = 0;
+
+			const ssize_t rc = client.reader->read(client.out.data(), client.out.size());
+
+			// Na końcu pliku lub w przypadku błędu zakończ połączenie
+			if (rc <= 0) return on_disconnect(it);
+			else client.out.resize(rc);
+		}
+
+		cout << "Sending file chunk to:\t" << it->fd << '\t';
+
+		const size_t rc = client.out.size() - client.sent;
+		const ssize_t sd = send_out(client);
+
+		cout << '(' << sd << '/' << rc << " B" << ')' << '\n';
+
+		if (sd < 0) return on_disconnect(it);
+		else return ++it;
+	}
+
+	// Odczytaj fragment danych od bieżącej pozycji - rozmiar fragmentu
+	// odpowiada miejscu, jakie zwykle jest wolne w buforze gniazda
+	const ssize_t rc = ::pread(client.file, m_chunk.data(), client.pace.chunk, client.offset);
+	struct stat st;
+
+	// Śledzony plik po dotarciu do jego końca czeka na dopisanie danych
+	// Plik skrócony, usunięty (otwarty plik nie ma już dowiązań - zdarzenie
+	// `IN_DELETE_SELF` nie nadejdzie) lub przeniesiony kończy sesję
+	if (rc == 0 && client.watch != -1 && !client.gone && ::fstat(client.file, &st) == 0 &&
+	    st.st_nlink > 0 && uint64_t(st.st_size) >= client.offset)
+	{
+		client.state = STATE::Following;
+		it->events = (it->events & ~POLLOUT) | POLLIN;
+
+		return ++it;
+	}
+
+	// Na końcu pliku lub w przypadku błędu zakończ połączenie
+	if (rc <= 0) return on_disconnect(it);
+
+	cout << "Sending file chunk to:\t" << it->fd << '\t';
+
+	// Wyślij tyle odczytanych danych, ile zmieści bufor gniazda - pętla
+	// nie czeka na wolnego klienta, a niepełne wysłanie zmniejszy porcję
+	const ssize_t sd = send_chunk(it->fd, m_chunk.data(), rc);
+
+	cout << '(' << sd << '/' << rc << " B" << ')' << '\n';
+
+	if (m_pacing) PACER::sent(it->fd, client.pace, rc, sd, !m_profile.sndbuf);
+
+	// Sprawdź, czy udało się wysłać dane - przy pełnym buforze
+	// gniazda odczytany fragment zostanie odczytany ponownie
+	if (sd < 0) return on_disconnect(it);
+	else if (sd == 0) return ++it;
+
+	// Przy niepełnym wysyłaniu kolejny odczyt zacznie się od pierwszego
+	// niewysłanego bajtu
+	else client.offset += sd;
+
+	TRACER::data(client.trace);
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+void SERVER::on_follow(int sock, uint64_t serial, uint32_t mask)
+{
+	CLIENT* const c = m_clients.find(sock);
+
+	// Klient mógł się w międzyczasie rozłączyć (a deskryptor zostać ponownie użyty)
+	if (!c || c->serial != serial) return;
+
+	// Usunięty plik zostanie wysłany do końca, po czym sesja się zakończy
+	if (mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED | IN_Q_OVERFLOW)) c->gone = true;
+
+	// Wznowienie jest już zaplanowane - dopisane dane zostaną wysłane razem
+	if (c->armed) return;
+
+	c->armed = true;
+	m_wakeups.emplace_back(chrono::steady_clock::now() + follow_delay, sock, serial);
+}
+
+int SERVER::wake_followers(void)
+{
+	const auto now = chrono::steady_clock::now();
+
+	while (!m_wakeups.empty() && get<0>(m_wakeups.front()) <= now)
+	{
+		const int sock = get<1>(m_wakeups.front());
+		const uint64_t serial = get<2>(m_wakeups.front());
+		CLIENT* const c = m_clients.find(sock);
+
+		m_wakeups.pop_front();
+
+		// Klient mógł się w międzyczasie rozłączyć
+		if (!c || c->serial != serial) continue;
+
+		c->armed = false;
+
+		// Klient w trakcie wysyłania sam odczyta dopisane dane
+		if (c->state != STATE::Following) continue;
+
+		const auto it = find_if(m_sockets.begin() + m_head, m_sockets.end(),
+						    [sock] (const pollfd& p) { return p.fd == sock; });
+
+		if (it == m_sockets.end()) continue;
+
+		c->state = STATE::Downloading;
+		it->events = (it->events & ~POLLIN) | POLLOUT;
+	}
+
+	if (m_wakeups.empty()) return -1;
+	else return chrono::ceil<chrono::milliseconds>(get<0>(m_wakeups.front()) - now).count();
+}
+
+void SERVER::unfollow(CLIENT& client)
+{
+	if (client.watch != -1) m_watcher.unwatch(client.watch);
+
+	client.watch = -1;
+}
+
+SERVER::ITERATOR SERVER::on_signature(ITERATOR it)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+
+	// Gdy bufor został wysłany wygeneruj kolejny fragment sygnatury
+	if (client.sent == client.out.size())
+	{
+		client.out.clear();
+		client.sent = 0;
+
+		if (!client.delta->sign(client.out)) return on_disconnect(it);
+	}
+
+	// Gdy cała sygnatura została wysłana czekaj na strumień zmian
+	if (client.out.empty())
+	{
+		client.state = STATE::Patching;
+		it->events = (it->events & ~POLLOUT) | POLLIN;
+
+		return ++it;
+	}
+
+	cout << "Sending signature to:\t" << it->fd << '\t';
+
+	const size_t rc = client.out.size() - client.sent;
+	const ssize_t sd = send_out(client);
+
+	cout << '(' << sd << '/' << rc << " B" << ')' << '\n';
+
+	// Sprawdź, czy udało się wysłać dane - pełny bufor gniazda nie jest błędem
+	if (sd < 0) return on_disconnect(it);
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+SERVER::ITERATOR SERVER::on_patch(ITERATOR it)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+
+	cout << "Recv delta chunk from:\t" << it->fd << '\t';
+
+	// Odczytaj fragment strumienia zmian od klienta
+	ssize_t rec = ::recv(it->fd, m_buff, sizeof(m_buff), 0);
+
+	cout << '(' << rec << " B" << ')' << '\n';
+
+	// Jeśli nie udało się odczytać danych lub są one błędne - zakończ połączenie
+	if (rec <= 0 || !client.delta->feed(m_buff, rec)) return on_disconnect(it);
+
+	// Po odebraniu całego strumienia zatwierdź plik grupowo - status
+	// zostanie odesłany dopiero po utrwaleniu pliku na dysku
+	if (client.delta->is_done())
+	{
+		string temp;
+
+		const int fd = client.delta->release(temp);
+		const int sock = it->fd;
+		const uint64_t serial = client.serial;
+		const string name = filesystem::path(client.name).filename();
+
+		cout << "Completed delta for:\t" << it->fd << '\t'
+			<< '(' << (fd != -1 ? "OK" : "FAIL") << ')' << '\n';
+
+		if (fd == -1)
+		{
+			const char status(1);
+
+			send_all(it->fd, &status, sizeof(status));
+
+			return on_disconnect(it);
+		}
+
+		m_committer.submit(fd, temp, client.name, [this, sock, serial, name] (bool ok)
+		{
+			if (ok && m_index) m_index->refresh(name);
+
+			on_committed(sock, serial, ok);
+		});
+
+		client.delta.reset();
+		client.state = STATE::Committing;
+
+		// Czekaj jedynie na ewentualne rozłączenie
+		it->events = 0;
+	}
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+SERVER::ITERATOR SERVER::on_dedup(ITERATOR it)
+{
+	cout << "Recv dedup chunk from:\t" << it->fd << '\t';
+
+	// Odczytaj fragment danych od klienta
+	ssize_t rec = ::recv(it->fd, m_buff, sizeof(m_buff), 0);
+
+	cout << '(' << rec << " B" << ')' << '\n';
+
+	// Jeśli nie udało się odczytać danych - zakończ połączenie
+	if (rec <= 0) return on_disconnect(it);
+	else return dedup_feed(it, m_buff, rec);
+}
+
+SERVER::ITERATOR SERVER::dedup_feed(ITERATOR it, const char* data, size_t size)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+	vector<char> reply; // Odpowiedź na zapytania o fragmenty
+
+	// Jeśli dane są błędne - zakończ połączenie
+	if (!client.dedup->feed(data, size, reply)) return on_disconnect(it);
+
+	// Odpowiedzi są niewielkie (mapa bitowa) - wyślij je od razu
+	if (!reply.empty() && !send_all(it->fd, reply.data(), reply.size()))
+		return on_disconnect(it);
+
+	// Po odebraniu całego pliku zatwierdź manifest i odeślij status
+	if (client.dedup->is_done())
+	{
+		const char status = client.dedup->commit() ? 0 : 1;
+
+		cout << "Completed dedup for:\t" << it->fd << '\t'
+			<< '(' << (status ? "FAIL" : "OK") << ')' << '\n';
+
+		send_all(it->fd, &status, sizeof(status));
+
+		return on_disconnect(it);
+	}
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+SERVER::ITERATOR SERVER::on_reply(ITERATOR it)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+
+	// Gdy bufor został wysłany dopisz kolejną porcję listy
+	if (client.sent == client.out.size())
+	{
+		client.out.clear();
+		client.sent = 0;
+
+		if (client.more)
+			client.more = !m_index->list(client.prefix, client.next, client.out, sizeof(m_buff));
+	}
+
+	// Po wysłaniu całej odpowiedzi zakończ połączenie
+	if (client.out.empty()) return on_disconnect(it);
+
+	cout << "Sending index reply to:\t" << it->fd << '\t';
+
+	const size_t rc = client.out.size() - client.sent;
+	const ssize_t sd = send_out(client);
+
+	cout << '(' << sd << '/' << rc << " B" << ')' << '\n';
+
+	// Sprawdź, czy udało się wysłać dane - pełny bufor gniazda nie jest błędem
+	if (sd < 0) return on_disconnect(it);
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+SERVER::ITERATOR SERVER::on_request(ITERATOR it)
+{
+	cout << "Recv name list from:\t" << it->fd << '\t';
+
+	// Odczytaj fragment listy nazw od klienta
+	ssize_t rec = ::recv(it->fd, m_buff, sizeof(m_buff), 0);
+
+	cout << '(' << rec << " B" << ')' << '\n';
+
+	// Jeśli nie udało się odczytać danych - zakończ połączenie
+	if (rec <= 0) return on_disconnect(it);
+	else return request_feed(it, m_buff, rec);
+}
+
+SERVER::ITERATOR SERVER::request_feed(ITERATOR it, const char* data, size_t size)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+	auto& in = client.in; // Niepełne rekordy
+
+	in.insert(in.end(), data, data + size);
+
+	size_t pos(0);
+
+	// Przetwórz wszystkie kompletne rekordy
+	while (in.size() - pos >= 2)
+	{
+		const size_t len = WIRE::get16(in.data() + pos);
+
+		// Rekord o zerowej długości kończy listę - rozpocznij wysyłanie
+		if (len == 0)
+		{
+			// Dane za końcem listy są błędem protokołu
+			if (in.size() - pos > 2) return on_disconnect(it);
+
+			in.clear();
+
+			client.state = STATE::Streaming;
+			it->events = (it->events & ~POLLIN) | POLLOUT;
+
+			return ++it;
+		}
+		else if (in.size() - pos < 2 + len) break;
+
+		// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+		const string name = filesystem::path(string(in.data() + pos + 2, len)).filename();
+
+		if (!name.empty()) client.batch.push_back(name);
+
+		// Ogranicz pamięć zajmowaną przez listę jednego klienta
+		if (client.batch.size() > (1 << 20)) return on_disconnect(it);
+
+		pos += 2 + len;
+	}
+
+	in.erase(in.begin(), in.begin() + pos);
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+SERVER::ITERATOR SERVER::on_stream(ITERATOR it)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+
+	// Gdy bufor został wysłany przygotuj kolejną porcję strumienia
+	if (client.sent == client.out.size())
+	{
+		auto& out = client.out;
+
+		out.clear();
+		client.sent = 0;
+
+		while (out.size() < stream_block)
+		{
+			// Dopisz kolejną część bieżącego pliku
+			if (client.input != -1)
+			{
+				const size_t pos = out.size();
+				const size_t n = min<uint64_t>(client.length - client.offset, stream_block - pos);
+
+				out.resize(pos + n);
+
+				const ssize_t rc = ::pread(client.input, out.data() + pos, n, client.offset);
+
+				// Plik skrócony w trakcie wysyłania psuje ramkę - zakończ połączenie
+				if (rc <= 0) return on_disconnect(it);
+				else out.resize(pos + rc);
+
+				client.offset += rc;
+
+				if (client.offset == client.length)
+				{
+					::close(client.input);
+					client.input = -1;
+				}
+			}
+
+			// Otwórz kolejny plik i dopisz nagłówek jego ramki
+			else if (client.index < client.batch.size())
+			{
+				const string& name = client.batch[client.index++];
+				const int fd = m_layout->open_file(name, O_RDONLY);
+
+				struct stat st;
+
+				// Pomiń pliki brakujące lub niebędące zwykłymi plikami
+				if (fd == -1) continue;
+				else if (::fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+				{
+					::close(fd);
+					continue;
+				}
+
+				WIRE::put16(out, name.size());
+				out.insert(out.end(), name.begin(), name.end());
+				WIRE::put64(out, st.st_size);
+
+				client.offset = 0;
+				client.length = st.st_size;
+
+				if (client.length) client.input = fd;
+				else ::close(fd);
+			}
+
+			// Po ostatnim pliku dopisz ramkę zakończenia
+			else if (client.more)
+			{
+				WIRE::put16(out, 0);
+				client.more = false;
+			}
+
+			else break;
+		}
+	}
+
+	// Po wysłaniu całego strumienia czekaj na kolejny nagłówek
+	if (client.out.empty())
+	{
+		client.batch.clear();
+		client.out.clear();
+		client.sent = client.index = 0;
+		client.state = STATE::Waiting;
+
+		it->events = (it->events & ~POLLOUT) | POLLIN;
+
+		// Przywróć bufor na nagłówek
+		if (!client.resize(64)) return on_disconnect(it);
+		else return ++it;
+	}
+
+	cout << "Sending stream to:\t" << it->fd << '\t';
+
+	const size_t rc = client.out.size() - client.sent;
+	const ssize_t sd = send_out(client);
+
+	cout << '(' << sd << '/' << rc << " B" << ')' << '\n';
+
+	// Sprawdź, czy udało się wysłać dane - pełny bufor gniazda nie jest błędem
+	if (sd < 0) return on_disconnect(it);
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+SERVER::ITERATOR SERVER::on_receive(ITERATOR it)
+{
+	// Wstrzymaj odbiór, gdy kolejne węzły nie nadążają z zapisem
+	if (throttle(it)) return ++it;
+
+	cout << "Recv stream chunk from:\t" << it->fd << '\t';
+
+	// Odczytaj fragment strumienia od klienta
+	ssize_t rec = ::recv(it->fd, m_buff, sizeof(m_buff), 0);
+
+	cout << '(' << rec << " B" << ')' << '\n';
+
+	// Jeśli nie udało się odczytać danych - zakończ połączenie
+	if (rec <= 0) return on_disconnect(it);
+
+	TRACER::data(m_clients[it->fd].trace);
+
+	return receive_feed(it, m_buff, rec);
+}
+
+SERVER::ITERATOR SERVER::receive_feed(ITERATOR it, const char* data, size_t size)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+	auto& head = client.in; // Niepełny nagłówek ramki
+
+	// Kończy bieżący plik - zatwierdza go lub przekazuje do zatwierdzenia
+	const auto finish = [this, &client, sock = it->fd] (void)
+	{
+		client.framed = false;
+
+		if (client.writer)
+		{
+			if (client.writer->commit()) ++client.stored;
+			else ++client.failed;
+
+			client.writer.reset();
+		}
+		else if (client.target != -1)
+		{
+			const uint64_t serial = client.serial;
+
+			++client.waiting;
+
+			commit(client.target, client.temp, client.name, client.replica,
+				  [this, sock, serial] (bool ok) { on_stored(sock, serial, ok); });
+
+			client.target = -1;
+			client.replica = 0;
+			client.temp.clear();
+		}
+		else ++client.failed;
+	};
+
+	while (size > 0)
+	{
+		// Kompletuj nagłówek ramki: długość nazwy, nazwa i rozmiar
+		if (!client.framed)
+		{
+			const size_t need = head.size() < 2 ? 2 : 2 + WIRE::get16(head.data()) + 8;
+			const size_t take = min(size, need - head.size());
+
+			head.insert(head.end(), data, data + take);
+			data += take; size -= take;
+
+			if (head.size() < 2) continue;
+
+			const size_t len = WIRE::get16(head.data());
+
+			// Ramka zakończenia - dane za nią są błędem protokołu
+			if (len == 0)
+			{
+				if (size > 0) return on_disconnect(it);
+
+				head.clear();
+				client.more = false;
+
+				// Czekaj na zatwierdzenie pozostałych plików
+				if (client.waiting) break;
+				else return finish_receive(it);
+			}
+			else if (head.size() < 2 + len + 8) continue;
+
+			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
+			const string name = filesystem::path(string(head.data() + 2, len)).filename();
+
+			client.length = WIRE::get64(head.data() + 2 + len);
+			client.framed = true;
+
+			head.clear();
+
+			// Pliki o niepoprawnych nazwach są odbierane, ale nie zapisywane
+			if (!name.empty() && name != "." && name != "..")
+			{
+				if (m_store) client.writer = make_unique<CHUNKSTORE::WRITER>(*m_store, name);
+				else
+				{
+					client.name = m_layout->path(name);
+					client.target = COMMITTER::create(client.name, client.temp, m_layout->dir(name));
+
+					// Przekazuj plik do kolejnych węzłów w trakcie odbioru
+					if (client.target != -1 && !m_replicas.empty())
+						client.replica = replicate(it, name, m_replicas);
+				}
+			}
+
+			if (!client.length) finish();
+		}
+
+		// Zapisz dane bieżącego pliku
+		else
+		{
+			const size_t take = min<uint64_t>(size, client.length);
+
+			// Błąd zapisu porzuca plik, ale nie przerywa strumienia
+			if (client.writer && !client.writer->write(data, take)) client.writer.reset();
+			else if (client.target != -1 && (!write_all(client.target, data, take) ||
+					 (client.replica && !m_replicator.push(client.replica, data, take))))
+			{
+				COMMITTER::discard(client.target, client.temp);
+				client.target = -1;
+
+				if (client.replica) m_replicator.abort(client.replica);
+				client.replica = 0;
+			}
+
+			data += take; size -= take;
+			client.length -= take;
+
+			if (!client.length) finish();
+		}
+	}
+
+	// Po ramce zakończenia czekaj jedynie na ewentualne rozłączenie
+	if (!client.more)
+	{
+		client.state = STATE::Committing;
+		it->events = 0;
+	}
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+void SERVER::on_stored(int sock, uint64_t serial, bool ok)
+{
+	CLIENT* const c = m_clients.find(sock);
+
+	// Klient mógł się w międzyczasie rozłączyć (a deskryptor zostać ponownie użyty)
+	if (!c || c->serial != serial) return;
+
+	auto& client = *c;
+
+	if (ok) ++client.stored;
+	else ++client.failed;
+
+	// Po zatwierdzeniu ostatniego pliku zakończonego strumienia odeślij wynik
+	if (--client.waiting || client.more) return;
+
+	const auto it = find_if(m_sockets.begin() + m_head, m_sockets.end(),
+					    [sock] (const pollfd& p) { return p.fd == sock; });
+
+	if (it != m_sockets.end()) finish_receive(it);
+}
+
+SERVER::ITERATOR SERVER::finish_receive(ITERATOR it)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+	vector<char> reply;
+
+	WIRE::put32(reply, client.stored);
+	WIRE::put32(reply, client.failed);
+
+	cout << "Completed stream for:\t" << it->fd << '\t'
+		<< '(' << client.stored << '/' << client.stored + client.failed << ')' << '\n';
+
+	// Odpowiedź jest niewielka - wyślij ją od razu
+	if (!send_all(it->fd, reply.data(), reply.size())) return on_disconnect(it);
+
+	// Czekaj na kolejny nagłówek w tym samym połączeniu
+	client.state = STATE::Waiting;
+	it->events = POLLIN | POLLHUP;
+
+	if (!client.resize(64)) return on_disconnect(it);
+	else return ++it;
+}
+
+SERVER::ITERATOR SERVER::on_replicate(ITERATOR it)
+{
+	// Wstrzymaj odbiór, gdy kolejne węzły nie nadążają z zapisem
+	if (throttle(it)) return ++it;
+
+	cout << "Recv replica chunk from:\t" << it->fd << '\t';
+
+	// Odczytaj fragment pliku od poprzedniego węzła
+	ssize_t rec = ::recv(it->fd, m_buff, sizeof(m_buff), 0);
+
+	cout << '(' << rec << " B" << ')' << '\n';
+
+	// Jeśli nie udało się odczytać danych - zakończ połączenie
+	if (rec <= 0) return on_disconnect(it);
+
+	TRACER::data(m_clients[it->fd].trace);
+
+	return replicate_feed(it, m_buff, rec);
+}
+
+SERVER::ITERATOR SERVER::replicate_feed(ITERATOR it, const char* data, size_t size)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+	auto& head = client.in; // Niepełna lista węzłów lub długość rekordu
+
+	while (size > 0)
+	{
+		// Kompletuj listę pozostałych węzłów łańcucha
+		if (!client.chained)
+		{
+			const size_t need = head.size() < 2 ? 2 : 2 + WIRE::get16(head.data());
+			const size_t take = min(size, need - head.size());
+
+			head.insert(head.end(), data, data + take);
+			data += take; size -= take;
+
+			// Po odebraniu długości kompletuj samą listę (o ile nie jest pusta)
+			if (head.size() < need || (need == 2 && WIRE::get16(head.data()) > 0)) continue;
+
+			vector<REPLICATOR::PEER> chain;
+
+			// Niepoprawna lista węzłów jest błędem protokołu
+			if (!REPLICATOR::split(string(head.data() + 2, head.size() - 2), chain))
+				return on_disconnect(it);
+
+			// Przekazuj plik jedynie do węzłów podanych opcją `--replica` - w
+			// przeciwnym razie dowolny klient mógłby wskazać adres połączenia
+			for (const auto& peer : chain) if (find(m_replicas.begin(), m_replicas.end(), peer) == m_replicas.end())
+			{
+				cout << "Unknown replica:\t" << REPLICATOR::join({ peer }) << '\n';
+
+				return on_disconnect(it);
+			}
+
+			// Przekazuj plik dalej, jeśli łańcuch się nie kończy
+			if (!chain.empty())
+			{
+				const string name = filesystem::path(client.name).filename();
+
+				client.replica = replicate(it, name, chain);
+			}
+
+			client.chained = true;
+			head.clear();
+		}
+
+		// Kompletuj długość rekordu
+		else if (!client.framed)
+		{
+			const size_t take = min(size, 4 - head.size());
+
+			head.insert(head.end(), data, data + take);
+			data += take; size -= take;
+
+			if (head.size() < 4) continue;
+
+			client.length = WIRE::get32(head.data());
+			client.framed = true;
+
+			head.clear();
+
+			// Rekord zakończenia - dane za nim są błędem protokołu
+			if (client.length == 0)
+			{
+				if (size > 0) return on_disconnect(it);
+
+				client.framed = false;
+
+				// Plik, którego nie udało się zapisać, zgłoś od razu
+				if (client.target == -1) return finish_replicate(it, false);
+
+				const string name = filesystem::path(client.name).filename();
+				const uint64_t serial = client.serial;
+				const int sock = it->fd;
+
+				// Po zatwierdzeniu zaktualizuj indeks bez oczekiwania na `inotify`
+				commit(client.target, client.temp, client.name, client.replica,
+					  [this, sock, serial, name] (bool ok)
+				{
+					if (ok && m_index) m_index->refresh(name);
+
+					on_replicated(sock, serial, ok);
+				});
+
+				client.target = -1;
+				client.replica = 0;
+				client.temp.clear();
+
+				// Czekaj na zatwierdzenie pliku
+				client.state = STATE::Committing;
+				it->events = 0;
+
+				return ++it;
+			}
+		}
+
+		// Zapisz dane rekordu i przekaż je dalej
+		else
+		{
+			const size_t take = min<uint64_t>(size, client.length);
+
+			// Błąd zapisu porzuca plik - status zostanie odesłany po ostatnim rekordzie
+			if (client.target != -1 && (!write_all(client.target, data, take) ||
+					 (client.replica && !m_replicator.push(client.replica, data, take))))
+			{
+				COMMITTER::discard(client.target, client.temp);
+				client.target = -1;
+
+				if (client.replica) m_replicator.abort(client.replica);
+				client.replica = 0;
+			}
+
+			data += take; size -= take;
+			client.length -= take;
+
+			if (!client.length) client.framed = false;
+		}
+	}
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+SERVER::ITERATOR SERVER::on_extents(ITERATOR it)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+
+	// Gdy bufor został wysłany przygotuj kolejny rekord lub fragment danych
+	if (client.sent == client.out.size())
+	{
+		client.out.clear();
+		client.sent = 0;
+
+		// Po wysłaniu rekordu zakończenia zamknij połączenie
+		if (client.extent == 0 && client.framed) return on_disconnect(it);
+
+		// Wyznacz kolejny obszar danych - dziurę przed nim opisz rekordem
+		else if (client.extent == 0)
+		{
+			uint64_t data(0), end(0);
+
+			if (!SPARSE::next(client.file, client.offset, client.length, data, end))
+				return on_disconnect(it);
+
+			if (data > client.offset)
+				SPARSE::put(client.out, SPARSE::Hole, client.offset, data - client.offset);
+
+			if (data == end)
+			{
+				SPARSE::put(client.out, SPARSE::End, client.length, 0);
+				client.framed = true;
+			}
+			else SPARSE::put(client.out, SPARSE::Data, data, end - data);
+
+			client.offset = data;
+			client.extent = end - data;
+		}
+
+		// Odczytaj fragment bieżącego obszaru danych
+		else
+		{
+			client.out.resize(min<uint64_t>(client.extent, sizeof(m_buff)));
+
+			const ssize_t rc = ::pread(client.file, client.out.data(), client.out.size(), client.offset);
+
+			// Plik skrócony w trakcie wysyłania psuje strumień - zakończ połączenie
+			if (rc <= 0) return on_disconnect(it);
+
+			client.out.resize(rc);
+			client.offset += rc;
+			client.extent -= rc;
+		}
+	}
+
+	cout << "Sending extent to:\t" << it->fd << '\t';
+
+	const size_t rc = client.out.size() - client.sent;
+	const ssize_t sd = send_out(client);
+
+	cout << '(' << sd << '/' << rc << " B" << ')' << '\n';
+
+	// Sprawdź, czy udało się wysłać dane - pełny bufor gniazda nie jest błędem
+	if (sd < 0) return on_disconnect(it);
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+SERVER::ITERATOR SERVER::on_punch(ITERATOR it)
+{
+	cout << "Recv extent chunk from:\t" << it->fd << '\t';
+
+	// Odczytaj fragment strumienia od klienta
+	ssize_t rec = ::recv(it->fd, m_buff, sizeof(m_buff), 0);
+
+	cout << '(' << rec << " B" << ')' << '\n';
+
+	// Jeśli nie udało się odczytać danych - zakończ połączenie
+	if (rec <= 0) return on_disconnect(it);
+
+	TRACER::data(m_clients[it->fd].trace);
+
+	return sparse_feed(it, m_buff, rec);
+}
+
+SERVER::ITERATOR SERVER::sparse_feed(ITERATOR it, const char* data, size_t size)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+	auto& head = client.in; // Niepełny rekord
+
+	while (size > 0)
+	{
+		// Kompletuj rekord
+		if (!client.framed)
+		{
+			const size_t take = min(size, SPARSE::header - head.size());
+
+			head.insert(head.end(), data, data + take);
+			data += take; size -= take;
+
+			if (head.size() < SPARSE::header) continue;
+
+			const char type = head[0];
+			const uint64_t offset = WIRE::get64(head.data() + 1);
+			const uint64_t length = WIRE::get64(head.data() + 9);
+
+			head.clear();
+
+			// Rekord zakończenia ustala rozmiar pliku (również końcowej dziury)
+			if (type == SPARSE::End)
+			{
+				// Dane za rekordem zakończenia są błędem protokołu
+				if (size > 0 || ::ftruncate(client.target, offset) != 0) return on_disconnect(it);
+
+				const int sock = it->fd;
+				const uint64_t serial = client.serial;
+				const string name = filesystem::path(client.name).filename();
+
+				// Plik tymczasowy zatwierdź grupowo - status zostanie
+				// odesłany dopiero po utrwaleniu pliku na dysku
+				m_committer.submit(client.target, client.temp, client.name,
+							    [this, sock, serial, name] (bool ok)
+				{
+					if (ok && m_index) m_index->refresh(name);
+
+					on_committed(sock, serial, ok);
+				});
+
+				client.target = -1;
+				client.temp.clear();
+				client.state = STATE::Committing;
+
+				// Czekaj jedynie na ewentualne rozłączenie
+				it->events = 0;
+
+				return ++it;
+			}
+
+			// Zwolnij bloki dziury - obszar nie może zawierać danych
+			else if (type == SPARSE::Hole)
+			{
+				if (!SPARSE::punch(client.target, offset, length)) return on_disconnect(it);
+			}
+
+			else if (type == SPARSE::Data && length > 0)
+			{
+				client.offset = offset;
+				client.extent = length;
+				client.framed = true;
+			}
+
+			else if (type != SPARSE::Data) return on_disconnect(it);
+		}
+
+		// Zapisz dane obszaru pod jego pozycją
+		else
+		{
+			const size_t take = min<uint64_t>(size, client.extent);
+
+			if (!SPARSE::write_at(client.target, data, take, client.offset)) return on_disconnect(it);
+
+			data += take; size -= take;
+			client.offset += take;
+			client.extent -= take;
+
+			if (!client.extent) client.framed = false;
+		}
+	}
+
+	return ++it; // Zwróć iterator na kolejne połączenie
+}
+
+void SERVER::on_replicated(int sock, uint64_t serial, bool ok)
+{
+	CLIENT* const c = m_clients.find(sock);
+
+	// Poprzedni węzeł mógł się w międzyczasie rozłączyć
+	if (!c || c->serial != serial) return;
+
+	const auto it = find_if(m_sockets.begin() + m_head, m_sockets.end(),
+					    [sock] (const pollfd& p) { return p.fd == sock; });
+
+	if (it != m_sockets.end()) finish_replicate(it, ok);
+}
+
+SERVER::ITERATOR SERVER::finish_replicate(ITERATOR it, bool ok)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+	const char status = ok ? 0 : 1;
+
+	cout << "Completed replica for:\t" << it->fd << '\t'
+		<< '(' << (ok ? "OK" : "FAIL") << ')' << '\n';
+
+	if (!send_all(it->fd, &status, 1)) return on_disconnect(it);
+
+	// Czekaj na kolejny nagłówek w tym samym połączeniu
+	client.state = STATE::Waiting;
+	client.chained = client.framed = false;
+	client.length = 0;
+	it->events = POLLIN | POLLHUP;
+
+	if (!client.resize(64)) return on_disconnect(it);
+	else return ++it;
+}
+
+unsigned SERVER::replicate(ITERATOR it, const string& name, const vector<REPLICATOR::PEER>& chain)
+{
+	const int sock = it->fd;
+	const uint64_t serial = m_clients[sock].serial;
+
+	return m_replicator.begin(name, chain, [this, sock, serial] (void) { on_resume(sock, serial); });
+}
+
+bool SERVER::throttle(ITERATOR it)
+{
+	const auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+
+	// Sprawdź, czy w kolejce strumienia zmieści się pełny bufor odbioru
+	if (!client.replica || m_replicator.writable(client.replica, client.pace.chunk)) return false;
+
+	it->events &= ~POLLIN;
+
+	return true;
+}
+
+void SERVER::on_resume(int sock, uint64_t serial)
+{
+	CLIENT* const c = m_clients.find(sock);
+
+	// Klient mógł się w międzyczasie rozłączyć (a deskryptor zostać ponownie użyty)
+	if (!c || c->serial != serial) return;
+
+	// Połączenia oczekujące na zatwierdzenie nie odbierają danych, a
+	// wstrzymane przez kontrolę przyjęć wznowi dopiero `admit`
+	if (c->held) return;
+	else if (c->state != STATE::Uploading &&
+	    c->state != STATE::Receiving &&
+	    c->state != STATE::Replicating) return;
+
+	const auto it = find_if(m_sockets.begin() + m_head, m_sockets.end(),
+					    [sock] (const pollfd& p) { return p.fd == sock; });
+
+	if (it != m_sockets.end()) it->events |= POLLIN;
+}
+
+void SERVER::commit(int fd, const string& temp, const string& name,
+				unsigned replica, const COMMITTER::CALLBACK& callback)
+{
+	if (!replica) m_committer.submit(fd, temp, name, callback);
+
+	// Zatwierdź plik dopiero po zapisaniu go przez wszystkie węzły łańcucha
+	else m_replicator.finish(replica, [this, fd, temp, name, callback] (bool ok)
+	{
+		if (ok) m_committer.submit(fd, temp, name, callback);
+		else
+		{
+			cout << "Replication failed:\t" << name << '\n';
+
+			COMMITTER::discard(fd, temp);
+
+			if (callback) callback(false);
+		}
+	});
+}
+
+SERVER::ITERATOR SERVER::on_proxy(ITERATOR it, const string& key)
 {
-	static const int yes = 1; // Zmienna do ustawienia opcji `SO_REUSEADDR`
-	if (m_sock) this->stop(); // Zatrzymaj serwer, jeśli jest aktywny
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+	const int backend = m_proxy->pick(key);
+	bool pending = false;
 
-	// Stwórz socket - IPv4, TCP
-	cout << "Creating socket...\t";
-	int sock = ::socket(PF_INET, SOCK_STREAM, 0);
+	// Jeśli żaden serwer docelowy nie jest sprawny - zakończ połączenie
+	if (backend == -1) return on_disconnect(it);
 
-	if (sock == -1) return false;
-	else cout << "OK\n";
+	const int sock = m_proxy->acquire(backend, pending);
 
-	sockaddr_in sin;
-	int res;
+	if (sock == -1)
+	{
+		m_proxy->report(backend, false);
 
-	// Uzupełnij strukturę adresu
-	memset(&sin, 0, sizeof(sin));
-	sin.sin_port = ::htons(port);
-	sin.sin_family = AF_INET;
+		return on_disconnect(it);
+	}
 
-	cout << "Filling struct...\t";
+	cout << "Proxying client:\t" << it->fd << '\t'
+		<< '(' << m_proxy->name(backend) << ')' << '\n';
 
-	// Konwertuj adres z łańcucha do liczby
-	res = inet_pton(AF_INET, addr.c_str(), &(sin.sin_addr));
+	// Strona serwera docelowego jest obsługiwana jak kolejny klient
+	if (CLIENT* const old = m_clients.find(sock)) discount(*old);
 
-	if (res <= 0) return false;
-	else cout << "OK\n";
+	auto& server = m_clients.insert(sock);
 
-	cout << "Setting options...\t";
+	server.clean();
+	server.serial = ++m_serial;
+	server.backend = backend;
+	server.connecting = pending;
+	server.peer = it->fd;
+	server.state = STATE::Relaying;
 
-	// Ustaw opcję ponownego użycia adresu
-	res = ::setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int));
+	client.peer = sock;
+	client.state = STATE::Relaying;
 
-	if (res == -1) return false;
-	else cout << "OK\n";
+	// Przygotuj potoki obu kierunków - gniazda muszą być nieblokujące
+	if (::pipe2(client.relay, O_NONBLOCK | O_CLOEXEC) == -1 ||
+	    ::pipe2(server.relay, O_NONBLOCK | O_CLOEXEC) == -1 ||
+	    ::fcntl(it->fd, F_SETFL, ::fcntl(it->fd, F_GETFL) | O_NONBLOCK) == -1)
+		return on_disconnect(it);
 
-	cout << "Binding address...\t";
+	// Większy potok zmniejsza liczbę wywołań (błąd nie przerywa działania)
+	::fcntl(client.relay[1], F_SETPIPE_SZ, relay_block);
+	::fcntl(server.relay[1], F_SETPIPE_SZ, relay_block);
 
-	// Połącz gniazdo z adresem
-	res = ::bind(sock, (sockaddr*) &sin, sizeof(sin));
+	// Nagłówek wraz z danymi za nim trafi do serwera docelowego jako pierwszy
+	if (::write(client.relay[1], client.buff, client.size) != ssize_t(client.size))
+		return on_disconnect(it);
 
-	if (res == -1) return false;
-	else cout << "OK\n";
+	client.piped = client.size;
+	client.clean();
 
-	cout << "Start listening...\t";
+	TRACER::mark(client.trace, TRACER::Open); // Sesja została przekazana
 
-	// Rozpocznij nasłuchiwanie
-	res = ::listen(sock, queue);
+	// Odbieraj od klienta dopiero po opróżnieniu potoku
+	it->events = 0;
 
-	if (res == -1) return false;
-	else cout << "OK\n\n";
+	const size_t pos = it - m_sockets.begin();
 
-	// Uzupełnij pola i dodaj gniazdo do listy `poll`
-	m_terminate = false;
-	m_sock = sock;
-	m_sockets.push_back(
-	{
-		sock,
-		POLLIN,
-		0
-	});
+	m_sockets.push_back({ sock, POLLIN | POLLOUT, 0 }); // Dodaj gniazdo do listy `poll`
 
-	return true;
+	return m_sockets.begin() + pos + 1; // Zwróć iterator na kolejne połączenie
 }
 
-void SERVER::stop(void)
+SERVER::ITERATOR SERVER::on_relay(ITERATOR it)
 {
-	cout << "Stopping server...\t";
+	auto& self = m_clients[it->fd]; // Obsługiwana strona sesji
+	CLIENT* const peer = m_clients.find(self.peer);
+	const short events = it->revents;
 
-	m_sockets.clear(); // Wyczyść listę `poll`
-	m_clients.clear(); // Wyczyść listę klientów
+	// Bez drugiej strony sesja nie ma dokąd przekazywać danych
+	if (!peer) return on_disconnect(it);
 
-	this->close(); // Zamknij gniazdo
+	auto& other = *peer; // Druga strona sesji
 
-	cout << "OK\n";
+	// Zakończ nawiązywanie połączenia z serwerem docelowym
+	if (self.connecting)
+	{
+		socklen_t len = sizeof(int);
+		int err = 0;
 
-	// Wszystkie połączenia klientów zostaną
-	// automatycznie zamknięte. Zajmie się
-	// tym destruktor struktury CLIENT::~CLIENT()
-}
+		if (::getsockopt(it->fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1) err = errno;
 
-void SERVER::end(int signal)
-{
-	cout << "\nTerminating server:\t" << signal << '\n';
+		m_proxy->report(self.backend, err == 0);
 
-	m_terminate = true; // Zakończ po kolejnej pętli
-}
+		if (err != 0) return on_disconnect(it);
+		else self.connecting = false;
+	}
 
-bool SERVER::loop(int timeout)
-{
-	// Sprawdź stan połączeń pod kątem możliwości ich obsługi
-	if (poll(m_sockets.data(), m_sockets.size(), timeout) > 0)
-	{
-		// Pierwszy element na liście to serwer
-		const auto& serv = m_sockets.front();
+	if (events & POLLERR) return on_disconnect(it);
 
-		// Jeśli serwer jest gotowy do odczytu (czeka nowy klient)
-		if (serv.revents & POLLIN)
+	// Przekaż dane drugiej strony oczekujące w potoku
+	if (events & POLLOUT)
+	{
+		if (!relay_flush(other, it->fd)) return on_disconnect(it);
+		else if (!other.piped)
 		{
-			sockaddr_in sin; // Struktura pomocnicza na adres
-			socklen_t size = sizeof(sin); // Długość adresu
-
-			// Akceptuj nowe połączenie do serwera
-			int sock = ::accept(serv.fd, (sockaddr*) &sin, &size);
+			it->events &= ~POLLOUT;
 
-			// Jeśli połączenie jest prawidłowe dodaj je do listy klientów
-			if (sock != -1) on_accept(sock);
+			// Po opróżnieniu potoku wznów odbiór lub przekaż koniec danych
+			if (other.shut) ::shutdown(it->fd, SHUT_WR);
+			else relay_events(self.peer, POLLIN, 0);
 		}
+	}
 
-		// Zacznij iteracje od pierwszego klienta
-		auto i = m_sockets.begin() + 1;
+	// Odbierz dane i od razu przekaż je drugiej stronie
+	if (events & (POLLIN | POLLHUP) && !self.shut && !self.piped)
+	{
+		const ssize_t rec = ::splice(it->fd, nullptr, self.relay[1], nullptr, relay_block,
+							    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
 
-		// Obsługuj kolejne połączenia aż do końca listy
-		while (i != m_sockets.end())
+		if (rec == -1 && errno != EAGAIN) return on_disconnect(it);
+		else if (rec == 0)
 		{
-			// Jeśli w połączeniu wystąpił błąd/zostało zamknięte - zwolnij zasoby
-			if (i->revents & (POLLHUP | POLLERR)) i = on_disconnect(i);
-
-			// Jeśli połączenie jest gotowe do odczytu i oczekuje się na nagłówek,
-			// pobierz jego fragment i przetwórz go w celu skompletowania nagłówka
-			else if (m_clients[i->fd].state == STATE::Waiting &&
-				    i->revents & POLLIN) i = on_header(i);
+			self.shut = true;
+			it->events &= ~POLLIN;
 
-			// Jeśli połączenie jest gotowe do odczytu i oczekuje się na dane pliku,
-			// pobierz kolejny fragment i zapisz go do pliku związanego z klientem
-			else if (m_clients[i->fd].state == STATE::Uploading &&
-				    i->revents & POLLIN) i = on_upload(i);
+			::shutdown(self.peer, SHUT_WR);
+		}
+		else if (rec > 0)
+		{
+			self.piped = rec;
 
-			// Jeśli połączenie jest gotowe do zapisu i dostępne są dane w pliku,
-			// odczytaj kolejny fragment danych i wyślij go do oczekującego klienta
-			else if (m_clients[i->fd].state == STATE::Downloading &&
-				    i->revents & POLLOUT) i = on_download(i);
+			if (!relay_flush(self, self.peer)) return on_disconnect(it);
 
-			else ++i; // Jeśli nie trzeba podejmować żadnej akcji przejdź do kolejnego klienta
+			// Druga strona nie odebrała wszystkiego - czekaj na jej gotowość
+			if (self.piped)
+			{
+				it->events &= ~POLLIN;
+				relay_events(self.peer, POLLOUT, 0);
+			}
 		}
-
-		return !m_terminate; // Zwróć stan serwera - `false` gdy trzeba zakończyć serwer
 	}
-	else return false; // Gdy `poll` zwróci błąd lub przekroczono czas oczekiwania
+
+	// Sesja kończy się po przekazaniu wszystkich danych obu stron
+	if (self.shut && other.shut && !self.piped && !other.piped) return on_disconnect(it);
+
+	return ++it; // Zwróć iterator na kolejne połączenie
 }
 
-bool SERVER::is_started(void) const
+bool SERVER::relay_flush(CLIENT& from, int sock)
 {
-	return m_sock > 0;
+	while (from.piped)
+	{
+		const ssize_t sd = ::splice(from.relay[0], nullptr, sock, nullptr, from.piped,
+							   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+		// Pełny bufor gniazda nie jest błędem - reszta zostanie w potoku
+		if (sd > 0) from.piped -= sd;
+		else return sd == -1 && errno == EAGAIN;
+	}
+
+	return true;
 }
 
-void SERVER::on_accept(int sock)
+void SERVER::relay_events(int sock, short set, short clear)
 {
-	cout << "Accepted client:\t" << sock << '\t'
-		<< '(' << get_name(sock) << ')' << '\n';
+	const auto it = find_if(m_sockets.begin() + m_head, m_sockets.end(),
+					    [sock] (const pollfd& p) { return p.fd == sock; });
 
-	m_sockets.push_back({ sock, POLLIN | POLLHUP, 0 }); // Dodaj socket do listy `poll`
-	m_clients.insert({ sock, sock }); // Dodaj klienta do listy klientów
+	if (it != m_sockets.end()) it->events = (it->events & ~clear) | set;
 }
 
-SERVER::ITERATOR SERVER::on_header(SERVER::ITERATOR it)
+vector<string> SERVER::match_files(const string& pattern) const
 {
-	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+	vector<string> names;
 
-	// Gdy w buforze na nagłówek jest mniej niż 32 B wolnego miejsca
-	// rozszerz bufor nagłówka o dodatkowe 64 B na dane.
-	if (client.cap - client.size < 32)
-		client.resize(client.cap + 64);
-
-	// Jeśli nie istnieje poprawny bufor na nagłówek - zakończ połączenie
-	if (!client.buff) return on_disconnect(it);
+	// Indeks zawiera posortowaną listę wszystkich plików
+	if (m_index) m_index->match(pattern, names);
+	else
+	{
+		for (const auto& dir : m_layout->directories())
+			m_layout->scan(dir, [&names, &pattern] (const string&, const string& name)
+			{
+				if (::fnmatch(pattern.c_str(), name.c_str(), FNM_PERIOD) == 0)
+					names.push_back(name);
+			});
+
+		sort(names.begin(), names.end());
+	}
 
-	cout << "Recv header chunk from:\t" << it->fd << '\t';
+	return names;
+}
 
-	// Dopisz odebrane dane do bufora, przy czym pobierz maksymalnie
-	// tyle bajtów danych, ile jest wolnego miejsca w buforze
-	ssize_t rec = ::recv(it->fd,
-					 client.buff + client.size,
-					 client.cap - client.size,
-					 0);
+ssize_t SERVER::send_chunk(int sock, const char* data, size_t size)
+{
+	const ssize_t sd = ::send(sock, data, size, MSG_DONTWAIT | MSG_NOSIGNAL);
 
-	cout << '(' << rec << " B" << ')' << '\n';
+	// Pełny bufor gniazda oznacza jedynie brak postępu
+	if (sd == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+	else return sd;
+}
 
-	// Jeśli wystąpił błąd lib zamknięto połączenie - zakończ połączenie
-	// W przeciwnym razie zaktualizuj rozmiar danych w buforze
-	if (rec <= 0) return on_disconnect(it);
-	else client.size += rec;
+ssize_t SERVER::send_out(CLIENT& client)
+{
+	// Wyślij tyle danych, ile zmieści się w buforze gniazda
+	const ssize_t sd = send_chunk(client.sock,
+						   client.out.data() + client.sent,
+						   client.out.size() - client.sent);
 
-	const auto pos_start = client.buff; // Początek bufora
-	const auto pos_end = pos_start + client.size; // Koniec bufora
-	const auto pos_nl = find(pos_start, pos_end, '\n'); // Pozycja nowej linii
+	if (sd > 0) client.sent += sd;
+	if (sd > 0) TRACER::data(client.trace);
 
-	// Jeśli znaleziono w buforze znak nowej linii
-	if (pos_nl != pos_end)
-	{
-		const auto pos_sp = find(pos_start, pos_nl, ' '); // Pozycja spacji
+	return sd;
+}
 
-		// Jeśli nie znaleziono spacji (brak parametru) - zakończ połączenie
-		// W przeciwnym razie zamień spację i znak nowej linii na '\0'
-		if (pos_sp == pos_nl) return on_disconnect(it);
-		else *pos_nl = *pos_sp = '\0';
+SERVER::ITERATOR SERVER::on_import(ITERATOR it)
+{
+	auto& client = m_clients[it->fd]; // Obiekt bieżącego klienta
+	ssize_t rc(0);
 
-		cout << "Completed header for:\t" << it->fd << '\t'
-			<< '(' << pos_start << ':' << pos_sp+1 << ')' << '\n';
+	cout << "Import file chunk from:\t" << it->fd << '\t';
 
-		// Oblicz ile danych znajduje się za nagłówkiem
-		// ilość = rozmiar_danych - pozycja_nl - pozycja_start - 1
-		const int left = client.size - (pos_nl - pos_start) - 1;
+	// Do magazynu dane trafiają przez bufor, do pliku - bez kopiowania
+	if (client.writer)
+	{
+		ssize_t n(0);
 
-		// Jeśli komunikat to "UPLOAD"
-		if (strcmp(pos_start, "UPLOAD") == 0)
+		// Odczytuj porcje danych, maksymalnie 1 MiB na jedną iterację pętli
+		while (rc < (1 << 20) && (n = ::read(client.source, m_buff, sizeof(m_buff))) > 0)
 		{
-			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
-			const string name = filesystem::path(pos_sp + 1).filename();
+			if (client.writer->write(m_buff, n)) rc += n;
+			else { n = -1; break; }
+		}
 
-			// Otwórz do zapisu plik o zadanej w parametrze nazwie i utnij go
-			client.file.open(name, ios_base::out | ios_base::trunc | ios_base::binary);
+		if (n < 0) rc = -1;
+	}
+	else rc = copy_fd(client.target, client.source, 1 << 20);
 
-			// Jeśli nie udało się otworzyć pliku - zakończ połączenie
-			// W przeciwnym razie zapisz dane za nagłówkiem (jeśli są)
-			if (!client.file.is_open()) return on_disconnect(it);
-			else if (left > 0) client.file.write(pos_nl + 1, left);
+	cout << '(' << rc << " B" << ')' << '\n';
 
-			client.state = STATE::Uploading; // Zmień stan na odbiór pliku.
-		}
+	if (rc > 0) return ++it;
 
-		// Jeśli komunikat to "DOWNLOAD"
-		else if (strcmp(pos_start, "DOWNLOAD") == 0)
-		{
-			// Pobierz jedynie nazwę pliku - ścieżka zostanie odrzucona
-			const string name = filesystem::path(pos_sp + 1).filename();
+	// Plik tymczasowy zatwierdź grupowo - status zostanie
+	// odesłany dopiero po utrwaleniu pliku na dysku
+	if (rc == 0 && !client.writer)
+	{
+		const int sock = it->fd;
+		const uint64_t serial = client.serial;
 
-			// Otwórz do odczytu plik o zadanej w parametrze nazwie
-			client.file.open(name, ios_base::in | ios_base::binary);
+		m_committer.submit(client.target, client.temp, client.name,
+					    [this, sock, serial] (bool ok) { on_committed(sock, serial, ok); });
 
-			// Jeśli nie udało się otworzyć pliku - zakończ połączenie
-			if (!client.file.is_open()) return on_disconnect(it);
+		client.target = -1;
+		client.temp.clear();
+		client.state = STATE::Committing;
 
-			client.state = STATE::Downloading; // Zmień stan na wysyłanie pliku.
+		// Czekaj jedynie na ewentualne rozłączenie
+		it->events = 0;
 
-			// Od teraz sprawdzaj tylko gotowość do zapisu danych
-			it->events = (it->events & ~POLLIN) | POLLOUT;
-		}
+		return ++it;
+	}
 
-		// Jeśli nie rozpoznano komunikatu zamknij połączenie
-		else return on_disconnect(it);
+	// Plik z magazynu zatwierdź od razu i odeślij status
+	bool ok = rc == 0 && client.writer->commit();
 
-		client.clean(); // Wyczyść bufor na nagłówek - nie będzie już potrzebny
-	}
+	const char status = ok ? 0 : 1;
 
-	return ++it; // Zwróć iterator na kolejne połączenie
+	cout << "Completed import for:\t" << it->fd << '\t'
+		<< '(' << (ok ? "OK" : "FAIL") << ')' << '\n';
+
+	::send(it->fd, &status, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+	return on_disconnect(it);
 }
 
-SERVER::ITERATOR SERVER::on_upload(ITERATOR it)
+void SERVER::on_committed(int sock, uint64_t serial, bool ok)
 {
-	cout << "Recv file chunk from:\t" << it->fd << '\t';
+	CLIENT* const c = m_clients.find(sock);
 
-	// Odczytaj fragment pliku od klienta
-	ssize_t rec = ::recv(it->fd, m_buff, sizeof(m_buff), 0);
+	// Klient mógł się w międzyczasie rozłączyć (a deskryptor zostać ponownie użyty)
+	if (!c || c->serial != serial) return;
 
-	cout << '(' << rec << " B" << ')' << '\n';
+	const auto it = find_if(m_sockets.begin() + m_head, m_sockets.end(),
+					    [sock] (const pollfd& p) { return p.fd == sock; });
 
-	// Jeśli nie udało się odczytać żadnych danych - zakończ połączenie
-	// W przeciwnym razie zapisz dane do pliku związanego z klientem
-	if (rec <= 0) return on_disconnect(it);
-	else m_clients[it->fd].file.write(m_buff, rec);
+	if (it == m_sockets.end()) return;
 
-	return ++it; // Zwróć iterator na kolejne połączenie
+	const char status = ok ? 0 : 1;
+
+	cout << "Completed import for:\t" << sock << '\t'
+		<< '(' << (ok ? "OK" : "FAIL") << ')' << '\n';
+
+	::send(sock, &status, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+	on_disconnect(it);
 }
 
-SERVER::ITERATOR SERVER::on_download(ITERATOR it)
+SERVER::ITERATOR SERVER::on_handoff(ITERATOR it, const string& name)
 {
-	auto& file = m_clients[it->fd].file; // Plik związany z klientem
+	int fd(-1);
 
-	// Jeśli są jeszcze dane do odczytu to je obsłuż
-	// Jeśli nie - zamknij połączenie
-	if (!file.eof())
+	// Plik z magazynu odtwórz w anonimowym pliku w pamięci
+	if (m_store && m_store->contains(name))
 	{
-		cout << "Sending file chunk to:\t" << it->fd << '\t';
+		CHUNKSTORE::READER reader(*m_store);
+		ssize_t rc(0);
 
-		// Odczytaj fragment danych
-		file.read(m_buff, sizeof(m_buff));
+		fd = ::memfd_create(name.c_str(), MFD_CLOEXEC);
 
-		// Pobierz odczytaną liczbę bajtów
-		int rc = file.gcount();
+		if (fd != -1 && reader.open(name))
+		{
+			while ((rc = reader.read(m_buff, sizeof(m_buff))) > 0)
+				if (::write(fd, m_buff, rc) != rc) { rc = -1; break; }
+		}
+		else rc = -1;
 
-		// Gdy nie odczytano danych - zakończ połączenie
-		if (rc <= 0) return on_disconnect(it);
+		if (rc < 0 || ::lseek(fd, 0, SEEK_SET) == -1)
+		{
+			if (fd != -1) ::close(fd);
+			fd = -1;
+		}
+	}
+	else fd = m_layout->open_file(name, O_RDONLY);
 
-		// Wyślij wszystkie odczytane dane
-		int sd = ::send(it->fd, m_buff, rc, 0);
+	const char status = fd != -1 ? 0 : 1;
+	CLIENT* const client = m_clients.find(it->fd);
 
-		cout << '(' << sd << '/' << rc << " B" << ')' << '\n';
+	if (client && fd != -1) TRACER::mark(client->trace, TRACER::Open);
 
-		// Sprawdź, czy udało się wysłać dane
-		if (sd <= 0) return on_disconnect(it);
+	cout << "Handoff file to:\t" << it->fd << '\t'
+		<< '(' << (fd != -1 ? "OK" : "FAIL") << ')' << '\n';
 
-		// W przypadku niepełnego wysyłania cofnij
-		// wskaźnik pliku do prawidłowego miejsca
-		else if (sd < rc) file.seekg(sd - rc, ios::cur);
-	}
-	else return on_disconnect(it); // Zamknij połączenie
+	// Przekaż status wraz z deskryptorem - klient przejmuje plik
+	if (send_fd(it->fd, fd, &status, 1) && client && fd != -1) TRACER::data(client->trace);
 
-	return ++it; // Zwróć iterator na kolejne połączenie
+	if (fd != -1) ::close(fd);
+
+	return on_disconnect(it);
 }
 
 SERVER::ITERATOR SERVER::on_disconnect(SERVER::ITERATOR it)
@@ -341,74 +3205,225 @@ SERVER::ITERATOR SERVER::on_disconnect(SERVER::ITERATOR it)
 	cout << "Disconnecting client:\t" << it->fd << '\t'
 		<< '(' << get_name(it->fd) << ')' << '\n';
 
-	// Usuń obiekt klienta z mapy
-	m_clients.erase(it->fd);
+	const int sock = it->fd;
+	CLIENT* const c = m_clients.find(sock);
+
+	// Zapisz zdarzenia śledzonej sesji
+	if (c) m_tracer.finish(c->trace, sock, c->serial);
+
+	// Porzuć replikację niedokończonego pliku
+	if (c && c->replica) m_replicator.abort(c->replica);
+
+	// Zakończ obserwację śledzonego pliku
+	if (c) unfollow(*c);
+
+	// Zamknij również drugą stronę przekazywanej sesji
+	if (c && c->peer != -1)
+	{
+		const int peer = c->peer;
+		const auto p = find_if(m_sockets.begin() + m_head, m_sockets.end(),
+						   [peer] (const pollfd& p) { return p.fd == peer; });
+
+		if (CLIENT* const other = m_clients.find(peer)) discount(*other);
+		m_clients.erase(peer);
+
+		// Usunięcie elementu przesuwa kolejne - odnajdź klienta ponownie
+		if (p != m_sockets.end())
+		{
+			m_sockets.erase(p);
+			it = find_if(m_sockets.begin() + m_head, m_sockets.end(),
+					   [sock] (const pollfd& p) { return p.fd == sock; });
+		}
+	}
+
+	// Usuń obiekt klienta z mapy i jego zasoby z liczników
+	if (c) discount(*c);
+	m_clients.erase(sock);
 
 	// Usuń klienta z listy `poll` oraz
 	// zwróć iterator na kolejne połączenie
 	return m_sockets.erase(it);
 }
 
-SERVER::CLIENT::CLIENT(int fd)
-: CLIENT() // Zainicjuj obiekt
+SERVER::CLIENT::CLIENT(void)
 {
-	sock = fd; // Zainicjuj deskryptor gniazda
+	buff = head; // Bufor na nagłówek jest częścią obiektu
 }
 
-SERVER::CLIENT::CLIENT(void)
+SERVER::CLIENT::~CLIENT(void)
 {
-	buff = (char*) ::malloc(cap); // Zarezerwuj pamięć na bufor
+	reset(); // Zamknij deskryptory i zwolnij zasoby
 }
 
-SERVER::CLIENT::~CLIENT(void)
+char* SERVER::CLIENT::resize(size_t new_size)
+{
+	// Gdy klient przekroczy dozwolony rozmiar bufora
+	if (new_size > sizeof(head))
+	{
+		size = cap = 0; // Zapisz informacje o braku danych
+		buff = nullptr; // Wyzeruj wskaźnik na bufor
+	}
+	else
+	{
+		size = min(size, new_size); // Oblicz nowy rozmiar danych
+		cap = new_size; // Zapisz nową pojemność bufora
+		buff = head; // Przywróć bufor
+	}
+
+	return buff; // Zwróć wskaźnik na bufor
+}
+
+void SERVER::CLIENT::clean(void)
+{
+	cap = size = 0; // Zapisz informacje o braku danych
+	buff = nullptr; // Wyzeruj wskaźnik na bufor
+}
+
+void SERVER::CLIENT::reset(void)
 {
-	if (buff) ::free(buff); // Jeśli bufor istnieje - zwolnij go
 	if (sock) ::close(sock); // Jeśli gniazdo jest aktywne - zamknij je
+	if (file != -1) ::close(file); // Zamknij pobierany plik
+
+	if (source != -1) ::close(source); // Zamknij deskryptor przekazany przez klienta
+	if (input != -1) ::close(input); // Zamknij bieżący plik strumienia
+
+	// Usuń niezatwierdzony plik tymczasowy
+	if (target != -1) COMMITTER::discard(target, temp);
+
+	// Zamknij potok przekazywanej sesji
+	if (relay[0] != -1) ::close(relay[0]);
+	if (relay[1] != -1) ::close(relay[1]);
+
+	// Zwolnij stan poleceń
+	delta.reset();
+	writer.reset();
+	reader.reset();
+	dedup.reset();
+	entry.reset();
+	cursor.reset();
+
+	// Wyczyść bufory i nazwy - zarezerwowana pamięć zostaje zachowana,
+	// chyba że przekracza porcję strumienia i zawyżałaby zajętość obiektu
+	out.clear();
+	in.clear();
+
+	if (out.capacity() > stream_block) out.shrink_to_fit();
+	if (in.capacity() > stream_block) in.shrink_to_fit();
+	batch.clear();
+	temp.clear();
+	name.clear();
+	prefix.clear();
+	next.clear();
+
+	state = STATE::Waiting;
+	buff = head;
+	size = sent = index = piped = 0;
+	cap = 64;
+	offset = start = extent = length = serial = 0;
+	stored = failed = waiting = 0;
+	replica = 0;
+	pace = PACER::STATE();
+	trace = TRACER::SPAN();
+	sock = 0;
+	file = source = target = input = peer = backend = -1;
+	relay[0] = relay[1] = -1;
+	watch = -1;
+	armed = gone = held = queued = false;
+	counted_files = counted_buffers = 0;
+	counted_receiving = false;
+	more = framed = chained = connecting = shut = local = false;
 }
 
-SERVER::CLIENT::CLIENT(CLIENT&& c)
+size_t SERVER::CLIENT::descriptors(void) const
 {
-	file = move(c.file); // Przenieś obiekt reprezentujący plik
+	// Deskryptory pamięci podręcznej i współdzielonego odczytu należą do
+	// tych usług, a stany synchronizacji i magazynu liczone są jako jeden
+	return (file != -1) + (source != -1) + (target != -1) + (input != -1) +
+		  (relay[0] != -1) + (relay[1] != -1) + bool(delta) + bool(reader) + bool(writer);
+}
 
-	state = c.state; // Skopiuj stan
-	buff = c.buff; // Przenieś bufor
-	size = c.size; // Skopiuj rozmiar
-	cap = c.cap; // Skopiuj pojemność
-	sock = c.sock; // Skopiuj deskryptor gniazda
+size_t SERVER::CLIENT::footprint(void) const
+{
+	return cap + out.capacity() + in.capacity() + piped + pace.buffer;
+}
 
-	c.buff = nullptr; // Wyzeruj wskaźnik na bufor (został przeniesiony)
-	c.sock = 0; // Wyzeruj deskryptor gniazda (zostało przeniesione)
+bool SERVER::CLIENT::receiving(void) const
+{
+	return state == STATE::Uploading || state == STATE::Receiving ||
+		  state == STATE::Replicating || state == STATE::Patching ||
+		  state == STATE::Deduping || state == STATE::Punching;
 }
 
-char* SERVER::CLIENT::resize(size_t new_size)
+SERVER::CLIENT& SERVER::POOL::insert(int sock)
 {
-	char* cpy = buff; // Skopiuj wskaźnik na dane (przyda się w przypadku błędu)
+	assert(sock >= 0);
 
-	// Gdy klient przekroczy dozwolony rozmiar bufora
-	if (new_size > 1024) buff = nullptr; // Nie alokuj więcej danych
-	else
-	{
-		size = min(size, new_size); // Oblicz nowy rozmiar danych
-		cap = new_size; // Zapisz nową pojemność bufora
+	CLIENT* client = nullptr;
 
-		buff = (char*) ::realloc(buff, new_size); // Realokuj bufor
+	// Użyj zwolnionego obiektu lub utwórz kolejny w bloku pamięci
+	if (!m_spare.empty())
+	{
+		client = m_spare.back();
+		m_spare.pop_back();
 	}
+	else client = &m_arena.emplace_back();
 
-	// Jesli alokacja się nie udała
-	if (!buff)
-	{
-		size = cap = 0; // Zapisz informacje o braku danych
-		buff = nullptr; // Wyzeruj wskaźnik na bufor
+	if (size_t(sock) >= m_slots.size()) m_slots.resize(sock + 1, nullptr);
 
-		if (cpy) ::free(cpy); // Zwolnij stary bufor
+	// Deskryptor został ponownie użyty - poprzedni obiekt nie posiada już gniazda
+	if (m_slots[sock])
+	{
+		m_slots[sock]->sock = 0;
+		erase(sock);
 	}
 
-	return buff; // Zwróć wskaźnik na nowy bufor
+	m_slots[sock] = client;
+	client->sock = sock;
+	++m_used;
+
+	return *client;
 }
 
-void SERVER::CLIENT::clean(void)
+SERVER::CLIENT* SERVER::POOL::find(int sock)
 {
-	if (buff) ::free(buff); // Jeśli bufor istnieje - zwolnij go
-	cap = size = 0; // Zapisz informacje o braku danych
-	buff = nullptr; // Wyzeruj wskaźnik na bufor
+	if (sock < 0 || size_t(sock) >= m_slots.size()) return nullptr;
+	else return m_slots[sock];
+}
+
+SERVER::CLIENT& SERVER::POOL::operator[] (int sock)
+{
+	assert(sock >= 0);
+
+	CLIENT* client = find(sock);
+
+	if (client) return *client;
+
+	// Podobnie jak domyślny element mapy nowy obiekt nie przejmuje gniazda
+	client = &insert(sock);
+	client->sock = 0;
+
+	return *client;
+}
+
+void SERVER::POOL::erase(int sock)
+{
+	CLIENT* client = find(sock);
+
+	if (!client) return;
+
+	m_slots[sock] = nullptr;
+	--m_used;
+
+	client->reset(); // Zamknij połączenie
+	m_spare.push_back(client);
+}
+
+void SERVER::POOL::clear(void)
+{
+	for (size_t sock = 0; sock < m_slots.size(); ++sock) erase(sock);
+}
+
+size_t SERVER::POOL::size(void) const
+{
+	return m_used;
 }
@@ -27,15 +27,34 @@
 #define SERVER_H
 
 #include "sockbase.hpp"
+#include "delta.hpp"
+#include "chunkstore.hpp"
+#include "filecache.hpp"
+#include "sharedread.hpp"
+#include "watcher.hpp"
+#include "committer.hpp"
+#include "layout.hpp"
+#include "index.hpp"
+#include "replicator.hpp"
+#include "proxy.hpp"
+#include "sparse.hpp"
+#include "frame.hpp"
+#include "pacer.hpp"
+#include "tracer.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <filesystem>
+#include <cassert>
 #include <algorithm>
+#include <chrono>
 #include <iostream>
-#include <fstream>
 #include <memory>
 #include <string>
 #include <vector>
-#include <map>
+#include <deque>
+#include <tuple>
 
 using namespace std;
 
@@ -47,6 +66,37 @@ using namespace std;
 class SERVER : public SOCKBASE
 {
 
+	public:
+
+		/*! \brief Limity zasobów.
+		 *  \see set_limits.
+		 *
+		 *  Wartość zerowa oznacza brak limitu.
+		 *
+		 */
+		struct LIMITS
+		{
+			size_t connections = 0; //!< Maksymalna liczba połączeń.
+			size_t files = 0; //!< Maksymalna liczba deskryptorów plików i potoków połączeń.
+			size_t buffers = 0; //!< Maksymalna liczba bajtów buforów połączeń.
+		};
+
+		/*! \brief Wykorzystanie zasobów.
+		 *  \see usage.
+		 *
+		 *  Stan połączeń w chwili pomiaru wraz z działaniami kontroli przyjęć.
+		 *
+		 */
+		struct USAGE
+		{
+			size_t connections = 0; //!< Liczba połączeń.
+			size_t files = 0; //!< Liczba deskryptorów plików i potoków połączeń (bez gniazd).
+			size_t buffers = 0; //!< Liczba bajtów buforów połączeń (wraz z przydziałem buforów gniazd).
+			size_t queued = 0; //!< Liczba żądań oczekujących na zwolnienie plików.
+			size_t paused = 0; //!< Liczba połączeń ze wstrzymanym odbiorem danych.
+			bool deferred = false; //!< Flaga wstrzymania przyjmowania połączeń.
+		};
+
 	protected:
 
 		/*! \brief Enumeracja maszyny stanów.
@@ -58,7 +108,21 @@ class SERVER : public SOCKBASE
 		{
 			Waiting, //!< Oczekiwanie na nagłówek.
 			Uploading, //!< Odbieranie danych z klienta.
-			Downloading //!< Wysyłanie danych do klienta.
+			Downloading, //!< Wysyłanie danych do klienta.
+			Signing, //!< Wysyłanie sygnatury pliku (synchronizacja różnicowa).
+			Patching, //!< Odbieranie strumienia zmian (synchronizacja różnicowa).
+			Deduping, //!< Odbieranie fragmentów pliku (wysyłanie z deduplikacją).
+			Importing, //!< Kopiowanie pliku z przekazanego deskryptora (gniazdo lokalne).
+			Committing, //!< Oczekiwanie na zatwierdzenie pliku przed odesłaniem statusu.
+			Replying, //!< Wysyłanie odpowiedzi z indeksu metadanych (`LIST`, `STAT`).
+			Requesting, //!< Odbieranie listy nazw plików (`MGET`).
+			Streaming, //!< Wysyłanie strumienia wielu plików (`MGET`).
+			Receiving, //!< Odbieranie strumienia wielu plików (`MPUT`).
+			Replicating, //!< Odbieranie pliku replikowanego przez inny węzeł (`REPLICATE`).
+			Relaying, //!< Przekazywanie sesji pomiędzy klientem i serwerem docelowym (tryb pośrednika).
+			Following, //!< Oczekiwanie na dopisanie danych do śledzonego pliku (`FOLLOW`).
+			Mapping, //!< Wysyłanie obszarów danych i dziur pliku rzadkiego (`SGET`).
+			Punching //!< Odbieranie obszarów danych i dziur pliku rzadkiego (`SPUT`).
 		};
 
 		/*! \brief Struktura opisująca klienta.
@@ -71,20 +135,80 @@ class SERVER : public SOCKBASE
 		{
 				STATE state = STATE::Waiting; //!< Status klienta.
 
-				char* buff = nullptr; //!< Bufor na nagłówek.
+				char* buff = nullptr; //!< Bufor na nagłówek (wskazuje na `head`).
 				size_t size = 0; //!< Liczba zgromadzonych danych.
 				size_t cap = 64; //!< Długość bufora.
 
-				fstream file; //!< Plik powiązany z klientem.
+				char head[1024]; //!< Pamięć bufora na nagłówek (maksymalna długość nagłówka).
+
+				int file = -1; //!< Deskryptor pobieranego pliku.
+
+				unique_ptr<DELTA> delta; //!< Stan synchronizacji różnicowej.
+				unique_ptr<CHUNKSTORE::WRITER> writer; //!< Zapis pliku do magazynu fragmentów.
+				unique_ptr<CHUNKSTORE::READER> reader; //!< Odczyt pliku z magazynu fragmentów.
+				unique_ptr<CHUNKSTORE::SESSION> dedup; //!< Stan wysyłania z deduplikacją.
+
+				FILECACHE::POINTER entry; //!< Wpis pamięci podręcznej pobieranego pliku.
+				uint64_t offset = 0; //!< Pozycja w pliku z pamięci podręcznej lub pobieranym pliku.
+				uint64_t start = 0; //!< Pozycja początkowa pobierania (rozszerzenie ramki binarnej).
+				PACER::STATE pace; //!< Rozmiar porcji i bufora gniazda połączenia.
+				TRACER::SPAN trace; //!< Chwile etapów śledzonej sesji.
+				uint64_t extent = 0; //!< Liczba pozostałych danych bieżącego obszaru pliku rzadkiego.
+
+				unique_ptr<SHAREDREAD::CURSOR> cursor; //!< Kursor współdzielonego odczytu.
+				vector<char> out; //!< Dane oczekujące na wysłanie.
+				size_t sent = 0; //!< Liczba wysłanych danych z bufora `out`.
+
+				int source = -1; //!< Deskryptor przekazany przez klienta lokalnego.
+				int target = -1; //!< Deskryptor pliku tymczasowego wysyłanego pliku.
+				string temp; //!< Nazwa pliku tymczasowego.
+				string name; //!< Nazwa pliku docelowego.
+
+				string prefix; //!< Przedrostek nazw listy plików.
+				string next; //!< Kolejna nazwa listy plików.
+				bool more = false; //!< Flaga niezakończonej listy plików.
+
+				vector<char> in; //!< Niepełne rekordy listy nazw.
+				vector<string> batch; //!< Nazwy plików strumienia.
+				size_t index = 0; //!< Indeks kolejnego pliku strumienia.
+				int input = -1; //!< Deskryptor bieżącego pliku strumienia.
+				uint64_t length = 0; //!< Rozmiar bieżącego pliku strumienia.
+
+				bool framed = false; //!< Flaga odbioru danych pliku ramki.
+				uint32_t stored = 0; //!< Liczba zapisanych plików strumienia.
+				uint32_t failed = 0; //!< Liczba błędów zapisu plików strumienia.
+				uint32_t waiting = 0; //!< Liczba plików oczekujących na zatwierdzenie.
+
+				unsigned replica = 0; //!< Numer strumienia replikacji bieżącego pliku.
+				bool chained = false; //!< Flaga odebrania listy węzłów łańcucha (`REPLICATE`).
+
+				int peer = -1; //!< Gniazdo drugiej strony przekazywanej sesji.
+				int relay[2] = { -1, -1 }; //!< Potok danych odebranych z gniazda.
+				size_t piped = 0; //!< Liczba danych w potoku.
+				int backend = -1; //!< Numer serwera docelowego (strona serwera docelowego).
+				bool connecting = false; //!< Flaga nawiązywania połączenia z serwerem docelowym.
+				bool shut = false; //!< Flaga zakończenia danych odbieranych z gniazda.
+
+				int watch = -1; //!< Identyfikator obserwacji śledzonego pliku.
+				bool armed = false; //!< Flaga zaplanowanego wznowienia wysyłania śledzonego pliku.
+				bool gone = false; //!< Flaga usunięcia lub przeniesienia śledzonego pliku.
+
+				bool held = false; //!< Flaga wstrzymania odbioru przez kontrolę przyjęć.
+				bool queued = false; //!< Flaga żądania oczekującego na zwolnienie plików.
+				size_t counted_files = 0; //!< Deskryptory uwzględnione w licznikach serwera.
+				size_t counted_buffers = 0; //!< Bufory uwzględnione w licznikach serwera.
+				bool counted_receiving = false; //!< Flaga uwzględnienia buforów jako odbierających.
+
+				bool local = false; //!< Flaga połączenia przez gniazdo lokalne.
+				uint64_t serial = 0; //!< Unikalny numer połączenia.
 
 				int sock = 0; //!< Gniazdo połączenia.
 
-				CLIENT(int fd); //!< Konstruktor konwertujący.
 				CLIENT(void); //!< Domyślny konstruktor.
 				~CLIENT(void); //!< Destruktor klienta.
 
 				CLIENT(const CLIENT&) = delete; //!< Konstruktor kopiujący (usunięty).
-				CLIENT(CLIENT&& c); //!< Konstruktor przenoszący.
+				CLIENT(CLIENT&& c) = delete; //!< Konstruktor przenoszący (usunięty).
 
 				CLIENT& operator= (CLIENT&) = delete; //!< Operator przypisania (kopia, usunięty)
 				CLIENT& operator= (CLIENT&& c) = delete; //!< Operator przypisania (przeniesienie, usunięty)
@@ -95,7 +219,8 @@ class SERVER : public SOCKBASE
 				 *  \param [in] new_size Nowy rozmiar bufora.
 				 *
 				 *  Zmienia rozmiar bufora na zadany. W przypadku mniejszego rozmiaru
-				 *  dane zostaną ucięte. W przypadku niepowodzenia zwraca pusty wskaźnik.
+				 *  dane zostaną ucięte. Gdy rozmiar przekracza pojemność `head` zwraca
+				 *  pusty wskaźnik.
 				 *
 				 */
 				char* resize(size_t new_size);
@@ -108,12 +233,132 @@ class SERVER : public SOCKBASE
 				 *
 				 */
 				void clean(void);
+
+				/*! \brief Przywrócenie stanu początkowego.
+				 *
+				 *  Zamyka deskryptory i zwalnia zasoby klienta, zachowując jednak
+				 *  zarezerwowaną pamięć buforów - obiekt może obsłużyć kolejne
+				 *  połączenie bez alokacji.
+				 *
+				 */
+				void reset(void);
+
+				//! Zwraca liczbę deskryptorów plików i potoków klienta (bez gniazda).
+				size_t descriptors(void) const;
+
+				//! Zwraca liczbę bajtów buforów klienta (wraz z przydziałem bufora gniazda).
+				size_t footprint(void) const;
+
+				//! Sprawdza, czy klient odbiera dane (jego odbiór może zostać wstrzymany).
+				bool receiving(void) const;
 		};
 
-		map<int, CLIENT> m_clients; //!< Mapa obsługiwanych klientów.
+		/*! \brief Pula obiektów klientów.
+		 *  \see CLIENT.
+		 *
+		 *  Obiekty klientów tworzone są w blokach (`deque`) i po rozłączeniu wracają
+		 *  do listy wolnych obiektów zamiast być niszczone. Klienci indeksowani są
+		 *  bezpośrednio numerem deskryptora gniazda, dzięki czemu w stanie ustalonym
+		 *  przyjęcie i zamknięcie połączenia nie alokuje pamięci.
+		 *
+		 */
+		class POOL
+		{
+
+			protected:
+
+				deque<CLIENT> m_arena; //!< Wszystkie utworzone obiekty.
+				vector<CLIENT*> m_slots; //!< Aktywni klienci według deskryptora.
+				vector<CLIENT*> m_spare; //!< Obiekty gotowe do ponownego użycia.
+				size_t m_used = 0; //!< Liczba aktywnych klientów.
+
+			public:
+
+				/*! \brief Dodanie klienta.
+				 *  \returns Obiekt klienta w stanie początkowym.
+				 *  \param [in] sock Gniazdo połączenia (przejmowane przez obiekt).
+				 *
+				 */
+				CLIENT& insert(int sock);
+
+				/*! \brief Wyszukanie klienta.
+				 *  \returns Wskaźnik na klienta lub `nullptr`, gdy gniazdo nie jest obsługiwane.
+				 *  \param [in] sock Gniazdo połączenia.
+				 *
+				 */
+				CLIENT* find(int sock);
+
+				//! Zwraca klienta, dodając go gdy gniazdo nie jest obsługiwane (tylko dla gniazd klientów; pozostałe wyszukuj przez `find`).
+				CLIENT& operator[] (int sock);
+
+				//! Zamyka połączenie klienta i zwraca obiekt do puli.
+				void erase(int sock);
+
+				//! Zamyka wszystkie połączenia.
+				void clear(void);
+
+				//! Zwraca liczbę aktywnych klientów.
+				size_t size(void) const;
+		};
+
+		static constexpr size_t stream_block = 1 << 18; //!< Rozmiar porcji strumienia wielu plików.
+		static constexpr size_t relay_block = 1 << 20; //!< Rozmiar potoku przekazywanej sesji.
+		static constexpr chrono::milliseconds follow_delay{ 5 }; //!< Czas gromadzenia dopisanych danych śledzonego pliku.
+
+		POOL m_clients; //!< Pula obsługiwanych klientów.
 		vector<pollfd> m_sockets; //!< Wektor wszystkich monitorowanych gniazd.
+		size_t m_head = 0; //!< Liczba deskryptorów usług na początku wektora `m_sockets`.
+
+		vector<int> m_listeners; //!< Gniazda nasłuchujące TCP (pierwsze to `m_sock`).
+		int m_local = 0; //!< Gniazdo nasłuchujące lokalne (`AF_UNIX`).
+		string m_path; //!< Ścieżka gniazda lokalnego.
+
+		unique_ptr<LAYOUT> m_layout; //!< Układ przechowywania plików.
+		unique_ptr<CHUNKSTORE> m_store; //!< Opcjonalny magazyn fragmentów.
+		unique_ptr<FILECACHE> m_cache; //!< Opcjonalna pamięć podręczna plików.
+		unique_ptr<SHAREDREAD> m_shared; //!< Opcjonalny współdzielony odczyt plików.
+		unique_ptr<INDEX> m_index; //!< Opcjonalny indeks metadanych plików.
+		unique_ptr<PROXY> m_proxy; //!< Opcjonalny tryb pośrednika.
+
+		WATCHER m_watcher; //!< Obserwator zmian w systemie plików.
+		vector<WATCHER::CALLBACK> m_observers; //!< Funkcje informowane o zmianach plików układu.
+		COMMITTER m_committer; //!< Grupowe zatwierdzanie wysyłanych plików.
+		REPLICATOR m_replicator; //!< Replikacja wysyłanych plików do kolejnych węzłów.
+		TRACER m_tracer; //!< Śledzenie opóźnień sesji.
+
+		vector<REPLICATOR::PEER> m_replicas; //!< Węzły łańcucha replikacji.
+
+		uint64_t m_serial = 0; //!< Numer ostatniego połączenia.
+
+		vector<char> m_chunk = vector<char>(PACER::max_chunk); //!< Bufor porcji o zmiennym rozmiarze.
+		bool m_pacing = true; //!< Flaga doboru rozmiaru porcji do połączenia.
+
+		LIMITS m_limits; //!< Limity zasobów kontroli przyjęć.
+		size_t m_files = 0; //!< Liczba deskryptorów klientów (według `account`).
+		size_t m_buffers = 0; //!< Liczba bajtów buforów klientów (według `account`).
+		size_t m_receiving = 0; //!< Liczba bajtów buforów klientów odbierających dane.
+		size_t m_held = 0; //!< Liczba klientów ze wstrzymanym odbiorem.
+		bool m_deferred = false; //!< Flaga wstrzymania przyjmowania połączeń.
+		deque<pair<int, uint64_t>> m_queue; //!< Żądania oczekujące na zwolnienie plików (gniazdo i numer połączenia).
 
 		bool m_terminate = false; //!< Flaga zakończenia działania serwera.
+		bool m_drain = false; //!< Flaga zgłoszenia wygaszania serwera.
+		bool m_draining = false; //!< Flaga trwającego wygaszania serwera.
+
+		chrono::seconds m_grace{ 30 }; //!< Maksymalny czas wygaszania.
+		chrono::steady_clock::time_point m_deadline; //!< Termin zakończenia wygaszania.
+
+		int m_handoff = -1; //!< Gniazdo przekazywania gniazd nasłuchujących.
+		string m_handoff_path; //!< Ścieżka gniazda przekazywania.
+		int m_takeover = -1; //!< Połączenie procesu przejmującego gniazda (oczekujące na potwierdzenie).
+
+		/*! \brief Zaplanowane wznowienia śledzonych plików.
+		 *
+		 *  Termin, gniazdo i numer połączenia. Opóźnienie jest stałe, więc
+		 *  kolejka jest uporządkowana według terminów.
+		 *
+		 */
+		deque<tuple<chrono::steady_clock::time_point, int, uint64_t>> m_wakeups;
 
 	public:
 
@@ -125,7 +370,7 @@ class SERVER : public SOCKBASE
 		/*! \brief Inicjacja serwera.
 		 *  \see stop.
 		 *  \returns Powodzenie operacji.
-		 *  \param [in] addr Adres do nasłuchiwania.
+		 *  \param [in] addr Adres do nasłuchiwania (IPv4, IPv6 lub `*` dla gniazda dwustosowego).
 		 *  \param [in] port Port do nasłuchiwania.
 		 *  \param [in] queue Liczba klientów do kolejkowania.
 		 *
@@ -138,6 +383,35 @@ class SERVER : public SOCKBASE
 				 const uint16_t port = 8080,
 				 const int queue = 10);
 
+		/*! \brief Dodanie gniazda nasłuchującego.
+		 *  \see start.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] addr Adres do nasłuchiwania (IPv4, IPv6 lub `*` dla gniazda dwustosowego).
+		 *  \param [in] port Port do nasłuchiwania.
+		 *  \param [in] queue Liczba klientów do kolejkowania.
+		 *
+		 *  Otwiera kolejne gniazdo (inny adres, interfejs lub port) obsługiwane przez
+		 *  tę samą pętlę serwera. Należy wywołać po funkcji `start`.
+		 *
+		 */
+		bool add_listener(const string& addr,
+					   const uint16_t port,
+					   const int queue = 10);
+
+		/*! \brief Nasłuchiwanie na gnieździe lokalnym.
+		 *  \see start, SOCKBASE::unix_address.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] path Ścieżka gniazda lub nazwa z prefiksem `@` (przestrzeń abstrakcyjna).
+		 *  \param [in] queue Liczba klientów do kolejkowania.
+		 *
+		 *  Dodaje gniazdo `AF_UNIX` obsługiwane przez tę samą pętlę co gniazdo TCP.
+		 *  Klienci lokalni mogą dodatkowo korzystać z poleceń `FDOWNLOAD` i `FUPLOAD`,
+		 *  w których zamiast danych pliku przekazywany jest jego deskryptor. Należy
+		 *  wywołać po funkcji `start`.
+		 *
+		 */
+		bool start_unix(const string& path, const int queue = 10);
+
 		/*! \brief Zatrzymuje serwer.
 		 *  \see start.
 		 *
@@ -154,6 +428,76 @@ class SERVER : public SOCKBASE
 		 */
 		void end(int signal);
 
+		/*! \brief Wygasza serwer.
+		 *  \see m_drain, set_grace.
+		 *
+		 *  Ustala flagę wygaszania - w kolejnej pętli serwer przestaje przyjmować
+		 *  połączenia i kończy pracę po obsłużeniu aktywnych transferów lub po
+		 *  upływie czasu wygaszania. Może być wywołana z obsługi sygnału.
+		 *
+		 */
+		void drain(int signal);
+
+		//! Ustawia maksymalny czas wygaszania w sekundach.
+		void set_grace(unsigned seconds);
+
+		/*! \brief Dobór rozmiaru porcji.
+		 *  \see PACER.
+		 *  \param [in] enable Dobór porcji i buforów gniazd do połączeń (domyślnie włączony).
+		 *
+		 *  Wyłączenie przywraca stałe porcje o rozmiarze `PACER::initial`. Bufory
+		 *  gniazd ustawione profilem strojenia nie są zmieniane.
+		 *
+		 */
+		void set_pacing(bool enable);
+
+		/*! \brief Ustawienie limitów zasobów.
+		 *  \see usage, admit.
+		 *  \param [in] limits Limity połączeń, deskryptorów i buforów.
+		 *
+		 *  Po przekroczeniu limitu połączeń serwer przestaje przyjmować połączenia
+		 *  (czekają one w kolejce gniazda nasłuchującego), po przekroczeniu limitu
+		 *  deskryptorów kompletne żądania czekają w kolejce na zwolnienie plików,
+		 *  a po przekroczeniu limitu buforów wstrzymywany jest odbiór danych od
+		 *  wysyłających klientów.
+		 *
+		 */
+		void set_limits(const LIMITS& limits);
+
+		/*! \brief Wykorzystanie zasobów.
+		 *  \see set_limits.
+		 *  \returns Bieżące wykorzystanie zasobów.
+		 *
+		 *  Przegląda wszystkie połączenia - koszt jest proporcjonalny do ich liczby.
+		 *
+		 */
+		USAGE usage(void);
+
+		/*! \brief Przekazywanie gniazd nasłuchujących.
+		 *  \see takeover.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] path Ścieżka gniazda lub nazwa z prefiksem `@` (przestrzeń abstrakcyjna).
+		 *
+		 *  Otwiera gniazdo lokalne, przez które nowy proces serwera może przejąć
+		 *  gniazda nasłuchujące. Po przekazaniu gniazd serwer rozpoczyna wygaszanie.
+		 *  Należy wywołać po funkcji `start` lub `takeover`.
+		 *
+		 */
+		bool start_handoff(const string& path);
+
+		/*! \brief Przejęcie gniazd nasłuchujących.
+		 *  \see start_handoff.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] path Ścieżka gniazda przekazywania działającego serwera.
+		 *
+		 *  Uruchamia serwer na gniazdach nasłuchujących (TCP i lokalnym) przekazanych
+		 *  przez działający proces, który następnie rozpoczyna wygaszanie. Połączenia
+		 *  oczekujące w kolejce nie są odrzucane, a przyjmowanie nie jest wstrzymywane
+		 *  na czas ponownego wiązania adresów. Zastępuje funkcję `start`.
+		 *
+		 */
+		bool takeover(const string& path);
+
 		/*! \brief Pętla serwera.
 		 *  \see start.
 		 *  \returns `false` gdy odebrano komunikat o zamknięciu serwera, `true` w przeciwnym razie.
@@ -165,6 +509,107 @@ class SERVER : public SOCKBASE
 		bool loop(int timeout = -1);
 
 
+		/*! \brief Wybór układu przechowywania plików.
+		 *  \see LAYOUT.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] spec Opis układu (`flat`, `sharded`, `sharded:2`) lub pusty łańcuch.
+		 *
+		 *  Wybiera układ katalogu roboczego. Pusty opis oznacza układ zapisany w
+		 *  znaczniku katalogu lub układ płaski. Układ niezgodny ze znacznikiem (lub
+		 *  podzielony dla niepustego katalogu bez znacznika) wymaga wcześniejszej
+		 *  migracji programem `TPK_migrate`. Należy wywołać przed `use_cache`,
+		 *  `use_shared` i `start`.
+		 *
+		 */
+		bool use_layout(const string& spec);
+
+		/*! \brief Wybór magazynu fragmentów.
+		 *  \see CHUNKSTORE.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] root Katalog magazynu.
+		 *
+		 *  Włącza zapis wysyłanych plików w magazynie fragmentów z deduplikacją.
+		 *  Pliki nieobecne w magazynie są nadal pobierane z katalogu roboczego.
+		 *
+		 */
+		bool use_store(const string& root);
+
+		/*! \brief Włączenie pamięci podręcznej.
+		 *  \see FILECACHE, WATCHER.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] budget Limit pamięci na zawartość plików w bajtach.
+		 *
+		 *  Włącza pamięć podręczną pobieranych plików. Wpisy są unieważniane na
+		 *  podstawie zdarzeń `inotify` z katalogu roboczego serwera.
+		 *
+		 */
+		bool use_cache(size_t budget);
+
+		/*! \brief Włączenie współdzielonego odczytu.
+		 *  \see SHAREDREAD, WATCHER.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] block Rozmiar bloku odczytu z wyprzedzeniem.
+		 *
+		 *  Równoczesne pobierania tego samego pliku korzystają z jednej sekwencji
+		 *  bloków odczytu. Przy włączonej pamięci podręcznej dotyczy to plików,
+		 *  których zawartość nie jest przechowywana w pamięci.
+		 *
+		 */
+		bool use_shared(size_t block = 1 << 18);
+
+		/*! \brief Włączenie indeksu metadanych.
+		 *  \see INDEX, WATCHER.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] hash Wyznaczanie skrótów zawartości plików.
+		 *
+		 *  Włącza polecenia `LIST` i `STAT` obsługiwane z indeksu w pamięci. Indeks
+		 *  budowany jest w funkcji `start` i aktualizowany po zatwierdzeniu wysłanych
+		 *  plików oraz na podstawie zdarzeń `inotify` - skróty i odbudowa po
+		 *  przepełnieniu kolejki zdarzeń wykonywane są w wątku indeksu. Pliki
+		 *  magazynu fragmentów nie są indeksowane. Należy wywołać przed `start`.
+		 *
+		 */
+		bool use_index(bool hash = false);
+
+		/*! \brief Włączenie śledzenia opóźnień.
+		 *  \see TRACER.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] path Ścieżka pliku zdarzeń (format zdarzeń Chrome).
+		 *  \param [in] rate Śledzona co `rate` sesja.
+		 *
+		 *  Zapisuje chwile przyjęcia połączenia, skompletowania nagłówka, otwarcia
+		 *  pliku, pierwszego i ostatniego bajtu danych oraz zamknięcia wybranych
+		 *  sesji. Plik zamykany jest w funkcji `stop`.
+		 *
+		 */
+		bool use_tracing(const string& path, unsigned rate = 1);
+
+		/*! \brief Włączenie replikacji łańcuchowej.
+		 *  \see REPLICATOR.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] chain Kolejne węzły łańcucha.
+		 *
+		 *  Wysyłane pliki (`UPLOAD` i `MPUT`) przekazywane są w trakcie odbioru do
+		 *  pierwszego węzła, który przekazuje je dalej. Plik zostaje zatwierdzony
+		 *  dopiero po potwierdzeniu zapisu przez cały łańcuch. Pliki magazynu
+		 *  fragmentów nie są replikowane. Należy wywołać przed `start`.
+		 *
+		 */
+		bool use_replicas(const vector<REPLICATOR::PEER>& chain);
+
+		/*! \brief Włączenie trybu pośrednika.
+		 *  \see PROXY.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] backends Serwery docelowe.
+		 *
+		 *  Serwer nie obsługuje poleceń samodzielnie - po odebraniu nagłówka wybiera
+		 *  serwer docelowy spójnym haszowaniem nazwy pliku i przekazuje do niego
+		 *  resztę sesji w obie strony bez kopiowania danych (`splice`). Należy
+		 *  wywołać przed `start`.
+		 *
+		 */
+		bool use_backends(const vector<PROXY::PEER>& backends);
+
 		/*! \brief Test uruchomienia serwera.
 		 *  \see start, stop.
 		 *  \returns `true` gdy serwer jest uruchomiony, `false` w przeciwnym razie.
@@ -176,14 +621,134 @@ class SERVER : public SOCKBASE
 
 	protected:
 
+		/*! \brief Przygotowanie uruchomienia.
+		 *  \returns Powodzenie operacji.
+		 *
+		 *  Wybiera domyślny układ przechowywania plików i buduje indeks metadanych.
+		 *
+		 */
+		bool prepare(void);
+
+		/*! \brief Uruchomienie obsługi.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] sock Pierwsze gniazdo nasłuchujące.
+		 *
+		 *  Dodaje gniazdo do listy `poll` i uruchamia usługi serwera.
+		 *
+		 */
+		bool launch(int sock);
+
+		/*! \brief Obsługa przejęcia gniazd.
+		 *  \see start_handoff, on_confirm.
+		 *
+		 *  Przekazuje nowemu procesowi gniazda nasłuchujące (`SCM_RIGHTS`) bez
+		 *  blokowania pętli serwera. Na potwierdzenie przejęcia czeka `poll`.
+		 *
+		 */
+		void on_takeover(void);
+
+		/*! \brief Obsługa potwierdzenia przejęcia gniazd.
+		 *  \see on_takeover.
+		 *
+		 *  Po potwierdzeniu przejęcia rozpoczyna wygaszanie i zwalnia ścieżkę
+		 *  gniazda przekazywania. Zamknięcie połączenia przez nowy proces
+		 *  porzuca przekazanie - serwer działa dalej.
+		 *
+		 */
+		void on_confirm(void);
+
+		/*! \brief Rozpoczęcie wygaszania.
+		 *  \param [in] handed Flaga przekazania gniazd innemu procesowi.
+		 *
+		 *  Zamyka gniazda nasłuchujące i wyznacza termin zakończenia pracy. Ścieżka
+		 *  przekazanego gniazda lokalnego nie jest usuwana.
+		 *
+		 */
+		void begin_drain(bool handed);
+
+		/*! \brief Test zakończenia wygaszania.
+		 *  \returns `true` gdy nie ma aktywnych transferów.
+		 *
+		 *  Połączenia oczekujące na nagłówek (np. pule połączeń) nie wstrzymują
+		 *  zakończenia pracy.
+		 *
+		 */
+		bool is_drained(void);
+
+		/*! \brief Kontrola przyjęć.
+		 *  \see set_limits.
+		 *
+		 *  Przyjmuje żądania z kolejki, wstrzymuje lub wznawia przyjmowanie
+		 *  połączeń i odbiór danych na podstawie liczników `account`. Wywoływana
+		 *  przed każdym `poll` - przegląda połączenia jedynie po przekroczeniu
+		 *  limitu buforów lub gdy odbiór któregoś klienta jest wstrzymany.
+		 *
+		 */
+		void admit(void);
+
+		/*! \brief Aktualizacja liczników zasobów.
+		 *  \see admit, discount.
+		 *  \param [in] sock Gniazdo klienta.
+		 *
+		 *  Zastępuje w licznikach serwera poprzednio uwzględnione zasoby klienta
+		 *  bieżącymi. Wywoływana po obsłużeniu zdarzeń klienta.
+		 *
+		 */
+		void account(int sock);
+
+		/*! \brief Usunięcie klienta z liczników zasobów.
+		 *  \see account.
+		 *  \param [in] client Usuwany klient.
+		 *
+		 */
+		void discount(CLIENT& client);
+
+		/*! \brief Dodanie deskryptora usługi.
+		 *  \see loop.
+		 *  \param [in] fd Deskryptor usługi.
+		 *
+		 *  Dodaje deskryptor (gniazdo nasłuchujące, obserwator itp.) przed listą
+		 *  klientów w wektorze `poll`.
+		 *
+		 */
+		void add_service(int fd);
+
+		//! Usuwa deskryptor usługi z listy `poll`.
+		void remove_service(int fd);
+
+		/*! \brief Utworzenie gniazda nasłuchującego.
+		 *  \returns Deskryptor gniazda lub `-1` w przypadku błędu.
+		 *  \param [in] addr Adres do nasłuchiwania.
+		 *  \param [in] port Port do nasłuchiwania.
+		 *  \param [in] queue Liczba klientów do kolejkowania.
+		 *
+		 *  Tworzy, konfiguruje i wiąże gniazdo TCP z adresem IPv4 lub IPv6.
+		 *
+		 */
+		int open_listener(const string& addr, const uint16_t port, const int queue);
+
+		/*! \brief Obserwacja katalogu roboczego.
+		 *  \see WATCHER.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] callback Funkcja zwrotna.
+		 *
+		 *  Rejestruje funkcję wywoływaną przy zmianach plików we wszystkich katalogach
+		 *  układu. Funkcja otrzymuje ścieżkę pliku w układzie. Katalogi obserwowane
+		 *  są raz, wspólnie dla wszystkich funkcji. W razie potrzeby otwiera
+		 *  obserwator i dodaje go do listy `poll`.
+		 *
+		 */
+		bool watch_files(const WATCHER::CALLBACK& callback);
+
 		/*! \brief Obsługa nowego połączenia.
 		 *  \see loop.
 		 *  \param [in] sock Deskryptor nowego połączenia.
+		 *  \param [in] local Flaga połączenia przez gniazdo lokalne.
 		 *
 		 *  Dodaje zaakceptowane połączenie do listy klientów.
 		 *
 		 */
-		void on_accept(int sock);
+		void on_accept(int sock, bool local = false);
 
 		/*! \brief Obsługa nagłówka.
 		 *  \see loop.
@@ -195,6 +760,41 @@ class SERVER : public SOCKBASE
 		 */
 		ITERATOR on_header(ITERATOR it);
 
+		/*! \brief Obsługa ramki binarnej.
+		 *  \see on_header, FRAME.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Sprawdza kompletną ramkę, odsyła jej status i zastępuje ją w buforze
+		 *  równoważnym nagłówkiem tekstowym.
+		 *
+		 */
+		ITERATOR on_frame(ITERATOR it);
+
+		/*! \brief Sprawdzenie pobieranego pliku.
+		 *  \see on_frame.
+		 *  \returns Status odpowiedzi na ramkę.
+		 *  \param [in] request Żądanie `DOWNLOAD` lub `FOLLOW`.
+		 *
+		 *  Sprawdza istnienie pliku i pozycję początkową przed potwierdzeniem
+		 *  ramki, aby klient wznawiający pobieranie mógł odróżnić kompletny
+		 *  plik od brakującego lub krótszego.
+		 *
+		 */
+		FRAME::STATUS probe(const FRAME::REQUEST& request);
+
+		/*! \brief Obsługa polecenia.
+		 *  \see on_header.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *  \param [in] admitted Żądanie przyjęte z kolejki (bez ponownej kontroli przyjęć).
+		 *
+		 *  Przetwarza kompletny nagłówek tekstowy i zmienia stan połączenia. Przy
+		 *  wyczerpanym limicie deskryptorów odkłada żądanie do kolejki.
+		 *
+		 */
+		ITERATOR on_command(ITERATOR it, bool admitted = false);
+
 		/*! \brief Obsługa wysyłania pliku.
 		 *  \see loop.
 		 *  \returns Iterator kolejnego klienta.
@@ -215,6 +815,403 @@ class SERVER : public SOCKBASE
 		 */
 		ITERATOR on_download(ITERATOR it);
 
+		/*! \brief Obsługa zmiany śledzonego pliku.
+		 *  \see on_download, follow_delay.
+		 *  \param [in] sock Deskryptor połączenia.
+		 *  \param [in] serial Numer połączenia.
+		 *  \param [in] mask Maska zdarzenia `inotify`.
+		 *
+		 *  Planuje wznowienie wysyłania po upływie `follow_delay` - dopisania z
+		 *  tego okresu zostaną wysłane razem.
+		 *
+		 */
+		void on_follow(int sock, uint64_t serial, uint32_t mask);
+
+		/*! \brief Wznowienie wysyłania śledzonych plików.
+		 *  \returns Czas w ms do kolejnego wznowienia lub `-1` gdy żadne nie jest zaplanowane.
+		 *
+		 *  Przywraca wysyłanie połączeniom, których termin gromadzenia danych minął.
+		 *
+		 */
+		int wake_followers(void);
+
+		//! Kończy obserwację śledzonego pliku klienta.
+		void unfollow(CLIENT& client);
+
+		/*! \brief Obsługa wysyłania sygnatury.
+		 *  \see loop, DELTA.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Wysyła kolejny fragment sygnatury pliku. Po wysłaniu całej sygnatury
+		 *  przechodzi do odbioru strumienia zmian.
+		 *
+		 */
+		ITERATOR on_signature(ITERATOR it);
+
+		/*! \brief Obsługa strumienia zmian.
+		 *  \see loop, DELTA.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Pobiera fragment strumienia zmian i odtwarza z niego plik. Po odebraniu
+		 *  całego strumienia zatwierdza plik i odsyła klientowi status operacji.
+		 *
+		 */
+		ITERATOR on_patch(ITERATOR it);
+
+		/*! \brief Obsługa wysyłania z deduplikacją.
+		 *  \see loop, CHUNKSTORE::SESSION.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Pobiera zapytania o fragmenty i dane brakujących fragmentów, odpowiada
+		 *  mapą obecnych fragmentów i po odebraniu całego pliku zatwierdza jego manifest.
+		 *
+		 */
+		ITERATOR on_dedup(ITERATOR it);
+
+		/*! \brief Przetworzenie danych deduplikacji.
+		 *  \see on_dedup.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *  \param [in] data Odebrane dane.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Przekazuje dane do sesji deduplikacji, wysyła odpowiedzi i kończy sesję.
+		 *
+		 */
+		ITERATOR dedup_feed(ITERATOR it, const char* data, size_t size);
+
+		/*! \brief Obsługa importu pliku.
+		 *  \see loop, SOCKBASE::copy_fd.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Kopiuje kolejny fragment pliku z deskryptora przekazanego przez klienta
+		 *  lokalnego. Po skopiowaniu całego pliku odsyła klientowi status operacji.
+		 *
+		 */
+		ITERATOR on_import(ITERATOR it);
+
+		/*! \brief Obsługa zatwierdzenia importu.
+		 *  \see on_import, COMMITTER.
+		 *  \param [in] sock Deskryptor połączenia.
+		 *  \param [in] serial Numer połączenia.
+		 *  \param [in] ok Wynik zatwierdzenia.
+		 *
+		 *  Odsyła status operacji i kończy połączenie, o ile nadal istnieje.
+		 *
+		 */
+		void on_committed(int sock, uint64_t serial, bool ok);
+
+		/*! \brief Przekazanie pliku klientowi lokalnemu.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *  \param [in] name Nazwa pliku.
+		 *
+		 *  Wysyła status operacji wraz z deskryptorem otwartego pliku i kończy połączenie.
+		 *  Pliki z magazynu fragmentów odtwarzane są w anonimowym pliku w pamięci.
+		 *
+		 */
+		ITERATOR on_handoff(ITERATOR it, const string& name);
+
+		/*! \brief Obsługa wysyłania odpowiedzi z indeksu.
+		 *  \see loop, INDEX.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Wysyła dane oczekujące, a dla polecenia `LIST` dopisuje kolejne porcje
+		 *  rekordów. Po wysłaniu całej odpowiedzi kończy połączenie.
+		 *
+		 */
+		ITERATOR on_reply(ITERATOR it);
+
+		/*! \brief Obsługa listy nazw plików.
+		 *  \see loop, on_stream.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Pobiera fragment listy nazw polecenia `MGET -`.
+		 *
+		 */
+		ITERATOR on_request(ITERATOR it);
+
+		/*! \brief Przetworzenie listy nazw plików.
+		 *  \see on_request.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *  \param [in] data Odebrane dane.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Dekoduje rekordy nazw (długość 16 b i nazwa). Po rekordzie o zerowej
+		 *  długości rozpoczyna wysyłanie strumienia plików.
+		 *
+		 */
+		ITERATOR request_feed(ITERATOR it, const char* data, size_t size);
+
+		/*! \brief Obsługa strumienia wielu plików.
+		 *  \see loop, on_request.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Wysyła kolejne ramki plików: długość nazwy (16 b), nazwę, rozmiar (64 b)
+		 *  i dane. Małe pliki łączone są w porcje o rozmiarze `stream_block`.
+		 *  Strumień kończy ramka o zerowej długości nazwy, po której połączenie
+		 *  oczekuje na kolejny nagłówek.
+		 *
+		 */
+		ITERATOR on_stream(ITERATOR it);
+
+		/*! \brief Obsługa odbioru wielu plików.
+		 *  \see loop, receive_feed.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Pobiera fragment strumienia polecenia `MPUT`.
+		 *
+		 */
+		ITERATOR on_receive(ITERATOR it);
+
+		/*! \brief Przetworzenie strumienia wielu plików.
+		 *  \see on_receive.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *  \param [in] data Odebrane dane.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Dekoduje ramki plików (jak w odpowiedzi `MGET`) i zapisuje każdy plik do
+		 *  pliku tymczasowego przekazywanego do grupowego zatwierdzenia. Po ramce
+		 *  zakończenia czeka na zatwierdzenie wszystkich plików.
+		 *
+		 */
+		ITERATOR receive_feed(ITERATOR it, const char* data, size_t size);
+
+		/*! \brief Obsługa zatwierdzenia pliku strumienia.
+		 *  \see receive_feed, COMMITTER.
+		 *  \param [in] sock Deskryptor połączenia.
+		 *  \param [in] serial Numer połączenia.
+		 *  \param [in] ok Wynik zatwierdzenia.
+		 *
+		 *  Aktualizuje liczniki strumienia i po zatwierdzeniu ostatniego pliku
+		 *  odsyła klientowi wynik.
+		 *
+		 */
+		void on_stored(int sock, uint64_t serial, bool ok);
+
+		/*! \brief Zakończenie strumienia wielu plików.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Odsyła liczbę zapisanych plików i błędów (po 32 b), a następnie oczekuje
+		 *  na kolejny nagłówek w tym samym połączeniu.
+		 *
+		 */
+		ITERATOR finish_receive(ITERATOR it);
+
+		/*! \brief Obsługa odbioru pliku replikowanego.
+		 *  \see loop, replicate_feed.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Pobiera fragment strumienia polecenia `REPLICATE`.
+		 *
+		 */
+		ITERATOR on_replicate(ITERATOR it);
+
+		/*! \brief Obsługa wysyłania pliku rzadkiego.
+		 *  \see loop, SPARSE.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Wyznacza kolejne obszary danych i dziury pliku i wysyła ich rekordy wraz
+		 *  z danymi. Po wysłaniu rekordu zakończenia zamyka połączenie.
+		 *
+		 */
+		ITERATOR on_extents(ITERATOR it);
+
+		/*! \brief Obsługa odbioru pliku rzadkiego.
+		 *  \see loop, sparse_feed.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Pobiera fragment strumienia polecenia `SPUT`.
+		 *
+		 */
+		ITERATOR on_punch(ITERATOR it);
+
+		/*! \brief Przetworzenie pliku rzadkiego.
+		 *  \see on_punch, SPARSE.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *  \param [in] data Odebrane dane.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Zapisuje dane obszarów pod wskazanymi pozycjami pliku tymczasowego i
+		 *  zwalnia bloki dziur. Rekord zakończenia ustala rozmiar pliku i przekazuje
+		 *  go do zatwierdzenia - status zostanie odesłany po utrwaleniu pliku.
+		 *
+		 */
+		ITERATOR sparse_feed(ITERATOR it, const char* data, size_t size);
+
+		/*! \brief Przetworzenie pliku replikowanego.
+		 *  \see on_replicate.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *  \param [in] data Odebrane dane.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Dekoduje listę pozostałych węzłów (długość 16 b i lista `host:port`
+		 *  rozdzielona przecinkami) oraz rekordy danych (długość 32 b i dane).
+		 *  Dane zapisuje do pliku tymczasowego i przekazuje do kolejnego węzła.
+		 *  Rekord o zerowej długości kończy plik.
+		 *
+		 */
+		ITERATOR replicate_feed(ITERATOR it, const char* data, size_t size);
+
+		/*! \brief Obsługa zatwierdzenia pliku replikowanego.
+		 *  \see replicate_feed, COMMITTER.
+		 *  \param [in] sock Deskryptor połączenia.
+		 *  \param [in] serial Numer połączenia.
+		 *  \param [in] ok Wynik zatwierdzenia.
+		 *
+		 *  Odsyła status operacji, o ile połączenie nadal istnieje.
+		 *
+		 */
+		void on_replicated(int sock, uint64_t serial, bool ok);
+
+		/*! \brief Zakończenie odbioru pliku replikowanego.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *  \param [in] ok Wynik zapisu pliku przez węzeł i dalszą część łańcucha.
+		 *
+		 *  Odsyła bajt statusu (`0` oznacza sukces), a następnie oczekuje na kolejny
+		 *  nagłówek w tym samym połączeniu.
+		 *
+		 */
+		ITERATOR finish_replicate(ITERATOR it, bool ok);
+
+		/*! \brief Rozpoczęcie replikacji pliku.
+		 *  \see REPLICATOR::begin.
+		 *  \returns Numer strumienia replikacji.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *  \param [in] name Nazwa pliku.
+		 *  \param [in] chain Węzły łańcucha.
+		 *
+		 *  Wstrzymany odbiór danych klienta zostanie wznowiony metodą `on_resume`.
+		 *
+		 */
+		unsigned replicate(ITERATOR it, const string& name, const vector<REPLICATOR::PEER>& chain);
+
+		/*! \brief Wstrzymanie odbioru danych.
+		 *  \returns `true` gdy odbiór został wstrzymany.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *
+		 *  Przestaje monitorować gotowość do odczytu, gdy kolejka strumienia
+		 *  replikacji klienta jest pełna.
+		 *
+		 */
+		bool throttle(ITERATOR it);
+
+		/*! \brief Wznowienie odbioru danych.
+		 *  \see throttle.
+		 *  \param [in] sock Deskryptor połączenia.
+		 *  \param [in] serial Numer połączenia.
+		 *
+		 *  Przywraca monitorowanie gotowości do odczytu, o ile połączenie nadal odbiera plik.
+		 *
+		 */
+		void on_resume(int sock, uint64_t serial);
+
+		/*! \brief Zatwierdzenie pliku.
+		 *  \see COMMITTER::submit, REPLICATOR::finish.
+		 *  \param [in] fd Deskryptor pliku tymczasowego.
+		 *  \param [in] temp Nazwa pliku tymczasowego.
+		 *  \param [in] name Nazwa pliku docelowego.
+		 *  \param [in] replica Numer strumienia replikacji lub `0`.
+		 *  \param [in] callback Funkcja zwrotna zatwierdzenia.
+		 *
+		 *  Przy replikacji przekazuje plik do zatwierdzenia dopiero po potwierdzeniu
+		 *  zapisu przez łańcuch - w przeciwnym razie usuwa plik tymczasowy.
+		 *
+		 */
+		void commit(int fd, const string& temp, const string& name,
+				  unsigned replica, const COMMITTER::CALLBACK& callback);
+
+		/*! \brief Rozpoczęcie przekazywania sesji.
+		 *  \see PROXY, on_relay.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanego klienta.
+		 *  \param [in] key Nazwa pliku wybierająca serwer docelowy.
+		 *
+		 *  Pobiera połączenie z serwerem docelowym i umieszcza odebrany nagłówek
+		 *  (wraz z danymi za nim) w potoku klienta.
+		 *
+		 */
+		ITERATOR on_proxy(ITERATOR it, const string& key);
+
+		/*! \brief Obsługa przekazywanej sesji.
+		 *  \see on_proxy.
+		 *  \returns Iterator kolejnego klienta.
+		 *  \param [in] it Iterator obsługiwanej strony sesji.
+		 *
+		 *  Przenosi dane z gniazda do potoku i z potoku do gniazda drugiej strony.
+		 *  Potok jest zapełniany dopiero po jego opróżnieniu, a koniec danych jednej
+		 *  strony zamyka kierunek nadawczy drugiej (`shutdown`). Sesja kończy się
+		 *  po zakończeniu danych obu stron.
+		 *
+		 */
+		ITERATOR on_relay(ITERATOR it);
+
+		/*! \brief Opróżnienie potoku.
+		 *  \returns `false` w przypadku błędu gniazda.
+		 *  \param [in,out] from Strona sesji, której dane znajdują się w potoku.
+		 *  \param [in] sock Gniazdo drugiej strony.
+		 *
+		 *  Przenosi bez blokowania dane z potoku do gniazda.
+		 *
+		 */
+		static bool relay_flush(CLIENT& from, int sock);
+
+		/*! \brief Zmiana monitorowanych zdarzeń.
+		 *  \param [in] sock Gniazdo połączenia.
+		 *  \param [in] set Zdarzenia do włączenia.
+		 *  \param [in] clear Zdarzenia do wyłączenia.
+		 *
+		 */
+		void relay_events(int sock, short set, short clear);
+
+		/*! \brief Wyszukanie plików wzorcem.
+		 *  \returns Nazwy dopasowanych plików w porządku nazw.
+		 *  \param [in] pattern Wzorzec nazw (`fnmatch`).
+		 *
+		 *  Korzysta z indeksu metadanych lub przegląda katalogi układu.
+		 *
+		 */
+		vector<string> match_files(const string& pattern) const;
+
+		/*! \brief Wysyłanie bez blokowania.
+		 *  \returns Liczba wysłanych bajtów, `0` gdy bufor gniazda jest pełny lub `-1` w przypadku błędu.
+		 *  \param [in] sock Gniazdo klienta.
+		 *  \param [in] data Dane do wysłania.
+		 *  \param [in] size Liczba bajtów (większa od zera).
+		 *
+		 *  Pełny bufor gniazda (`EAGAIN`) nie jest błędem - klient zostanie
+		 *  obsłużony ponownie, gdy `poll` zgłosi gotowość do zapisu.
+		 *
+		 */
+		static ssize_t send_chunk(int sock, const char* data, size_t size);
+
+		/*! \brief Wysyłanie danych oczekujących.
+		 *  \see send_chunk.
+		 *  \returns Liczba wysłanych bajtów, `0` gdy bufor gniazda jest pełny lub `-1` w przypadku błędu.
+		 *  \param [in] client Obsługiwany klient.
+		 *
+		 *  Wysyła bez blokowania dane z bufora `out` klienta, począwszy od pozycji `sent`.
+		 *
+		 */
+		static ssize_t send_out(CLIENT& client);
+
 		/*! \brief Obsługa rozłączenia klienta.
 		 *  \see loop.
 		 *  \returns Iterator kolejnego klienta.
@@ -0,0 +1,171 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy współdzielonego odczytu plików.
+ *  \file
+ *
+ */
+
+#include "sharedread.hpp"
+
+SHAREDREAD::STREAM::STREAM(int fd, uint64_t size, size_t block, size_t window)
+: m_fd(fd), m_size(size), m_block(block), m_window(window)
+{
+	// Strumień jest odczytywany sekwencyjnie
+	::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+SHAREDREAD::STREAM::~STREAM(void)
+{
+	::close(m_fd); // Zamknij deskryptor pliku
+}
+
+SHAREDREAD::BLOCKPTR SHAREDREAD::STREAM::get(uint64_t index)
+{
+	// Zwróć blok, jeśli ktoś go jeszcze posiada
+	if (auto block = m_blocks[index].lock()) return block;
+
+	auto block = make_shared<BLOCK>();
+	block->offset = index * m_block;
+
+	const size_t size = min<uint64_t>(m_block, m_size - min(m_size, block->offset));
+	size_t done = 0;
+	ssize_t rc = 0;
+
+	block->data.resize(size);
+
+	// Odczytaj cały blok
+	while (done < size && (rc = ::pread(m_fd, block->data.data() + done,
+								 size - done, block->offset + done)) > 0) done += rc;
+
+	if (rc < 0) return nullptr;
+	else block->data.resize(done);
+
+	// Poproś jądro o odczyt kolejnego bloku z wyprzedzeniem
+	::posix_fadvise(m_fd, block->offset + m_block, m_block, POSIX_FADV_WILLNEED);
+
+	m_blocks[index] = block;
+	m_recent.push_back(block);
+
+	// Ogranicz okno ostatnich bloków
+	if (m_recent.size() > m_window) m_recent.pop_front();
+
+	// Usuń wygasłe wpisy indeksu
+	if (m_blocks.size() > 4 * m_window)
+	{
+		for (auto it = m_blocks.begin(); it != m_blocks.end(); )
+		{
+			if (it->second.expired()) it = m_blocks.erase(it);
+			else ++it;
+		}
+	}
+
+	return block;
+}
+
+uint64_t SHAREDREAD::STREAM::size(void) const
+{
+	return m_size;
+}
+
+size_t SHAREDREAD::STREAM::block(void) const
+{
+	return m_block;
+}
+
+SHAREDREAD::CURSOR::CURSOR(const shared_ptr<STREAM>& stream)
+: m_stream(stream) {}
+
+ssize_t SHAREDREAD::CURSOR::peek(const char*& data)
+{
+	if (m_offset >= m_stream->size()) return 0;
+
+	const uint64_t index = m_offset / m_stream->block();
+
+	// Przejdź do bloku zawierającego bieżącą pozycję
+	if (!m_block || m_block->offset != index * m_stream->block())
+		m_block = m_stream->get(index);
+
+	if (!m_block) return -1;
+
+	const size_t pos = m_offset - m_block->offset;
+
+	// Blok może być krótszy, gdy plik został skrócony
+	if (pos >= m_block->data.size()) return 0;
+
+	data = m_block->data.data() + pos;
+
+	return m_block->data.size() - pos;
+}
+
+void SHAREDREAD::CURSOR::advance(size_t size)
+{
+	m_offset += size;
+}
+
+SHAREDREAD::SHAREDREAD(size_t block, size_t window)
+: m_block(block), m_window(window) {}
+
+unique_ptr<SHAREDREAD::CURSOR> SHAREDREAD::open(const string& name, int dir)
+{
+	// Dołącz do istniejącego strumienia
+	if (auto stream = m_streams[name].lock())
+		return make_unique<CURSOR>(stream);
+
+	const size_t slash = dir == AT_FDCWD ? string::npos : name.rfind('/');
+
+	// Względem katalogu plik otwierany jest samą nazwą
+	const int fd = ::openat(dir, name.c_str() + (slash == string::npos ? 0 : slash + 1), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+
+	if (fd == -1) { m_streams.erase(name); return nullptr; }
+	else if (::fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+	{
+		m_streams.erase(name);
+		::close(fd);
+
+		return nullptr;
+	}
+
+	// Usuń wygasłe strumienie
+	if (m_streams.size() > 1024)
+	{
+		for (auto it = m_streams.begin(); it != m_streams.end(); )
+		{
+			if (it->second.expired()) it = m_streams.erase(it);
+			else ++it;
+		}
+	}
+
+	auto stream = make_shared<STREAM>(fd, st.st_size, m_block, m_window);
+	m_streams[name] = stream;
+
+	return make_unique<CURSOR>(stream);
+}
+
+void SHAREDREAD::invalidate(const string& name)
+{
+	m_streams.erase(name);
+}
+
+void SHAREDREAD::clear(void)
+{
+	m_streams.clear();
+}
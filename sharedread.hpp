@@ -0,0 +1,186 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy współdzielonego odczytu plików.
+ *  \file
+ *
+ */
+
+#ifndef SHAREDREAD_HPP
+#define SHAREDREAD_HPP
+
+#include <sys/stat.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+
+using namespace std;
+
+/*! \brief Klasa współdzielonego odczytu plików.
+ *
+ *  Łączy równoczesne pobierania tego samego pliku. Wszystkie połączenia
+ *  pobierające plik korzystają z jednego strumienia (jeden deskryptor) i jednej
+ *  sekwencji bloków odczytu z wyprzedzeniem. Bloki są zliczane referencjami -
+ *  żyją dopóki korzysta z nich którykolwiek kursor lub dopóki mieszczą się w
+ *  oknie ostatnio odczytanych bloków strumienia. Każde połączenie posiada
+ *  własny kursor, więc odczyty z dysku i zużycie pamięci nie rosną wraz z
+ *  liczbą pobierających.
+ *
+ */
+class SHAREDREAD
+{
+
+	public:
+
+		/*! \brief Blok odczytu z wyprzedzeniem.
+		 *
+		 *  Fragment pliku współdzielony przez kursory.
+		 *
+		 */
+		struct BLOCK
+		{
+			uint64_t offset; //!< Pozycja bloku w pliku.
+			vector<char> data; //!< Dane bloku.
+		};
+
+		using BLOCKPTR = shared_ptr<const BLOCK>; //!< Wskaźnik na blok.
+
+		/*! \brief Strumień pliku.
+		 *
+		 *  Współdzielony przez wszystkie kursory danego pliku.
+		 *
+		 */
+		class STREAM
+		{
+
+			protected:
+
+				int m_fd; //!< Deskryptor pliku.
+				uint64_t m_size; //!< Rozmiar pliku.
+				size_t m_block; //!< Rozmiar bloku.
+				size_t m_window; //!< Liczba ostatnich bloków utrzymywanych w pamięci.
+
+				unordered_map<uint64_t, weak_ptr<const BLOCK>> m_blocks; //!< Bloki według indeksu.
+				deque<BLOCKPTR> m_recent; //!< Ostatnio odczytane bloki.
+
+			public:
+
+				STREAM(int fd, uint64_t size, size_t block, size_t window); //!< Konstruktor strumienia.
+				~STREAM(void); //!< Destruktor, zamyka deskryptor.
+
+				STREAM(const STREAM&) = delete; //!< Konstruktor kopiujący (usunięty).
+				STREAM& operator= (const STREAM&) = delete; //!< Operator przypisania (usunięty).
+
+				/*! \brief Pobranie bloku.
+				 *  \returns Blok lub pusty wskaźnik w przypadku błędu odczytu.
+				 *  \param [in] index Indeks bloku.
+				 *
+				 *  Zwraca współdzielony blok, a gdy nikt go nie posiada odczytuje go z pliku.
+				 *
+				 */
+				BLOCKPTR get(uint64_t index);
+
+				//! Zwraca rozmiar pliku.
+				uint64_t size(void) const;
+
+				//! Zwraca rozmiar bloku.
+				size_t block(void) const;
+
+		};
+
+		/*! \brief Kursor połączenia.
+		 *
+		 *  Pozycja pojedynczego pobierającego w strumieniu pliku.
+		 *
+		 */
+		class CURSOR
+		{
+
+			protected:
+
+				shared_ptr<STREAM> m_stream; //!< Strumień pliku.
+				BLOCKPTR m_block; //!< Bieżący blok.
+				uint64_t m_offset = 0; //!< Pozycja w pliku.
+
+			public:
+
+				explicit CURSOR(const shared_ptr<STREAM>& stream); //!< Konstruktor kursora.
+
+				/*! \brief Dostęp do danych.
+				 *  \returns Liczba dostępnych bajtów, `0` na końcu pliku lub `-1` w przypadku błędu.
+				 *  \param [out] data Wskaźnik na dane od bieżącej pozycji.
+				 *
+				 *  Zwraca dane od bieżącej pozycji do końca bieżącego bloku bez kopiowania.
+				 *
+				 */
+				ssize_t peek(const char*& data);
+
+				//! Przesuwa kursor o wskazaną liczbę bajtów.
+				void advance(size_t size);
+
+		};
+
+	protected:
+
+		unordered_map<string, weak_ptr<STREAM>> m_streams; //!< Otwarte strumienie według nazwy.
+
+		size_t m_block; //!< Rozmiar bloku.
+		size_t m_window; //!< Liczba ostatnich bloków utrzymywanych w pamięci.
+
+	public:
+
+		/*! \brief Konstruktor współdzielonego odczytu.
+		 *  \param [in] block Rozmiar bloku odczytu.
+		 *  \param [in] window Liczba ostatnich bloków utrzymywanych dla opóźnionych kursorów.
+		 *
+		 */
+		explicit SHAREDREAD(size_t block = 1 << 18,
+						size_t window = 4);
+
+		/*! \brief Otwarcie pliku.
+		 *  \returns Kursor lub pusty wskaźnik gdy plik nie istnieje.
+		 *  \param [in] name Ścieżka pliku.
+		 *  \param [in] dir Deskryptor katalogu pliku - plik otwierany jest wtedy względem niego.
+		 *
+		 *  Dołącza do istniejącego strumienia pliku lub otwiera nowy.
+		 *
+		 */
+		unique_ptr<CURSOR> open(const string& name, int dir = AT_FDCWD);
+
+		/*! \brief Unieważnienie strumienia.
+		 *  \param [in] name Nazwa pliku.
+		 *
+		 *  Kolejne pobrania otworzą plik ponownie. Trwające pobrania korzystają ze starego strumienia.
+		 *
+		 */
+		void invalidate(const string& name);
+
+		//! Unieważnia wszystkie strumienie.
+		void clear(void);
+
+};
+
+#endif // SHAREDREAD_HPP
@@ -25,6 +25,13 @@
 
 #include "sockbase.hpp"
 
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <ctype.h>
+
+#include <algorithm>
+
 SOCKBASE::SOCKBASE(void) {}
 
 SOCKBASE::~SOCKBASE(void)
@@ -42,13 +49,23 @@ void SOCKBASE::close(void)
 	}
 }
 
-bool SOCKBASE::send_all(int sock, const char* data, size_t size)
+void SOCKBASE::set_profile(const PROFILE& profile)
+{
+	m_profile = profile;
+}
+
+const SOCKBASE::PROFILE& SOCKBASE::get_profile(void) const
+{
+	return m_profile;
+}
+
+bool SOCKBASE::send_all(int sock, const char* data, size_t size, int flags)
 {
 	// Gdy są jeszcze dane do wysłania
 	while (size > 0)
 	{
 		// Wyślij brakujące dane
-		const int sc = ::send(sock, data, size, 0);
+		const ssize_t sc = ::send(sock, data, size, flags);
 
 		// W przypadku błędu przerwij działanie
 		if (sc <= 0) return false;
@@ -62,14 +79,409 @@ bool SOCKBASE::send_all(int sock, const char* data, size_t size)
 	return true;
 }
 
+bool SOCKBASE::recv_all(int sock, char* data, size_t size)
+{
+	// Gdy są jeszcze dane do odebrania
+	while (size > 0)
+	{
+		// Odbierz brakujące dane
+		const ssize_t rc = ::recv(sock, data, size, 0);
+
+		// W przypadku błędu lub zamknięcia połączenia przerwij działanie
+		if (rc <= 0) return false;
+		else
+		{
+			data += rc; // Przesuń wskaźnik na dane
+			size -= rc; // Zmniejsz liczbę pozostałych danych
+		}
+	}
+
+	return true;
+}
+
 char* SOCKBASE::get_name(int sock)
 {
-	sockaddr_in addr;
+	static char name[INET6_ADDRSTRLEN] = "";
+	static char local[] = "local";
+
+	sockaddr_storage addr;
 	socklen_t len = sizeof(addr);
 
 	// Pobierz dane związane z gniazdem
-	getpeername(sock, (sockaddr*) &addr, &len);
+	if (getpeername(sock, (sockaddr*) &addr, &len) == -1) return name;
 
 	// Konwertuj adres z liczby na łańcuch
-	return inet_ntoa(addr.sin_addr);
+	if (addr.ss_family == AF_INET6)
+		inet_ntop(AF_INET6, &((sockaddr_in6*) &addr)->sin6_addr, name, sizeof(name));
+	else if (addr.ss_family == AF_INET)
+		inet_ntop(AF_INET, &((sockaddr_in*) &addr)->sin_addr, name, sizeof(name));
+	else return local; // Gniazda lokalne nie mają adresu sieciowego
+
+	return name;
+}
+
+bool SOCKBASE::split_endpoint(const std::string& spec, std::string& host, uint16_t& port)
+{
+	size_t colon = std::string::npos;
+
+	// Adres IPv6 zapisywany jest w nawiasach kwadratowych
+	if (!spec.empty() && spec[0] == '[')
+	{
+		const size_t close = spec.find(']');
+
+		if (close == std::string::npos || spec.compare(close + 1, 1, ":") != 0) return false;
+
+		host = spec.substr(1, close - 1);
+		colon = close + 1;
+	}
+	else if ((colon = spec.rfind(':')) != std::string::npos)
+	{
+		host = spec.substr(0, colon);
+	}
+	else return false;
+
+	const int value = atoi(spec.c_str() + colon + 1);
+
+	if (host.empty() || value <= 0 || value > 65535) return false;
+	else port = value;
+
+	return true;
+}
+
+bool SOCKBASE::unix_address(const std::string& path, sockaddr_un& addr, socklen_t& len)
+{
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	// Nazwa musi zmieścić się w strukturze razem z kończącym zerem
+	if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+
+	// W przestrzeni abstrakcyjnej nazwa zaczyna się bajtem zerowym
+	// i nie jest zakończona zerem - liczy się długość adresu
+	if (path[0] == '@')
+	{
+		memcpy(addr.sun_path + 1, path.data() + 1, path.size() - 1);
+		len = offsetof(sockaddr_un, sun_path) + path.size();
+	}
+	else
+	{
+		memcpy(addr.sun_path, path.data(), path.size());
+		len = sizeof(addr);
+	}
+
+	return true;
+}
+
+bool SOCKBASE::send_fd(int sock, int fd, const char* data, size_t size)
+{
+	if (size == 0) return false;
+
+	// Bufor komunikatu kontrolnego z prawidłowym wyrównaniem
+	union { cmsghdr align; char buff[CMSG_SPACE(sizeof(int))]; } control;
+
+	iovec iov = { (void*) data, size };
+	msghdr msg = {};
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	// Dołącz deskryptor do komunikatu
+	if (fd != -1)
+	{
+		msg.msg_control = control.buff;
+		msg.msg_controllen = sizeof(control.buff);
+
+		cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+
+	const ssize_t sc = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+
+	if (sc <= 0) return false;
+
+	// Resztę danych wyślij bez deskryptora
+	return send_all(sock, data + sc, size - sc, MSG_NOSIGNAL);
+}
+
+ssize_t SOCKBASE::recv_fd(int sock, char* data, size_t size, int& fd)
+{
+	// Miejsce na kilka deskryptorów - nadmiarowe zostaną zamknięte
+	union { cmsghdr align; char buff[CMSG_SPACE(8 * sizeof(int))]; } control;
+
+	iovec iov = { data, size };
+	msghdr msg = {};
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buff;
+	msg.msg_controllen = sizeof(control.buff);
+
+	fd = -1;
+
+	const ssize_t rc = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+
+	if (rc < 0) return rc;
+
+	// Przejmij pierwszy przekazany deskryptor (jeśli jest) - pozostałe
+	// zamknij, aby nadawca nie mógł wyczerpać deskryptorów procesu
+	for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+	{
+		if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+
+		const size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			int other;
+			memcpy(&other, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+
+			if (fd == -1) fd = other;
+			else ::close(other);
+		}
+	}
+
+	return rc;
+}
+
+ssize_t SOCKBASE::copy_fd(int out, int in, size_t size)
+{
+	// Kopiowanie w obrębie jądra (na niektórych systemach plików bez kopiowania danych)
+	ssize_t rc = ::copy_file_range(in, nullptr, out, nullptr, size, 0);
+
+	// Pliki z różnych systemów plików (np. memfd) przepisz przez `sendfile`
+	if (rc == -1 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP))
+		rc = ::sendfile(out, in, nullptr, size);
+
+	return rc;
+}
+
+bool SOCKBASE::write_all(int fd, const char* data, size_t size)
+{
+	// Gdy są jeszcze dane do zapisania
+	while (size > 0)
+	{
+		const ssize_t wc = ::write(fd, data, size);
+
+		// W przypadku błędu przerwij działanie
+		if (wc <= 0) return false;
+
+		data += wc; // Przesuń wskaźnik na dane
+		size -= wc; // Zmniejsz liczbę pozostałych danych
+	}
+
+	return true;
+}
+
+int64_t SOCKBASE::send_file(int sock, int fd, uint64_t size, const PROGRESS& progress)
+{
+	uint64_t count(0);
+
+	while (count < size)
+	{
+		// Mniejsze porcje pozwalają regularnie raportować postęp
+		const ssize_t rc = ::sendfile(sock, fd, nullptr, min<uint64_t>(size - count, 1 << 24));
+
+		if (rc > 0) count += rc;
+		else if (rc == 0) break; // Plik jest krótszy niż zapowiedziano
+		else if (errno == EINTR) continue;
+
+		// Plik nieobsługujący `sendfile` (np. potok) - przejdź na potok buforów
+		else if (count == 0 && (errno == EINVAL || errno == ENOSYS))
+		{
+			return PIPELINE::run(
+				[fd] (char* data, size_t n) { return ::read(fd, data, n); },
+				[sock, &progress, &count] (const char* data, size_t n)
+				{
+					if (!send_all(sock, data, n)) return false;
+					else if (progress) progress(count += n);
+
+					return true;
+				},
+				size);
+		}
+
+		else return -1;
+
+		if (progress) progress(count);
+	}
+
+	return count;
+}
+
+int64_t SOCKBASE::recv_file(int sock, int fd, uint64_t limit, const PROGRESS& progress)
+{
+	int pipes[2];
+	uint64_t count(0);
+
+	// Bez potoku jądra przesyłaj dane przez potok buforów
+	const auto fallback = [sock, fd, limit, &progress, &count] (void)
+	{
+		return PIPELINE::run(
+			[sock] (char* data, size_t n) { return ::recv(sock, data, n, 0); },
+			[fd, &progress, &count] (const char* data, size_t n)
+			{
+				if (!write_all(fd, data, n)) return false;
+				else if (progress) progress(count += n);
+
+				return true;
+			},
+			limit);
+	};
+
+	if (::pipe2(pipes, O_CLOEXEC) == -1) return fallback();
+
+	// Większy potok zmniejsza liczbę wywołań systemowych
+	::fcntl(pipes[1], F_SETPIPE_SZ, 1 << 20);
+
+	bool failed = false;
+	bool unsupported = false;
+
+	while (count < limit && !failed)
+	{
+		ssize_t rc = ::splice(sock, nullptr, pipes[1], nullptr,
+						  min<uint64_t>(limit - count, 1 << 20),
+						  SPLICE_F_MOVE | SPLICE_F_MORE);
+
+		if (rc == 0) break; // Połączenie zostało zamknięte
+		else if (rc < 0 && errno == EINTR) continue;
+		else if (rc < 0)
+		{
+			unsupported = count == 0 && errno == EINVAL;
+			failed = true;
+
+			break;
+		}
+
+		// Przenieś całą zawartość potoku do pliku
+		while (rc > 0)
+		{
+			const ssize_t wc = ::splice(pipes[0], nullptr, fd, nullptr, rc, SPLICE_F_MOVE | SPLICE_F_MORE);
+
+			if (wc > 0) { rc -= wc; count += wc; }
+			else if (wc < 0 && errno == EINTR) continue;
+			else { failed = true; break; }
+		}
+
+		if (progress && !failed) progress(count);
+	}
+
+	::close(pipes[0]);
+	::close(pipes[1]);
+
+	if (unsupported) return fallback();
+	else return failed ? -1 : int64_t(count);
+}
+
+int SOCKBASE::apply(int sock, ROLE role) const
+{
+	const auto set = [sock] (int level, int name, int value) -> int
+	{
+		return ::setsockopt(sock, level, name, &value, sizeof(value)) == -1;
+	};
+
+	const bool listening = role == ROLE::Listening;
+	int fails = 0;
+
+	// Bufory ustaw przed `listen`/`connect` - wpływają na skalowanie okna TCP,
+	// gniazda zaakceptowane dziedziczą je po gnieździe nasłuchującym
+	if (m_profile.sndbuf) fails += set(SOL_SOCKET, SO_SNDBUF, m_profile.sndbuf);
+	if (m_profile.rcvbuf) fails += set(SOL_SOCKET, SO_RCVBUF, m_profile.rcvbuf);
+
+	// Opcje dotyczące przesyłania danych
+	if (!listening)
+	{
+		if (m_profile.nodelay) fails += set(IPPROTO_TCP, TCP_NODELAY, 1);
+		if (m_profile.notsent_lowat) fails += set(IPPROTO_TCP, TCP_NOTSENT_LOWAT, m_profile.notsent_lowat);
+		if (m_profile.busy_poll) fails += set(SOL_SOCKET, SO_BUSY_POLL, m_profile.busy_poll);
+	}
+
+	// TCP Fast Open - kolejka po stronie serwera, dane w SYN po stronie klienta
+	if (m_profile.fastopen)
+	{
+		if (listening) fails += set(IPPROTO_TCP, TCP_FASTOPEN, m_profile.fastopen);
+		else if (role == ROLE::Connecting) fails += set(IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1);
+	}
+
+	return fails;
+}
+
+int SOCKBASE::cork_flags(void) const
+{
+	return m_profile.cork ? MSG_MORE : 0;
+}
+
+SOCKBASE::PROFILE SOCKBASE::PROFILE::bulk(void)
+{
+	PROFILE p;
+
+	p.sndbuf = 4 << 20;
+	p.rcvbuf = 4 << 20;
+	p.cork = 1;
+
+	return p;
+}
+
+SOCKBASE::PROFILE SOCKBASE::PROFILE::latency(void)
+{
+	PROFILE p;
+
+	p.nodelay = 1;
+	p.notsent_lowat = 16 << 10;
+	p.busy_poll = 50;
+	p.fastopen = 16;
+
+	return p;
+}
+
+bool SOCKBASE::PROFILE::parse(const std::string& spec, PROFILE& profile)
+{
+	size_t pos = spec.find(',');
+	const std::string name = spec.substr(0, pos);
+
+	// Wybierz profil bazowy
+	if (name == "bulk") profile = bulk();
+	else if (name == "latency") profile = latency();
+	else if (name == "default") profile = PROFILE();
+	else return false;
+
+	// Przetwórz kolejne nadpisania `opcja=wartość`
+	while (pos != std::string::npos)
+	{
+		const size_t next = spec.find(',', pos + 1);
+		const std::string item = spec.substr(pos + 1, next - pos - 1);
+		const size_t eq = item.find('=');
+
+		if (eq == std::string::npos) return false;
+
+		const std::string key = item.substr(0, eq);
+		const char* arg = item.c_str() + eq + 1;
+		char* end(nullptr);
+
+		// Wartość musi być nieujemną liczbą dziesiętną mieszczącą się w `int`
+		if (!isdigit((unsigned char) *arg)) return false;
+
+		errno = 0;
+		const long num = strtol(arg, &end, 10);
+
+		if (errno || *end || num > INT_MAX) return false;
+
+		const int value = num;
+
+		if (key == "sndbuf") profile.sndbuf = value;
+		else if (key == "rcvbuf") profile.rcvbuf = value;
+		else if (key == "nodelay") profile.nodelay = value;
+		else if (key == "cork") profile.cork = value;
+		else if (key == "notsent_lowat") profile.notsent_lowat = value;
+		else if (key == "busy_poll") profile.busy_poll = value;
+		else if (key == "fastopen") profile.fastopen = value;
+		else return false;
+
+		pos = next;
+	}
+
+	return true;
 }
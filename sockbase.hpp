@@ -29,16 +29,26 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/signal.h>
+#include <sys/sendfile.h>
+#include <sys/un.h>
 
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 
 #include <arpa/inet.h>
 
 #include <unistd.h>
 #include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
 #include <poll.h>
 #include <netdb.h>
 
+#include <functional>
+#include <string>
+
+#include "pipeline.hpp"
+
 /*! \brief Klasa bazowa.
  *
  *  Klasa reprezentująca wspólne części serwera i klienta.
@@ -47,10 +57,65 @@
 class SOCKBASE
 {
 
+	public:
+
+		/*! \brief Profil strojenia gniazd.
+		 *  \see set_profile.
+		 *
+		 *  Zbiór opcji gniazd stosowanych do gniazd nasłuchujących, zaakceptowanych
+		 *  i łączących się. Wartość zerowa oznacza pozostawienie ustawień systemu.
+		 *
+		 */
+		struct PROFILE
+		{
+			int sndbuf = 0; //!< Rozmiar bufora nadawczego (`SO_SNDBUF`).
+			int rcvbuf = 0; //!< Rozmiar bufora odbiorczego (`SO_RCVBUF`).
+			int nodelay = 0; //!< Wyłączenie algorytmu Nagle'a (`TCP_NODELAY`).
+			int cork = 0; //!< Łączenie nagłówka z danymi (`MSG_MORE`).
+			int notsent_lowat = 0; //!< Limit niewysłanych danych w buforze (`TCP_NOTSENT_LOWAT`).
+			int busy_poll = 0; //!< Czas aktywnego odpytywania w µs (`SO_BUSY_POLL`).
+			int fastopen = 0; //!< Kolejka TCP Fast Open serwera lub włączenie u klienta (`TCP_FASTOPEN`).
+
+			//! Profil dużej przepustowości (duże bufory, łączenie segmentów).
+			static PROFILE bulk(void);
+
+			//! Profil małych opóźnień (bez Nagle'a, odpytywanie, Fast Open).
+			static PROFILE latency(void);
+
+			/*! \brief Przetworzenie opisu profilu.
+			 *  \returns Powodzenie operacji.
+			 *  \param [in] spec Opis profilu.
+			 *  \param [out] profile Wynikowy profil.
+			 *
+			 *  Opis ma postać `nazwa[,opcja=wartość...]`, gdzie nazwa to `default`,
+			 *  `bulk` lub `latency`, a opcje nadpisują wartości wybranego profilu,
+			 *  np. `bulk,sndbuf=8388608,nodelay=1`.
+			 *
+			 */
+			static bool parse(const std::string& spec, PROFILE& profile);
+		};
+
+		/*! \brief Rola gniazda.
+		 *  \see apply.
+		 *
+		 *  Określa, które opcje profilu mają zastosowanie do gniazda.
+		 *
+		 */
+		enum class ROLE
+		{
+			Listening, //!< Gniazdo nasłuchujące serwera.
+			Accepted, //!< Gniazdo zaakceptowanego połączenia.
+			Connecting //!< Gniazdo klienta przed połączeniem.
+		};
+
+		using PROGRESS = function<void(uint64_t)>; //!< Funkcja informowana o łącznej liczbie przesłanych bajtów.
+
 	protected:
 
 		int m_sock = 0; //!< Gniazdo główne.
-		char m_buff[1024]; //!< Ogólny bufor na dane.
+		char m_buff[1 << 16]; //!< Ogólny bufor na dane.
+
+		PROFILE m_profile; //!< Profil strojenia gniazd.
 
 	public:
 
@@ -62,6 +127,27 @@ class SOCKBASE
 
 		void close(void); //!< Zamyka gniazdo.
 
+		/*! \brief Wybór profilu strojenia.
+		 *  \see PROFILE.
+		 *  \param [in] profile Profil strojenia.
+		 *
+		 *  Profil stosowany jest do gniazd tworzonych po jego wybraniu.
+		 *
+		 */
+		void set_profile(const PROFILE& profile);
+
+		//! Zwraca bieżący profil strojenia.
+		const PROFILE& get_profile(void) const;
+
+		/*! \brief Podział opisu punktu końcowego.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] spec Opis w postaci `adres:port` lub `[adres IPv6]:port`.
+		 *  \param [out] host Adres.
+		 *  \param [out] port Port.
+		 *
+		 */
+		static bool split_endpoint(const std::string& spec, std::string& host, uint16_t& port);
+
 		SOCKBASE& operator= (const SOCKBASE&) = delete; //!< Operator przypisania (kopia, usunięty)
 		SOCKBASE& operator= (SOCKBASE&&) = delete; //!< Operator przypisania (przeniesienie, usunięty)
 
@@ -72,12 +158,25 @@ class SOCKBASE
 		 *  \param [in] sock Deskryptor gniazda.
 		 *  \param [in] data Dane do wysłania.
 		 *  \param [in] size Liczba danych w bajtach.
+		 *  \param [in] flags Flagi funkcji `send` (np. `MSG_MORE`).
 		 *
 		 *  Wysyła wskazane dane ponawiając próbę w przypadku niepełnego wysyłania.
 		 *  Zwraca `true` w przypadku wysłania wszystkich danych lub `false` w przeciwnym razie.
 		 *
 		 */
-		static bool send_all(int sock, const char* data, size_t size);
+		static bool send_all(int sock, const char* data, size_t size, int flags = 0);
+
+		/*! \brief Odbieranie danych.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] sock Deskryptor gniazda.
+		 *  \param [out] data Bufor na dane.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Odbiera dokładnie wskazaną liczbę danych ponawiając próbę w przypadku niepełnego odbioru.
+		 *  Zwraca `true` w przypadku odebrania wszystkich danych lub `false` w przeciwnym razie.
+		 *
+		 */
+		static bool recv_all(int sock, char* data, size_t size);
 
 		/*! \brief Pobranie nazwy hosta.
 		 *  \returns Łańcuch nazwy hosta.
@@ -88,6 +187,114 @@ class SOCKBASE
 		 */
 		static char* get_name(int sock);
 
+		/*! \brief Adres gniazda lokalnego.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] path Ścieżka gniazda lub nazwa z prefiksem `@` (przestrzeń abstrakcyjna).
+		 *  \param [out] addr Struktura adresu.
+		 *  \param [out] len Długość adresu.
+		 *
+		 *  Wypełnia strukturę adresu gniazda `AF_UNIX`. Nazwy rozpoczynające się znakiem
+		 *  `@` umieszczane są w abstrakcyjnej przestrzeni nazw i nie tworzą pliku.
+		 *
+		 */
+		static bool unix_address(const std::string& path, sockaddr_un& addr, socklen_t& len);
+
+		/*! \brief Wysyłanie deskryptora.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] sock Deskryptor gniazda lokalnego.
+		 *  \param [in] fd Przekazywany deskryptor lub `-1`.
+		 *  \param [in] data Dane do wysłania (co najmniej jeden bajt).
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Wysyła dane wraz z deskryptorem pliku (`SCM_RIGHTS`). Deskryptor dołączany
+		 *  jest do pierwszego fragmentu danych.
+		 *
+		 */
+		static bool send_fd(int sock, int fd, const char* data, size_t size);
+
+		/*! \brief Odbieranie deskryptora.
+		 *  \returns Liczba odebranych bajtów, `0` po zamknięciu połączenia lub `-1` w przypadku błędu.
+		 *  \param [in] sock Deskryptor gniazda lokalnego.
+		 *  \param [out] data Bufor na dane.
+		 *  \param [in] size Rozmiar bufora.
+		 *  \param [out] fd Odebrany deskryptor lub `-1`, gdy nie został przekazany.
+		 *
+		 *  Odbiera dane tak jak `recv`, dodatkowo przejmując przekazany deskryptor.
+		 *  Gdy komunikat zawiera kilka deskryptorów, przejmowany jest pierwszy,
+		 *  a pozostałe są zamykane.
+		 *
+		 */
+		static ssize_t recv_fd(int sock, char* data, size_t size, int& fd);
+
+		/*! \brief Kopiowanie pomiędzy plikami.
+		 *  \returns Liczba skopiowanych bajtów, `0` na końcu pliku lub `-1` w przypadku błędu.
+		 *  \param [in] out Deskryptor pliku docelowego.
+		 *  \param [in] in Deskryptor pliku źródłowego.
+		 *  \param [in] size Maksymalna liczba bajtów.
+		 *
+		 *  Kopiuje dane od bieżących pozycji plików bez udziału przestrzeni użytkownika
+		 *  (`copy_file_range`, a dla różnych systemów plików `sendfile`).
+		 *
+		 */
+		static ssize_t copy_fd(int out, int in, size_t size);
+
+		/*! \brief Zapis danych do pliku.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] fd Deskryptor pliku.
+		 *  \param [in] data Dane do zapisania.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *
+		 *  Zapisuje wszystkie dane ponawiając próbę w przypadku niepełnego zapisu.
+		 *
+		 */
+		static bool write_all(int fd, const char* data, size_t size);
+
+		/*! \brief Wysyłanie pliku.
+		 *  \see PIPELINE.
+		 *  \returns Liczba wysłanych bajtów lub `-1` w przypadku błędu.
+		 *  \param [in] sock Deskryptor gniazda.
+		 *  \param [in] fd Deskryptor pliku (od bieżącej pozycji).
+		 *  \param [in] size Liczba bajtów do wysłania.
+		 *  \param [in] progress Funkcja informowana o liczbie wysłanych bajtów (opcjonalna).
+		 *
+		 *  Wysyła dane bez kopiowania do przestrzeni użytkownika (`sendfile`). Gdy
+		 *  plik nie obsługuje `sendfile`, dane przesyłane są potokiem buforów.
+		 *  Wynik mniejszy niż `size` oznacza, że plik jest krótszy.
+		 *
+		 */
+		static int64_t send_file(int sock, int fd, uint64_t size,
+							const PROGRESS& progress = nullptr);
+
+		/*! \brief Odbiór do pliku.
+		 *  \see PIPELINE.
+		 *  \returns Liczba odebranych bajtów lub `-1` w przypadku błędu.
+		 *  \param [in] sock Deskryptor gniazda.
+		 *  \param [in] fd Deskryptor pliku (od bieżącej pozycji).
+		 *  \param [in] limit Maksymalna liczba bajtów.
+		 *  \param [in] progress Funkcja informowana o liczbie odebranych bajtów (opcjonalna).
+		 *
+		 *  Przenosi dane z gniazda do pliku przez potok jądra (`splice`) do
+		 *  zamknięcia połączenia lub osiągnięcia limitu. Gdy `splice` nie jest
+		 *  dostępne, dane przesyłane są potokiem buforów.
+		 *
+		 */
+		static int64_t recv_file(int sock, int fd, uint64_t limit = UINT64_MAX,
+							const PROGRESS& progress = nullptr);
+
+		/*! \brief Zastosowanie profilu.
+		 *  \returns Liczba opcji, których nie udało się ustawić.
+		 *  \param [in] sock Deskryptor gniazda.
+		 *  \param [in] role Rola gniazda.
+		 *
+		 *  Ustawia opcje profilu właściwe dla roli gniazda. Błędy pojedynczych opcji
+		 *  (np. brak uprawnień do `SO_BUSY_POLL`) nie przerywają działania.
+		 *
+		 */
+		int apply(int sock, ROLE role) const;
+
+		//! Zwraca flagi `send` dla danych, po których nastąpią kolejne (łączenie segmentów).
+		int cork_flags(void) const;
+
 };
 
 #endif // SOCKBASE_HPP
@@ -0,0 +1,96 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy przesyłania plików rzadkich.
+ *  \file
+ *
+ */
+
+#include "sparse.hpp"
+
+bool SPARSE::next(int fd, uint64_t pos, uint64_t size, uint64_t& data, uint64_t& end)
+{
+	data = end = size;
+
+	if (pos >= size) return true;
+
+	const off_t d = ::lseek(fd, pos, SEEK_DATA);
+
+	// Brak danych do końca pliku
+	if (d == -1 && errno == ENXIO) return true;
+
+	// System plików nie rozróżnia dziur - wyślij resztę pliku jako dane
+	else if (d == -1 && errno == EINVAL) { data = pos; return true; }
+
+	else if (d == -1) return false;
+
+	const off_t h = ::lseek(fd, d, SEEK_HOLE);
+
+	if (h == -1) return false;
+
+	// Plik mógł urosnąć od pobrania rozmiaru - wyślij jedynie zapowiedzianą część
+	data = min<uint64_t>(d, size);
+	end = min<uint64_t>(h, size);
+
+	return true;
+}
+
+void SPARSE::put(vector<char>& out, TYPE type, uint64_t offset, uint64_t length)
+{
+	WIRE::put8(out, type);
+	WIRE::put64(out, offset);
+	WIRE::put64(out, length);
+}
+
+bool SPARSE::punch(int fd, uint64_t offset, uint64_t length)
+{
+	if (length == 0) return true;
+	else if (::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, length) == 0) return true;
+	else if (errno != EOPNOTSUPP) return false;
+
+	static const char zero[1 << 16] = {};
+
+	// Zapisz obszar zerami, gdy dziury nie są obsługiwane
+	while (length > 0)
+	{
+		const size_t n = min<uint64_t>(length, sizeof(zero));
+
+		if (!write_at(fd, zero, n, offset)) return false;
+
+		offset += n;
+		length -= n;
+	}
+
+	return true;
+}
+
+bool SPARSE::write_at(int fd, const char* data, size_t size, uint64_t offset)
+{
+	while (size > 0)
+	{
+		const ssize_t rc = ::pwrite(fd, data, size, offset);
+
+		if (rc > 0) { data += rc; size -= rc; offset += rc; }
+		else if (rc < 0 && errno == EINTR) continue;
+		else return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,119 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy przesyłania plików rzadkich.
+ *  \file
+ *
+ */
+
+#ifndef SPARSE_HPP
+#define SPARSE_HPP
+
+#include "wire.hpp"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+/*! \brief Klasa przesyłania plików rzadkich.
+ *
+ *  Plik rzadki przesyłany jest jako ciąg rekordów opisujących kolejne obszary
+ *  pliku. Rekord składa się z typu (8 b), pozycji w pliku (64 b) i długości
+ *  obszaru (64 b). Za rekordem danych następuje `length` bajtów pliku, rekord
+ *  dziury nie niesie danych, a rekord zakończenia podaje w polu pozycji rozmiar
+ *  pliku. Obszary wyznaczane są funkcją `lseek` (`SEEK_DATA` i `SEEK_HOLE`),
+ *  dzięki czemu przez sieć i na dysk trafiają jedynie dane.
+ *
+ */
+class SPARSE
+{
+
+	public:
+
+		/*! \brief Typ rekordu.
+		 *
+		 *  Pierwszy bajt rekordu.
+		 *
+		 */
+		enum TYPE : char
+		{
+			Data = 'D', //!< Obszar danych (za rekordem następują dane).
+			Hole = 'H', //!< Dziura (obszar bez danych).
+			End = 'E' //!< Koniec pliku (pozycja oznacza rozmiar pliku).
+		};
+
+		static constexpr size_t header = 17; //!< Rozmiar rekordu w bajtach.
+
+		/*! \brief Wyszukanie obszaru danych.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] fd Deskryptor pliku.
+		 *  \param [in] pos Pozycja początkowa.
+		 *  \param [in] size Rozmiar pliku.
+		 *  \param [out] data Początek kolejnego obszaru danych.
+		 *  \param [out] end Koniec obszaru danych (początek kolejnej dziury).
+		 *
+		 *  Gdy za pozycją nie ma już danych, obie wartości są równe `size`. System
+		 *  plików bez obsługi `SEEK_DATA` traktowany jest tak, jakby cały plik był
+		 *  jednym obszarem danych. Zmienia pozycję pliku.
+		 *
+		 */
+		static bool next(int fd, uint64_t pos, uint64_t size,
+					  uint64_t& data, uint64_t& end);
+
+		/*! \brief Zapis rekordu.
+		 *  \param [out] out Bufor docelowy.
+		 *  \param [in] type Typ rekordu.
+		 *  \param [in] offset Pozycja w pliku.
+		 *  \param [in] length Długość obszaru.
+		 *
+		 */
+		static void put(vector<char>& out, TYPE type,
+					 uint64_t offset, uint64_t length);
+
+		/*! \brief Usunięcie danych obszaru.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] fd Deskryptor pliku.
+		 *  \param [in] offset Pozycja w pliku.
+		 *  \param [in] length Długość obszaru.
+		 *
+		 *  Zwalnia bloki obszaru (`FALLOC_FL_PUNCH_HOLE`) bez zmiany rozmiaru
+		 *  pliku. Gdy system plików nie obsługuje dziur, zapisuje obszar zerami.
+		 *
+		 */
+		static bool punch(int fd, uint64_t offset, uint64_t length);
+
+		/*! \brief Zapis danych pod wskazaną pozycją.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] fd Deskryptor pliku.
+		 *  \param [in] data Dane.
+		 *  \param [in] size Liczba danych w bajtach.
+		 *  \param [in] offset Pozycja w pliku.
+		 *
+		 */
+		static bool write_at(int fd, const char* data, size_t size, uint64_t offset);
+
+};
+
+#endif // SPARSE_HPP
@@ -0,0 +1,172 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy śledzenia opóźnień.
+ *  \file
+ *
+ */
+
+#include "tracer.hpp"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <fcntl.h>
+
+#include <thread>
+#include <chrono>
+
+TRACER::TRACER(void) {}
+
+TRACER::~TRACER(void)
+{
+	close(); // Zapisz oczekujące zdarzenia
+}
+
+bool TRACER::open(const string& path, unsigned rate)
+{
+	if (is_open() || rate == 0) return false;
+
+	m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (m_fd == -1) return false;
+
+	m_pid = ::getpid();
+	m_rate = rate;
+	m_count = 0;
+	m_first = true;
+	m_out = "[\n";
+
+	// Wstępna kalibracja - kolejne sesje korzystają z coraz dłuższego przedziału
+	m_tick0 = now();
+	m_nsec0 = nsec();
+
+	this_thread::sleep_for(chrono::milliseconds(10));
+	calibrate();
+
+	return true;
+}
+
+void TRACER::close(void)
+{
+	if (!is_open()) return;
+
+	// Tablica bez zamknięcia jest również akceptowana (np. po awarii procesu)
+	m_out += "\n]\n";
+	flush();
+
+	::close(m_fd);
+
+	m_fd = -1;
+	m_rate = 0;
+}
+
+bool TRACER::is_open(void) const
+{
+	return m_fd != -1;
+}
+
+void TRACER::finish(SPAN& span, int sock, uint64_t serial)
+{
+	if (!span.active) return;
+
+	static const char* const names[] = { "wait header", "open", "first byte", "transfer", "close" };
+
+	span.stamp[Close] = now();
+	calibrate();
+
+	event(span.command.empty() ? "(no request)" : span.command, "session",
+		 span.stamp[Accept], span.stamp[Close], sock, serial);
+
+	// Etapy, które nie wystąpiły, dołączane są do kolejnego etapu
+	for (int p = Accept, n = Header; n < Phases; ++n) if (span.stamp[n])
+	{
+		event(names[n - 1], "phase", span.stamp[p], span.stamp[n], sock, serial);
+		p = n;
+	}
+
+	span = SPAN();
+
+	if (m_out.size() >= flush_size) flush();
+}
+
+uint64_t TRACER::nsec(void)
+{
+	timespec ts;
+	::clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void TRACER::calibrate(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	const uint64_t ticks = now() - m_tick0;
+	const uint64_t nanos = nsec() - m_nsec0;
+
+	if (ticks) m_scale = double(nanos) / ticks;
+#endif
+}
+
+void TRACER::event(const string& name, const char* cat, uint64_t from, uint64_t to,
+			    int sock, uint64_t serial)
+{
+	char buff[256];
+
+	const double ts = (from - m_tick0) * m_scale / 1000.0;
+	const double dur = (to - from) * m_scale / 1000.0;
+
+	if (!m_first) m_out += ",\n";
+	else m_first = false;
+
+	m_out += "{\"name\":\"";
+
+	// Nazwy plików mogą zawierać dowolne znaki
+	for (const char c : name)
+	{
+		if (c == '"' || c == '\\') { m_out += '\\'; m_out += c; }
+		else if (uint8_t(c) < 0x20)
+		{
+			snprintf(buff, sizeof(buff), "\\u%04x", c);
+			m_out += buff;
+		}
+		else m_out += c;
+	}
+
+	snprintf(buff, sizeof(buff), "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+		    "\"pid\":%d,\"tid\":%d,\"args\":{\"serial\":%llu}}",
+		    cat, ts, dur, m_pid, sock, (unsigned long long) serial);
+
+	m_out += buff;
+}
+
+void TRACER::flush(void)
+{
+	size_t done = 0;
+
+	while (done < m_out.size())
+	{
+		const ssize_t rc = ::write(m_fd, m_out.data() + done, m_out.size() - done);
+
+		if (rc <= 0) break;
+		else done += rc;
+	}
+
+	m_out.clear();
+}
@@ -0,0 +1,206 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy śledzenia opóźnień.
+ *  \file
+ *
+ */
+
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+
+using namespace std;
+
+/*! \brief Klasa śledzenia opóźnień.
+ *
+ *  Zapisuje chwile kolejnych etapów wybranych sesji: przyjęcie połączenia,
+ *  skompletowanie nagłówka, otwarcie pliku, pierwszy i ostatni bajt danych
+ *  oraz zamknięcie połączenia. Zakończone sesje zapisywane są do pliku w
+ *  formacie zdarzeń Chrome (`chrome://tracing`, Perfetto) - każda sesja to
+ *  zdarzenie obejmujące całe połączenie oraz zdarzenia jego etapów.
+ *
+ *  Czas odczytywany jest licznikiem `rdtsc` (tam, gdzie jest dostępny) lub
+ *  zegarem monotonicznym i przeliczany na mikrosekundy dopiero przy zapisie.
+ *  Gdy śledzenie jest wyłączone lub sesja nie została wylosowana, każdy etap
+ *  kosztuje jedynie sprawdzenie flagi sesji.
+ *
+ */
+class TRACER
+{
+
+	public:
+
+		/*! \brief Etap sesji.
+		 *
+		 *  Indeks chwili w opisie sesji.
+		 *
+		 */
+		enum PHASE
+		{
+			Accept, //!< Przyjęcie połączenia.
+			Header, //!< Skompletowanie nagłówka.
+			Open, //!< Otwarcie pliku (rozpoczęcie polecenia).
+			First, //!< Pierwszy bajt danych.
+			Last, //!< Ostatni bajt danych.
+			Close, //!< Zamknięcie połączenia.
+			Phases //!< Liczba etapów.
+		};
+
+		/*! \brief Opis sesji.
+		 *
+		 *  Chwile etapów śledzonej sesji (zero oznacza etap, który nie wystąpił).
+		 *
+		 */
+		struct SPAN
+		{
+			bool active = false; //!< Flaga śledzenia sesji.
+			uint64_t stamp[Phases] = {}; //!< Chwile etapów w jednostkach licznika.
+
+			string command; //!< Polecenie i nazwa pliku.
+		};
+
+		static constexpr size_t flush_size = 1 << 16; //!< Rozmiar bufora zapisywanego do pliku.
+
+	protected:
+
+		int m_fd = -1; //!< Deskryptor pliku zdarzeń.
+		int m_pid = 0; //!< Numer procesu (proces zdarzeń).
+		unsigned m_rate = 0; //!< Śledzona co `m_rate` sesja (`0` - śledzenie wyłączone).
+		unsigned m_count = 0; //!< Licznik sesji do losowania.
+		bool m_first = true; //!< Flaga braku zapisanych zdarzeń.
+
+		uint64_t m_tick0 = 0; //!< Licznik w chwili otwarcia.
+		uint64_t m_nsec0 = 0; //!< Czas monotoniczny w chwili otwarcia.
+		double m_scale = 1.0; //!< Liczba nanosekund na jednostkę licznika.
+
+		string m_out; //!< Zdarzenia oczekujące na zapis.
+
+	public:
+
+		explicit TRACER(void); //!< Konstruktor domyślny.
+		virtual ~TRACER(void); //!< Destruktor, zamyka plik zdarzeń.
+
+		TRACER(const TRACER&) = delete; //!< Konstruktor kopiujący (usunięty).
+		TRACER& operator= (const TRACER&) = delete; //!< Operator przypisania (usunięty).
+
+		/*! \brief Rozpoczęcie śledzenia.
+		 *  \returns Powodzenie operacji.
+		 *  \param [in] path Ścieżka pliku zdarzeń.
+		 *  \param [in] rate Śledzona co `rate` sesja.
+		 *
+		 *  Tworzy plik zdarzeń i wyznacza częstotliwość licznika.
+		 *
+		 */
+		bool open(const string& path, unsigned rate = 1);
+
+		//! Zapisuje oczekujące zdarzenia i zamyka plik zdarzeń.
+		void close(void);
+
+		//! Sprawdza, czy śledzenie zostało włączone.
+		bool is_open(void) const;
+
+		/*! \brief Rozpoczęcie sesji.
+		 *  \param [out] span Opis sesji.
+		 *
+		 *  Losuje sesję do śledzenia i zapisuje chwilę przyjęcia połączenia.
+		 *
+		 */
+		void begin(SPAN& span)
+		{
+			span.active = m_rate && ++m_count % m_rate == 0;
+
+			if (span.active) span.stamp[Accept] = now();
+		}
+
+		/*! \brief Zapis etapu.
+		 *  \param [in,out] span Opis sesji.
+		 *  \param [in] phase Etap sesji (zapisywany jedynie za pierwszym razem).
+		 *
+		 */
+		static void mark(SPAN& span, PHASE phase)
+		{
+			if (span.active && !span.stamp[phase]) span.stamp[phase] = now();
+		}
+
+		/*! \brief Zapis przesłania danych.
+		 *  \param [in,out] span Opis sesji.
+		 *
+		 *  Zapisuje chwilę pierwszego i ostatniego przesłanego bajtu.
+		 *
+		 */
+		static void data(SPAN& span)
+		{
+			if (!span.active) return;
+
+			span.stamp[Last] = now();
+
+			if (!span.stamp[First]) span.stamp[First] = span.stamp[Last];
+		}
+
+		/*! \brief Zakończenie sesji.
+		 *  \param [in,out] span Opis sesji.
+		 *  \param [in] sock Gniazdo połączenia (wątek zdarzeń).
+		 *  \param [in] serial Numer połączenia.
+		 *
+		 *  Zapisuje zdarzenia śledzonej sesji i przywraca opis do stanu początkowego.
+		 *
+		 */
+		void finish(SPAN& span, int sock, uint64_t serial);
+
+		//! Odczytuje licznik czasu.
+		static uint64_t now(void)
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			timespec ts;
+			::clock_gettime(CLOCK_MONOTONIC, &ts);
+
+			return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+#endif
+		}
+
+	protected:
+
+		//! Zwraca czas monotoniczny w nanosekundach.
+		static uint64_t nsec(void);
+
+		//! Wyznacza częstotliwość licznika na podstawie czasu od otwarcia.
+		void calibrate(void);
+
+		//! Zapisuje zdarzenie obejmujące przedział czasu.
+		void event(const string& name, const char* cat, uint64_t from, uint64_t to,
+				 int sock, uint64_t serial);
+
+		//! Zapisuje oczekujące zdarzenia do pliku.
+		void flush(void);
+
+};
+
+#endif // TRACER_HPP
@@ -0,0 +1,131 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik źródłowy obserwatora systemu plików.
+ *  \file
+ *
+ */
+
+#include "watcher.hpp"
+
+WATCHER::WATCHER(void) {}
+
+WATCHER::~WATCHER(void)
+{
+	close(); // Zamknij deskryptor
+}
+
+bool WATCHER::open(void)
+{
+	if (m_fd == -1) m_fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	return m_fd != -1;
+}
+
+void WATCHER::close(void)
+{
+	if (m_fd != -1) ::close(m_fd);
+
+	m_watches.clear();
+	m_targets.clear();
+	m_fd = -1;
+}
+
+int WATCHER::watch(const string& path, uint32_t mask, const CALLBACK& callback)
+{
+	if (m_fd == -1) return -1;
+
+	// Sumuj maski - ta sama ścieżka daje ten sam deskryptor obserwacji
+	const int wd = ::inotify_add_watch(m_fd, path.c_str(), mask | IN_MASK_ADD);
+
+	if (wd == -1) return -1;
+
+	m_watches.insert({ m_next, { wd, mask, callback } });
+	m_targets[wd].push_back(m_next);
+
+	return m_next++;
+}
+
+void WATCHER::unwatch(int id)
+{
+	const auto it = m_watches.find(id);
+
+	if (it == m_watches.end()) return;
+
+	const int wd = it->second.wd;
+	auto& ids = m_targets[wd];
+
+	m_watches.erase(it);
+	ids.erase(find(ids.begin(), ids.end(), id));
+
+	// Gdy nikt już nie obserwuje ścieżki zakończ obserwację
+	if (!ids.empty()) return;
+
+	m_targets.erase(wd);
+	::inotify_rm_watch(m_fd, wd);
+}
+
+void WATCHER::dispatch(void)
+{
+	alignas(inotify_event) char buff[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+	ssize_t len;
+
+	// Odczytuj zdarzenia aż do opróżnienia kolejki
+	while ((len = ::read(m_fd, buff, sizeof(buff))) > 0)
+	{
+		for (char* p = buff; p < buff + len; )
+		{
+			const auto* ev = (const inotify_event*) p;
+			const string name = ev->len ? ev->name : "";
+
+			// Zbierz pasujące rejestracje - funkcje zwrotne mogą je modyfikować
+			vector<int> ids;
+
+			if (ev->mask & IN_Q_OVERFLOW)
+				for (const auto& [id, w] : m_watches) ids.push_back(id);
+			else if (const auto t = m_targets.find(ev->wd); t != m_targets.end())
+				for (const int id : t->second)
+					if (m_watches.at(id).mask & ev->mask) ids.push_back(id);
+
+			for (const int id : ids)
+			{
+				const auto it = m_watches.find(id);
+
+				if (it != m_watches.end())
+				{
+					const auto callback = it->second.callback;
+					callback(ev->mask, name);
+				}
+			}
+
+			p += sizeof(inotify_event) + ev->len;
+		}
+	}
+}
+
+int WATCHER::fd(void) const
+{
+	return m_fd;
+}
+
+bool WATCHER::is_open(void) const
+{
+	return m_fd != -1;
+}
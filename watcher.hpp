@@ -0,0 +1,140 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy obserwatora systemu plików.
+ *  \file
+ *
+ */
+
+#ifndef WATCHER_HPP
+#define WATCHER_HPP
+
+#include <sys/inotify.h>
+
+#include <unistd.h>
+#include <limits.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+/*! \brief Klasa obserwatora systemu plików.
+ *
+ *  Opakowanie mechanizmu `inotify`. Pozwala wielu modułom serwera obserwować
+ *  te same ścieżki - każda rejestracja posiada własną funkcję zwrotną i maskę
+ *  zdarzeń. Deskryptor obserwatora dodawany jest do listy `poll` serwera, a
+ *  zdarzenia obsługiwane są w pętli głównej metodą `dispatch` - każde trafia
+ *  jedynie do rejestracji swojego deskryptora obserwacji.
+ *
+ */
+class WATCHER
+{
+
+	public:
+
+		/*! \brief Funkcja zwrotna zdarzenia.
+		 *
+		 *  Otrzymuje maskę zdarzenia oraz nazwę pliku w obserwowanym katalogu
+		 *  (pustą dla zdarzeń dotyczących samej obserwowanej ścieżki).
+		 *
+		 */
+		using CALLBACK = function<void(uint32_t mask, const string& name)>;
+
+	protected:
+
+		/*! \brief Opis rejestracji.
+		 *
+		 *  Wiąże deskryptor obserwacji `inotify` z funkcją zwrotną.
+		 *
+		 */
+		struct WATCH
+		{
+			int wd; //!< Deskryptor obserwacji.
+			uint32_t mask; //!< Maska interesujących zdarzeń.
+			CALLBACK callback; //!< Funkcja zwrotna.
+		};
+
+		int m_fd = -1; //!< Deskryptor `inotify`.
+		int m_next = 1; //!< Identyfikator kolejnej rejestracji.
+
+		map<int, WATCH> m_watches; //!< Rejestracje według identyfikatora.
+		map<int, vector<int>> m_targets; //!< Identyfikatory rejestracji według deskryptora obserwacji.
+
+	public:
+
+		explicit WATCHER(void); //!< Konstruktor domyślny.
+		virtual ~WATCHER(void); //!< Destruktor, zamyka deskryptor.
+
+		WATCHER(const WATCHER&) = delete; //!< Konstruktor kopiujący (usunięty).
+		WATCHER& operator= (const WATCHER&) = delete; //!< Operator przypisania (usunięty).
+
+		/*! \brief Inicjacja obserwatora.
+		 *  \returns Powodzenie operacji.
+		 *
+		 *  Tworzy nieblokujący deskryptor `inotify`.
+		 *
+		 */
+		bool open(void);
+
+		//! Zamyka deskryptor i usuwa wszystkie rejestracje.
+		void close(void);
+
+		/*! \brief Rejestracja obserwacji.
+		 *  \returns Identyfikator rejestracji lub `-1` w przypadku błędu.
+		 *  \param [in] path Obserwowana ścieżka.
+		 *  \param [in] mask Maska zdarzeń (`IN_*`).
+		 *  \param [in] callback Funkcja zwrotna.
+		 *
+		 *  Dodaje obserwację ścieżki. Maski kolejnych rejestracji tej samej
+		 *  ścieżki są sumowane.
+		 *
+		 */
+		int watch(const string& path, uint32_t mask, const CALLBACK& callback);
+
+		/*! \brief Usunięcie rejestracji.
+		 *  \param [in] id Identyfikator rejestracji.
+		 *
+		 *  Usuwa rejestrację, a gdy była ostatnią dla danej ścieżki kończy jej obserwację.
+		 *  Może być wywołana z funkcji zwrotnej.
+		 *
+		 */
+		void unwatch(int id);
+
+		/*! \brief Obsługa zdarzeń.
+		 *
+		 *  Odczytuje wszystkie oczekujące zdarzenia i wywołuje funkcje zwrotne.
+		 *  Przepełnienie kolejki (`IN_Q_OVERFLOW`) przekazywane jest wszystkim rejestracjom.
+		 *
+		 */
+		void dispatch(void);
+
+		//! Zwraca deskryptor `inotify` do monitorowania funkcją `poll`.
+		int fd(void) const;
+
+		//! Sprawdza, czy obserwator został zainicjowany.
+		bool is_open(void) const;
+
+};
+
+#endif // WATCHER_HPP
@@ -0,0 +1,126 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *                                                                         *
+ *  Simple file transfer project example                                   *
+ *  Copyright (C) 2021  Łukasz "Kuszki" Dróżdż  lukasz.kuszki@gmail.com    *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the  Free Software Foundation, either  version 3 of the  License, or   *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This  program  is  distributed  in the hope  that it will be useful,   *
+ *  but WITHOUT ANY  WARRANTY;  without  even  the  implied  warranty of   *
+ *  MERCHANTABILITY  or  FITNESS  FOR  A  PARTICULAR  PURPOSE.  See  the   *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have  received a copy  of the  GNU General Public License   *
+ *  along with this program. If not, see http://www.gnu.org/licenses/.     *
+ *                                                                         *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*! \brief Plik nagłówkowy kodowania danych binarnych.
+ *  \file
+ *
+ */
+
+#ifndef WIRE_HPP
+#define WIRE_HPP
+
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+/*! \brief Klasa kodowania danych.
+ *
+ *  Zbiór funkcji zapisujących i odczytujących liczby całkowite w sieciowej
+ *  kolejności bajtów. Wykorzystywana przez wszystkie binarne części protokołu.
+ *
+ */
+class WIRE
+{
+
+	public:
+
+		/*! \brief Zapis liczby 8-bitowej.
+		 *  \param [out] out Bufor docelowy.
+		 *  \param [in] v Wartość do zapisania.
+		 *
+		 *  Dopisuje wartość na koniec bufora.
+		 *
+		 */
+		static void put8(std::vector<char>& out, uint8_t v)
+		{
+			out.push_back(char(v));
+		}
+
+		/*! \brief Zapis liczby 16-bitowej.
+		 *  \param [out] out Bufor docelowy.
+		 *  \param [in] v Wartość do zapisania.
+		 *
+		 *  Dopisuje wartość na koniec bufora w sieciowej kolejności bajtów.
+		 *
+		 */
+		static void put16(std::vector<char>& out, uint16_t v)
+		{
+			v = htobe16(v);
+			out.insert(out.end(), (const char*) &v, (const char*) &v + sizeof(v));
+		}
+
+		/*! \brief Zapis liczby 32-bitowej.
+		 *  \param [out] out Bufor docelowy.
+		 *  \param [in] v Wartość do zapisania.
+		 *
+		 *  Dopisuje wartość na koniec bufora w sieciowej kolejności bajtów.
+		 *
+		 */
+		static void put32(std::vector<char>& out, uint32_t v)
+		{
+			v = htobe32(v);
+			out.insert(out.end(), (const char*) &v, (const char*) &v + sizeof(v));
+		}
+
+		/*! \brief Zapis liczby 64-bitowej.
+		 *  \param [out] out Bufor docelowy.
+		 *  \param [in] v Wartość do zapisania.
+		 *
+		 *  Dopisuje wartość na koniec bufora w sieciowej kolejności bajtów.
+		 *
+		 */
+		static void put64(std::vector<char>& out, uint64_t v)
+		{
+			v = htobe64(v);
+			out.insert(out.end(), (const char*) &v, (const char*) &v + sizeof(v));
+		}
+
+		//! Odczytuje liczbę 8-bitową spod wskazanego adresu.
+		static uint8_t get8(const char* in)
+		{
+			return uint8_t(*in);
+		}
+
+		//! Odczytuje liczbę 16-bitową spod wskazanego adresu.
+		static uint16_t get16(const char* in)
+		{
+			uint16_t v; memcpy(&v, in, sizeof(v));
+			return be16toh(v);
+		}
+
+		//! Odczytuje liczbę 32-bitową spod wskazanego adresu.
+		static uint32_t get32(const char* in)
+		{
+			uint32_t v; memcpy(&v, in, sizeof(v));
+			return be32toh(v);
+		}
+
+		//! Odczytuje liczbę 64-bitową spod wskazanego adresu.
+		static uint64_t get64(const char* in)
+		{
+			uint64_t v; memcpy(&v, in, sizeof(v));
+			return be64toh(v);
+		}
+
+};
+
+#endif // WIRE_HPP